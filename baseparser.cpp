@@ -3,25 +3,35 @@
 #include "baseparser.h"
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
+#include <algorithm>
 
-#ifdef _WIN32
-#	include <direct.h>
-#else
-#	include <libgen.h>
-#	include <unistd.h>
-#	include <limits.h>
-#	define _chdir chdir
-#endif
 
 //======================================================================
 //
 //======================================================================
-BaseParser::BaseParser(std::unique_ptr<SymbolTable> symbolTable)
+BaseParser::BaseParser(std::unique_ptr<SymbolTable> symbolTable, MemoryResource *pResource)
 {
+	m_pResource		= pResource ? pResource : getDefaultResource();
 	m_lexer			= nullptr;
 	m_errorCount	= 0;
 	m_warningCount	= 0;
 	m_pSymbolTable	= std::move(symbolTable);
+	m_pSink			= nullptr;
+	m_errorLimit	= 0;
+	m_parseDepth	= 0;
+	m_aborted		= false;
+	m_pProfiler		= nullptr;
+	m_pTree			= nullptr;
+
+	m_limitExceeded		= ParseLimits::None;
+	m_nesting			= 0;
+	m_tokensMatched		= 0;
+	m_nextCheck			= UINT64_MAX;
+	m_bytesAtStart		= 0;
+	m_symbolsInstalled	= 0;
+
+	resetSpeculation();
 }
 
 //
@@ -30,76 +40,121 @@ BaseParser::~BaseParser()
 	//m_pSymbolTable->dumpUnreferencedSymbolsAtCurrentLevel();
 }
 
+//======================================================================
+// Every error and warning ends up here. With a sink the message stays
+// unformatted unless the sink wants the text; without one it is
+// formatted and handed to the lexer as it always was.
+//======================================================================
+void BaseParser::vreport(Severity severity, int code, const char *file, int line, int column, const char *fmt, va_list args)
+{
+	// a trial parse that goes wrong just fails
+	if (m_trying)
+	{
+		if (severity >= Severity::Error)
+			throw ParseBacktrack();
+		return;
+	}
+
+	if (severity >= Severity::Error)
+		m_errorCount++;
+	else if (severity == Severity::Warning)
+		m_warningCount++;
+
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+
+	Diagnostic diag;
+	diag.severity	= severity;
+	diag.code		= code;
+	diag.file		= file ? file : "";
+	diag.line		= line;
+	diag.column		= column;
+	diag.fmt		= fmt;
+	diag.pArgs		= &argsCopy;
+
+	if (m_pSink)
+	{
+		m_pSink->report(diag);
+	}
+	else
+	{
+		char s[SMALL_BUFFER];
+
+		diag.render(s, sizeof(s) - 2);
+		strcat(s, "\r\n");
+
+		// delegate messages to the lexical analyzer
+		if (severity >= Severity::Error)
+			m_lexer->yyerror(s);
+		else
+			m_lexer->yywarning(s);
+	}
+
+	va_end(argsCopy);
+
+	bool overLimit = m_errorLimit && m_errorCount >= m_errorLimit;
+	if ((severity == Severity::Fatal || overLimit) && m_parseDepth > 0)
+		throw ParseAbort();
+}
+
 // the parser calls this method to report errors
 void BaseParser::yyerror(const Position &pos, const char *fmt, ...)
 {
-	char buf[SMALL_BUFFER], s[SMALL_BUFFER];
 	va_list argptr;
 
 	va_start(argptr, fmt);
-		vsnprintf(buf, sizeof(buf), fmt, argptr);
+		vreport(Severity::Error, 0, pos.srcFile.c_str(), pos.srcLine, pos.srcColumn, fmt, argptr);
 	va_end(argptr);
-
-	snprintf(s, sizeof(s), "%s(%d) : error near column %d: %s\r\n", pos.srcFile.c_str(), pos.srcLine, pos.srcColumn, buf);
-
-	m_errorCount++;
-
-	// delegate error messages to the lexical analyzer
-	m_lexer->yyerror(s);
 }
 
 // the parser calls this method to report errors
 void BaseParser::yyerror(const char *fmt, ...)
 {
-	char buf[SMALL_BUFFER], s[SMALL_BUFFER];
 	va_list argptr;
 
 	va_start(argptr, fmt);
-		vsnprintf(buf, sizeof(buf), fmt, argptr);
+		vreport(Severity::Error, 0, m_lexer->getFileName(), getLine(), getColumn(), fmt, argptr);
 	va_end(argptr);
-
-	snprintf(s, sizeof(s), "%s(%d) : error near column %d: %s\r\n", m_lexer->getFile().c_str(), m_lexer->getLineNumber(), m_lexer->getColumn(), buf);
-
-	m_errorCount++;
-
-	// delegate error messages to the lexical analyzer
-	m_lexer->yyerror(s);
 }
 
 // print a warning message
 void BaseParser::yywarning(const Position &pos, const char *fmt, ...)
 {
-	char buf[SMALL_BUFFER], s[SMALL_BUFFER];
 	va_list argptr;
 
 	va_start(argptr, fmt);
-		vsnprintf(buf, sizeof(buf), fmt, argptr);
+		vreport(Severity::Warning, 0, pos.srcFile.c_str(), pos.srcLine, pos.srcColumn, fmt, argptr);
 	va_end(argptr);
-
-	snprintf(s, sizeof(s), "%s(%d) : warning near column %d: %s\r\n", pos.srcFile.c_str(), pos.srcLine, pos.srcColumn, buf);
-
-	m_warningCount++;
-
-	// delegate error messages to the lexical analyzer
-	m_lexer->yywarning(s);
 }
 
 // print a warning message
 void BaseParser::yywarning(const char *fmt, ...)
 {
-	char buf[SMALL_BUFFER], s[SMALL_BUFFER];
 	va_list argptr;
 
 	va_start(argptr, fmt);
-		vsnprintf(buf, sizeof(buf), fmt, argptr);
+		vreport(Severity::Warning, 0, m_lexer->getFileName(), getLine(), getColumn(), fmt, argptr);
 	va_end(argptr);
+}
 
-	snprintf(s, sizeof(s), "%s(%d) : warning near column %d: %s\r\n", m_lexer->getFile().c_str(), m_lexer->getLineNumber(), m_lexer->getColumn(), buf);
+// report a diagnostic with a severity and code at the current position
+void BaseParser::report(Severity severity, int code, const char *fmt, ...)
+{
+	va_list argptr;
 
-	m_warningCount++;
+	va_start(argptr, fmt);
+		vreport(severity, code, m_lexer->getFileName(), getLine(), getColumn(), fmt, argptr);
+	va_end(argptr);
+}
+
+// report a diagnostic with a severity and code at the given position
+void BaseParser::report(Severity severity, int code, const Position &pos, const char *fmt, ...)
+{
+	va_list argptr;
 
-	// delegate error messages to the lexical analyzer
-	m_lexer->yywarning(s);
+	va_start(argptr, fmt);
+		vreport(severity, code, pos.srcFile.c_str(), pos.srcLine, pos.srcColumn, fmt, argptr);
+	va_end(argptr);
 }
 
 //
@@ -136,7 +191,18 @@ int BaseParser::match(int token)
 {
 	if (lookahead == token)
 	{
-		lookahead = m_lexer->yylex();
+		if (m_pTree && !m_speculating)
+			m_pTree->addToken(token, m_lookStart, m_lookEnd);
+
+		lookahead = nextToken();
+		PARSE_PROFILE(if (m_pProfiler) m_pProfiler->countToken());
+
+		if (++m_tokensMatched >= m_nextCheck)
+			checkLimits();
+	}
+	else if (m_trying)
+	{
+		throw ParseBacktrack();
 	}
 	else
 	{
@@ -146,12 +212,163 @@ int BaseParser::match(int token)
 	return lookahead;
 }
 
+//======================================================================
+// Tokens come from the buffer while there are buffered tokens past the
+// lookahead, i.e. after a rewind(), and are added to it while anything
+// is marked
+//======================================================================
+int BaseParser::nextToken()
+{
+	size_t offset = m_position - m_tokenBase;
+	if (offset < m_tokens.size())
+	{
+		const BufferedToken &buffered = m_tokens[offset];
+		yylval		= buffered.value;
+		m_lookStart	= buffered.start;
+		m_lookEnd	= buffered.end;
+		m_position++;
+
+		return buffered.token;
+	}
+
+	// caught up, and nobody can go back
+	if (!m_marks && !m_tokens.empty())
+	{
+		m_tokens.clear();
+		clearMemo();
+	}
+
+	int token = m_lexer->yylex();
+	m_lookStart	= m_lexer->getTokenStart();
+	m_lookEnd	= m_lexer->getCaptured();
+
+	if (m_marks)
+	{
+		BufferedToken buffered;
+		buffered.token	= token;
+		buffered.value	= yylval;
+		buffered.line	= m_lexer->getLineNumber();
+		buffered.column	= m_lexer->getColumn();
+		buffered.start	= m_lookStart;
+		buffered.end	= m_lookEnd;
+
+		m_tokens.push_back(buffered);
+	}
+
+	m_position++;
+	return token;
+}
+
+//======================================================================
+//
+//======================================================================
+unsigned BaseParser::mark()
+{
+	assert(m_position > 0);
+	unsigned index = m_position - 1;
+
+	// the lookahead was read before anything was marked, so keep it too
+	if (m_tokens.empty())
+	{
+		BufferedToken buffered;
+		buffered.token	= lookahead;
+		buffered.value	= yylval;
+		buffered.line	= m_lexer->getLineNumber();
+		buffered.column	= m_lexer->getColumn();
+		buffered.start	= m_lookStart;
+		buffered.end	= m_lookEnd;
+
+		m_tokens.push_back(buffered);
+		m_tokenBase = index;
+	}
+
+	m_marks++;
+	return index;
+}
+
+//
+void BaseParser::rewind(unsigned marker)
+{
+	seek(marker);
+}
+
+//
+void BaseParser::release(unsigned marker)
+{
+	assert(m_marks > 0 && marker >= m_tokenBase);
+	(void)marker;
+
+	m_marks--;
+}
+
+//======================================================================
+// Make a buffered token the lookahead
+//======================================================================
+void BaseParser::seek(unsigned index)
+{
+	assert(index >= m_tokenBase && index - m_tokenBase < m_tokens.size());
+
+	const BufferedToken &buffered = m_tokens[index - m_tokenBase];
+	lookahead	= buffered.token;
+	yylval		= buffered.value;
+	m_lookStart	= buffered.start;
+	m_lookEnd	= buffered.end;
+	m_position	= index + 1;
+}
+
+//
+void BaseParser::clearMemo()
+{
+	// the arena's deallocate() does nothing, so drop the table first
+	m_pMemo.reset();
+	m_memoArena.release();
+}
+
+//
+void BaseParser::resetSpeculation()
+{
+	m_tokens.clear();
+	m_tokenBase		= 0;
+	m_position		= 0;
+	m_marks			= 0;
+	m_trying		= 0;
+	m_speculating	= 0;
+	m_lookStart		= 0;
+	m_lookEnd		= 0;
+
+	clearMemo();
+}
+
+//======================================================================
+// Where the lookahead was read. The lexer is past it when tokens after
+// it have been read and buffered.
+//======================================================================
+int BaseParser::getLine() const
+{
+	size_t offset = m_position - m_tokenBase;
+	if (m_position && offset < m_tokens.size())
+		return m_tokens[offset - 1].line;
+
+	return m_lexer->getLineNumber();
+}
+
+//
+int BaseParser::getColumn() const
+{
+	size_t offset = m_position - m_tokenBase;
+	if (m_position && offset < m_tokens.size())
+		return m_tokens[offset - 1].column;
+
+	return m_lexer->getColumn();
+}
+
 //
 // this method does nothing and is meant to be overridden in sub-classes 
 //
 int BaseParser::yyparse()
 {
-	lookahead = m_lexer->yylex();
+	lookahead = nextToken();
+	PARSE_PROFILE(if (m_pProfiler) m_pProfiler->countToken());
 	return 0;
 }
 
@@ -162,37 +379,19 @@ int BaseParser::parseFile (const char *filename)
 
 	assert(filename);
 
-#ifdef _WIN32
-	char szFullPath[_MAX_PATH];
-	char workingDir[_MAX_PATH], drive[_MAX_DRIVE], dir[_MAX_DIR], file[_MAX_FNAME], ext[_MAX_EXT];
-	char oldWorkingDir[_MAX_PATH];
-
-	_fullpath(szFullPath, filename, sizeof(szFullPath));
-	_splitpath_s(szFullPath, drive, dir, file, ext);
-	sprintf_s(workingDir, "%s%s", drive, dir);
-	_getdcwd(_getdrive(), oldWorkingDir, sizeof(oldWorkingDir));
-	_chdir(workingDir);
-#else
-	char workingDir[PATH_MAX], oldWorkingDir[PATH_MAX];
-	strcpy(workingDir, dirname((char*)filename));
-
-	getcwd(oldWorkingDir, PATH_MAX);
-	chdir(workingDir);
-#endif
-
+	// relative includes are resolved by the lexer against this file's
+	// directory, so there is no need to chdir() and parsers can run
+	// concurrently
+	m_aborted = false;
 
 	rv = m_lexer->pushFile(filename);
 	if (rv != 0)
 	{
 		yyerror("Couldn't open file: %s", filename);
-		_chdir(oldWorkingDir);
 		return rv;
 	}
 
-	yyparse();
-
-	_chdir(oldWorkingDir);
-	return 0;
+	return runParse();
 }
 
 //
@@ -202,6 +401,8 @@ int BaseParser::parseData(char *textToParse, const char *fileName, void *pUserDa
 
 	assert(textToParse);
 
+	m_aborted = false;
+
 	rv = m_lexer->setData(textToParse, fileName, pUserData);
 	if (rv != 0)
 	{
@@ -210,7 +411,219 @@ int BaseParser::parseData(char *textToParse, const char *fileName, void *pUserDa
 	}
 
 	// TODO - should return the value from yyparse()?
-	yyparse();
+	return runParse();
+}
 
-	return 0;
+//
+void BaseParser::reset()
+{
+	assert(!m_parseDepth);
+
+	m_errorCount		= 0;
+	m_warningCount		= 0;
+	m_aborted			= false;
+
+	m_limitExceeded		= ParseLimits::None;
+	m_nesting			= 0;
+	m_tokensMatched		= 0;
+	m_symbolsInstalled	= 0;
+
+	resetSpeculation();
+
+	if (m_lexer)
+		m_lexer->reset();
+
+	if (m_pSymbolTable)
+		m_pSymbolTable->reset();
+
+	if (m_pLiteralPool)
+		m_pLiteralPool->clear();
+}
+
+//
+int BaseParser::parseSource(InputSource *pSource, const char *fileName)
+{
+	int rv;
+
+	assert(pSource);
+
+	m_aborted = false;
+
+	// start out at the end of an empty chunk, so the first character read
+	// asks for the real one
+	char empty[2] = { 0, 0 };
+
+	rv = m_lexer->setData(&empty[1], fileName, nullptr, pSource);
+	if (rv != 0)
+	{
+		yyerror("Couldn't parse text");
+		return rv;
+	}
+
+	rv = runParse();
+
+	// whatever wasn't read goes with the chunks
+	if (!m_parseDepth)
+		m_lexer->closeAll();
+
+	return rv;
+}
+
+//======================================================================
+// Limits count from the start of the outermost parse
+//======================================================================
+void BaseParser::startLimits()
+{
+	m_limitExceeded		= ParseLimits::None;
+	m_nesting			= 0;
+	m_tokensMatched		= 0;
+	m_symbolsInstalled	= 0;
+	m_bytesAtStart		= m_lexer->getBytesConsumed();
+
+	if (m_limits.timeout > std::chrono::steady_clock::duration::zero())
+		m_deadline = std::chrono::steady_clock::now() + m_limits.timeout;
+
+	bool periodic = m_limits.maxTokens || m_limits.maxBytes || m_limits.pCancel ||
+		m_limits.timeout > std::chrono::steady_clock::duration::zero();
+
+	// the first is at the first token
+	m_nextCheck = periodic ? 1 : UINT64_MAX;
+}
+
+//
+// the ones that are too costly to look at on every token
+//
+void BaseParser::checkLimits()
+{
+	m_nextCheck = m_tokensMatched + std::max(m_limits.checkInterval, 1u);
+
+	if (m_limits.maxTokens)
+	{
+		if (m_tokensMatched > m_limits.maxTokens)
+			limitExceeded(ParseLimits::Tokens);
+
+		m_nextCheck = std::min(m_nextCheck, m_limits.maxTokens + 1);
+	}
+
+	if (m_limits.maxBytes && m_lexer->getBytesConsumed() - m_bytesAtStart > m_limits.maxBytes)
+		limitExceeded(ParseLimits::Bytes);
+
+	if (m_limits.pCancel && m_limits.pCancel->load(std::memory_order_relaxed))
+		limitExceeded(ParseLimits::Cancelled);
+
+	if (m_limits.timeout > std::chrono::steady_clock::duration::zero() && std::chrono::steady_clock::now() > m_deadline)
+		limitExceeded(ParseLimits::Deadline);
+}
+
+//
+void BaseParser::limitExceeded(ParseLimits::Limit limit)
+{
+	m_limitExceeded = limit;
+
+	// not a syntax error, speculation mustn't take it for a failed
+	// alternative and carry on
+	unsigned trying = m_trying;
+	m_trying = 0;
+
+	try
+	{
+		switch (limit)
+		{
+		case ParseLimits::Depth:
+			report(Severity::Fatal, 0, "nested deeper than %u levels", m_limits.maxDepth);
+			break;
+		case ParseLimits::Tokens:
+			report(Severity::Fatal, 0, "more than %llu tokens", (unsigned long long)m_limits.maxTokens);
+			break;
+		case ParseLimits::Bytes:
+			report(Severity::Fatal, 0, "more than %llu bytes of input", (unsigned long long)m_limits.maxBytes);
+			break;
+		case ParseLimits::Symbols:
+			report(Severity::Fatal, 0, "more than %llu symbols", (unsigned long long)m_limits.maxSymbols);
+			break;
+		case ParseLimits::Deadline:
+			report(Severity::Fatal, 0, "parse ran past its time limit");
+			break;
+		case ParseLimits::Cancelled:
+			report(Severity::Fatal, 0, "parse cancelled");
+			break;
+		default:
+			break;
+		}
+	}
+	catch (...)
+	{
+		m_trying = trying;
+		throw;
+	}
+
+	m_trying = trying;
+}
+
+//
+// rules left open by an error are closed where the parse stopped
+//
+void BaseParser::finishTree()
+{
+	if (!m_pTree)
+		return;
+
+	m_pTree->closeAll();
+	m_lexer->setCapture(nullptr);
+}
+
+//
+// run yyparse(), catching an abort and closing whatever it left open
+//
+int BaseParser::runParse()
+{
+	PARSE_PROFILE(uint64_t bytesBefore = m_lexer->getBytesRead());
+
+	if (!m_parseDepth)
+	{
+		resetSpeculation();
+		startLimits();
+
+		if (m_pTree)
+		{
+			m_pTree->clear();
+			m_lexer->setCapture(m_pTree->getCaptureBuffer());
+		}
+	}
+
+	m_parseDepth++;
+
+	try
+	{
+		yyparse();
+	}
+	catch (const ParseAbort &)
+	{
+		m_aborted = true;
+	}
+	catch (...)
+	{
+		m_parseDepth--;
+		if (!m_parseDepth)
+			finishTree();
+		m_lexer->closeAll();
+		throw;
+	}
+
+	m_parseDepth--;
+
+	// the token buffer and memo only matter while the parse runs
+	if (!m_parseDepth)
+	{
+		resetSpeculation();
+		finishTree();
+	}
+
+	PARSE_PROFILE(if (m_pProfiler) m_pProfiler->countBytes(m_lexer->getBytesRead() - bytesBefore));
+
+	if (!m_aborted)
+		return 0;
+
+	m_lexer->closeAll();
+	return -1;
 }
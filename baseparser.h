@@ -6,17 +6,71 @@
 
 
 #include <stdio.h>
+#include <stdint.h>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <map>
 #include <memory>
 #include <vector>
 #include <list>
+#include <unordered_map>
 #include "lexer.h"
 #include "symboltable.h"
+#include "literalpool.h"
+#include "syntaxtree.h"
+#include "diagnostics.h"
+#include "profiler.h"
+#include "tracebuffer.h"
+#include "memoryresource.h"
 
 #define SMALL_BUFFER	512
 
+//======================================================================
+// Thrown by an error while speculating, to unwind to speculate() or
+// attempt(); never escapes them
+//======================================================================
+class ParseBacktrack : public std::exception
+{
+public:
+	const char *what() const noexcept override	{ return "parse backtracked"; }
+};
+
+//======================================================================
+// Bounds on each parse, see BaseParser::setLimits(); a zero is no limit.
+// Going over one reports a Fatal diagnostic, which ends the parse with
+// parseFile()/parseData() returning -1. Tokens, bytes, the clock and
+// pCancel are only looked at every checkInterval tokens matched, so the
+// parse may run that far past them.
+//======================================================================
+struct ParseLimits
+{
+	enum Limit
+	{
+		None,
+		Depth,
+		Tokens,
+		Bytes,
+		Symbols,
+		Deadline,
+		Cancelled
+	};
+
+	unsigned maxDepth;			// nested NestingScopes
+	uint64_t maxTokens;			// tokens matched
+	uint64_t maxBytes;			// input read, includes and all
+	size_t maxSymbols;			// symbols installed
+	std::chrono::steady_clock::duration timeout;	// from the start of the parse
+
+	// set from any thread to stop the parse
+	const std::atomic<bool> *pCancel;
+
+	unsigned checkInterval;
+
+	ParseLimits() : maxDepth(0), maxTokens(0), maxBytes(0), maxSymbols(0), timeout(0), pCancel(nullptr), checkInterval(256) {}
+};
+
 //
 class BaseParser
 {
@@ -26,6 +80,9 @@ public:
 	FILE *yyhout = stdout;
 
 protected:
+	// where the parse allocates from, never null
+	MemoryResource *m_pResource;
+
 	// the lexical analyzer
 	std::unique_ptr<LexicalAnalyzer> m_lexer;
 
@@ -44,20 +101,166 @@ protected:
 	// our symbol table
 	std::unique_ptr<SymbolTable> m_pSymbolTable;
 
+	// optional home for string literals, see setLiteralPool()
+	std::unique_ptr<LiteralPool> m_pLiteralPool;
+
 	std::string outputFileName;
 
+	// where diagnostics go, nullptr for the lexer's yyerror()/yywarning()
+	DiagnosticSink *m_pSink;
+
+	// abort once this many errors are reported, 0 for no limit
+	unsigned m_errorLimit;
+
+	// ParseAbort is only thrown while a parse is running to catch it
+	int m_parseDepth;
+	bool m_aborted;
+
+	// optional, see setProfiler()
+	ParseProfiler *m_pProfiler;
+
+	// optional, see setSyntaxTree(); where the lookahead is in its text
+	SyntaxTree *m_pTree;
+	size_t m_lookStart;
+	size_t m_lookEnd;
+
+	// see setLimits(); the counts are for the parse under way
+	ParseLimits m_limits;
+	ParseLimits::Limit m_limitExceeded;
+	unsigned m_nesting;
+	uint64_t m_tokensMatched;
+	uint64_t m_nextCheck;					// when match() calls checkLimits()
+	uint64_t m_bytesAtStart;
+	size_t m_symbolsInstalled;
+	std::chrono::steady_clock::time_point m_deadline;
+
+	void startLimits();
+	void checkLimits();
+	void limitExceeded(ParseLimits::Limit limit);
+
+	// a token kept for replay while there are marks, see mark()
+	struct BufferedToken
+	{
+		int token;
+		YYSTYPE value;
+		int line;
+		int column;
+		size_t start;
+		size_t end;
+	};
+
+	// a packrat result: did the rule parse at that token, and where it ended
+	struct MemoEntry
+	{
+		bool success;
+		unsigned end;
+	};
+
+	using MemoTable = std::unordered_map<uint64_t, MemoEntry, std::hash<uint64_t>, std::equal_to<uint64_t>,
+		ResourceAllocator<std::pair<const uint64_t, MemoEntry>>>;
+
+	std::vector<BufferedToken> m_tokens;	// m_tokens[0] is token m_tokenBase
+	unsigned m_tokenBase;
+	unsigned m_position;					// tokens read, the lookahead included
+	unsigned m_marks;
+	unsigned m_trying;						// in speculate() or attempt(): errors backtrack
+	unsigned m_speculating;					// in speculate(): memoize() applies
+
+	MonotonicResource m_memoArena;
+	std::unique_ptr<MemoTable> m_pMemo;
+
+	// the lookahead's position, from the buffer when replaying
+	int getLine() const;
+	int getColumn() const;
+
+	void seek(unsigned index);
+	void resetSpeculation();
+
+	void vreport(Severity severity, int code, const char *file, int line, int column, const char *fmt, va_list args);
+	int runParse();
+	void finishTree();
+
 public:
-	BaseParser(std::unique_ptr<SymbolTable> symbolTable);
+	BaseParser(std::unique_ptr<SymbolTable> symbolTable, MemoryResource *pResource = nullptr);
 	virtual ~BaseParser();
 
+	// pass this on to anything built during the parse
+	MemoryResource *getResource() const	{ return m_pResource; }
+
 	unsigned getErrorCount() const		{ return m_errorCount; }
 	unsigned getWarningCount() const	{ return m_warningCount; }
 	void addWarningCount(int count)		{ m_warningCount += count;  }
 
 	virtual int reportUnreferencedSymbols() const { return m_pSymbolTable->dumpUnreferencedSymbolsAtCurrentLevel(); }
+	void dumpSymbolStats() const					{ m_pSymbolTable->dumpStats(); }
 
 	virtual int parseFile(const char *filename);
+
+	// Ready for another input as if newly built, without rebuilding the
+	// lexer's keyword table or giving up allocated capacity. Counts,
+	// symbols, literals and open input go; the sink, limits, profiler and
+	// lexer options stay. Parsers with state of their own extend it.
+	virtual void reset();
+
+	int addIncludePath(const char *path)	{ return m_lexer->addIncludePath(path); }
+
+	// With a sink, errors and warnings are handed over unformatted rather
+	// than printed by the lexer, whose default yyerror() exits. The sink
+	// must outlive the parser.
+	void setDiagnosticSink(DiagnosticSink *pSink)	{ m_pSink = pSink; }
+	DiagnosticSink *getDiagnosticSink() const		{ return m_pSink; }
+
+	// unwind the parse with ParseAbort at this many errors; a Fatal
+	// diagnostic always does. parseFile()/parseData() then return -1.
+	void setErrorLimit(unsigned limit)				{ m_errorLimit = limit; }
+	bool wasAborted() const							{ return m_aborted; }
+
+	// Rules marked with PARSE_RULE(), tokens matched, bytes read and
+	// symbols installed are counted into the profiler when built with
+	// PARSERKIT_PROFILE. The profiler must outlive the parser.
+	void setProfiler(ParseProfiler *pProfiler)		{ m_pProfiler = pProfiler; }
+	ParseProfiler *getProfiler() const				{ return m_pProfiler; }
+
+	// Build a concrete syntax tree of each parse from here on, into pTree,
+	// which is cleared first: match() adds the tokens and openNode() and
+	// closeNode() the rules around them. Nothing is added while
+	// speculating, and a failed attempt() takes back what it added. The
+	// tree must outlive the parser or be unset.
+	void setSyntaxTree(SyntaxTree *pTree)			{ m_pTree = pTree; }
+	SyntaxTree *getSyntaxTree() const				{ return m_pTree; }
+
+	void openNode(int kind)
+	{
+		if (m_pTree && !m_speculating)
+			m_pTree->openNode(kind);
+	}
+
+	void closeNode()
+	{
+		if (m_pTree && !m_speculating)
+			m_pTree->closeNode();
+	}
+
+	// bounds on every parse from here on, and the one that ended the last
+	void setLimits(const ParseLimits &limits)		{ m_limits = limits; }
+	const ParseLimits &getLimits() const			{ return m_limits; }
+	ParseLimits::Limit getLimitExceeded() const		{ return m_limitExceeded; }
+
+	// count a recursive rule against maxDepth, see NestingScope
+	void enterNesting()
+	{
+		if (++m_nesting > m_limits.maxDepth && m_limits.maxDepth)
+		{
+			m_nesting--;
+			limitExceeded(ParseLimits::Depth);
+		}
+	}
+
+	void leaveNesting()								{ m_nesting--; }
 	virtual int parseData(char *textToParse, const char *fileName, void *pUserData);
+
+	// parse text pulled from pSource as the lexer runs out, see PushParser
+	virtual int parseSource(InputSource *pSource, const char *fileName);
 	virtual int yyparse();
 
 	virtual void yyerror(const char *fmt, ...);
@@ -68,10 +271,49 @@ public:
 
 	virtual void yylog(const char *fmt, ...);
 
+	// report with a severity and a caller defined code, at the lexer's
+	// position or an explicit one
+	void report(Severity severity, int code, const char *fmt, ...);
+	void report(Severity severity, int code, const Position &pos, const char *fmt, ...);
+
 	virtual void expected(int token);
 	virtual int match(int token);
 	virtual int match() { return match(lookahead); }
 
+	// the next token, from the lexer or replayed after a rewind()
+	int nextToken();
+	unsigned getTokenIndex() const	{ return m_position ? m_position - 1 : 0; }
+
+	// Backtracking. mark() returns the lookahead's index and keeps every
+	// token from there on, rewind() goes back to it, and release() says it
+	// won't be rewound to again. Marks nest; the buffer is dropped once the
+	// last is released and the parse has caught up.
+	unsigned mark();
+	void rewind(unsigned marker);
+	void release(unsigned marker);
+	bool isSpeculating() const		{ return m_speculating > 0; }
+
+	// Try rule() without committing to it: errors inside it don't count,
+	// they just make it fail, and the tokens are always given back.
+	template <class Rule>
+	bool speculate(Rule rule);
+
+	// As speculate(), but keeps the tokens if rule() parses
+	template <class Rule>
+	bool attempt(Rule rule);
+
+	// Packrat memoization, keyed by rule id (any small number, e.g. from
+	// ParseProfiler::ruleId()) and token index. While speculating, a rule
+	// already tried at this token isn't run again: a failure fails at
+	// once and a success skips to where it ended, which keeps repeated
+	// speculation linear. Outside speculation rule() simply runs, so it
+	// can build things then. Entries live in an arena, dropped with the
+	// token buffer or by clearMemo().
+	template <class Rule>
+	void memoize(unsigned ruleId, Rule rule);
+	void clearMemo();
+	size_t getMemoSize() const		{ return m_pMemo ? m_pMemo->size() : 0; }
+
 	void setFileName(std::string &str)
 	{
 		outputFileName = str;
@@ -80,6 +322,11 @@ public:
 	// these methods delegate their work to the symbol table object
 	SymbolEntry *installSymbol(char *lexeme, SymbolType st = stUndef)
 	{
+		PARSE_PROFILE(if (m_pProfiler) m_pProfiler->countSymbol());
+
+		if (m_limits.maxSymbols && ++m_symbolsInstalled > m_limits.maxSymbols)
+			limitExceeded(ParseLimits::Symbols);
+
 		return m_pSymbolTable->install(lexeme, st);
 	}
 
@@ -87,7 +334,163 @@ public:
 	{
 		return m_pSymbolTable->lookup(lexeme);
 	}
+
+	// with a pool, TV_STRING tokens fill in yylval.lit instead of yylval.sym
+	void setLiteralPool(std::unique_ptr<LiteralPool> pool)	{ m_pLiteralPool = std::move(pool); }
+	LiteralPool *getLiteralPool() const						{ return m_pLiteralPool.get(); }
 };
 
+//======================================================================
+// Counts a recursive rule against ParseLimits::maxDepth while it runs,
+// e.g. NestingScope nesting(this); at the top of DoValue()
+//======================================================================
+class NestingScope
+{
+	BaseParser *m_pParser;
+
+public:
+	explicit NestingScope(BaseParser *pParser) : m_pParser(pParser)
+	{
+		m_pParser->enterNesting();
+	}
+
+	~NestingScope()
+	{
+		m_pParser->leaveNesting();
+	}
+
+	NestingScope(const NestingScope&) = delete;
+	NestingScope &operator=(const NestingScope&) = delete;
+};
+
+//======================================================================
+//
+//======================================================================
+template <class Rule>
+bool BaseParser::speculate(Rule rule)
+{
+	unsigned marker = mark();
+	m_trying++;
+	m_speculating++;
+
+	bool success = true;
+	try
+	{
+		rule();
+	}
+	catch (const ParseBacktrack &)
+	{
+		success = false;
+	}
+	catch (...)
+	{
+		m_trying--;
+		m_speculating--;
+		release(marker);
+		throw;
+	}
+
+	m_trying--;
+	m_speculating--;
+
+	rewind(marker);
+	release(marker);
+
+	return success;
+}
+
+//======================================================================
+//
+//======================================================================
+template <class Rule>
+bool BaseParser::attempt(Rule rule)
+{
+	unsigned marker = mark();
+	m_trying++;
+
+	SyntaxTree::Mark treeMark = SyntaxTree::Mark();
+	bool building = m_pTree && !m_speculating;
+	if (building)
+		treeMark = m_pTree->getMark();
+
+	bool success = true;
+	try
+	{
+		rule();
+	}
+	catch (const ParseBacktrack &)
+	{
+		success = false;
+	}
+	catch (...)
+	{
+		m_trying--;
+		release(marker);
+		throw;
+	}
+
+	m_trying--;
+
+	if (!success)
+	{
+		rewind(marker);
+		if (building)
+			m_pTree->rewind(treeMark);
+	}
+	release(marker);
+
+	return success;
+}
+
+//======================================================================
+//
+//======================================================================
+template <class Rule>
+void BaseParser::memoize(unsigned ruleId, Rule rule)
+{
+	if (!m_speculating)
+	{
+		rule();
+		return;
+	}
+
+	if (!m_pMemo)
+	{
+		ResourceAllocator<std::pair<const uint64_t, MemoEntry>> alloc(&m_memoArena);
+		m_pMemo.reset(new MemoTable(64, std::hash<uint64_t>(), std::equal_to<uint64_t>(), alloc));
+	}
+
+	unsigned start = getTokenIndex();
+	uint64_t key = ((uint64_t)ruleId << 32) | start;
+
+	auto iter = m_pMemo->find(key);
+	if (iter != m_pMemo->end())
+	{
+		if (!iter->second.success)
+			throw ParseBacktrack();
+
+		seek(iter->second.end);
+		return;
+	}
+
+	MemoEntry entry;
+	entry.success = false;
+	entry.end = start;
+
+	try
+	{
+		rule();
+	}
+	catch (const ParseBacktrack &)
+	{
+		(*m_pMemo)[key] = entry;
+		throw;
+	}
+
+	entry.success = true;
+	entry.end = getTokenIndex();
+	(*m_pMemo)[key] = entry;
+}
+
 #endif	//__BASEPARSER_H
 
@@ -0,0 +1,366 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "batchparser.h"
+
+using BatchClock = std::chrono::steady_clock;
+
+//======================================================================
+// One worker thread: its queue of input indices and its reused parser.
+// It is also the parser's diagnostic sink, filing each message under
+// the input being parsed.
+//======================================================================
+struct BatchParser::Worker : public DiagnosticSink
+{
+	std::mutex lock;
+	std::deque<size_t> queue;
+
+	std::unique_ptr<BaseParser> parser;
+	BatchResult *pCurrent;
+
+	double busySeconds;
+	size_t parsed;
+	uint64_t steals;
+
+	Worker() : pCurrent(nullptr), busySeconds(0), parsed(0), steals(0) {}
+
+	void report(const Diagnostic &diag) override
+	{
+		if (diag.severity >= Severity::Error)
+			pCurrent->errors++;
+		else if (diag.severity == Severity::Warning)
+			pCurrent->warnings++;
+
+		pCurrent->messages.push_back(diag.toString());
+	}
+};
+
+//======================================================================
+//
+//======================================================================
+double BatchStats::utilization(unsigned worker) const
+{
+	if (worker >= busySeconds.size() || wallSeconds <= 0)
+		return 0.0;
+
+	return busySeconds[worker] / wallSeconds;
+}
+
+//======================================================================
+// threads == 0 uses one worker per hardware thread
+//======================================================================
+BatchParser::BatchParser(Factory factory, unsigned threads)
+{
+	assert(factory);
+
+	m_factory		= std::move(factory);
+	m_threads		= threads;
+	m_stopOnError	= true;
+
+	clearStats();
+}
+
+//======================================================================
+//
+//======================================================================
+void BatchParser::clearStats()
+{
+	m_stats.inputs		= 0;
+	m_stats.bytes		= 0;
+	m_stats.errors		= 0;
+	m_stats.warnings	= 0;
+	m_stats.workers		= 0;
+	m_stats.wallSeconds	= 0;
+	m_stats.steals		= 0;
+
+	m_stats.busySeconds.clear();
+	m_stats.parsed.clear();
+}
+
+//======================================================================
+//
+//======================================================================
+void BatchParser::addFile(const char *filename)
+{
+	assert(filename);
+
+	Input input;
+	input.name	= filename;
+	input.pData	= nullptr;
+	input.size	= 0;
+
+	m_inputs.push_back(input);
+}
+
+//======================================================================
+// The data is copied, NUL terminated, and parsed in place by whichever
+// worker picks it up
+//======================================================================
+void BatchParser::addData(const char *name, const char *data, size_t size)
+{
+	assert(name);
+	assert(data || !size);
+
+	m_buffers.push_back(std::unique_ptr<char[]>(new char[size + 1]));
+	if (size)
+		memcpy(m_buffers.back().get(), data, size);
+	m_buffers.back()[size] = 0;
+
+	Input input;
+	input.name	= name;
+	input.pData	= m_buffers.back().get();
+	input.size	= size;
+
+	m_inputs.push_back(input);
+}
+
+//======================================================================
+// Take from the front of our own queue, which holds our largest inputs,
+// otherwise steal the smallest input from the back of someone else's.
+// Nothing is queued once run() starts, so all queues empty means done.
+//======================================================================
+bool BatchParser::nextInput(std::vector<std::unique_ptr<Worker>> &workers, unsigned index, size_t &input)
+{
+	Worker &self = *workers[index];
+
+	{
+		std::lock_guard<std::mutex> guard(self.lock);
+		if (!self.queue.empty())
+		{
+			input = self.queue.front();
+			self.queue.pop_front();
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < workers.size(); i++)
+	{
+		Worker &victim = *workers[(index + i) % workers.size()];
+
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.queue.empty())
+		{
+			input = victim.queue.back();
+			victim.queue.pop_back();
+			self.steals++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//======================================================================
+// Parse one input with this worker's parser, creating it on first use
+// or after the last one threw something other than ParseAbort
+//======================================================================
+void BatchParser::parseInput(Worker &worker, size_t index)
+{
+	const Input &input = m_inputs[index];
+	BatchResult &result = m_results[index];
+
+	if (!worker.parser)
+	{
+		worker.parser = m_factory();
+		assert(worker.parser);
+
+		worker.parser->setDiagnosticSink(&worker);
+		worker.parser->setErrorLimit(m_stopOnError ? 1 : 0);
+	}
+
+	worker.pCurrent = &result;
+
+	try
+	{
+		if (input.pData)
+			worker.parser->parseData(input.pData, input.name.c_str(), nullptr);
+		else
+			worker.parser->parseFile(input.name.c_str());
+
+		if (m_completion && !worker.parser->wasAborted())
+			m_completion(*worker.parser, index, result);
+
+		// clean for the next input, even if this one was abandoned part way
+		worker.parser->reset();
+	}
+	catch (const std::exception &e)
+	{
+		result.messages.push_back(input.name + " : error: " + e.what());
+		result.errors++;
+
+		// no telling what state that left it in, build another
+		worker.parser.reset();
+	}
+
+	worker.pCurrent = nullptr;
+
+	if (result.status != BatchResult::OpenFailed)
+		result.status = result.errors ? BatchResult::Failed : BatchResult::Ok;
+}
+
+//======================================================================
+//
+//======================================================================
+void BatchParser::runWorker(std::vector<std::unique_ptr<Worker>> &workers, unsigned index)
+{
+	Worker &self = *workers[index];
+	size_t input;
+
+	while (nextInput(workers, index, input))
+	{
+		BatchClock::time_point start = BatchClock::now();
+
+		parseInput(self, input);
+
+		double seconds = std::chrono::duration<double>(BatchClock::now() - start).count();
+		m_results[input].seconds	= seconds;
+		m_results[input].worker		= index;
+
+		self.busySeconds += seconds;
+		self.parsed++;
+	}
+
+	// parsers are destroyed on the thread that used them
+	self.parser.reset();
+}
+
+//======================================================================
+// Size every input, deal them out largest first, and run the workers
+//======================================================================
+unsigned BatchParser::run()
+{
+	BatchClock::time_point start = BatchClock::now();
+
+	clearStats();
+
+	m_results.clear();
+	m_results.resize(m_inputs.size());
+
+	std::vector<size_t> order;
+	order.reserve(m_inputs.size());
+
+	for (size_t i = 0; i < m_inputs.size(); i++)
+	{
+		BatchResult &result = m_results[i];
+		result.name		= m_inputs[i].name;
+		result.bytes	= m_inputs[i].size;
+		result.status	= BatchResult::Ok;
+		result.errors	= 0;
+		result.warnings	= 0;
+		result.worker	= 0;
+		result.seconds	= 0;
+
+		if (!m_inputs[i].pData)
+		{
+			FILE *fp = fopen(m_inputs[i].name.c_str(), "rb");
+			if (!fp)
+			{
+				result.status = BatchResult::OpenFailed;
+				result.errors = 1;
+				result.messages.push_back(result.name + " : error: couldn't open file");
+				continue;
+			}
+
+			fseek(fp, 0, SEEK_END);
+			long size = ftell(fp);
+			fclose(fp);
+
+			result.bytes = size > 0 ? (size_t)size : 0;
+		}
+
+		order.push_back(i);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+	{
+		return m_results[a].bytes > m_results[b].bytes;
+	});
+
+	unsigned threads = m_threads ? m_threads : std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	if (threads > order.size())
+		threads = order.size() ? (unsigned)order.size() : 1;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (unsigned i = 0; i < threads; i++)
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+	// deal round robin so every queue starts with its largest input
+	for (size_t i = 0; i < order.size(); i++)
+		workers[i % threads]->queue.push_back(order[i]);
+
+	if (threads == 1)
+	{
+		runWorker(workers, 0);
+	}
+	else
+	{
+		std::vector<std::thread> pool;
+		for (unsigned i = 0; i < threads; i++)
+			pool.push_back(std::thread(&BatchParser::runWorker, this, std::ref(workers), i));
+
+		for (auto iter = pool.begin(); iter != pool.end(); iter++)
+			iter->join();
+	}
+
+	m_stats.inputs		= m_inputs.size();
+	m_stats.workers		= threads;
+	m_stats.wallSeconds	= std::chrono::duration<double>(BatchClock::now() - start).count();
+
+	for (auto iter = m_results.begin(); iter != m_results.end(); iter++)
+	{
+		m_stats.bytes		+= iter->bytes;
+		m_stats.errors		+= iter->errors;
+		m_stats.warnings	+= iter->warnings;
+	}
+
+	for (auto iter = workers.begin(); iter != workers.end(); iter++)
+	{
+		m_stats.busySeconds.push_back((*iter)->busySeconds);
+		m_stats.parsed.push_back((*iter)->parsed);
+		m_stats.steals += (*iter)->steals;
+	}
+
+	return m_stats.errors;
+}
+
+//======================================================================
+//
+//======================================================================
+void BatchParser::dumpResults(FILE *fout) const
+{
+	for (auto iter = m_results.begin(); iter != m_results.end(); iter++)
+	{
+		for (auto msg = iter->messages.begin(); msg != iter->messages.end(); msg++)
+			fprintf(fout, "%s\n", msg->c_str());
+	}
+
+	dumpStats(fout);
+}
+
+//======================================================================
+//
+//======================================================================
+void BatchParser::dumpStats(FILE *fout) const
+{
+	fprintf(fout, "%zu input(s), %zu bytes in %.3f s: %.2f MB/s, %.1f inputs/s, %u error(s), %u warning(s)\n",
+		m_stats.inputs, m_stats.bytes, m_stats.wallSeconds,
+		m_stats.bytesPerSecond() / (1024.0 * 1024.0), m_stats.inputsPerSecond(),
+		m_stats.errors, m_stats.warnings);
+
+	for (unsigned i = 0; i < m_stats.workers; i++)
+	{
+		fprintf(fout, "  worker %u: %zu input(s), %.3f s busy, %.0f%% utilization\n",
+			i, m_stats.parsed[i], m_stats.busySeconds[i], 100.0 * m_stats.utilization(i));
+	}
+
+	fprintf(fout, "  %llu input(s) stolen\n", (unsigned long long)m_stats.steals);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#ifndef __BATCHPARSER_H
+#define __BATCHPARSER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "baseparser.h"
+
+//======================================================================
+// Outcome of parsing one input, in the order the inputs were added
+//======================================================================
+struct BatchResult
+{
+	enum Status
+	{
+		Ok,				// parsed, possibly with warnings
+		Failed,			// parsed with errors, or abandoned at the first one
+		OpenFailed		// the file could not be read
+	};
+
+	std::string name;
+	size_t bytes;
+	Status status;
+	unsigned errors;
+	unsigned warnings;
+
+	// diagnostics in the order the parser reported them
+	std::vector<std::string> messages;
+
+	unsigned worker;		// which worker parsed it
+	double seconds;			// time spent parsing it, including reading a file
+};
+
+//======================================================================
+// Totals for one run()
+//======================================================================
+struct BatchStats
+{
+	size_t inputs;
+	size_t bytes;
+	unsigned errors;
+	unsigned warnings;
+
+	unsigned workers;
+	double wallSeconds;
+	uint64_t steals;		// inputs taken from another worker's queue
+
+	// per worker time spent parsing and number of inputs parsed
+	std::vector<double> busySeconds;
+	std::vector<size_t> parsed;
+
+	double bytesPerSecond() const	{ return wallSeconds > 0 ? bytes / wallSeconds : 0.0; }
+	double inputsPerSecond() const	{ return wallSeconds > 0 ? inputs / wallSeconds : 0.0; }
+	double utilization(unsigned worker) const;
+};
+
+//======================================================================
+// Parses many files or buffers on a pool of worker threads.
+//
+// Each worker asks the factory for one parser and reuses it for input
+// after input, calling reset() in between. Inputs are dealt out largest
+// first; a worker whose own queue runs dry steals from the back of a
+// busier one. Diagnostics are captured per input through a
+// DiagnosticSink, so results come back in input order no matter which
+// worker ran them or when.
+//
+// The factory runs on the worker threads, so parsers must not share
+// mutable state with each other.
+//======================================================================
+class BatchParser
+{
+public:
+	using Factory = std::function<std::unique_ptr<BaseParser>()>;
+
+	// called on the worker thread after each parse, to pull results out
+	// of the parser before it moves on to the next input
+	using Completion = std::function<void(BaseParser &parser, size_t index, BatchResult &result)>;
+
+protected:
+	struct Input
+	{
+		std::string name;
+		char *pData;			// our copy of a buffer, nullptr for a file
+		size_t size;
+	};
+
+	struct Worker;
+
+	Factory m_factory;
+	Completion m_completion;
+	unsigned m_threads;
+	bool m_stopOnError;
+
+	std::vector<Input> m_inputs;
+	std::vector<std::unique_ptr<char[]>> m_buffers;
+	std::vector<BatchResult> m_results;
+	BatchStats m_stats;
+
+	void runWorker(std::vector<std::unique_ptr<Worker>> &workers, unsigned index);
+	bool nextInput(std::vector<std::unique_ptr<Worker>> &workers, unsigned index, size_t &input);
+	void parseInput(Worker &worker, size_t input);
+	void clearStats();
+
+public:
+	explicit BatchParser(Factory factory, unsigned threads = 0);
+	virtual ~BatchParser() = default;
+
+	BatchParser(const BatchParser&) = delete;
+	BatchParser &operator=(const BatchParser&) = delete;
+
+	// inputs are parsed by run(); buffers are copied, so need not outlive the call
+	void addFile(const char *filename);
+	void addData(const char *name, const char *data, size_t size);
+
+	void setCompletion(Completion completion)	{ m_completion = std::move(completion); }
+
+	// abandon an input at its first error (an error limit of 1) rather
+	// than letting the parser try to recover; on by default, as most don't
+	void setStopOnError(bool onoff)				{ m_stopOnError = onoff; }
+
+	// parse everything added so far, returns the total error count
+	unsigned run();
+
+	const std::vector<BatchResult> &getResults() const	{ return m_results; }
+	const BatchStats &getStats() const					{ return m_stats; }
+
+	// print each input's diagnostics in input order, then a summary
+	void dumpResults(FILE *fout = stdout) const;
+	void dumpStats(FILE *fout = stdout) const;
+};
+
+#endif	// __BATCHPARSER_H
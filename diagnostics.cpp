@@ -0,0 +1,124 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include "diagnostics.h"
+
+#define DIAGNOSTIC_BUFFER	512
+
+//======================================================================
+//
+//======================================================================
+const char *severityName(Severity severity)
+{
+	switch (severity)
+	{
+	case Severity::Note:	return "note";
+	case Severity::Warning:	return "warning";
+	case Severity::Error:	return "error";
+	case Severity::Fatal:	return "fatal error";
+	}
+
+	return "error";
+}
+
+//======================================================================
+// The arguments are copied so the diagnostic can be formatted more than
+// once, e.g. by a sink that both prints and keeps it
+//======================================================================
+int Diagnostic::formatMessage(char *buf, size_t size) const
+{
+	assert(fmt);
+
+	if (!pArgs)
+		return snprintf(buf, size, "%s", fmt);
+
+	va_list args;
+	va_copy(args, *pArgs);
+		int length = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+
+	return length;
+}
+
+//======================================================================
+//
+//======================================================================
+int Diagnostic::render(char *buf, size_t size) const
+{
+	int length = snprintf(buf, size, "%s(%d) : %s near column %d: ", file, line, severityName(severity), column);
+	if (length < 0)
+		return length;
+
+	size_t used = (size_t)length < size ? (size_t)length : (size ? size - 1 : 0);
+	int message = formatMessage(buf + used, size - used);
+
+	return message < 0 ? message : length + message;
+}
+
+//======================================================================
+//
+//======================================================================
+std::string Diagnostic::toString() const
+{
+	char buf[DIAGNOSTIC_BUFFER];
+
+	int length = render(buf, sizeof(buf));
+	if (length < 0)
+		return std::string();
+
+	if ((size_t)length < sizeof(buf))
+		return std::string(buf, length);
+
+	// too long for the stack, go again with room for all of it
+	std::string text(length + 1, 0);
+	render(&text[0], text.size());
+	text.resize(length);
+
+	return text;
+}
+
+//======================================================================
+//
+//======================================================================
+void StreamSink::report(const Diagnostic &diag)
+{
+	char buf[DIAGNOSTIC_BUFFER];
+
+	int length = diag.render(buf, sizeof(buf));
+	if (length < 0)
+		return;
+
+	if ((size_t)length < sizeof(buf))
+		fprintf(m_fout, "%s\n", buf);
+	else
+		fprintf(m_fout, "%s\n", diag.toString().c_str());
+}
+
+//======================================================================
+//
+//======================================================================
+void CollectingSink::report(const Diagnostic &diag)
+{
+	Record record;
+	record.severity	= diag.severity;
+	record.code		= diag.code;
+	record.file		= diag.file;
+	record.line		= diag.line;
+	record.column	= diag.column;
+
+	char buf[DIAGNOSTIC_BUFFER];
+	int length = diag.formatMessage(buf, sizeof(buf));
+
+	if (length >= 0 && (size_t)length < sizeof(buf))
+	{
+		record.message.assign(buf, length);
+	}
+	else if (length >= 0)
+	{
+		record.message.resize(length + 1);
+		diag.formatMessage(&record.message[0], record.message.size());
+		record.message.resize(length);
+	}
+
+	m_records.push_back(std::move(record));
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef __DIAGNOSTICS_H
+#define __DIAGNOSTICS_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <exception>
+#include <string>
+#include <vector>
+
+enum class Severity
+{
+	Note,
+	Warning,
+	Error,
+	Fatal		// always ends the parse
+};
+
+const char *severityName(Severity severity);
+
+//======================================================================
+// One error or warning as the parser reported it. The message is kept
+// as its printf format and arguments, so nothing is formatted unless a
+// sink asks for the text.
+//
+// A Diagnostic only lives for the duration of DiagnosticSink::report();
+// the arguments (and any strings they point at) are gone afterwards, so
+// a sink that keeps it must render it first.
+//======================================================================
+struct Diagnostic
+{
+	Severity severity;
+	int code;				// caller defined, 0 if none was given
+
+	const char *file;		// never null
+	int line;
+	int column;
+
+	const char *fmt;
+	va_list *pArgs;
+
+	// just the message, returns the length it wanted like snprintf()
+	int formatMessage(char *buf, size_t size) const;
+
+	// the message with its location, in the MS style the console uses:
+	//	filename(line) : error near column N: message
+	int render(char *buf, size_t size) const;
+	std::string toString() const;
+};
+
+//======================================================================
+// Thrown to unwind a parse after a fatal error or once the parser's
+// error limit is reached. BaseParser::parseFile() and parseData() catch
+// it, so it only escapes if raised outside of them. Sinks may throw it
+// too, to give up on their own terms.
+//======================================================================
+class ParseAbort : public std::exception
+{
+public:
+	const char *what() const noexcept override	{ return "parse aborted"; }
+};
+
+//======================================================================
+// Receives a parser's diagnostics in place of the lexer's yyerror(),
+// which prints and exits
+//======================================================================
+class DiagnosticSink
+{
+public:
+	virtual ~DiagnosticSink() = default;
+
+	virtual void report(const Diagnostic &diag) = 0;
+};
+
+//======================================================================
+// Prints each diagnostic and carries on
+//======================================================================
+class StreamSink : public DiagnosticSink
+{
+protected:
+	FILE *m_fout;
+
+public:
+	explicit StreamSink(FILE *fout = stderr) : m_fout(fout) {}
+
+	void report(const Diagnostic &diag) override;
+};
+
+//======================================================================
+// Keeps every diagnostic, rendered, for inspection after the parse
+//======================================================================
+class CollectingSink : public DiagnosticSink
+{
+public:
+	struct Record
+	{
+		Severity severity;
+		int code;
+		std::string file;
+		int line;
+		int column;
+		std::string message;	// without the location
+	};
+
+protected:
+	std::vector<Record> m_records;
+
+public:
+	void report(const Diagnostic &diag) override;
+
+	const std::vector<Record> &getRecords() const	{ return m_records; }
+	void clear()									{ m_records.clear(); }
+};
+
+//======================================================================
+// Counts diagnostics by severity and drops them without ever formatting
+// a message, for when only pass/fail matters
+//======================================================================
+class CountingSink : public DiagnosticSink
+{
+protected:
+	unsigned m_counts[4];
+
+public:
+	CountingSink()									{ clear(); }
+
+	void report(const Diagnostic &diag) override	{ m_counts[(int)diag.severity]++; }
+
+	unsigned getCount(Severity severity) const		{ return m_counts[(int)severity]; }
+	void clear()									{ m_counts[0] = m_counts[1] = m_counts[2] = m_counts[3] = 0; }
+};
+
+#endif	// __DIAGNOSTICS_H
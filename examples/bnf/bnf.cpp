@@ -15,9 +15,17 @@
 // Command line switches
 //
 static bool g_bDebug = false;
+static bool g_bStats = false;
+static bool g_bTrace = false;
+static bool g_bRecursive = false;
+static bool g_bLALR = false;
+static uint64_t g_corpusSize = 0;
+static unsigned g_corpusDepth = 16;
+static unsigned g_corpusSeed = 1;
 static FILE *yyout = stdout;
 static FILE *yyhout = stdout;
 static std::string outputFile = "ytab";
+static bool g_bOutputFile = false;
 
 //
 // show usage
@@ -25,31 +33,102 @@ static std::string outputFile = "ytab";
 void usage()
 {
 	printf("usage: bnf [options] filename\n");
+	printf("  -o name   write the parser to name.cpp and name.h, or a corpus to name\n");
+	printf("  -l        LALR(1) tables for LRParser\n");
+	printf("  -r        recursive-descent code on BaseParser\n");
+	printf("  -t        a parser that logs its steps\n");
+	printf("  -v        log the grammar's analysis\n");
+	printf("  -s        show symbol table statistics\n");
+	printf("  -g size   about size bytes of random sentences, k, m or g for 1024s\n");
+	printf("  -d depth  nest non-terminals up to depth deep in a corpus (16)\n");
+	printf("  -S seed   seed a corpus's choices (1)\n");
 	exit(0);
 }
 
+//
+// the argument after switch i, or usage if there isn't one
+//
+const char *switchArg(int n, char *args[], int &i)
+{
+	if (i + 1 >= n)
+		usage();
+
+	return args[++i];
+}
+
+//
+// a size in bytes, with a k, m or g after it for 1024s of them
+//
+uint64_t sizeArg(const char *arg)
+{
+	char *end;
+	uint64_t size = strtoull(arg, &end, 10);
+
+	switch (tolower((unsigned char)*end))
+	{
+	case 'g':	size <<= 10;	// fall through
+	case 'm':	size <<= 10;	// fall through
+	case 'k':	size <<= 10;	break;
+	}
+
+	return size;
+}
+
 //
 // get options from the command line
 //
 int getopt(int n, char *args[])
 {
 	int i;
-	for (i = 1; args[i][0] == '-'; i++)
+	for (i = 1; i < n && args[i][0] == '-'; i++)
 	{
 		if (args[i][1] == 'v')
 			g_bDebug = true;
 
+		if (args[i][1] == 's')
+			g_bStats = true;
+
+		if (args[i][1] == 't')
+			g_bTrace = true;
+
+		if (args[i][1] == 'r')
+			g_bRecursive = true;
+
+		if (args[i][1] == 'l')
+			g_bLALR = true;
+
+		// a corpus of random sentences instead of a parser, its depth
+		// and the seed it's made from
+		if (args[i][1] == 'g')
+			g_corpusSize = sizeArg(switchArg(n, args, i));
+
+		if (args[i][1] == 'd')
+			g_corpusDepth = atoi(switchArg(n, args, i));
+
+		if (args[i][1] == 'S')
+			g_corpusSeed = atoi(switchArg(n, args, i));
+
 		if (args[i][1] == 'o')
 		{
-			outputFile = args[++i];
-			std::string file = outputFile + ".cpp";
-			yyout = fopen(file.c_str(), "wt");
-
-			file = outputFile + ".h";
-			yyhout = fopen(file.c_str(), "wt");
+			outputFile = switchArg(n, args, i);
+			g_bOutputFile = true;
 		}
 	}
 
+	// a corpus goes to the file named, and a parser to its .cpp and .h
+	if (g_bOutputFile && g_corpusSize)
+	{
+		yyout = fopen(outputFile.c_str(), "wb");
+	}
+	else if (g_bOutputFile)
+	{
+		std::string file = outputFile + ".cpp";
+		yyout = fopen(file.c_str(), "wt");
+
+		file = outputFile + ".h";
+		yyhout = fopen(file.c_str(), "wt");
+	}
+
 	return i;
 }
 
@@ -62,15 +141,26 @@ int main(int argc, char* argv[])
 		usage();
 
 	int iFirstArg = getopt(argc, argv);
+	if (iFirstArg >= argc)
+		usage();
 
 	BNFParser parser;
 
 	parser.yydebug = g_bDebug;
+	parser.yytrace = g_bTrace;
+	parser.recursiveDescent = g_bRecursive;
+	parser.lalr = g_bLALR;
+	parser.corpusSize = g_corpusSize;
+	parser.corpusDepth = g_corpusDepth;
+	parser.corpusSeed = g_corpusSeed;
 	parser.yyout = yyout;
 	parser.yyhout = yyhout;
 	parser.setFileName(outputFile);
 
 	parser.parseFile(argv[iFirstArg]);
 
+	if (g_bStats)
+		parser.dumpSymbolStats();
+
 	return 0;
 }
\ No newline at end of file
@@ -1,6 +1,38 @@
 #include "../../baseparser.h"
 #include "bnflexer.h"
 
+//
+// A grammar has no numbers, so '+' is always the EBNF operator rather
+// than the sign of one
+//
+int BNFLexer::yylex()
+{
+	int chr = skipLeadingWhiteSpace();
+	if (chr == '+')
+	{
+		markToken(chr);
+		return chr;
+	}
+
+	if (chr != EOF)
+		ungetChar(chr);
+
+	return LexicalAnalyzer::yylex();
+}
+
+//
+// A corpus has no C++ in it, so the %{ ... %} block is passed over
+//
+void BNFLexer::skipUntilChar(int endChar)
+{
+	int chr;
+	while ((chr = getChar()) != endChar && chr != EOF)
+		;
+
+	if (chr != EOF)
+		ungetChar(chr);
+}
+
 //
 //
 //
@@ -10,7 +10,9 @@ enum {
 	TV_START,
 	TV_LEFT,
 	TV_RIGHT,
-	TV_NONASSOC
+	TV_NONASSOC,
+	TV_SAMPLE,
+	TV_WEIGHT
 };
 
 //
@@ -23,7 +25,11 @@ public:
 		m_bCharLiterals		= true;
 	}
 
+	int yylex() override;
 	int specialTokens(int chr) override;
+
+	// as copyUntilChar(), keeping nothing
+	void skipUntilChar(int endChar);
 };
 
 #endif	//__BNFLEXER_H
@@ -6,6 +6,10 @@
 
 #include "bnfparser.h"
 #include "bnflexer.h"
+#include <algorithm>
+
+// tables up to this many entries are written out dense
+#define DENSE_TABLE_LIMIT	4096
 
 //
 // Table of lexemes and tokens to be recognized by the lexer
@@ -17,6 +21,8 @@ static TokenTable _tokenTable[] =
 	{ "left",	  TV_LEFT },
 	{ "right",	  TV_RIGHT },
 	{ "nonassoc", TV_NONASSOC },
+	{ "sample",	  TV_SAMPLE },
+	{ "weight",	  TV_WEIGHT },
 	{ "%%",		  TV_PERCENTS},
 	{ "%{",		  TV_PERCENT_LBRACE },
 	{ "%}",		  TV_PERCENT_RBRACE },
@@ -42,6 +48,8 @@ BNFParser::BNFParser() : BaseParser(std::make_unique<SymbolTable>())
 //
 void BNFParser::DoRules()
 {
+	PARSE_RULE("BNFParser::DoRules");
+
 	int actionIndex = 1;
 
 	yylog("Identify non-terminals");
@@ -76,38 +84,24 @@ void BNFParser::DoRules()
 		match(':');
 
 		// match one or more rules
+		m_ebnfCount = 0;
 		do
 		{
-			rhs.clear();
+			rhs = DoSymbols(lhs);
 
-			// a rule is zero or more symbols. Symbols are non-terminals and/or terminals (ie. tokens)
-			while (lookahead == TV_ID || lookahead == TV_CHARVAL)
+			// how often a corpus takes this rule, see bnf -g
+			unsigned weight = 1;
+			if (lookahead == '%')
 			{
-				Symbol symbol;
-
-				if (lookahead == TV_CHARVAL)
-				{
-					symbol.name = yylval.char_val;
-					symbol.type = SymbolType::CharTerminal;
-
-					// character values are terminal symbols
-					terminals.insert(symbol.name);
-				}
-				else if (tokens.find(yylval.sym->lexeme) != tokens.end())
-				{
-					symbol.type = SymbolType::Terminal;
-					symbol.name = yylval.sym->lexeme;
-					yylval.sym->type = stTerminal;
-				}
-				else {
-					symbol.type = SymbolType::Nonterminal;
-					symbol.name = yylval.sym->lexeme;
-					yylval.sym->type = stNonTerminal;
-				}
+				match('%');
+				match(TV_WEIGHT);
 
-				rhs.push_back(symbol);
+				if (lookahead == TV_INTVAL && yylval.ival < 0)
+					yyerror("The weight of a rule for %s is negative", lhs.c_str());
+				else if (lookahead == TV_INTVAL)
+					weight = yylval.ival;
 
-				match(lookahead);
+				match(TV_INTVAL);
 			}
 
 			std::string action;
@@ -122,14 +116,208 @@ void BNFParser::DoRules()
 				match('}');
 			}
 
+			// only the recursive-descent code has a vector to give a
+			// repetition's value, and a corpus has no actions at all
+			if (action != "" && !isRecursiveDescent() && !corpusSize)
+			{
+				std::vector<bool> used(rhs.size() + 1, false);
+				ReplaceValues(action, used);
+
+				for (size_t i = 0; i < rhs.size(); i++)
+				{
+					if (used[i + 1] && isRepetition(rhs[i].name))
+						yyerror("The value of a repetition ($%zu in a rule for %s) needs bnf -r", i + 1, lhs.c_str());
+				}
+			}
+
 			// add production to our list of productions
 			Production prod(lhs, rhs, action, actionIndex++);
+			prod.rhs.weight = weight;
 			productions.push_back(prod);
 
 		} while (lookahead == '|' && match('|'));
 
 		match(';');
 	}
+
+	// the rules made for (...), ?, * and +, after the grammar's own
+	for (auto prod = m_ebnfProductions.begin(); prod != m_ebnfProductions.end(); prod++)
+	{
+		prod->rhs.actionIndex = actionIndex++;
+		productions.push_back(*prod);
+	}
+	m_ebnfProductions.clear();
+}
+
+//======================================================================
+// A rule's symbols, up to its action, its '|' or the end of its group.
+// A group, (...), and a symbol or group followed by ?, * or + stand for
+// a non-terminal made for them, see AddEbnfRule().
+//======================================================================
+BNFParser::SymbolList BNFParser::DoSymbols(const std::string &lhs)
+{
+	PARSE_RULE("BNFParser::DoSymbols");
+
+	SymbolList rhs;
+
+	// a rule is zero or more symbols. Symbols are non-terminals and/or terminals (ie. tokens)
+	while (lookahead == TV_ID || lookahead == TV_CHARVAL || lookahead == '(')
+	{
+		Symbol symbol;
+
+		if (lookahead == '(')
+		{
+			match('(');
+			symbol = DoGroup(lhs);
+			match(')');
+		}
+		else if (lookahead == TV_CHARVAL)
+		{
+			symbol.name = yylval.char_val;
+			symbol.type = SymbolType::CharTerminal;
+
+			// character values are terminal symbols
+			terminals.insert(symbol.name);
+			match(lookahead);
+		}
+		else if (tokens.find(yylval.sym->lexeme) != tokens.end())
+		{
+			symbol.type = SymbolType::Terminal;
+			symbol.name = yylval.sym->lexeme;
+			yylval.sym->type = stTerminal;
+			match(lookahead);
+		}
+		else {
+			symbol.type = SymbolType::Nonterminal;
+			symbol.name = yylval.sym->lexeme;
+			yylval.sym->type = stNonTerminal;
+			match(lookahead);
+		}
+
+		if (lookahead == '?' || lookahead == '*' || lookahead == '+')
+		{
+			symbol = AddEbnfRule(lhs, lookahead, symbol);
+			match(lookahead);
+		}
+
+		rhs.push_back(symbol);
+	}
+
+	return rhs;
+}
+
+//======================================================================
+// The alternatives of a group, after its '('. Each takes the value of
+// its first symbol that isn't a character, so (',' value) is the value's,
+// or of its first symbol if they all are. A group of one symbol is just
+// that symbol.
+//======================================================================
+BNFParser::Symbol BNFParser::DoGroup(const std::string &lhs)
+{
+	PARSE_RULE("BNFParser::DoGroup");
+
+	std::vector<SymbolList> alternatives;
+
+	do
+	{
+		alternatives.push_back(DoSymbols(lhs));
+	} while (lookahead == '|' && match('|'));
+
+	if (alternatives.size() == 1 && alternatives[0].size() == 1)
+		return alternatives[0][0];
+
+	Symbol group = AddEbnfRule(lhs, '(', Symbol());
+	for (auto alternative = alternatives.begin(); alternative != alternatives.end(); alternative++)
+	{
+		std::string action;
+		for (size_t i = 0; i < alternative->size(); i++)
+		{
+			if ((*alternative)[i].type != SymbolType::CharTerminal)
+			{
+				if (i)
+					action = " $$ = $" + std::to_string(i + 1) + "; ";
+				break;
+			}
+		}
+
+		m_ebnfProductions.push_back(Production(group.name, *alternative, action, 0));
+	}
+
+	return group;
+}
+
+//======================================================================
+// A non-terminal for (...), X?, X* or X+, named after the rule it is in,
+// members_1 and so on. For the last three its rules are added here:
+//
+//	X?	h: | X
+//	X*	h: | X h			h: | h X with -l
+//	X+	h: X t, t: X*		h: X | h X with -l
+//
+// LL(1) needs the recursion on the right; LALR(1) takes it on the left,
+// which reduces as it goes and keeps the stack flat. The recursive-
+// descent code writes * and + as loops instead, see OutputLoopFunction().
+//======================================================================
+BNFParser::Symbol BNFParser::AddEbnfRule(const std::string &lhs, int op, const Symbol &item)
+{
+	if (isPrattMode())
+		yyerror("(...), ?, * and + in rules need LL(1), bnf -r or bnf -l, not precedence parsing");
+
+	Symbol symbol;
+	symbol.type = SymbolType::Nonterminal;
+	do
+	{
+		symbol.name = lhs + "_" + std::to_string(++m_ebnfCount);
+	} while (nonTerminals.count(symbol.name) || tokens.count(symbol.name));
+
+	nonTerminals.insert(symbol.name);
+
+	EbnfRule &rule = m_ebnfRules[symbol.name];
+	rule.op = (char)op;
+	rule.item = item;
+
+	SymbolList one(1, item);
+	SymbolList none;
+
+	switch (op)
+	{
+	case '?':
+		m_ebnfProductions.push_back(Production(symbol.name, none, "", 0));
+		m_ebnfProductions.push_back(Production(symbol.name, one, "", 0));
+		break;
+
+	case '*':
+		m_ebnfProductions.push_back(Production(symbol.name, none, "", 0));
+		if (lalr)
+			m_ebnfProductions.push_back(Production(symbol.name, SymbolList{ symbol, item }, "", 0));
+		else
+			m_ebnfProductions.push_back(Production(symbol.name, SymbolList{ item, symbol }, "", 0));
+		break;
+
+	case '+':
+		if (lalr)
+		{
+			m_ebnfProductions.push_back(Production(symbol.name, one, "", 0));
+			m_ebnfProductions.push_back(Production(symbol.name, SymbolList{ symbol, item }, "", 0));
+		}
+		else
+		{
+			Symbol tail = AddEbnfRule(lhs, '*', item);
+			m_ebnfRules[tail.name].tail = true;
+			m_ebnfRules[symbol.name].tailName = tail.name;
+			m_ebnfProductions.push_back(Production(symbol.name, SymbolList{ item, tail }, "", 0));
+		}
+		break;
+	}
+
+	return symbol;
+}
+
+//
+bool BNFParser::isRepetition(const std::string &name) const
+{
+	auto rule = m_ebnfRules.find(name);
+	return rule != m_ebnfRules.end() && (rule->second.op == '*' || rule->second.op == '+');
 }
 
 //
@@ -137,6 +325,8 @@ void BNFParser::DoRules()
 //
 void BNFParser::DoTokens()
 {
+	PARSE_RULE("BNFParser::DoTokens");
+
 	// tokens are optional
 	if (lookahead != '%')
 		return;
@@ -197,6 +387,21 @@ void BNFParser::DoTokens()
 			m_nextPrecLevel++;
 			break;
 		}
+
+		case TV_SAMPLE:
+		{
+			// a token's spellings in a corpus, see bnf -g
+			match(TV_SAMPLE);
+			std::string name = yylval.sym->lexeme;
+			match(TV_ID);
+
+			while (lookahead == TV_STRING)
+			{
+				m_samples[name].push_back(yylval.sym->lexeme);
+				match(TV_STRING);
+			}
+			break;
+		}
 		}
 	}
 }
@@ -218,11 +423,12 @@ void BNFParser::OutputSymbols()
 		fprintf(yyout, "\tTS_%s,\n", iter->c_str());
 	}
 
-	if (!isPrattMode())
+	if (!isPrattMode() && !lalr)
 	{
-		// output all the non-Terminals (only needed for LL(1) table)
+		// output all the non-Terminals (only needed for LL(1) table), in
+		// the order of the table's rows
 		fputs("\n\t// Non-Terminal symbols\n", yyout);
-		for (auto iter = nonTerminals.begin(); iter != nonTerminals.end(); iter++)
+		for (auto iter = nonTerminalNames.begin(); iter != nonTerminalNames.end(); iter++)
 		{
 			fprintf(yyout, "\tNTS_%s,\n", iter->c_str());
 		}
@@ -231,7 +437,7 @@ void BNFParser::OutputSymbols()
 	fputs("\tLAST_TOKEN\n", yyout);
 	fputs("};\n\n", yyout);
 
-	if (!isPrattMode())
+	if (!isPrattMode() && !lalr)
 	{
 		// output all the action symbols (only needed for LL(1))
 		fputs("// Action symbols\n", yyout);
@@ -250,28 +456,55 @@ void BNFParser::OutputSymbols()
 	if (isPrattMode())
 	{
 		// Pratt parser class declaration
-		fprintf(yyhout, "class %s : public PrattParser<YYSTYPE> {\n", outputFileName.c_str());
+		const char *name = outputFileName.c_str();
+		fprintf(yyhout, "class %s : public PrattParser<YYSTYPE> {\n", name);
 		fputs("protected:\n", yyhout);
-		fputs("\tvoid initPrattTable() override;\n", yyhout);
+		fputs("\tstatic const PrattTable yytables;\n\n", yyhout);
 		fputs("\tYYSTYPE nud(int token, YYSTYPE val) override;\n", yyhout);
 		fputs("\tYYSTYPE led(int op, YYSTYPE left, YYSTYPE right) override;\n", yyhout);
+		if (hasProduction(&BNFParser::isPrefixProduction))
+			fputs("\tYYSTYPE prefix(int op, YYSTYPE val, YYSTYPE operand) override;\n", yyhout);
+		if (hasProduction(&BNFParser::isPostfixProduction))
+			fputs("\tYYSTYPE postfix(int op, YYSTYPE operand, YYSTYPE val) override;\n", yyhout);
 		fputs("public:\n", yyhout);
-		fprintf(yyhout, "\t%s(LexicalAnalyzer lex) : PrattParser<YYSTYPE>(lex, &yylval) {}\n", outputFileName.c_str());
+		fprintf(yyhout, "\t%s(TokenSource<YYSTYPE> *pSource) : PrattParser<YYSTYPE>(pSource, &yytables) {}\n", name);
 		fputs("\tint yyparse() override;\n", yyhout);
 		fputs("};\n", yyhout);
 	}
+	else if (lalr)
+	{
+		// LALR(1) LRParser class declaration
+		const char *name = outputFileName.c_str();
+		fprintf(yyhout, "class %s : public LRParser<YYSTYPE> {\n", name);
+		fputs("protected:\n", yyhout);
+		fputs("\tstatic const LRTable yytables;\n\n", yyhout);
+		fputs("\tvoid yyreduce(int rule, YYSTYPE *yyvsp, YYSTYPE &yyval) override;\n", yyhout);
+		fputs("public:\n", yyhout);
+		fprintf(yyhout, "\t%s(TokenSource<YYSTYPE> *pSource = nullptr) : LRParser<YYSTYPE>(pSource, &yytables) {}\n", name);
+		fputs("};\n", yyhout);
+	}
 	else
 	{
 		// LL(1) TableParser class declaration
-		fprintf(yyhout, "class %s : public TableParser {\n", outputFileName.c_str());
+		const char *name = outputFileName.c_str();
+		fprintf(yyhout, "class %s : public TableParser {\n", name);
 		fputs("protected:\n", yyhout);
-		fputs("\tstd::vector<std::pair<Symbols, YYSTYPE>> vs;\n\n", yyhout);
-		fputs("\tvoid initTable() override;\n", yyhout);
-		fputs("\tint yyrule(int rule) override;\n", yyhout);
-		fputs("\tint yyaction(int action) override;\n\n", yyhout);
-		fputs("\tvoid tokenMatch(int token) override\n\t{\n\t\tvs.push_back(std::make_pair(token, yylval));\n\t\tyylog(\"Pushed (%d, %f) onto the value stack: %zd\\n\", token, yylval, vs.size());\n\t}\n", yyhout);
-		fputs("\tvoid pop(int count) { for (int i = 0; i < count; i++) vs.pop_back(); yylog(\"\\nPopping %d items from value stack.\\n\", count); }", yyhout);
-		fprintf(yyhout, "\npublic:\n\t%s(LexicalAnalyzer lexer) : TableParser(lexer) {}\n", outputFileName.c_str());
+		fprintf(yyhout, "\tusing Action = void (%s::*)();\n\n", name);
+		fputs("\t// value stack, one value per symbol matched or predicted\n", yyhout);
+		fputs("\tstd::vector<YYSTYPE> vs;\n\n", yyhout);
+		fputs("\t// where the tokens come from, and the lookahead's value\n", yyhout);
+		fputs("\tTokenSource<YYSTYPE> *yysource;\n", yyhout);
+		fputs("\tYYSTYPE yylval;\n\n", yyhout);
+		fputs("\tstatic const ParseTable yytables;\n", yyhout);
+		fputs("\tstatic const Action yyactions[];\n\n", yyhout);
+		fputs("\t// each production's action, see yyactions\n", yyhout);
+		fputs("\ttemplate<int rule> void yyaction();\n\n", yyhout);
+		fputs("\tvoid pop(size_t count) { vs.erase(vs.end() - count, vs.end()); }\n", yyhout);
+		fputs("\tint yylex() { return yysource->yylex(yylval); }\n", yyhout);
+		fputs("\tint yystep(int token);\n", yyhout);
+		fprintf(yyhout, "\npublic:\n\t%s(TokenSource<YYSTYPE> *pSource = nullptr) : TableParser(&yytables), yysource(pSource), yylval() { vs.reserve(YYSTACKSIZE); }\n\n", name);
+		fputs("\tint yyparse() override;\n", yyhout);
+		fputs("\tint yypush(int token, const YYSTYPE &value);\n", yyhout);
 		fputs("};\n", yyhout);
 	}
 }
@@ -285,7 +518,7 @@ void BNFParser::OutputProductions()
 	auto iter = productions.begin();
 	for (; iter != productions.end(); iter++)
 	{
-		Production prod = *iter;
+		const Production &prod = *iter;
 		yylog("%s: ", prod.lhs.c_str());
 
 		auto symbols = prod.rhs.symbols.begin();
@@ -306,16 +539,15 @@ void BNFParser::GenerateTable()
 	// TODO - look for first/first conflicts
 	
 	// make sure all Nonterminals are on lhs of a production
-	auto sym = m_pSymbolTable->getFirstGlobal();
-	while (sym)
+	for (auto sym = m_pSymbolTable->begin_globals(); sym != m_pSymbolTable->end_globals(); ++sym)
 	{
 		if (sym->type == stNonTerminal && nonTerminals.find(sym->lexeme) == nonTerminals.end())
 		{
-			yywarning(Position(sym), "Non-terminal (%s) missing from left-hand side rule", sym->lexeme.c_str());
+			yywarning(Position(&*sym), "Non-terminal (%s) missing from left-hand side rule", sym->lexeme.c_str());
 		}
+	}
 
-		sym = m_pSymbolTable->getNextGlobal();
-	};
+	NumberSymbols();
 
 	ComputeNullable();
 
@@ -326,92 +558,96 @@ void BNFParser::GenerateTable()
 	yylog("\nNullable non-terminals");
 	yylog("----------------------");
 
-	for (auto iter = nullable.begin(); iter != nullable.end(); iter++)
-	{
-		yylog("%s is nullable\n", (*iter).c_str());
-	}
-
-	yylog("\nFirst sets");
-	yylog("----------");
-
-	for (auto iter = first.begin(); iter != first.end(); iter++)
+	for (unsigned nt = 0; nt < nonTerminalNames.size(); nt++)
 	{
-		yylog("First %s: [", iter->first.c_str());
-		for (auto rhs = iter->second.begin(); rhs != iter->second.end(); rhs++)
-		{
-			yylog("%s ", (*rhs).c_str());
-		}
-		yylog("]");
+		if (nullable[nt])
+			yylog("%s is nullable\n", nonTerminalNames[nt].c_str());
 	}
 
-	yylog("\nFollow sets");
-	yylog("-----------");
+	LogSets("First", first);
 
-	for (auto iter = follow.begin(); iter != follow.end(); iter++)
-	{
-		yylog("Follow %s: [", iter->first.c_str());
-		for (auto rhs = iter->second.begin(); rhs != iter->second.end(); rhs++)
-		{
-			yylog("%s ", (*rhs).c_str());
-		}
-		yylog("]");
-	}
+	LogSets("Follow", follow);
 
 	yylog("\nParse table rules");
 	yylog("-----------------");
 
+	size_t columns = terminalNames.size();
+	predictions.assign(nonTerminalNames.size() * columns, 0);
+
+	// the terminals that select each production
+	TerminalSet select;
+	select.resize(terminalNames.size());
+
 	// foreach production
-	for (auto iter = productions.begin(); iter != productions.end(); iter++)
+	for (unsigned prod = 0; prod < productions.size(); prod++)
 	{
-		auto lhs = iter->lhs;
-		auto rhs = iter->rhs.symbols;
-		
-		auto followSet = follow.find(lhs)->second;
+		const std::string &lhs = productions[prod].lhs;
+		const RightHandSide &rhs = productions[prod].rhs;
+		unsigned *row = &predictions[lhsIds[prod] * columns];
 
-		if (AreAllNullable(0, rhs.size(), rhs))
+		auto addRule = [&](unsigned terminal)
 		{
-			for (auto followy = followSet.begin(); followy != followSet.end(); followy++)
+			const std::string &name = terminalNames[terminal];
+
+			if (!row[terminal])
+				row[terminal] = prod + 1;
+			else
 			{
-				auto result = parseTable[lhs].insert(std::pair<std::string, RightHandSide>(*followy, RightHandSide(rhs, iter->rhs.action, iter->rhs.actionIndex)));
-				if (!result.second)
-				{
-					auto sym = m_pSymbolTable->lookup(lhs.c_str());
+				// the rules made for (...), ?, * and + have no symbol
+				auto sym = m_pSymbolTable->lookup(lhs.c_str());
+				if (sym)
 					yywarning(Position(sym), "Conflict! Production for non-terminal '%s' is ambiguous.", lhs.c_str());
-				}
+				else
+					yywarning("Conflict! Production for non-terminal '%s' is ambiguous.", lhs.c_str());
+			}
 
-				yylog("(%s, %s): %s -> ", lhs.c_str(), (*followy).c_str(), lhs.c_str());
-				for (auto i = rhs.begin(); i != rhs.end(); i++)
+			if (yydebug)
+			{
+				yylog("(%s, %s): %s -> ", lhs.c_str(), name.c_str(), lhs.c_str());
+				for (auto i = rhs.symbols.begin(); i != rhs.symbols.end(); i++)
 				{
 					yylog("%s ", i->name.c_str());
 				}
 				yylog("");
 			}
+		};
+
+		// FIRST[Y1...Yk], up to the first symbol that can't be empty
+		std::fill(select.bits.begin(), select.bits.end(), 0);
+		bool allNullable = true;
+
+		for (unsigned i = rhsStart[prod]; i < rhsStart[prod + 1] && allNullable; i++)
+		{
+			if (isTerminal(rhsIds[i]))
+			{
+				select.insert(rhsIds[i]);
+				allNullable = false;
+			}
+			else
+			{
+				unsigned nt = nonTerminalOf(rhsIds[i]);
+				select.merge(first[nt]);
+				allNullable = nullable[nt];
+			}
 		}
 
-		// (X, T) = production X -> Y for each T in FIRST[Yi]
-		if (rhs.size())
+		// (X, T) = production X -> Y for each T in FOLLOW[X] if Y can be empty
+		if (allNullable)
 		{
-			auto firstSet = first.find(rhs[0].name)->second;
-			for (auto firsty = firstSet.begin(); firsty != firstSet.end(); firsty++)
+			const TerminalSet &followSet = follow[lhsIds[prod]];
+			for (unsigned t = 0; t < terminalNames.size(); t++)
 			{
-				if (terminals.find(*firsty) != terminals.end())
-				{
-					auto result = parseTable[lhs].insert(std::pair<std::string, RightHandSide>(*firsty, RightHandSide(rhs, iter->rhs.action, iter->rhs.actionIndex)));
-					if (!result.second)
-					{
-						auto sym = m_pSymbolTable->lookup(lhs.c_str());
-						yywarning(Position(sym), "Conflict! Production for non-terminal '%s' is ambiguous.", lhs.c_str());
-					}
-
-					yylog("(%s, %s): %s -> ", lhs.c_str(), (*firsty).c_str(), lhs.c_str());
-					for (auto rhsIter = rhs.begin(); rhsIter != rhs.end(); rhsIter++)
-					{
-						yylog("%s ", rhsIter->name.c_str());
-					}
-					yylog("");
-				}
+				if (followSet.contains(t))
+					addRule(t);
 			}
 		}
+
+		// (X, T) = production X -> Y for each T in FIRST[Y]
+		for (unsigned t = 0; t < terminalNames.size(); t++)
+		{
+			if (select.contains(t))
+				addRule(t);
+		}
 	}
 }
 
@@ -435,22 +671,22 @@ void BNFParser::TemplateReplace(std::string &str, size_t symbolCount)
 {
 	char buf[256], buf2[256];
 
-	snprintf(buf, sizeof(buf), "vs[vs.size() - %d].second", (int)symbolCount + 1);
+	snprintf(buf, sizeof(buf), "vs[vs.size() - %d]", (int)symbolCount + 1);
 	replace(str, "$$", buf);
 
-	snprintf(buf, sizeof(buf), "vs[vs.size() - %d].second", (int)symbolCount + 2);
+	snprintf(buf, sizeof(buf), "vs[vs.size() - %d]", (int)symbolCount + 2);
 	replace(str, "$<", buf);
 
 	for (auto i = 1; i <= symbolCount; i++)
 	{
 		snprintf(buf, sizeof(buf), "$%d", i);
-		snprintf(buf2, sizeof(buf2), "vs[vs.size() - %d].second", (int)(1 + symbolCount - i));
+		snprintf(buf2, sizeof(buf2), "vs[vs.size() - %d]", (int)(1 + symbolCount - i));
 		replace(str, buf, buf2);
 	}
 }
 
 //
-std::string BNFParser::getRule(const std::string &lhs, RightHandSide &rhs)
+std::string BNFParser::getRule(const std::string &lhs, const RightHandSide &rhs)
 {
 	std::string str = lhs;
 
@@ -475,330 +711,598 @@ std::string BNFParser::getRule(const std::string &lhs, RightHandSide &rhs)
 }
 
 //
-void BNFParser::OutputTable()
+std::string BNFParser::symbolCode(const Symbol &sym) const
 {
-	fprintf(yyout, "#include \"%s.h\"\n\n", outputFileName.c_str());
-	fprintf(yyout, "void %s::initTable() {\n", outputFileName.c_str());
+	if (sym.type == SymbolType::Nonterminal)
+		return "NTS_" + sym.name;
 
-	fputs("\t// End Of File marker is last thing we'll see!\n\tss.push(0);\n\n", yyout);
+	if (sym.type == SymbolType::Terminal)
+		return "TS_" + sym.name;
+
+	unsigned char c = sym.name[0];
+	if (isprint(c) && c != '\'' && c != '\\')
+		return std::string("'") + sym.name + "'";
 
-	// push the start symbol
-	fprintf(yyout, "\t// push the start symbol\n\tss.push(NTS_%s);\n\n", startSymbol.c_str());
+	return std::to_string(c);
+}
 
-	fputs("\t// setup the LL(1) parse table\n", yyout);
+//======================================================================
+// The parser is the table, each rule's symbols, each production's
+// action with a table to call them through, and a yyparse() that runs
+// them: a rule is predicted by replacing the non-terminal on top of the
+// stack with the rule's symbols, copied in one go from yyrhs[], under
+// the action that ends it. Rules with no symbols have no action.
+//======================================================================
+void BNFParser::OutputTable()
+{
+	const char *name = outputFileName.c_str();
 
-	// write out the parser table rules
-	auto index = 1;
-	for (auto entry = parseTable.begin(); entry != parseTable.end(); entry++)
-	{
-		for (auto item = entry->second.begin(); item != entry->second.end(); item++)
-		{
-			const char *prefix = "TS_", *postfix = "";
-			auto sym = m_pSymbolTable->lookup(item->first.c_str());
-			if (!sym)
-			{
-				prefix = postfix = "'";
-			}
+	fprintf(yyout, "#include \"%s.h\"\n\n", name);
 
-			if (item->first == "")
-				fprintf(yyout, "\ttable[NTS_%s][0] = %d;\n", entry->first.c_str(), index++);
-			else
-				fprintf(yyout, "\ttable[NTS_%s][%s%s%s] = %d;\n", entry->first.c_str(), prefix, item->first.c_str(), postfix, index++);
-		}
-	}
+	OutputParseTable();
 
-	fputs("\n", yyout);
+	// rule n predicts production n - 1, pushing its action then its
+	// symbols from the right
+	fputs("// the symbols each rule pushes, from yyrhs[yyrhsStart[rule - 1]] up to\n// yyrhs[yyrhsStart[rule]]\n", yyout);
+	fputs("static constexpr int yyrhs[] = {\n", yyout);
 
-	// write out the parser table actions
-	for (auto entry = parseTable.begin(); entry != parseTable.end(); entry++)
+	std::vector<int> rhsStarts(1, 0);
+	for (auto production = productions.begin(); production != productions.end(); production++)
 	{
-		for (auto item = entry->second.begin(); item != entry->second.end(); item++)
+		const RightHandSide &rhs = production->rhs;
+
+		fprintf(yyout, "\t// %s\n", getRule(production->lhs, rhs).c_str());
+		if (rhs.symbols.empty())
 		{
-//			if (item->second.action != "")
-				fprintf(yyout, "\tactions[NTS_%s] = ACTION_%d;\n", entry->first.c_str(), item->second.actionIndex);
+			rhsStarts.push_back(rhsStarts.back());
+			continue;
 		}
-	}
 
-	fputs("}\n\n", yyout);
+		fprintf(yyout, "\tACTION_%d,", rhs.actionIndex);
+		for (auto i = rhs.symbols.rbegin(); i != rhs.symbols.rend(); i++)
+			fprintf(yyout, " %s,", symbolCode(*i).c_str());
+		fputs("\n", yyout);
 
-	fprintf(yyout, "int %s::yyrule(int rule)\n{\n", outputFileName.c_str());
-	fprintf(yyout, "\tswitch (rule)\n\t{\n");
-
-	index = 1;
-	for (auto nt = parseTable.begin(); nt != parseTable.end(); nt++)
-	{
-		auto entry = *nt;
-		for (auto t = entry.second.begin(); t != entry.second.end(); t++)
-		{
-			auto str = getRule(entry.first, t->second);
+		rhsStarts.push_back(rhsStarts.back() + (int)rhs.symbols.size() + 1);
+	}
 
-			fprintf(yyout, "\t\t// %s\n", str.c_str());
-			fprintf(yyout, "\t\tcase %d:\n", index++);
-			fprintf(yyout, "\t\t\tyylog(\"%s\\n\");\n", str.c_str());
-			fputs("\t\t\ttokenMatch(ss.top());\n\t\t\tss.pop();\n", yyout);
+	if (rhsStarts.back() == 0)
+		fputs("\t0\n", yyout);
+	fputs("};\n\n", yyout);
 
-//			if (t->second.action != "")
-			{
-				fprintf(yyout, "\t\t\tss.push(ACTION_%d);\n", t->second.actionIndex);
-			}
+	OutputArray("unsigned", "yyrhsStart", rhsStarts);
 
-			for (auto i = t->second.symbols.rbegin(); i != t->second.symbols.rend(); i++)
-			{
-				const char *prefix = "TS_", *postfix = "";
+	// the actions
+	for (auto production = productions.begin(); production != productions.end(); production++)
+	{
+		const RightHandSide &rhs = production->rhs;
+		if (rhs.symbols.empty())
+			continue;
 
-				if (i->type == SymbolType::Nonterminal)
-					prefix = "NTS_";
+		auto str = getRule(production->lhs, rhs);
+		fprintf(yyout, "// %s\n", str.c_str());
+		fprintf(yyout, "template<> void %s::yyaction<%d>()\n{\n", name, rhs.actionIndex);
 
-				if (i->type == SymbolType::CharTerminal)
-				{
-					postfix = prefix = "'";
-				}
+		if (yytrace)
+			fprintf(yyout, "\tYYLOG(\"Action: %s\\n\");\n", str.c_str());
 
-				fprintf(yyout, "\t\t\tss.push(%s%s%s);\n", prefix, i->name.c_str(), postfix);
-			}
-			fputs("\t\t\tbreak;\n\n", yyout);
+		// if there is an action then output that code
+		if (rhs.action != "")
+		{
+			std::string action = rhs.action;
+			TemplateReplace(action, rhs.symbols.size());
+			fprintf(yyout, "\t%s\n", action.c_str());
+		}
+		else {
+			// default is to left-propagate the first symbols value
+			fprintf(yyout, "\tvs[vs.size() - %zd] = vs[vs.size() - %zd];\n", rhs.symbols.size() + 1, rhs.symbols.size());
 		}
-	}
-
-	fputs("\t\tdefault:\n\t\t\tyyerror(\"parsing table defaulted\");\n\t\t\treturn 0;\n\t\t\tbreak;\n", yyout);
-	fputs("\t}\n", yyout);
-	fputs("\treturn rule;\n}\n\n", yyout);
 
-	// generate the actions handler
-	fprintf(yyout, "int %s::yyaction(int action)\n{\n", outputFileName.c_str());
-	fprintf(yyout, "\tswitch (action)\n\t{\n");
+		fprintf(yyout, "\tpop(%zd);\n}\n\n", rhs.symbols.size());
+	}
 
-	std::set<int> actions;
-	for (auto nt = parseTable.begin(); nt != parseTable.end(); nt++)
+	fprintf(yyout, "const %s::Action %s::yyactions[] = {\n", name, name);
+	for (auto production = productions.begin(); production != productions.end(); production++)
 	{
-		auto entry = *nt;
-		for (auto t = entry.second.begin(); t != entry.second.end(); t++)
-		{
-			if (actions.insert(t->second.actionIndex).second == false)
-				continue;
-
-			auto str = getRule(entry.first, t->second);
-			fprintf(yyout, "\t// %s\n", str.c_str());
+		if (production->rhs.symbols.empty())
+			fputs("\tnullptr,\n", yyout);
+		else
+			fprintf(yyout, "\t&%s::yyaction<%d>,\n", name, production->rhs.actionIndex);
+	}
+	fputs("};\n\n", yyout);
 
-			fprintf(yyout, "\tcase ACTION_%d:\n", t->second.actionIndex);
-			fputs("\t\t{\n", yyout);
-			fprintf(yyout, "\t\t\tyylog(\"Action: %s\\n\");\n", str.c_str());
+	// the parser, pulling its tokens or having them pushed, around the
+	// steps each one calls for
+	fprintf(yyout, "int %s::yypush(int token, const YYSTYPE &value)\n{\n", name);
+	fputs("\tyylval = value;\n\treturn yystep(token);\n}\n\n", yyout);
+
+	fprintf(yyout, "int %s::yyparse()\n{\n", name);
+	fputs("\tyyreset();\n\n\tint status;\n", yyout);
+	fputs("\tdo\n\t\tstatus = yystep(yylex());\n", yyout);
+	fputs("\twhile (status == YYPUSH_MORE);\n\n\treturn status;\n}\n\n", yyout);
+
+	fprintf(yyout, "int %s::yystep(int token)\n{\n", name);
+	fputs("\t// End Of File marker is last thing we'll see, under the start symbol\n", yyout);
+	fputs("\tif (!depth)\n\t{\n\t\tpush(0);\n", yyout);
+	fprintf(yyout, "\t\tpush(NTS_%s);\n", startSymbol.c_str());
+	fputs("\t\tvs.clear();\n\t}\n\n", yyout);
+	fputs("\twhile (depth)\n\t{\n", yyout);
+	fputs("\t\tint top = ss[depth - 1];\n\n", yyout);
+
+	fputs("\t\t// if the token matches TOS then we match the token\n", yyout);
+	fputs("\t\tif (top == token)\n\t\t{\n", yyout);
+	if (yytrace)
+		fputs("\t\t\tYYLOG(\"Matched token: %d\\n\", token);\n", yyout);
+	fputs("\t\t\tdepth--;\n", yyout);
+	fputs("\t\t\tif (token)\n\t\t\t\tvs.push_back(yylval);\n\n", yyout);
+	fputs("\t\t\t// if there is more parsing to do, then it's for the next token\n", yyout);
+	fputs("\t\t\tif (depth)\n\t\t\t\treturn YYPUSH_MORE;\n", yyout);
+	fputs("\t\t}\n", yyout);
+
+	fputs("\t\telse if (top > FIRST_ACTION)\n\t\t{\n", yyout);
+	fputs("\t\t\tdepth--;\n", yyout);
+	fputs("\t\t\t(this->*yyactions[top - FIRST_ACTION - 1])();\n", yyout);
+	fputs("\t\t}\n", yyout);
+
+	fputs("\t\telse\n\t\t{\n", yyout);
+	fprintf(yyout, "\t\t\tint rule = yytables.predict(top, token);\n");
+	fputs("\t\t\tif (!rule)\n\t\t\t{\n\t\t\t\tunexpectedToken(token);\n\t\t\t\treturn YYPUSH_ERROR;\n\t\t\t}\n\n", yyout);
+	if (yytrace)
+		fputs("\t\t\tYYLOG(\"Predict rule %d\\n\", rule);\n\n", yyout);
+	fputs("\t\t\t// the non-terminal's value stays for the rule's action to set\n", yyout);
+	fputs("\t\t\tdepth--;\n", yyout);
+	fputs("\t\t\tvs.push_back(yylval);\n", yyout);
+	fputs("\t\t\tpush(&yyrhs[yyrhsStart[rule - 1]], yyrhsStart[rule] - yyrhsStart[rule - 1]);\n", yyout);
+	fputs("\t\t}\n", yyout);
+
+	fputs("\t}\n\n\treturn YYPUSH_ACCEPT;\n}\n\n", yyout);
+}
 
-			if (t->second.symbols.size())
-			{
-				// if there is an action then output that code
-				if (t->second.action != "")
-				{
-					TemplateReplace(t->second.action, t->second.symbols.size());
-					fprintf(yyout, "\t\t\t%s\n", t->second.action.c_str());
-				}
-				else {
-					// default is to left-propagate the first symbols value
-					fprintf(yyout, "\t\t\tvs[vs.size() - %zd].second = vs[vs.size() - %zd].second;\n", t->second.symbols.size() + 1, t->second.symbols.size());
-				}
+//
+int BNFParser::tokenValue(unsigned terminal) const
+{
+	const std::string &name = terminalNames[terminal];
 
-				fprintf(yyout, "\t\t\tpop(%zd);\n", t->second.symbols.size());
-			}
-			else
-			{
-				fputs("\t\t\t// do nothing!\n", yyout);
-			}
+	// the end of input
+	if (name.empty())
+		return 0;
 
-			fputs("\t\t}\n\t\tbreak;\n\n", yyout);
-		}
-	}
+	// named tokens follow ERROR = 256 in the enum, see OutputSymbols()
+	auto token = tokens.find(name);
+	if (token != tokens.end())
+		return 257 + (int)std::distance(tokens.begin(), token);
 
-	fputs("\tdefault:\n\t\treturn 0;\n\t\tbreak;\n", yyout);
-	fputs("\t}\n", yyout);
-	fputs("\treturn action;\n}\n\n", yyout);
+	return (unsigned char)name[0];
 }
 
 //
-bool BNFParser::AreAllNullable(size_t start, size_t end, const SymbolList &symbols)
+void BNFParser::OutputArray(const char *type, const char *name, const std::vector<int> &values)
 {
-	bool allNullable = true;
+	fprintf(yyout, "static constexpr %s %s[%zu] = {", type, name, values.size());
 
-	for (auto i = start; i < end; i++)
+	for (size_t i = 0; i < values.size(); i++)
 	{
-		if (nullable.find(symbols[i].name) == nullable.end())
-			allNullable = false;
+		if (i % 16 == 0)
+			fputs("\n\t", yyout);
+		fprintf(yyout, "%d,", values[i]);
 	}
 
-	if (allNullable)
-		return true;
-	else
-		return false;
+	fputs("\n};\n\n", yyout);
 }
 
-//
-//for each production X->Y1Y2...Yk
-//	for each i from 1 to k, each j from i + 1 to k
-//		if Y1...Yi - 1 are all nullable(or if i = 1)
-//			then FIRST[X] = FIRST[X] u FIRST[Yi]
-//
-void BNFParser::ComputeFirst()
+//======================================================================
+// Comb compression: the entries of each row that aren't 0 or its default
+// go at base[row] + column in next[], and check[] says which row each
+// slot belongs to. The rows with most entries go first, each at the
+// lowest offset where its entries land on free slots. Returns the size
+// of next[].
+//======================================================================
+size_t BNFParser::PackTable(const std::vector<int> &cells, size_t rows, size_t columns, const std::vector<int> &defaults,
+	std::vector<int> &base, std::vector<int> &next, std::vector<int> &check)
 {
-	// for all Terminals, First[T] = {T}
-	auto terminalIter = terminals.begin();
-	for (; terminalIter != terminals.end(); terminalIter++)
+	std::vector<std::vector<unsigned>> entries(rows);
+
+	for (size_t row = 0; row < rows; row++)
 	{
-		first[*terminalIter].insert(*terminalIter);
+		const int *values = &cells[row * columns];
+		for (unsigned column = 0; column < columns; column++)
+		{
+			if (values[column] && values[column] != defaults[row])
+				entries[row].push_back(column);
+		}
 	}
 
-	auto done = true;
+	std::vector<unsigned> order(rows);
+	for (unsigned row = 0; row < rows; row++)
+		order[row] = row;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+	{
+		return entries[a].size() > entries[b].size();
+	});
 
-	do
+	base.assign(rows, 0);
+	next.clear();
+	check.clear();
+
+	size_t size = columns;
+	for (auto row = order.begin(); row != order.end() && !entries[*row].empty(); row++)
 	{
-		done = true;
+		const std::vector<unsigned> &columnsUsed = entries[*row];
 
-		// foreach production
-		auto prodIter = productions.begin();
-		for (; prodIter != productions.end(); prodIter++)
+		unsigned offset = 0;
+		for (;; offset++)
 		{
-			Production prod = *prodIter;
+			bool fits = true;
+			for (auto t = columnsUsed.begin(); t != columnsUsed.end() && fits; t++)
+				fits = offset + *t >= check.size() || check[offset + *t] == EMPTY_SLOT;
+			if (fits)
+				break;
+		}
 
-			auto nullSoFar = true;
+		if (offset + columns > check.size())
+		{
+			next.resize(offset + columns, 0);
+			check.resize(offset + columns, EMPTY_SLOT);
+		}
 
-			// foreach symbol
-			for (auto symbolIndex = 0; symbolIndex < prod.rhs.symbols.size(); symbolIndex++)
-			{
-				auto rhs = prod.rhs.symbols[symbolIndex];
+		base[*row] = offset;
+		for (auto t = columnsUsed.begin(); t != columnsUsed.end(); t++)
+		{
+			next[offset + *t] = cells[*row * columns + *t];
+			check[offset + *t] = *row;
+		}
 
-				if (nullable.find(rhs.name) == nullable.end())
-					nullSoFar = false;
+		size = std::max(size, (size_t)offset + columns);
+	}
 
-				// insert first[Yi] into first[X]
-				if (0 == symbolIndex || nullSoFar)
-				{
-					auto rhsSet = first[rhs.name];
-
-					for (auto rhsIter = rhsSet.begin(); rhsIter != rhsSet.end(); rhsIter++)
-					{
-						auto result = first[prod.lhs].insert(*rhsIter);
-						if (result.second)
-							done = false;
-					}
-				}
-			}
-		}
-	} while (!done);
+	next.resize(size, 0);
+	check.resize(size, EMPTY_SLOT);
+
+	return size;
 }
 
-//
-//for each production X->Y1Y2...Yk
-//	for each i from 1 to k, each j from i + 1 to k
-//		if Yi + 1...Yk are all nullable(or if i = k)
-//			then FOLLOW[Yi] = FOLLOW[Yi] u FOLLOW[X]
-//		if Yi + 1...Yj - 1 are all nullable(or if i + 1 = j)
-//			then FOLLOW[Yi] = FOLLOW[Yi] u FIRST[Yj]
-//
-void BNFParser::ComputeFollow()
+//======================================================================
+// The table goes out as constant data, see ParseTable in tableparser.h.
+// Up to DENSE_TABLE_LIMIT entries it is a plain array; past that each
+// row's most common rule becomes its default and the rest are packed
+// into a comb, the rows with most entries first, each at the lowest
+// offset where its entries land on free slots.
+//======================================================================
+void BNFParser::OutputParseTable()
 {
-	auto done = true;
+	size_t rows = nonTerminalNames.size(), columns = terminalNames.size();
 
-	// initialize follow set with (start,EOF) and EOF for all nullables
-	follow[startSymbol].insert("");
-	for (auto nullIter = nullable.begin(); nullIter != nullable.end(); nullIter++)
+	if (rows >= EMPTY_SLOT || productions.size() >= EMPTY_SLOT)
 	{
-		follow[*nullIter].insert("");
+		yyerror("Grammar is too large for the parse table");
+		return;
 	}
 
-	do
+	// token -> column, with columns for a token that has none
+	std::vector<int> translate(257 + tokens.size(), (int)columns);
+	for (unsigned t = 0; t < columns; t++)
+		translate[tokenValue(t)] = t;
+
+	fputs("// LL(1) parse table, see ParseTable in tableparser.h\n", yyout);
+	OutputArray("unsigned short", "yytranslate", translate);
+
+	bool dense = rows * columns <= DENSE_TABLE_LIMIT;
+
+	if (dense)
+	{
+		fprintf(yyout, "static constexpr unsigned short yydense[%zu] = {\n", rows * columns);
+		for (size_t row = 0; row < rows; row++)
+		{
+			fprintf(yyout, "\t// %s\n", nonTerminalNames[row].c_str());
+			for (size_t t = 0; t < columns; t++)
+				fprintf(yyout, "%s%u,", t % 16 ? "" : t ? "\n\t" : "\t", predictions[row * columns + t]);
+			fputs("\n", yyout);
+		}
+		fputs("};\n\n", yyout);
+	}
+	else
 	{
-		done = true;
+		std::vector<int> cells(predictions.begin(), predictions.end());
+		std::vector<int> defaults(rows, 0), base, next, check;
 
-		// foreach production
-		auto prodIter = productions.begin();
-		for (; prodIter != productions.end(); prodIter++)
+		for (size_t row = 0; row < rows; row++)
 		{
-			Production prod = *prodIter;
-		
-			// foreach symbol
-			for (auto i = 0; i < prod.rhs.symbols.size(); i++)
-			{
-				auto rhs = prod.rhs.symbols;
-				auto Yi = rhs[i].name;
+			const unsigned *rules = &predictions[row * columns];
 
-				if (rhs[i].type == SymbolType::Nonterminal)
-				{
-					if ((i == prod.rhs.symbols.size() - 1 || AreAllNullable(i + 1, rhs.size(), rhs)))
-					{
-						// insert follow[X] in follow[Yi]
-						auto X = prod.lhs;
-						auto followSet = follow[X];
-						for (auto rhsIter = followSet.begin(); rhsIter != followSet.end(); rhsIter++)
-						{
-							auto result = follow[Yi].insert(*rhsIter);
-							if (result.second)
-								done = false;
-						}
-					}
-
-					for (auto j = i + 1; j < prod.rhs.symbols.size(); j++)
-					{
-						if (i + 1 == j || AreAllNullable(i + 1, j - 1, rhs))
-						{
-							// insert first[Yj] in follow[Yi]
-							auto Yj = prod.rhs.symbols[j].name;
-							auto firstSet = first[Yj];
-							for (auto rhsIter = firstSet.begin(); rhsIter != firstSet.end(); rhsIter++)
-							{
-								auto result = follow[Yi].insert(*rhsIter);
-								if (result.second)
-									done = false;
-							}
-						}
-					}
-				}
+			std::map<unsigned, unsigned> counts;
+			for (size_t t = 0; t < columns; t++)
+			{
+				if (rules[t] && ++counts[rules[t]] > counts[defaults[row]])
+					defaults[row] = rules[t];
 			}
 		}
 
-	} while (!done);
-}
+		size_t size = PackTable(cells, rows, columns, defaults, base, next, check);
 
-//
-//for each production X->Y1Y2...Yk
-//	if Y1...Yk are all nullable(or if k = 0)
-//		then nullable[X] = true
-//
-void BNFParser::ComputeNullable()
-{
-	auto done = true;
+		OutputArray("int", "yybase", base);
+		OutputArray("unsigned short", "yynext", next);
+		OutputArray("unsigned short", "yycheck", check);
+		OutputArray("unsigned short", "yydefaults", defaults);
 
-	do
+		yylog("\nParse table of %zu x %zu packed into %zu entries", rows, columns, size);
+	}
+
+	fprintf(yyout, "const ParseTable %s::yytables = {\n", outputFileName.c_str());
+	fprintf(yyout, "\tNTS_%s, NTS_%s, %zu, %zu, %zu,\n", startSymbol.c_str(), nonTerminalNames[0].c_str(), rows, columns, translate.size());
+	if (dense)
+		fputs("\tyytranslate, yydense, nullptr, nullptr, nullptr, nullptr\n", yyout);
+	else
+		fputs("\tyytranslate, nullptr, yybase, yynext, yycheck, yydefaults\n", yyout);
+	fputs("};\n\n", yyout);
+}
+
+//======================================================================
+// Number the symbols for the analysis below and put the productions in
+// terms of those numbers
+//======================================================================
+void BNFParser::NumberSymbols()
+{
+	// non-terminals used without a rule of their own are numbered too
+	std::set<std::string> names = nonTerminals;
+	for (auto prod = productions.begin(); prod != productions.end(); prod++)
 	{
-		done = true;
+		for (auto sym = prod->rhs.symbols.begin(); sym != prod->rhs.symbols.end(); sym++)
+		{
+			if (sym->type == SymbolType::Nonterminal)
+				names.insert(sym->name);
+			else
+				terminals.insert(sym->name);
+		}
+	}
 
-		auto prodIter = productions.begin();
-		for (; prodIter != productions.end(); prodIter++)
+	// the end of input is "" in the table, and sorts first
+	terminalNames.assign(1, "");
+	terminalNames.insert(terminalNames.end(), terminals.begin(), terminals.end());
+	nonTerminalNames.assign(names.begin(), names.end());
+
+	terminalIds.clear();
+	for (unsigned i = 0; i < terminalNames.size(); i++)
+		terminalIds[terminalNames[i]] = i;
+
+	nonTerminalIds.clear();
+	for (unsigned i = 0; i < nonTerminalNames.size(); i++)
+		nonTerminalIds[nonTerminalNames[i]] = i;
+
+	unsigned terminalCount = (unsigned)terminalNames.size();
+
+	lhsIds.clear();
+	rhsStart.clear();
+	rhsIds.clear();
+
+	for (auto prod = productions.begin(); prod != productions.end(); prod++)
+	{
+		lhsIds.push_back(nonTerminalIds[prod->lhs]);
+		rhsStart.push_back((unsigned)rhsIds.size());
+
+		for (auto sym = prod->rhs.symbols.begin(); sym != prod->rhs.symbols.end(); sym++)
 		{
-			Production prod = *prodIter;
+			if (sym->type == SymbolType::Nonterminal)
+				rhsIds.push_back(terminalCount + nonTerminalIds[sym->name]);
+			else
+				rhsIds.push_back(terminalIds[sym->name]);
+		}
+	}
 
-			auto symbols = prod.rhs.symbols.begin();
-			if (symbols == prod.rhs.symbols.end())
+	rhsStart.push_back((unsigned)rhsIds.size());
+}
+
+//======================================================================
+// Until nothing changes, sets[x] takes in sets[y] for each x in into[y].
+// Only the sets that grew are looked at again.
+//======================================================================
+void BNFParser::Propagate(std::vector<TerminalSet> &sets, const std::vector<std::vector<unsigned>> &into)
+{
+	std::vector<unsigned> work;
+	std::vector<bool> queued(sets.size(), true);
+
+	for (unsigned i = (unsigned)sets.size(); i-- > 0; )
+		work.push_back(i);
+
+	while (!work.empty())
+	{
+		unsigned y = work.back();
+		work.pop_back();
+		queued[y] = false;
+
+		for (auto x = into[y].begin(); x != into[y].end(); x++)
+		{
+			if (sets[*x].merge(sets[y]) && !queued[*x])
 			{
-				auto result = nullable.insert(prod.lhs);
-				if (result.second)
-					done = false;
+				queued[*x] = true;
+				work.push_back(*x);
 			}
-			else
+		}
+	}
+}
+
+//
+void BNFParser::LogSets(const char *title, const std::vector<TerminalSet> &sets)
+{
+	if (!yydebug)
+		return;
+
+	yylog("\n%s sets", title);
+	yylog("%s", std::string(strlen(title) + 5, '-').c_str());
+
+	for (unsigned nt = 0; nt < sets.size(); nt++)
+	{
+		yylog("%s %s: [", title, nonTerminalNames[nt].c_str());
+		for (unsigned t = 0; t < terminalNames.size(); t++)
+		{
+			if (sets[nt].contains(t))
+				yylog("%s ", terminalNames[t].c_str());
+		}
+		yylog("]");
+	}
+}
+
+//
+//for each production X->Y1Y2...Yk
+//	for each i from 1 to k
+//		if Y1...Yi - 1 are all nullable(or if i = 1)
+//			then FIRST[X] = FIRST[X] u FIRST[Yi]
+//
+// Terminals go straight in; a non-terminal Yi makes FIRST[X] take in
+// whatever FIRST[Yi] gets, see Propagate()
+//
+void BNFParser::ComputeFirst()
+{
+	size_t count = nonTerminalNames.size();
+
+	first.assign(count, TerminalSet());
+	for (auto set = first.begin(); set != first.end(); set++)
+		set->resize(terminalNames.size());
+
+	std::vector<std::vector<unsigned>> into(count);
+
+	// foreach production
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		unsigned X = lhsIds[prod];
+
+		// foreach symbol, until one that can't be empty
+		for (unsigned i = rhsStart[prod]; i < rhsStart[prod + 1]; i++)
+		{
+			if (isTerminal(rhsIds[i]))
 			{
-				auto nullableCount = 0;
-				for (; symbols != prod.rhs.symbols.end(); symbols++)
-				{
-					if (nullable.find(symbols->name) != nullable.end())
-						nullableCount++;
-				}
+				first[X].insert(rhsIds[i]);
+				break;
+			}
 
-				if (nullableCount == prod.rhs.symbols.size())
-				{
-					auto result = nullable.insert(prod.lhs);
-					if (result.second)
-						done = false;
-				}
+			unsigned Yi = nonTerminalOf(rhsIds[i]);
+			if (Yi != X)
+				into[Yi].push_back(X);
+
+			if (!nullable[Yi])
+				break;
+		}
+	}
+
+	Propagate(first, into);
+}
+
+//
+//for each production X->Y1Y2...Yk
+//	for each i from 1 to k, each j from i + 1 to k
+//		if Yi + 1...Yk are all nullable(or if i = k)
+//			then FOLLOW[Yi] = FOLLOW[Yi] u FOLLOW[X]
+//		if Yi + 1...Yj - 1 are all nullable(or if i + 1 = j)
+//			then FOLLOW[Yi] = FOLLOW[Yi] u FIRST[Yj]
+//
+// Walking each production from the right gives FIRST[Yi+1...Yk] as it
+// goes, so the second rule is applied directly and the first becomes
+// FOLLOW[Yi] taking in FOLLOW[X], see Propagate()
+//
+void BNFParser::ComputeFollow()
+{
+	size_t count = nonTerminalNames.size();
+
+	follow.assign(count, TerminalSet());
+	for (auto set = follow.begin(); set != follow.end(); set++)
+		set->resize(terminalNames.size());
+
+	// the start symbol is followed by the end of input
+	auto start = nonTerminalIds.find(startSymbol);
+	if (start != nonTerminalIds.end())
+		follow[start->second].insert(0);
+
+	std::vector<std::vector<unsigned>> into(count);
+
+	TerminalSet rest;
+	rest.resize(terminalNames.size());
+
+	// foreach production
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		unsigned X = lhsIds[prod];
+
+		std::fill(rest.bits.begin(), rest.bits.end(), 0);
+		bool restNullable = true;
+
+		// foreach symbol, from the right
+		for (unsigned i = rhsStart[prod + 1]; i-- > rhsStart[prod]; )
+		{
+			if (isTerminal(rhsIds[i]))
+			{
+				std::fill(rest.bits.begin(), rest.bits.end(), 0);
+				rest.insert(rhsIds[i]);
+				restNullable = false;
+				continue;
+			}
+
+			unsigned Yi = nonTerminalOf(rhsIds[i]);
+
+			follow[Yi].merge(rest);
+			if (restNullable && Yi != X)
+				into[X].push_back(Yi);
+
+			if (nullable[Yi])
+				rest.merge(first[Yi]);
+			else
+			{
+				rest = first[Yi];
+				restNullable = false;
 			}
 		}
-	} while (!done);
+	}
+
+	Propagate(follow, into);
+}
+
+//
+//for each production X->Y1Y2...Yk
+//	if Y1...Yk are all nullable(or if k = 0)
+//		then nullable[X] = true
+//
+// Each production counts down the symbols not yet known to be nullable,
+// and a non-terminal found to be nullable counts down the productions
+// it appears in
+//
+void BNFParser::ComputeNullable()
+{
+	size_t count = nonTerminalNames.size();
+
+	nullable.assign(count, false);
+
+	std::vector<std::vector<unsigned>> usedIn(count);
+	std::vector<unsigned> remaining(productions.size());
+	std::vector<unsigned> work;
+
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		remaining[prod] = rhsStart[prod + 1] - rhsStart[prod];
+
+		for (unsigned i = rhsStart[prod]; i < rhsStart[prod + 1]; i++)
+		{
+			if (!isTerminal(rhsIds[i]))
+				usedIn[nonTerminalOf(rhsIds[i])].push_back(prod);
+		}
+
+		if (!remaining[prod])
+			work.push_back(lhsIds[prod]);
+	}
+
+	while (!work.empty())
+	{
+		unsigned nt = work.back();
+		work.pop_back();
+
+		if (nullable[nt])
+			continue;
+
+		nullable[nt] = true;
+
+		for (auto prod = usedIn[nt].begin(); prod != usedIn[nt].end(); prod++)
+		{
+			if (!--remaining[*prod])
+				work.push_back(lhsIds[*prod]);
+		}
+	}
 }
 
 //
@@ -810,8 +1314,11 @@ int BNFParser::yyparse()
 
 	if (lookahead == TV_PERCENT_LBRACE)
 	{
-		// copy contents to output file
-		m_lexer->copyUntilChar('%', 0, yyout);
+		// copy contents to output file, unless it's for a corpus
+		if (corpusSize)
+			static_cast<BNFLexer *>(m_lexer.get())->skipUntilChar('%');
+		else
+			m_lexer->copyUntilChar('%', 0, yyout);
 
 		match(lookahead);
 
@@ -828,7 +1335,18 @@ int BNFParser::yyparse()
 	
 	OutputProductions();
 
-	if (!isPrattMode())
+	// a corpus is all that's written, and the rest of the file is C++
+	if (corpusSize)
+	{
+		GenerateCorpus();
+		return 0;
+	}
+
+	if (lalr)
+	{
+		GenerateLALR();
+	}
+	else if (!isPrattMode())
 	{
 		GenerateTable();
 	}
@@ -837,15 +1355,26 @@ int BNFParser::yyparse()
 		DetectExprNonterminals();
 	}
 
-	OutputSymbols();
-
-	if (!isPrattMode())
+	if (isRecursiveDescent())
 	{
-		OutputTable();
+		OutputRecursiveDescent();
 	}
 	else
 	{
-		OutputPrattTable();
+		OutputSymbols();
+
+		if (lalr)
+		{
+			OutputLALRTable();
+		}
+		else if (!isPrattMode())
+		{
+			OutputTable();
+		}
+		else
+		{
+			OutputPrattTable();
+		}
 	}
 
 	// copy tail of file to output
@@ -874,6 +1403,44 @@ bool BNFParser::isInfixProduction(const Production& prod) const
 		&& m_operatorDecls.count(rhs[1].name) > 0;
 }
 
+// Returns true for a prefix operator production:  X → op X
+bool BNFParser::isPrefixProduction(const Production& prod) const
+{
+	const auto& rhs = prod.rhs.symbols;
+	return rhs.size() == 2
+		&& rhs[0].type != SymbolType::Nonterminal
+		&& rhs[1].type == SymbolType::Nonterminal && rhs[1].name == prod.lhs;
+}
+
+// Returns true for a postfix operator production:  X → X op
+bool BNFParser::isPostfixProduction(const Production& prod) const
+{
+	const auto& rhs = prod.rhs.symbols;
+	return rhs.size() == 2
+		&& rhs[0].type == SymbolType::Nonterminal && rhs[0].name == prod.lhs
+		&& rhs[1].type != SymbolType::Nonterminal;
+}
+
+// Returns true if an expression non-terminal has a production of the kind
+bool BNFParser::hasProduction(bool (BNFParser::*kind)(const Production&) const) const
+{
+	for (const auto& prod : productions)
+	{
+		if (m_exprNonterminals.count(prod.lhs) && (this->*kind)(prod))
+			return true;
+	}
+	return false;
+}
+
+// Returns the token value of an operator, as the TS_ enum numbers them
+int BNFParser::opTokenValue(const std::string& name) const
+{
+	auto token = tokens.find(name);
+	if (token != tokens.end())
+		return 257 + (int)std::distance(tokens.begin(), token);
+	return (unsigned char)name[0];
+}
+
 // Returns the C++ token expression for a symbol: 'x' for char terminals,
 // TS_NAME for named terminals.
 std::string BNFParser::symbolTokenName(const Symbol& sym) const
@@ -905,42 +1472,81 @@ void BNFParser::DetectExprNonterminals()
 }
 
 // ---------------------------------------------------------------------------
-// OutputPrattTable — generates the three methods that make up a Pratt parser:
+// OutputPrattTable — generates the tables and methods of a Pratt parser:
 //
-//   initPrattTable()  — populate m_infixBP from the %left/%right declarations
-//   nud(token, val)   — null denotation: prefix/atom cases
+//   yytables          — binding powers by token, see PrattTable
+//   nud(token, val)   — null denotation: atoms and bracketed forms
 //   led(op, l, r)     — left denotation: infix binary cases
-//   yyparse()         — entry point; drives parseExpr() and runs the start action
+//   prefix()/postfix() — X → op X and X → X op cases, if there are any
+//   yyparse()         — entry point; drives parseExprIterative() and runs
+//                       the start action
+//
+// Infix operators bind as declared. A prefix or postfix operator binds at
+// its declared level too, or tighter than every infix operator if it
+// isn't declared.
 // ---------------------------------------------------------------------------
 void BNFParser::OutputPrattTable()
 {
-	fprintf(yyout, "#include \"%s.h\"\n\n", outputFileName.c_str());
-
-	// --- initPrattTable() ---
-	fprintf(yyout, "void %s::initPrattTable() {\n", outputFileName.c_str());
-	for (const auto& kv : m_operatorDecls)
-	{
-		const auto& opName = kv.first;
-		const auto& decl   = kv.second;
-		int lbp = decl.level;
-		int rbp = decl.rightAssoc ? decl.level - 1 : decl.level;
-		fprintf(yyout, "\tm_infixBP[%s] = {%d, %d};\n",
-		        opTokenName(opName).c_str(), lbp, rbp);
+	const char *name = outputFileName.c_str();
+
+	fprintf(yyout, "#include \"%s.h\"\n\n", name);
+
+	if (m_nextPrecLevel > 255)
+	{
+		yyerror("Too many precedence levels");
+		return;
 	}
-	fprintf(yyout, "}\n\n");
 
-	// --- nud() — handles atoms and prefix expressions ---
+	// --- binding powers ---
+	size_t count = 257 + tokens.size();
+	std::vector<int> infixLeft(count, 0), infixRight(count, 0), prefixBP(count, 0), postfixBP(count, 0);
+
+	for (const auto& prod : productions)
+	{
+		if (!m_exprNonterminals.count(prod.lhs))
+			continue;
+
+		bool infix = isInfixProduction(prod);
+		if (!infix && !isPrefixProduction(prod) && !isPostfixProduction(prod))
+			continue;
+
+		const std::string& op = prod.rhs.symbols[infix ? 1 : isPrefixProduction(prod) ? 0 : 1].name;
+		auto decl = m_operatorDecls.find(op);
+		int level = decl != m_operatorDecls.end() ? decl->second.level : m_nextPrecLevel;
+		int token = opTokenValue(op);
+
+		if (infix)
+		{
+			infixLeft[token] = level;
+			infixRight[token] = decl->second.rightAssoc ? level - 1 : level;
+		}
+		else if (isPrefixProduction(prod))
+			prefixBP[token] = level;
+		else
+			postfixBP[token] = level;
+	}
+
+	fputs("// binding powers by token, see PrattTable in tableparser.h\n", yyout);
+	OutputArray("unsigned char", "yyinfixLeft", infixLeft);
+	OutputArray("unsigned char", "yyinfixRight", infixRight);
+	OutputArray("unsigned char", "yyprefix", prefixBP);
+	OutputArray("unsigned char", "yypostfix", postfixBP);
+
+	fprintf(yyout, "const PrattTable %s::yytables = {\n", name);
+	fprintf(yyout, "\t%zu, yyinfixLeft, yyinfixRight, yyprefix, yypostfix\n};\n\n", count);
+
+	// --- nud() — handles atoms and bracketed expressions ---
 	fprintf(yyout, "YYSTYPE %s::nud(int token, YYSTYPE val) {\n", outputFileName.c_str());
 	fprintf(yyout, "\tswitch (token) {\n");
 
 	for (const auto& prod : productions)
 	{
-		if (!m_exprNonterminals.count(prod.lhs) || isInfixProduction(prod))
+		if (!m_exprNonterminals.count(prod.lhs) || isInfixProduction(prod) || isPrefixProduction(prod))
 			continue;
 
 		const auto& rhs = prod.rhs.symbols;
-		if (rhs.empty())
-			continue;  // epsilon — not representable in nud
+		if (rhs.empty() || rhs[0].type == SymbolType::Nonterminal)
+			continue;  // epsilon, or led()'s — not representable in nud
 
 		const auto& first = rhs[0];
 		fprintf(yyout, "\tcase %s:\n\t{\n", symbolTokenName(first).c_str());
@@ -951,7 +1557,7 @@ void BNFParser::OutputPrattTable()
 			const auto& sym = rhs[k];
 			if (sym.type == SymbolType::Nonterminal && m_exprNonterminals.count(sym.name))
 			{
-				fprintf(yyout, "\t\tYYSTYPE s%zu = parseExpr(0);\n", k + 1);
+				fprintf(yyout, "\t\tYYSTYPE s%zu = parseExprIterative(0);\n", k + 1);
 			}
 			else
 			{
@@ -985,7 +1591,7 @@ void BNFParser::OutputPrattTable()
 	}
 
 	fprintf(yyout, "\tdefault:\n");
-	fprintf(yyout, "\t\tyyerror(\"unexpected token in expression\");\n");
+	fprintf(yyout, "\t\tsyntaxError(\"unexpected token in expression\");\n");
 	fprintf(yyout, "\t\treturn YYSTYPE{};\n");
 	fprintf(yyout, "\t}\n}\n\n");
 
@@ -1021,13 +1627,56 @@ void BNFParser::OutputPrattTable()
 	}
 
 	fprintf(yyout, "\tdefault:\n");
-	fprintf(yyout, "\t\tyyerror(\"unknown operator\");\n");
+	fprintf(yyout, "\t\tsyntaxError(\"unknown operator\");\n");
 	fprintf(yyout, "\t\treturn YYSTYPE{};\n");
 	fprintf(yyout, "\t}\n}\n\n");
 
+	// --- prefix() and postfix() — X → op X and X → X op ---
+	for (int fix = 0; fix < 2; fix++)
+	{
+		auto kind = fix ? &BNFParser::isPostfixProduction : &BNFParser::isPrefixProduction;
+		if (!hasProduction(kind))
+			continue;
+
+		if (fix)
+			fprintf(yyout, "YYSTYPE %s::postfix(int op, YYSTYPE operand, YYSTYPE val) {\n", name);
+		else
+			fprintf(yyout, "YYSTYPE %s::prefix(int op, YYSTYPE val, YYSTYPE operand) {\n", name);
+		fprintf(yyout, "\tswitch (op) {\n");
+
+		for (const auto& prod : productions)
+		{
+			if (!m_exprNonterminals.count(prod.lhs) || !(this->*kind)(prod))
+				continue;
+
+			fprintf(yyout, "\tcase %s:\n\t{\n", symbolTokenName(prod.rhs.symbols[fix]).c_str());
+
+			if (!prod.rhs.action.empty())
+			{
+				std::string action = prod.rhs.action;
+				replace(action, "$$", "_result");
+				replace(action, "$1", fix ? "operand" : "val");
+				replace(action, "$2", fix ? "val" : "operand");
+				fprintf(yyout, "\t\tYYSTYPE _result = YYSTYPE{};\n");
+				fprintf(yyout, "\t\t%s\n", action.c_str());
+				fprintf(yyout, "\t\treturn _result;\n");
+			}
+			else
+			{
+				fprintf(yyout, "\t\treturn operand;\n");
+			}
+
+			fprintf(yyout, "\t}\n");
+		}
+
+		fprintf(yyout, "\tdefault:\n");
+		fprintf(yyout, "\t\treturn operand;\n");
+		fprintf(yyout, "\t}\n}\n\n");
+	}
+
 	// --- yyparse() — drives the parse from the start symbol ---
 	fprintf(yyout, "int %s::yyparse() {\n", outputFileName.c_str());
-	fprintf(yyout, "\tinitPrattTable();\n");
+	fprintf(yyout, "\tm_errors = 0;\n");
 	fprintf(yyout, "\tadvance();\n");
 
 	// Find the first production for the start symbol and generate its body
@@ -1043,7 +1692,7 @@ void BNFParser::OutputPrattTable()
 			const auto& sym = rhs[k];
 			if (sym.type == SymbolType::Nonterminal && m_exprNonterminals.count(sym.name))
 			{
-				fprintf(yyout, "\tYYSTYPE s%zu = parseExpr(0);\n", k + 1);
+				fprintf(yyout, "\tYYSTYPE s%zu = parseExprIterative(0);\n", k + 1);
 			}
 			else if (sym.type == SymbolType::CharTerminal)
 			{
@@ -1055,6 +1704,9 @@ void BNFParser::OutputPrattTable()
 			}
 		}
 
+		// the action only runs on a parse that succeeded
+		fprintf(yyout, "\tif (parseStatus() != YYPUSH_ACCEPT)\n\t\treturn YYPUSH_ERROR;\n");
+
 		if (!prod.rhs.action.empty())
 		{
 			std::string action = prod.rhs.action;
@@ -1072,5 +1724,319 @@ void BNFParser::OutputPrattTable()
 		break;  // only the first start-symbol production
 	}
 
-	fprintf(yyout, "\treturn 0;\n}\n\n");
+	fprintf(yyout, "\treturn YYPUSH_ACCEPT;\n}\n\n");
+}
+
+//======================================================================
+// Recursive-descent output: a BaseParser with a Do function per
+// non-terminal, on the library's LexicalAnalyzer. Tokens named like the
+// lexer's own (ID, INTVAL, FLOATVAL, CHARVAL, STRING) are those; any
+// other is a keyword spelled as its name in lower case.
+//======================================================================
+void BNFParser::OutputRecursiveDescent()
+{
+	static const char *lexerTokens[] = { "ID", "INTVAL", "FLOATVAL", "CHARVAL", "STRING", nullptr };
+
+	const char *name = outputFileName.c_str();
+
+	// the class
+	fputs("#include \"baseparser.h\"\n\n", yyhout);
+	fprintf(yyhout, "class %s : public BaseParser\n{\npublic:\n", name);
+	fputs("\t// the start symbol's value, after yyparse()\n\tYYSTYPE yyvalue;\n\n", yyhout);
+	fprintf(yyhout, "\t%s();\n", name);
+	fprintf(yyhout, "\tvirtual ~%s() = default;\n\n", name);
+	fputs("\tint yyparse() override;\n\n", yyhout);
+	fputs("\t// one per non-terminal, returning its value\n", yyhout);
+	for (auto nt = nonTerminalNames.begin(); nt != nonTerminalNames.end(); nt++)
+	{
+		Symbol sym = { SymbolType::Nonterminal, *nt };
+		auto rule = m_ebnfRules.find(*nt);
+		if (rule == m_ebnfRules.end() || !rule->second.tail)
+			fprintf(yyhout, "\t%s %s();\n", valueType(sym).c_str(), ruleFunction(*nt).c_str());
+	}
+	fputs("};\n", yyhout);
+
+	// the tokens
+	fprintf(yyout, "#include \"%s.h\"\n\n", name);
+	fputs("// Tokens\nenum {\n", yyout);
+
+	std::vector<std::string> keywords;
+	for (auto token = tokens.begin(); token != tokens.end(); token++)
+	{
+		const char **lexerToken = lexerTokens;
+		while (*lexerToken && *token != *lexerToken)
+			lexerToken++;
+
+		if (*lexerToken)
+			fprintf(yyout, "\tTS_%s = TV_%s,\n", token->c_str(), *lexerToken);
+		else
+		{
+			fprintf(yyout, "\tTS_%s = TV_USER + %zu,\n", token->c_str(), keywords.size());
+			keywords.push_back(*token);
+		}
+	}
+	fputs("};\n\n", yyout);
+
+	fputs("static TokenTable yytokens[] =\n{\n", yyout);
+	for (auto keyword = keywords.begin(); keyword != keywords.end(); keyword++)
+	{
+		std::string lexeme = *keyword;
+		std::transform(lexeme.begin(), lexeme.end(), lexeme.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+		fprintf(yyout, "\t{ \"%s\", TS_%s },\n", lexeme.c_str(), keyword->c_str());
+	}
+	fputs("\n\t{ nullptr, TV_DONE }\n};\n\n", yyout);
+
+	// the parser
+	fprintf(yyout, "//\n%s::%s() : BaseParser(std::make_unique<SymbolTable>())\n{\n", name, name);
+	fputs("\tm_lexer = std::make_unique<LexicalAnalyzer>(yytokens, this, &yylval);\n", yyout);
+	fputs("\tyyvalue = YYSTYPE();\n}\n\n", yyout);
+
+	fprintf(yyout, "//\nint %s::yyparse()\n{\n", name);
+	fputs("\tBaseParser::yyparse();\n\n", yyout);
+	fprintf(yyout, "\tyyvalue = %s();\n\n", ruleFunction(startSymbol).c_str());
+	fputs("\tif (lookahead != TV_DONE)\n\t\tyyerror(\"expected to see the end of the input\");\n\n", yyout);
+	fputs("\treturn 0;\n}\n\n", yyout);
+
+	for (unsigned nt = 0; nt < nonTerminalNames.size(); nt++)
+		OutputRuleFunction(nt);
+}
+
+//======================================================================
+// A switch on the lookahead, with a case for each terminal that selects
+// a production; a non-terminal with one production has no need of it,
+// the production's first symbol checks the lookahead itself
+//======================================================================
+void BNFParser::OutputRuleFunction(unsigned nt)
+{
+	// an X+ has the loop for its tail
+	auto rule = m_ebnfRules.find(nonTerminalNames[nt]);
+	if (rule != m_ebnfRules.end() && rule->second.tail)
+		return;
+
+	if (isRepetition(nonTerminalNames[nt]))
+	{
+		OutputLoopFunction(nt);
+		return;
+	}
+
+	size_t columns = terminalNames.size();
+	const unsigned *row = &predictions[nt * columns];
+
+	std::vector<unsigned> prods;
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		if (lhsIds[prod] == nt)
+			prods.push_back(prod);
+	}
+
+	bool useSwitch = prods.size() != 1;
+
+	fprintf(yyout, "//\nYYSTYPE %s::%s()\n{\n", outputFileName.c_str(), ruleFunction(nonTerminalNames[nt]).c_str());
+	fputs("\tYYSTYPE yyval = YYSTYPE();\n\n", yyout);
+
+	if (useSwitch)
+		fputs("\tswitch (lookahead)\n\t{\n", yyout);
+
+	const char *indent = useSwitch ? "\t\t" : "\t";
+
+	for (auto prod = prods.begin(); prod != prods.end(); prod++)
+	{
+		const RightHandSide &rhs = productions[*prod].rhs;
+
+		if (useSwitch)
+		{
+			bool selected = false;
+			for (unsigned t = 0; t < columns; t++)
+			{
+				if (row[t] == *prod + 1)
+				{
+					fprintf(yyout, "\tcase %s:\n", terminalCode(t).c_str());
+					selected = true;
+				}
+			}
+
+			// lost to a conflict
+			if (!selected)
+				continue;
+		}
+
+		fprintf(yyout, "%s// %s\n", indent, getRule(productions[*prod].lhs, rhs).c_str());
+		if (useSwitch)
+			fprintf(yyout, "%s{\n", indent);
+
+		// which symbols' values the action uses
+		std::vector<bool> used(rhs.symbols.size() + 1, false);
+		std::string action;
+		if (rhs.action != "")
+		{
+			action = ReplaceValues(rhs.action, used);
+			action.erase(0, action.find_first_not_of(" \t\r\n"));
+			action.erase(action.find_last_not_of(" \t\r\n") + 1);
+		}
+		else if (rhs.symbols.size())
+		{
+			action = "yyval = yy1;";
+			used[1] = true;
+		}
+
+		const char *bodyIndent = useSwitch ? "\t\t\t" : "\t";
+		for (size_t i = 0; i < rhs.symbols.size(); i++)
+		{
+			const Symbol &sym = rhs.symbols[i];
+
+			if (sym.type == SymbolType::Nonterminal)
+			{
+				if (used[i + 1])
+					fprintf(yyout, "%s%s yy%zu = %s();\n", bodyIndent, valueType(sym).c_str(), i + 1, ruleFunction(sym.name).c_str());
+				else
+					fprintf(yyout, "%s%s();\n", bodyIndent, ruleFunction(sym.name).c_str());
+			}
+			else
+			{
+				if (used[i + 1])
+					fprintf(yyout, "%sYYSTYPE yy%zu = yylval;\n", bodyIndent, i + 1);
+				fprintf(yyout, "%smatch(%s);\n", bodyIndent, symbolCode(sym).c_str());
+			}
+		}
+
+		if (action != "")
+			fprintf(yyout, "%s%s\n", bodyIndent, action.c_str());
+
+		if (useSwitch)
+			fprintf(yyout, "%s}\n%sbreak;\n\n", indent, indent);
+	}
+
+	if (useSwitch)
+	{
+		fputs("\tdefault:\n", yyout);
+		fprintf(yyout, "\t\tyyerror(\"unexpected token in %s\");\n", nonTerminalNames[nt].c_str());
+		fputs("\t\tbreak;\n\t}\n", yyout);
+	}
+
+	fputs("\n\treturn yyval;\n}\n\n", yyout);
+}
+
+//======================================================================
+// X* and X+ collect their X's values in a vector, in a loop that goes on
+// while the lookahead is one that predicts another X
+//======================================================================
+void BNFParser::OutputLoopFunction(unsigned nt)
+{
+	const EbnfRule &rule = m_ebnfRules.find(nonTerminalNames[nt])->second;
+	const std::string &loop = rule.op == '+' ? rule.tailName : nonTerminalNames[nt];
+
+	// the loop's production that isn't empty
+	size_t columns = terminalNames.size();
+	unsigned loopId = nonTerminalIds.find(loop)->second;
+	unsigned more = 0;
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		if (lhsIds[prod] == loopId && !productions[prod].rhs.symbols.empty())
+			more = prod + 1;
+	}
+
+	std::string condition;
+	const unsigned *row = &predictions[loopId * columns];
+	for (unsigned t = 0; t < columns; t++)
+	{
+		if (row[t] == more)
+			condition += (condition.empty() ? "lookahead == " : " || lookahead == ") + terminalCode(t);
+	}
+
+	if (condition.empty())
+		condition = "false";
+
+	std::string element;
+	if (rule.item.type == SymbolType::Nonterminal)
+		element = "yyval.push_back(" + ruleFunction(rule.item.name) + "());";
+	else
+		element = "yyval.push_back(yylval);\n\t\tmatch(" + symbolCode(rule.item) + ");";
+
+	Symbol sym = { SymbolType::Nonterminal, nonTerminalNames[nt] };
+	fprintf(yyout, "//\n%s %s::%s()\n{\n", valueType(sym).c_str(), outputFileName.c_str(), ruleFunction(nonTerminalNames[nt]).c_str());
+	fprintf(yyout, "\t%s yyval;\n\n", valueType(sym).c_str());
+
+	if (rule.op == '+')
+		fprintf(yyout, "\tdo\n\t{\n\t\t%s\n\t} while (%s);\n", element.c_str(), condition.c_str());
+	else
+		fprintf(yyout, "\twhile (%s)\n\t{\n\t\t%s\n\t}\n", condition.c_str(), element.c_str());
+
+	fputs("\n\treturn yyval;\n}\n\n", yyout);
+}
+
+// a vector of the values for X* and X+
+std::string BNFParser::valueType(const Symbol &sym) const
+{
+	return sym.type == SymbolType::Nonterminal && isRepetition(sym.name) ? "std::vector<YYSTYPE>" : "YYSTYPE";
+}
+
+// DoKeyValues() for key_values
+std::string BNFParser::ruleFunction(const std::string &name) const
+{
+	std::string function = "Do";
+	bool upper = true;
+
+	for (auto c = name.begin(); c != name.end(); c++)
+	{
+		if (*c == '_')
+			upper = true;
+		else
+		{
+			function += upper ? (char)toupper((unsigned char)*c) : *c;
+			upper = false;
+		}
+	}
+
+	return function;
+}
+
+// the token a terminal is, as a case label
+std::string BNFParser::terminalCode(unsigned terminal) const
+{
+	if (!terminal)
+		return "TV_DONE";
+
+	const std::string &name = terminalNames[terminal];
+
+	Symbol sym;
+	sym.name = name;
+	sym.type = tokens.count(name) ? SymbolType::Terminal : SymbolType::CharTerminal;
+
+	return symbolCode(sym);
+}
+
+//======================================================================
+// $$ is the rule's value, yyval, and $n the local holding the value of
+// its nth symbol, or with onStack its entry in yyvsp[]
+//======================================================================
+std::string BNFParser::ReplaceValues(const std::string &action, std::vector<bool> &used, bool onStack) const
+{
+	std::string result;
+
+	for (size_t i = 0; i < action.size(); i++)
+	{
+		if (action[i] == '$' && i + 1 < action.size() && action[i + 1] == '$')
+		{
+			result += "yyval";
+			i++;
+		}
+		else if (action[i] == '$' && i + 1 < action.size() && isdigit((unsigned char)action[i + 1]))
+		{
+			size_t n = 0;
+			while (i + 1 < action.size() && isdigit((unsigned char)action[i + 1]))
+				n = n * 10 + (action[++i] - '0');
+
+			if (n > 0 && n < used.size())
+				used[n] = true;
+
+			if (onStack)
+				result += "yyvsp[" + std::to_string((int)n - 1) + "]";
+			else
+				result += "yy" + std::to_string(n);
+		}
+		else
+			result += action[i];
+	}
+
+	return result;
 }
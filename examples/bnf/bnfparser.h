@@ -1,7 +1,13 @@
 #pragma once
 
 #include "../../baseparser.h"
+#include <stdint.h>
 #include <set>
+#include <unordered_map>
+#include <random>
+
+// a free entry in a comb's check[], see PackTable()
+#define EMPTY_SLOT			0xffff
 
 class BNFParser : public BaseParser
 {
@@ -27,6 +33,7 @@ protected:
 		SymbolList symbols;
 		std::string action;
 		int actionIndex;
+		unsigned weight = 1;	// how often bnf -g picks it, see %weight
 
 		RightHandSide(SymbolList _symbols, std::string _action, int _index)
 		{
@@ -54,13 +61,48 @@ protected:
 	using TokenSet = std::set<std::string>;
 	TokenSet tokens, terminals, nonTerminals;
 
-	std::map<std::string, std::map<std::string, RightHandSide>> parseTable;
+	// the production predicted for each non-terminal and terminal, rows of
+	// terminalNames.size(); 0 for an error, else the production's index + 1
+	std::vector<unsigned> predictions;
+
+	// --- LL(1) analysis ---
+	// Terminals and non-terminals are numbered densely in name order, and
+	// terminal 0 is the end of input, so the sets below are bitsets
+	struct TerminalSet
+	{
+		std::vector<uint64_t> bits;
+
+		void resize(size_t count)				{ bits.assign((count + 63) / 64, 0); }
+		void insert(unsigned id)				{ bits[id >> 6] |= (uint64_t)1 << (id & 63); }
+		void erase(unsigned id)					{ bits[id >> 6] &= ~((uint64_t)1 << (id & 63)); }
+		bool contains(unsigned id) const		{ return (bits[id >> 6] >> (id & 63)) & 1; }
+
+		// true if anything was added
+		bool merge(const TerminalSet &rhs)
+		{
+			uint64_t added = 0;
+			for (size_t i = 0; i < bits.size(); i++)
+			{
+				added |= rhs.bits[i] & ~bits[i];
+				bits[i] |= rhs.bits[i];
+			}
+			return added != 0;
+		}
+	};
+
+	std::vector<std::string> terminalNames, nonTerminalNames;
+	std::unordered_map<std::string, unsigned> terminalIds, nonTerminalIds;
 
-	//
-	std::set<std::string> nullable;
+	// each production's lhs and, from rhsStart[i] to rhsStart[i + 1],
+	// its symbols: a terminal's id, or a non-terminal's id past the
+	// terminals
+	std::vector<unsigned> lhsIds, rhsStart, rhsIds;
 
-	using TerminalSets = std::map<std::string, std::set<std::string>>;
-	TerminalSets first, follow;
+	std::vector<bool> nullable;
+	std::vector<TerminalSet> first, follow;
+
+	bool isTerminal(unsigned code) const	{ return code < terminalNames.size(); }
+	unsigned nonTerminalOf(unsigned code) const	{ return code - (unsigned)terminalNames.size(); }
 
 	// --- Operator precedence ---
 	struct OperatorDecl
@@ -75,9 +117,33 @@ protected:
 	// Set of non-terminals that are handled by Pratt parsing
 	std::set<std::string> m_exprNonterminals;
 
-	bool isPrattMode() const { return !m_operatorDecls.empty(); }
+	// LALR(1) takes the precedence declarations for its conflicts
+	bool isPrattMode() const { return !m_operatorDecls.empty() && !lalr; }
+
+	// a grammar with precedence declarations is left in Pratt mode
+	bool isRecursiveDescent() const { return recursiveDescent && !isPrattMode() && !lalr; }
+
+	// --- EBNF ---
+	// the non-terminals made for (...), X?, X* and X+ in rules, see
+	// AddEbnfRule()
+	struct EbnfRule
+	{
+		char op = 0;			// '(', '?', '*' or '+'
+		Symbol item;			// what ?, * and + apply to
+		bool tail = false;		// the X* that follows the first X of an X+
+		std::string tailName;	// an X+'s tail
+	};
+	std::map<std::string, EbnfRule> m_ebnfRules;
+	Productions m_ebnfProductions;		// added after the grammar's own
+	unsigned m_ebnfCount = 0;			// made for the rule so far
+
+	SymbolList DoSymbols(const std::string &lhs);
+	Symbol DoGroup(const std::string &lhs);
+	Symbol AddEbnfRule(const std::string &lhs, int op, const Symbol &item);
+	bool isRepetition(const std::string &name) const;
 
 	// --- LL(1) methods ---
+	void NumberSymbols();
 	void ComputeNullable();
 	void ComputeFirst();
 	void ComputeFollow();
@@ -88,21 +154,97 @@ protected:
 	void OutputSymbols();
 	void OutputProductions();
 	void OutputTable();
+	void OutputParseTable();
+	void OutputArray(const char *type, const char *name, const std::vector<int> &values);
+	size_t PackTable(const std::vector<int> &cells, size_t rows, size_t columns, const std::vector<int> &defaults,
+		std::vector<int> &base, std::vector<int> &next, std::vector<int> &check);
+	int tokenValue(unsigned terminal) const;
 	void TemplateReplace(std::string &str, size_t symbolCount);
 
+	// --- Recursive-descent methods ---
+	void OutputRecursiveDescent();
+	void OutputRuleFunction(unsigned nt);
+	void OutputLoopFunction(unsigned nt);
+	std::string valueType(const Symbol &sym) const;
+
+	std::string ruleFunction(const std::string &name) const;
+	std::string terminalCode(unsigned terminal) const;
+	std::string ReplaceValues(const std::string &action, std::vector<bool> &used, bool onStack = false) const;
+
+	// --- LALR(1) ---
+	// An item is a production with a dot in it, numbered itemStart[prod] +
+	// dot; the two past the last are the start symbol's own production,
+	// $accept -> start, before and after the start symbol
+	struct LRState
+	{
+		std::vector<unsigned> kernel;
+		std::vector<std::pair<unsigned, unsigned>> transitions;	// symbol code, state; by symbol
+		std::vector<unsigned> reductions;						// productions
+	};
+
+	std::vector<LRState> lrStates;
+	std::vector<unsigned> itemStart, itemProd;
+
+	// ACTION, states x terminals: > 0 shifts to that state, < 0 reduces by
+	// rule -n, rule n being production n - 1, and 0 is an error; GOTO,
+	// non-terminals x states
+	std::vector<int> lrActions, lrGotos;
+	std::vector<bool> lrErrors;		// states with %nonassoc errors
+
+	void GenerateLALR();
+	void BuildLRStates();
+	void ComputeLookaheads(std::vector<std::vector<TerminalSet>> &lookaheads);
+	void ResolveActions(const std::vector<std::vector<TerminalSet>> &lookaheads);
+	void OutputLALRTable();
+	void LogLRStates();
+
+	unsigned symbolAfter(unsigned item) const;
+	unsigned transition(unsigned state, unsigned symbol) const;
+	const OperatorDecl *precedence(unsigned prod) const;
+
 	// --- Pratt methods ---
 	void DetectExprNonterminals();
 	void OutputPrattTable();
 
 	bool isInfixProduction(const Production& prod) const;
+	bool isPrefixProduction(const Production& prod) const;
+	bool isPostfixProduction(const Production& prod) const;
+	bool hasProduction(bool (BNFParser::*kind)(const Production&) const) const;
+	int opTokenValue(const std::string& name) const;
 	std::string symbolTokenName(const Symbol& sym) const;
 	std::string opTokenName(const std::string& name) const;
+	std::string symbolCode(const Symbol& sym) const;
+
+	// --- Corpus generation ---
+	// a token's spellings in a corpus, from %sample
+	std::map<std::string, std::vector<std::string>> m_samples;
+
+	void GenerateCorpus();
+	void ComputeHeights(std::vector<unsigned> &heights, std::vector<unsigned> &prodHeights);
+	unsigned chooseProduction(const std::vector<unsigned> &prods, std::mt19937_64 &random) const;
+	void tokenText(unsigned terminal, std::string &text, std::mt19937_64 &random) const;
 
 	// ---
-	bool AreAllNullable(size_t start, size_t end, const SymbolList &symbols);
-	std::string getRule(const std::string &lhs, RightHandSide &rhs);
+	void Propagate(std::vector<TerminalSet> &sets, const std::vector<std::vector<unsigned>> &into);
+	void LogSets(const char *title, const std::vector<TerminalSet> &sets);
+	std::string getRule(const std::string &lhs, const RightHandSide &rhs);
 
 public:
+	// generate a parser that logs its steps, see YYLOG
+	bool yytrace = false;
+
+	// generate recursive-descent code on BaseParser rather than tables
+	bool recursiveDescent = false;
+
+	// generate LALR(1) tables for LRParser, see bnf -l
+	bool lalr = false;
+
+	// write about this many bytes of random sentences rather than a
+	// parser, nesting non-terminals up to corpusDepth deep, see bnf -g
+	uint64_t corpusSize = 0;
+	unsigned corpusDepth = 16;
+	unsigned corpusSeed = 1;
+
 	BNFParser();
 	virtual ~BNFParser() = default;
 	
@@ -1,7 +1,6 @@
 %{
 #define _CRT_SECURE_NO_WARNINGS
 #define YYSTYPE double
-YYSTYPE yylval;
 
 #include <stdio.h>
 #include <ctype.h>
@@ -27,13 +26,16 @@ expr: NUMBER
 
 %%
 
-int yylex()
+// reads the FILE it's given and keeps nothing of its own, so each parser
+// can have a lexer and input of its own
+int yylex(void *context, YYSTYPE &value)
 {
+    FILE *fp = (FILE *)context;
     int c;
 
-    yylval = 0.0;
+    value = 0.0;
     
-    while ((c=getchar()) == ' ' || c == '\t' || c == '\n')
+    while ((c=getc(fp)) == ' ' || c == '\t' || c == '\n')
         ;
 
     if (c == EOF)
@@ -41,8 +43,9 @@ int yylex()
 
     if (c == '.' || isdigit(c)) 
     {
-        ungetc(c, stdin);
-        scanf("%lf", &yylval);
+        ungetc(c, fp);
+        if (fscanf(fp, "%lf", &value) != 1)
+            value = 0.0;
         return TS_NUMBER;
     }
 
@@ -51,11 +54,25 @@ int yylex()
 
 int main(int argc, char *argv[])
 {
-	calc parser(yylex);
+	CallbackTokenSource<YYSTYPE> source(yylex, stdin);
+
+	// calc -b times the parser over a corpus from bnf -g
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		CorpusDriver<YYSTYPE> driver(&source);
+		calc parser(&driver);
+
+		uint64_t failed = driver.run(parser);
+		driver.report(stderr, ftell(stdin));
+		return failed != 0;
+	}
+
+	calc parser(&source);
 
     // set to true to see parsing details
 //	parser.setDebug(true);
-	parser.yyparse();
+	if (parser.yyparse() != YYPUSH_ACCEPT)
+		return 1;
 
 	printf("Successful parse.\n");
 	
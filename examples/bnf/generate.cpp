@@ -0,0 +1,238 @@
+//
+//
+// Random sentences of the grammar for corpora to time and test its parsers
+// on, see bnf -g
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "bnfparser.h"
+#include <algorithm>
+
+// a non-terminal, or a production, that never comes to an end
+#define NO_HEIGHT			((unsigned)-1)
+
+//======================================================================
+// How many levels of non-terminals each one needs at least to come down
+// to terminals: a production of terminals, or of nothing, is 0 and any
+// other is one more than its highest non-terminal. A non-terminal takes
+// its lowest production's. Until nothing changes, as it's the lowest of
+// the highest.
+//======================================================================
+void BNFParser::ComputeHeights(std::vector<unsigned> &heights, std::vector<unsigned> &prodHeights)
+{
+	heights.assign(nonTerminalNames.size(), NO_HEIGHT);
+	prodHeights.assign(productions.size(), NO_HEIGHT);
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (unsigned prod = 0; prod < productions.size(); prod++)
+		{
+			unsigned height = 0;
+			for (unsigned i = rhsStart[prod]; i < rhsStart[prod + 1] && height != NO_HEIGHT; i++)
+			{
+				if (!isTerminal(rhsIds[i]))
+				{
+					unsigned below = heights[nonTerminalOf(rhsIds[i])];
+					height = below == NO_HEIGHT ? NO_HEIGHT : std::max(height, below + 1);
+				}
+			}
+
+			prodHeights[prod] = height;
+			if (height < heights[lhsIds[prod]])
+			{
+				heights[lhsIds[prod]] = height;
+				changed = true;
+			}
+		}
+	}
+}
+
+//======================================================================
+// One of the productions, in proportion to their %weights, or any of
+// them alike if they all weigh nothing
+//======================================================================
+unsigned BNFParser::chooseProduction(const std::vector<unsigned> &prods, std::mt19937_64 &random) const
+{
+	uint64_t total = 0;
+	for (auto prod = prods.begin(); prod != prods.end(); prod++)
+		total += productions[*prod].rhs.weight;
+
+	if (!total)
+		return prods[random() % prods.size()];
+
+	uint64_t pick = random() % total;
+	for (auto prod = prods.begin(); prod != prods.end(); prod++)
+	{
+		if (pick < productions[*prod].rhs.weight)
+			return *prod;
+		pick -= productions[*prod].rhs.weight;
+	}
+
+	return prods.back();
+}
+
+//======================================================================
+// A terminal as a lexer would read it. A character is itself and a
+// token with a %sample is one of its spellings. Otherwise the lexer's
+// own token names, as bnf -r has them, get a value of that kind, a name
+// starting NUM is a number, and any other is a keyword spelled as its
+// name in lower case.
+//======================================================================
+void BNFParser::tokenText(unsigned terminal, std::string &text, std::mt19937_64 &random) const
+{
+	const std::string &name = terminalNames[terminal];
+
+	if (tokens.find(name) == tokens.end())
+	{
+		text += name;
+		return;
+	}
+
+	auto samples = m_samples.find(name);
+	if (samples != m_samples.end() && !samples->second.empty())
+	{
+		text += samples->second[random() % samples->second.size()];
+		return;
+	}
+
+	auto letters = [&](size_t count) {
+		for (size_t i = 0; i < count; i++)
+			text += (char)('a' + random() % 26);
+	};
+
+	if (name == "ID")
+	{
+		// an x, so it's never a keyword
+		text += 'x';
+		letters(random() % 8);
+	}
+	else if (name == "STRING")
+	{
+		text += '"';
+		letters(random() % 12);
+		text += '"';
+	}
+	else if (name == "CHARVAL")
+	{
+		text += '\'';
+		letters(1);
+		text += '\'';
+	}
+	else if (name == "INTVAL")
+	{
+		text += std::to_string(random() % 100000);
+	}
+	else if (name == "FLOATVAL" || name.compare(0, 3, "NUM") == 0)
+	{
+		text += std::to_string(random() % 10000);
+		if (random() & 1)
+			text += "." + std::to_string(random() % 1000);
+	}
+	else
+	{
+		for (auto chr = name.begin(); chr != name.end(); chr++)
+			text += (char)tolower((unsigned char)*chr);
+	}
+}
+
+//======================================================================
+// Sentences of the grammar, each followed by a NUL and a new line, until
+// there are corpusSize bytes of them. Each non-terminal is expanded by a
+// production picked at random by weight, with an explicit stack. Past
+// corpusDepth levels of them, a nullable non-terminal is left out and
+// any other takes one of its lowest productions, so every sentence comes
+// to an end; a non-terminal that couldn't is never chosen. The same seed
+// gives the same corpus.
+//======================================================================
+void BNFParser::GenerateCorpus()
+{
+	if (nonTerminals.find(startSymbol) == nonTerminals.end())
+	{
+		yyerror("Start symbol (%s) has no rules", startSymbol.c_str());
+		return;
+	}
+
+	NumberSymbols();
+
+	ComputeNullable();
+
+	std::vector<unsigned> heights, prodHeights;
+	ComputeHeights(heights, prodHeights);
+
+	unsigned start = nonTerminalIds[startSymbol];
+	if (heights[start] == NO_HEIGHT)
+	{
+		yyerror("Start symbol (%s) has no sentences", startSymbol.c_str());
+		return;
+	}
+
+	// each non-terminal's productions that come to an end, and its lowest
+	size_t count = nonTerminalNames.size();
+	std::vector<std::vector<unsigned>> finite(count), lowest(count);
+
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		unsigned nt = lhsIds[prod];
+		if (prodHeights[prod] == NO_HEIGHT)
+			continue;
+
+		finite[nt].push_back(prod);
+		if (prodHeights[prod] == heights[nt])
+			lowest[nt].push_back(prod);
+	}
+
+	for (unsigned nt = 0; nt < count; nt++)
+	{
+		if (heights[nt] == NO_HEIGHT)
+			yywarning("Non-terminal (%s) has no sentences", nonTerminalNames[nt].c_str());
+	}
+
+	std::mt19937_64 random(corpusSeed);
+
+	// symbol code and depth
+	std::vector<std::pair<unsigned, unsigned>> stack;
+	std::string sentence;
+	uint64_t written = 0, sentences = 0;
+	unsigned terminalCount = (unsigned)terminalNames.size();
+
+	while (written < corpusSize)
+	{
+		sentence.clear();
+		stack.assign(1, std::make_pair(terminalCount + start, 0u));
+
+		while (!stack.empty())
+		{
+			unsigned code = stack.back().first, depth = stack.back().second;
+			stack.pop_back();
+
+			if (isTerminal(code))
+			{
+				if (!sentence.empty())
+					sentence += ' ';
+				tokenText(code, sentence, random);
+				continue;
+			}
+
+			unsigned nt = nonTerminalOf(code);
+			if (depth >= corpusDepth && nullable[nt])
+				continue;
+
+			unsigned prod = chooseProduction(depth < corpusDepth ? finite[nt] : lowest[nt], random);
+			for (unsigned i = rhsStart[prod + 1]; i-- > rhsStart[prod]; )
+				stack.push_back(std::make_pair(rhsIds[i], depth + 1));
+		}
+
+		sentence += '\0';
+		sentence += '\n';
+
+		fwrite(sentence.data(), 1, sentence.size(), yyout);
+		written += sentence.size();
+		sentences++;
+	}
+
+	yylog("\n%llu sentences, %llu bytes", (unsigned long long)sentences, (unsigned long long)written);
+}
@@ -233,8 +233,8 @@ int yylex()
 	// skip any leading WS
 	chr = skipLeadingWhiteSpace();
 
-    if (chr == EOF)
-        return 0;
+	if (chr == EOF)
+		return 0;
 
 	// look for a number value
 	if (isdigit(chr))
@@ -279,15 +279,29 @@ int yylex()
 }
 
 //
-int main()
+int main(int argc, char *argv[])
 {
-	jsonparser parser(yylex);
+	GlobalTokenSource<YYSTYPE> source(yylex, &yylval);
+
+	// jsonparser -b times the parser over a corpus from bnf -g
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		CorpusDriver<YYSTYPE> driver(&source);
+		jsonparser parser(&driver);
+
+		uint64_t failed = driver.run(parser);
+		driver.report(stderr, ftell(stdin));
+		return failed != 0;
+	}
+
+	jsonparser parser(&source);
 
     // set to true to see parsing details
 	//parser.setDebug(true);
-	parser.yyparse();
+	if (parser.yyparse() != YYPUSH_ACCEPT)
+		return 1;
 
-	printf("Succesful parse.\n");
+	printf("Successful parse.\n");
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+%{
+//
+// JSON for the recursive-descent backend, on the library's lexer:
+//
+//	bnf -r -o jsonrd jsonrd.y
+//
+// Each value is the number of values in it, itself included
+//
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+%}
+
+%token STRING INTVAL FLOATVAL TRUE FALSE NULL
+%start value
+
+%%
+
+value: object
+	| array
+	| STRING	{ $$.ival = 1; }
+	| INTVAL	{ $$.ival = 1; }
+	| FLOATVAL	{ $$.ival = 1; }
+	| TRUE		{ $$.ival = 1; }
+	| FALSE		{ $$.ival = 1; }
+	| NULL		{ $$.ival = 1; }
+	;
+
+object: '{' members '}'	{ $$.ival = 1 + $2.ival; }
+	;
+
+members:		{ $$.ival = 0; }
+	| member (',' member)*	{ $$.ival = $1.ival; for (auto &v : $2) $$.ival += v.ival; }
+	;
+
+member: STRING ':' value	{ $$ = $3; }
+	;
+
+array: '[' elements ']'	{ $$.ival = 1 + $2.ival; }
+	;
+
+elements:		{ $$.ival = 0; }
+	| value (',' value)*	{ $$.ival = $1.ival; for (auto &v : $2) $$.ival += v.ival; }
+	;
+
+%%
+
+//
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: jsonrd <file.json>\n");
+		return 1;
+	}
+
+	jsonrd parser;
+	parser.parseFile(argv[1]);
+
+	if (parser.getErrorCount())
+		return 1;
+
+	printf("%d values\n", parser.yyvalue.ival);
+	return 0;
+}
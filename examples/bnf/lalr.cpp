@@ -0,0 +1,560 @@
+//
+//
+// LALR(1) tables for the BNF parser: the LR(0) states, their lookaheads
+// after DeRemer and Pennello, and conflicts settled with the precedence
+// declarations, as yacc does
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "bnfparser.h"
+#include <algorithm>
+
+// no symbol after the dot
+#define NO_SYMBOL			((unsigned)-1)
+
+// states and rules go into the tables as shorts
+#define LR_TABLE_LIMIT		0x7fff
+
+//
+unsigned BNFParser::symbolAfter(unsigned item) const
+{
+	unsigned prod = itemProd[item];
+	unsigned i = rhsStart[prod] + item - itemStart[prod];
+
+	return i < rhsStart[prod + 1] ? rhsIds[i] : NO_SYMBOL;
+}
+
+//
+unsigned BNFParser::transition(unsigned state, unsigned symbol) const
+{
+	const auto &transitions = lrStates[state].transitions;
+
+	auto found = std::lower_bound(transitions.begin(), transitions.end(), std::make_pair(symbol, 0u));
+	return found != transitions.end() && found->first == symbol ? found->second : 0;
+}
+
+//======================================================================
+// As in yacc, a production takes the precedence of its last terminal,
+// nullptr if that has none
+//======================================================================
+const BNFParser::OperatorDecl *BNFParser::precedence(unsigned prod) const
+{
+	for (unsigned i = rhsStart[prod + 1]; i-- > rhsStart[prod]; )
+	{
+		if (isTerminal(rhsIds[i]))
+		{
+			auto decl = m_operatorDecls.find(terminalNames[rhsIds[i]]);
+			return decl != m_operatorDecls.end() ? &decl->second : nullptr;
+		}
+	}
+
+	return nullptr;
+}
+
+//======================================================================
+// The LR(0) states, each known by its kernel; the rest of a state's
+// items are its closure, which is only needed to find its transitions
+// and reductions. The start symbol's own production, $accept -> start,
+// is added to rhsStart/rhsIds as production productions.size().
+//======================================================================
+void BNFParser::BuildLRStates()
+{
+	unsigned prods = (unsigned)productions.size();
+
+	rhsIds.push_back((unsigned)terminalNames.size() + nonTerminalIds[startSymbol]);
+	rhsStart.push_back((unsigned)rhsIds.size());
+
+	itemStart.clear();
+	itemProd.clear();
+	for (unsigned prod = 0; prod <= prods; prod++)
+	{
+		itemStart.push_back((unsigned)itemProd.size());
+		itemProd.insert(itemProd.end(), rhsStart[prod + 1] - rhsStart[prod] + 1, prod);
+	}
+
+	std::vector<std::vector<unsigned>> alternatives(nonTerminalNames.size());
+	for (unsigned prod = 0; prod < prods; prod++)
+		alternatives[lhsIds[prod]].push_back(prod);
+
+	std::map<std::vector<unsigned>, unsigned> stateIds;
+	std::map<unsigned, std::vector<unsigned>> kernels;
+	std::vector<unsigned> closure, added(nonTerminalNames.size(), NO_SYMBOL);
+
+	lrStates.assign(1, LRState());
+	lrStates[0].kernel.push_back(itemStart[prods]);
+	stateIds[lrStates[0].kernel] = 0;
+
+	for (unsigned state = 0; state < lrStates.size(); state++)
+	{
+		closure = lrStates[state].kernel;
+		kernels.clear();
+
+		for (size_t i = 0; i < closure.size(); i++)
+		{
+			unsigned item = closure[i];
+			unsigned symbol = symbolAfter(item);
+
+			if (symbol == NO_SYMBOL)
+			{
+				if (itemProd[item] < prods)
+					lrStates[state].reductions.push_back(itemProd[item]);
+				continue;
+			}
+
+			kernels[symbol].push_back(item + 1);
+
+			if (!isTerminal(symbol) && added[nonTerminalOf(symbol)] != state)
+			{
+				unsigned nt = nonTerminalOf(symbol);
+				added[nt] = state;
+
+				for (auto prod = alternatives[nt].begin(); prod != alternatives[nt].end(); prod++)
+					closure.push_back(itemStart[*prod]);
+			}
+		}
+
+		std::sort(lrStates[state].reductions.begin(), lrStates[state].reductions.end());
+
+		for (auto kernel = kernels.begin(); kernel != kernels.end(); kernel++)
+		{
+			std::sort(kernel->second.begin(), kernel->second.end());
+
+			auto found = stateIds.find(kernel->second);
+			unsigned target = found != stateIds.end() ? found->second : (unsigned)lrStates.size();
+
+			if (found == stateIds.end())
+			{
+				stateIds.emplace(kernel->second, target);
+				lrStates.push_back(LRState());
+				lrStates.back().kernel = kernel->second;
+			}
+
+			lrStates[state].transitions.push_back(std::make_pair(kernel->first, target));
+		}
+	}
+}
+
+//======================================================================
+// DeRemer and Pennello's LALR(1) lookaheads, over the transitions on
+// non-terminals. Read(x) is what can be shifted right after x, through
+// transitions on nullable non-terminals (reads); Follow(x) adds what
+// follows each transition x includes, that is the transition whose
+// production x ends but for nullable symbols. A reduction's lookahead
+// is the Follow of each transition it looks back on, those it could have
+// been predicted at.
+//======================================================================
+void BNFParser::ComputeLookaheads(std::vector<std::vector<TerminalSet>> &lookaheads)
+{
+	size_t terminalCount = terminalNames.size();
+	unsigned prods = (unsigned)productions.size();
+
+	auto key = [](uint64_t state, unsigned symbol) { return state << 32 | symbol; };
+
+	// number the non-terminal transitions
+	std::vector<unsigned> from, symbols;
+	std::unordered_map<uint64_t, unsigned> gotoIds;
+
+	for (unsigned state = 0; state < lrStates.size(); state++)
+	{
+		for (auto tr = lrStates[state].transitions.begin(); tr != lrStates[state].transitions.end(); tr++)
+		{
+			if (!isTerminal(tr->first))
+			{
+				gotoIds[key(state, tr->first)] = (unsigned)from.size();
+				from.push_back(state);
+				symbols.push_back(tr->first);
+			}
+		}
+	}
+
+	std::vector<TerminalSet> follows(from.size());
+	std::vector<std::vector<unsigned>> into(from.size());
+
+	// the terminals shifted straight after each, and what it reads
+	for (unsigned x = 0; x < from.size(); x++)
+	{
+		unsigned target = transition(from[x], symbols[x]);
+		follows[x].resize(terminalCount);
+
+		for (auto tr = lrStates[target].transitions.begin(); tr != lrStates[target].transitions.end(); tr++)
+		{
+			if (isTerminal(tr->first))
+				follows[x].insert(tr->first);
+			else if (nullable[nonTerminalOf(tr->first)])
+				into[gotoIds[key(target, tr->first)]].push_back(x);
+		}
+	}
+
+	// the end of input follows the start symbol
+	follows[gotoIds[key(0, rhsIds[rhsStart[prods]])]].insert(0);
+
+	Propagate(follows, into);
+
+	// whether all of a production's symbols after rhsIds[i] can be empty
+	std::vector<bool> restNullable(rhsIds.size());
+	for (unsigned prod = 0; prod < prods; prod++)
+	{
+		bool rest = true;
+		for (unsigned i = rhsStart[prod + 1]; i-- > rhsStart[prod]; )
+		{
+			restNullable[i] = rest;
+			rest = rest && !isTerminal(rhsIds[i]) && nullable[nonTerminalOf(rhsIds[i])];
+		}
+	}
+
+	std::vector<std::vector<unsigned>> alternatives(nonTerminalNames.size());
+	for (unsigned prod = 0; prod < prods; prod++)
+		alternatives[lhsIds[prod]].push_back(prod);
+
+	// includes, and lookback, keyed by state and production
+	std::unordered_map<uint64_t, std::vector<unsigned>> lookback;
+
+	for (auto list = into.begin(); list != into.end(); list++)
+		list->clear();
+
+	for (unsigned x = 0; x < from.size(); x++)
+	{
+		const std::vector<unsigned> &prodList = alternatives[nonTerminalOf(symbols[x])];
+
+		for (auto prod = prodList.begin(); prod != prodList.end(); prod++)
+		{
+			unsigned state = from[x];
+			for (unsigned i = rhsStart[*prod]; i < rhsStart[*prod + 1]; i++)
+			{
+				if (!isTerminal(rhsIds[i]) && restNullable[i])
+					into[x].push_back(gotoIds[key(state, rhsIds[i])]);
+
+				state = transition(state, rhsIds[i]);
+			}
+
+			lookback[key(state, *prod)].push_back(x);
+		}
+	}
+
+	Propagate(follows, into);
+
+	lookaheads.assign(lrStates.size(), std::vector<TerminalSet>());
+	for (unsigned state = 0; state < lrStates.size(); state++)
+	{
+		const std::vector<unsigned> &reductions = lrStates[state].reductions;
+		lookaheads[state].resize(reductions.size());
+
+		for (size_t r = 0; r < reductions.size(); r++)
+		{
+			lookaheads[state][r].resize(terminalCount);
+
+			const std::vector<unsigned> &transitions = lookback[key(state, reductions[r])];
+			for (auto x = transitions.begin(); x != transitions.end(); x++)
+				lookaheads[state][r].merge(follows[*x]);
+		}
+	}
+}
+
+//======================================================================
+// Fill in ACTION and GOTO as yacc does. First each reduction with a
+// precedence is weighed against the shifts of tokens with one: the
+// higher wins, and at the same level %left reduces, %right shifts and
+// %nonassoc makes the token an error. Whatever is left over is a
+// conflict, reported: a shift wins over a reduction, and a reduction
+// over those of later productions. Accepting counts as shifting the end
+// of input.
+//======================================================================
+void BNFParser::ResolveActions(const std::vector<std::vector<TerminalSet>> &lookaheads)
+{
+	size_t columns = terminalNames.size(), states = lrStates.size();
+	int accept = (int)productions.size() + 1;
+	unsigned acceptState = transition(0, rhsIds[rhsStart[productions.size()]]);
+	unsigned shiftReduce = 0, reduceReduce = 0;
+
+	lrActions.assign(states * columns, 0);
+	lrGotos.assign(nonTerminalNames.size() * states, 0);
+	lrErrors.assign(states, false);
+
+	std::vector<int> shifts(columns);
+	std::vector<bool> errors(columns);
+	std::vector<TerminalSet> reduceOn;
+
+	for (unsigned state = 0; state < states; state++)
+	{
+		int *row = &lrActions[state * columns];
+		const LRState &lrState = lrStates[state];
+
+		std::fill(shifts.begin(), shifts.end(), 0);
+		std::fill(errors.begin(), errors.end(), false);
+
+		for (auto tr = lrState.transitions.begin(); tr != lrState.transitions.end(); tr++)
+		{
+			if (isTerminal(tr->first))
+				shifts[tr->first] = (int)tr->second;
+			else
+				lrGotos[nonTerminalOf(tr->first) * states + state] = (int)tr->second;
+		}
+
+		if (state == acceptState)
+			shifts[0] = -accept;
+
+		reduceOn = lookaheads[state];
+
+		for (size_t r = 0; r < lrState.reductions.size(); r++)
+		{
+			const OperatorDecl *rule = precedence(lrState.reductions[r]);
+			if (!rule)
+				continue;
+
+			for (unsigned t = 1; t < columns; t++)
+			{
+				auto found = m_operatorDecls.find(terminalNames[t]);
+				if (!shifts[t] || !reduceOn[r].contains(t) || found == m_operatorDecls.end())
+					continue;
+
+				const OperatorDecl &token = found->second;
+				bool reduce = rule->level > token.level || (rule->level == token.level && !token.rightAssoc);
+				bool shift = rule->level < token.level || (rule->level == token.level && (token.rightAssoc || token.nonAssoc));
+
+				// %nonassoc takes both away
+				if (reduce)
+					shifts[t] = 0;
+				if (shift)
+					reduceOn[r].erase(t);
+				if (reduce && shift)
+					errors[t] = true;
+			}
+		}
+
+		for (size_t r = 0; r < lrState.reductions.size(); r++)
+		{
+			for (unsigned t = 0; t < columns; t++)
+			{
+				if (!reduceOn[r].contains(t))
+					continue;
+
+				if (row[t])
+				{
+					reduceReduce++;
+					yylog("State %u: reduce/reduce conflict on '%s'", state, t ? terminalNames[t].c_str() : "$end");
+				}
+				else
+					row[t] = -(int)(lrState.reductions[r] + 1);
+			}
+		}
+
+		for (unsigned t = 0; t < columns; t++)
+		{
+			if (shifts[t])
+			{
+				if (row[t])
+				{
+					shiftReduce++;
+					yylog("State %u: shift/reduce conflict on '%s', shifting", state, t ? terminalNames[t].c_str() : "$end");
+				}
+				row[t] = shifts[t];
+			}
+			else if (errors[t])
+			{
+				row[t] = 0;
+				lrErrors[state] = true;
+			}
+		}
+	}
+
+	if (shiftReduce)
+		yywarning("%u shift/reduce conflict(s), resolved by shifting", shiftReduce);
+	if (reduceReduce)
+		yywarning("%u reduce/reduce conflict(s), resolved by the earlier production", reduceReduce);
+}
+
+//======================================================================
+// Each state's kernel and what it does on each terminal, as y.output
+//======================================================================
+void BNFParser::LogLRStates()
+{
+	size_t columns = terminalNames.size();
+
+	auto symbolName = [&](unsigned code) -> std::string
+	{
+		if (!isTerminal(code))
+			return nonTerminalNames[nonTerminalOf(code)];
+		if (!code)
+			return "$end";
+		return tokens.count(terminalNames[code]) ? terminalNames[code] : "'" + terminalNames[code] + "'";
+	};
+
+	for (unsigned state = 0; state < lrStates.size(); state++)
+	{
+		yylog("\nState %u", state);
+
+		for (auto item = lrStates[state].kernel.begin(); item != lrStates[state].kernel.end(); item++)
+		{
+			unsigned prod = itemProd[*item];
+			std::string text = prod < productions.size() ? productions[prod].lhs : "$accept";
+			text += " ->";
+
+			for (unsigned i = rhsStart[prod]; i <= rhsStart[prod + 1]; i++)
+			{
+				if (i == rhsStart[prod] + *item - itemStart[prod])
+					text += " .";
+				if (i < rhsStart[prod + 1])
+					text += " " + symbolName(rhsIds[i]);
+			}
+
+			yylog("\t%s", text.c_str());
+		}
+
+		for (unsigned t = 0; t < columns; t++)
+		{
+			int action = lrActions[state * columns + t];
+			if (action > 0)
+				yylog("\t%s shift %d", symbolName(t).c_str(), action);
+			else if (action < 0)
+				yylog("\t%s reduce %d", symbolName(t).c_str(), -action);
+		}
+	}
+}
+
+//
+void BNFParser::GenerateLALR()
+{
+	if (nonTerminals.find(startSymbol) == nonTerminals.end())
+	{
+		yyerror("Start symbol (%s) has no rules", startSymbol.c_str());
+		return;
+	}
+
+	NumberSymbols();
+
+	ComputeNullable();
+
+	BuildLRStates();
+
+	std::vector<std::vector<TerminalSet>> lookaheads;
+	ComputeLookaheads(lookaheads);
+
+	ResolveActions(lookaheads);
+
+	if (yydebug)
+		LogLRStates();
+
+	yylog("\n%zu LALR(1) states", lrStates.size());
+}
+
+//======================================================================
+// The tables go out as constant data, see LRTable in tableparser.h, and
+// the actions as one switch in yyreduce(). Each state's most common
+// reduction becomes its default, and each non-terminal's most common
+// state its GOTO default.
+//======================================================================
+void BNFParser::OutputLALRTable()
+{
+	const char *name = outputFileName.c_str();
+	size_t states = lrStates.size(), columns = terminalNames.size(), rows = nonTerminalNames.size();
+	size_t rules = productions.size() + 1;
+
+	fprintf(yyout, "#include \"%s.h\"\n\n", name);
+
+	// see GenerateLALR()
+	if (lrStates.empty())
+		return;
+
+	if (states >= LR_TABLE_LIMIT || rules >= LR_TABLE_LIMIT || rows >= EMPTY_SLOT)
+	{
+		yyerror("Grammar is too large for the LALR(1) tables");
+		return;
+	}
+
+	// token -> column, with columns for a token that has none
+	std::vector<int> translate(257 + tokens.size(), (int)columns);
+	for (unsigned t = 0; t < columns; t++)
+		translate[tokenValue(t)] = t;
+
+	fputs("// LALR(1) tables, see LRTable in tableparser.h\n", yyout);
+	OutputArray("unsigned short", "yytranslate", translate);
+
+	std::vector<int> actionDefaults(states, 0), gotoDefaults(rows, 0), base, next, check;
+
+	for (size_t state = 0; state < states; state++)
+	{
+		if (lrErrors[state])
+			continue;
+
+		// on a tie the earlier production, as yacc has it
+		size_t most = 0;
+		const std::vector<unsigned> &reductions = lrStates[state].reductions;
+		for (auto prod = reductions.begin(); prod != reductions.end(); prod++)
+		{
+			int action = -(int)(*prod + 1);
+			size_t count = std::count(&lrActions[state * columns], &lrActions[state * columns] + columns, action);
+			if (count > most)
+			{
+				most = count;
+				actionDefaults[state] = action;
+			}
+		}
+	}
+
+	size_t actionSize = PackTable(lrActions, states, columns, actionDefaults, base, next, check);
+
+	OutputArray("short", "yyactionDefaults", actionDefaults);
+	OutputArray("int", "yyactionBase", base);
+	OutputArray("short", "yyactionNext", next);
+	OutputArray("unsigned short", "yyactionCheck", check);
+
+	for (size_t nt = 0; nt < rows; nt++)
+	{
+		std::map<int, unsigned> counts;
+		for (size_t state = 0; state < states; state++)
+		{
+			int target = lrGotos[nt * states + state];
+			if (target && ++counts[target] > counts[gotoDefaults[nt]])
+				gotoDefaults[nt] = target;
+		}
+	}
+
+	size_t gotoSize = PackTable(lrGotos, rows, states, gotoDefaults, base, next, check);
+
+	OutputArray("unsigned short", "yygotoDefaults", gotoDefaults);
+	OutputArray("int", "yygotoBase", base);
+	OutputArray("unsigned short", "yygotoNext", next);
+	OutputArray("unsigned short", "yygotoCheck", check);
+
+	// rule n is production n - 1, and the last one accepts
+	std::vector<int> ruleLength(1, 0), ruleLhs(1, 0);
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		ruleLength.push_back((int)productions[prod].rhs.symbols.size());
+		ruleLhs.push_back((int)lhsIds[prod]);
+	}
+	ruleLength.push_back(1);
+	ruleLhs.push_back(0);
+
+	OutputArray("unsigned short", "yyruleLength", ruleLength);
+	OutputArray("unsigned short", "yyruleLhs", ruleLhs);
+
+	fprintf(yyout, "const LRTable %s::yytables = {\n", name);
+	fprintf(yyout, "\t%zu, %zu, %zu, %zu, yytranslate,\n", states, columns, translate.size(), rules);
+	fputs("\tyyactionDefaults, yyactionBase, yyactionNext, yyactionCheck,\n", yyout);
+	fputs("\tyygotoDefaults, yygotoBase, yygotoNext, yygotoCheck,\n", yyout);
+	fputs("\tyyruleLength, yyruleLhs\n", yyout);
+	fputs("};\n\n", yyout);
+
+	yylog("\nACTION of %zu x %zu packed into %zu entries, GOTO of %zu x %zu into %zu", states, columns, actionSize, rows, states, gotoSize);
+
+	// the actions
+	fprintf(yyout, "void %s::yyreduce(int rule, YYSTYPE *yyvsp, YYSTYPE &yyval)\n{\n", name);
+	fputs("\t// not every grammar's actions use them\n", yyout);
+	fputs("\t(void)yyvsp;\n\t(void)yyval;\n\n", yyout);
+	fputs("\tswitch (rule)\n\t{\n", yyout);
+
+	for (unsigned prod = 0; prod < productions.size(); prod++)
+	{
+		const RightHandSide &rhs = productions[prod].rhs;
+		if (rhs.action.empty())
+			continue;
+
+		std::vector<bool> used(rhs.symbols.size() + 1, false);
+		fprintf(yyout, "\t// %s\n", getRule(productions[prod].lhs, rhs).c_str());
+		fprintf(yyout, "\tcase %u:\n\t\t{%s}\n\t\tbreak;\n", prod + 1, ReplaceValues(rhs.action, used, true).c_str());
+	}
+
+	fputs("\t}\n}\n\n", yyout);
+}
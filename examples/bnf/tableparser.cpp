@@ -1,76 +1,37 @@
 #include <stdarg.h>
 #include <iostream>
-#include <map>
-#include <stack>
 #include "tableparser.h"
 
 //
-int TableParser::yyparse()
+void TableParser::grow(size_t count)
 {
-	int token, rule;
+	size_t size = ss.size() * 2;
+	if (size < depth + count)
+		size = depth + count;
 
-	// setup the LL(1) parsing table
-	initTable();
-
-	token = yylex();
-
-	while (ss.size() > 0)
-	{
-		// if the token matches TOS then we match the token
-		if (token == ss.top())
-		{
-			if (token > 0 && token < 256)
-				yylog("\nMatched character: '%c'\n", token);
-			else
-				yylog("\nMatched token: %d\n", token);
-
-			// TODO - what do we push for a non-terminal symbol? yylval is not populated with data!
-			// save the yylval on the value stack
-			if (token)
-				tokenMatch(token);
-
-			// pop the matched symbol from the stack
-			ss.pop();
-
-			// if there is more parsing to do, then get the next token
-			if (ss.size() > 0)
-				token = yylex();
-		}
-		else
-		{
-			// perform any actions if they exist
-			if (yyaction(ss.top()))
-			{
-//				yylog("Action %d\n", ss.top());
-
-				// pop the executed action off the stack
-				ss.pop();
-				
-				// there might be more actions?
-				continue;
-			}
-
-			rule = table[ss.top()][token];
-			yylog("\nPredict rule %d: ", rule);
+	ss.resize(size);
+}
 
-			// process the rule
-			yyrule(rule);
-		}
-	}
+//
+void TableParser::unexpectedToken(int token)
+{
+	char msg[64];
+	snprintf(msg, sizeof(msg), "unexpected token %d", token);
+	yyerror(msg);
 
-	return 0;
+	depth = 0;
 }
 
 //
 void TableParser::yyerror(const std::string &str)
 {
-	yylog("error: %s\n", str.c_str());
+	yyreport("error", str);
 }
 
 //
 void TableParser::yywarning(const std::string &str)
 {
-	yylog("warning: %s\n", str.c_str());
+	yyreport("warning", str);
 }
 
 //
@@ -90,5 +51,5 @@ void TableParser::yylog(const char *fmt, ...)
 #endif
 	va_end(argptr);
 
-	fputs(buf, YYLOG);
+	fputs(buf, YYLOGFILE);
 }
\ No newline at end of file
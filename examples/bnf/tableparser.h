@@ -1,83 +1,561 @@
 #pragma once
 
-#include <map>
-#include <stack>
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include "../../tracebuffer.h"
 
-#define YYLOG stdout
+#define YYLOGFILE stdout
 #define YYBUFSIZE 2048
+#define YYSTACKSIZE 256
 
+// what yypush() makes of a token; yyparse() returns the last two
+enum
+{
+	YYPUSH_MORE = -1,		// it was taken, push the next one
+	YYPUSH_ACCEPT = 0,		// the input is complete
+	YYPUSH_ERROR = 1		// it can't come next, and the parse is over
+};
+
+// How every generated parser reports an error or warning, unless its
+// yyerror() is overridden: on stderr, debugging or not.
+inline void yyreport(const char *kind, const std::string &msg)
+{
+	fprintf(stderr, "%s: %s\n", kind, msg.c_str());
+}
+
+// ---------------------------------------------------------------------------
+// TokenSource — where a generated parser reads its tokens from.
+//
+// yylex() returns the next token, 0 at the end of the input, and sets its
+// value. The parser keeps the value itself, so parsers that each have a
+// source of their own share nothing and can run side by side, one per
+// thread. The adapters below cover the usual lexers; the parser doesn't
+// own its source.
+// ---------------------------------------------------------------------------
+template<typename ValueType>
+class TokenSource
+{
+public:
+	virtual ~TokenSource() = default;
+
+	virtual int yylex(ValueType &value) = 0;
+};
+
+// a function given a context pointer of its own, e.g. the input
+template<typename ValueType>
+class CallbackTokenSource : public TokenSource<ValueType>
+{
+public:
+	using Callback = int(*)(void *context, ValueType &value);
+
+	CallbackTokenSource(Callback callback, void *context) : m_callback(callback), m_context(context) {}
+
+	int yylex(ValueType &value) override { return m_callback(m_context, value); }
+
+protected:
+	Callback m_callback;
+	void *m_context;
+};
+
+// a yacc lexer, int yylex() setting a global yylval; parsers using the
+// same one can't run at once
+template<typename ValueType>
+class GlobalTokenSource : public TokenSource<ValueType>
+{
+public:
+	using Function = int(*)();
+
+	GlobalTokenSource(Function yylex, const ValueType *pyylval) : m_yylex(yylex), m_pyylval(pyylval) {}
+
+	int yylex(ValueType &value) override
+	{
+		int token = m_yylex();
+		value = *m_pyylval;
+		return token;
+	}
+
+protected:
+	Function m_yylex;
+	const ValueType *m_pyylval;
+};
+
+// a lexer object with int yylex() that leaves the value in pyylval, such
+// as a subclass of the library's LexicalAnalyzer and the yylval it was
+// constructed with. Its tokens must be the grammar's, 0 at the end, so
+// the subclass's yylex() turns TV_DONE, TV_INTVAL and the like into them.
+//
+//	LexerTokenSource<YYSTYPE, MyLexer> source(&lexer, &yylval);
+template<typename ValueType, typename Lexer>
+class LexerTokenSource : public TokenSource<ValueType>
+{
+public:
+	LexerTokenSource(Lexer *pLexer, const ValueType *pyylval) : m_pLexer(pLexer), m_pyylval(pyylval) {}
+
+	int yylex(ValueType &value) override
+	{
+		int token = m_pLexer->yylex();
+		value = *m_pyylval;
+		return token;
+	}
+
+protected:
+	Lexer *m_pLexer;
+	const ValueType *m_pyylval;
+};
+
+// ---------------------------------------------------------------------------
+// CorpusDriver — times a parser over a corpus from bnf -g.
+//
+// A corpus is sentences each ended by a NUL, which a lexer that returns
+// the characters it doesn't know as themselves gives as 0, the end of the
+// input. The driver is the parser's source, reading the lexer's, and runs
+// yyparse() once a sentence until the lexer has nothing left, counting
+// the tokens and the sentences that fail; the rest of a failed one is
+// skipped. The time is the lexer's and the parser's together.
+//
+//	CallbackTokenSource<YYSTYPE> lexer(yylex, stdin);
+//	CorpusDriver<YYSTYPE> driver(&lexer);
+//	calc parser(&driver);
+//	driver.run(parser);
+//	driver.report(stderr);
+// ---------------------------------------------------------------------------
+template<typename ValueType>
+class CorpusDriver : public TokenSource<ValueType>
+{
+public:
+	CorpusDriver(TokenSource<ValueType> *pSource) : m_pSource(pSource), m_value() {}
+
+	int yylex(ValueType &value) override
+	{
+		if (m_peeked)
+		{
+			m_peeked = false;
+			value = m_value;
+			m_last = m_token;
+		}
+		else
+			m_last = m_pSource->yylex(value);
+
+		if (m_last)
+			m_tokens++;
+
+		return m_last;
+	}
+
+	// parse each sentence left in the corpus, returning how many failed
+	template<typename Parser>
+	uint64_t run(Parser &parser)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		// a sentence's first token is read here, to see if there is one
+		while ((m_token = m_pSource->yylex(m_value)) != 0)
+		{
+			m_peeked = true;
+
+			// a parse can succeed with the sentence's end still to come
+			if (parser.yyparse() != 0 || m_last != 0)
+			{
+				m_failed++;
+				while (m_last != 0)
+					m_last = m_pSource->yylex(m_value);
+			}
+
+			m_sentences++;
+		}
+
+		m_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return m_failed;
+	}
+
+	// with the corpus's size in bytes, if it's known, for a rate in MB/s
+	void report(FILE *fp, long bytes = -1) const
+	{
+		double seconds = m_seconds > 0 ? m_seconds : 1e-9;
+
+		fprintf(fp, "%llu sentences, %llu failed, %llu tokens in %.3f s: %.0f tokens/s, %.0f sentences/s",
+			(unsigned long long)m_sentences, (unsigned long long)m_failed, (unsigned long long)m_tokens,
+			m_seconds, m_tokens / seconds, m_sentences / seconds);
+
+		if (bytes > 0)
+			fprintf(fp, ", %.1f MB/s", bytes / seconds / (1024 * 1024));
+
+		fputc('\n', fp);
+	}
+
+protected:
+	TokenSource<ValueType> *m_pSource;
+
+	// a sentence's first token, until the parser asks for it
+	bool m_peeked = false;
+	int m_token = 0;
+	ValueType m_value;
+
+	int m_last = 0;				// the last token the parser was given
+	uint64_t m_sentences = 0;
+	uint64_t m_failed = 0;
+	uint64_t m_tokens = 0;
+	double m_seconds = 0;
+};
+
+// ---------------------------------------------------------------------------
+// ParseTable — the LL(1) table a generated parser is built with.
+//
+// The generator writes it out as constant data, so there is nothing to
+// set up before a parse. A token is turned into the table's column by
+// translate[]; tokens past it, or with no column, have no rule. Row r is
+// the non-terminal firstNonTerminal + r.
+//
+// Small tables are dense, rows * columns rules with 0 for an error. Large
+// ones are comb compressed: a row's entries are at base[row] + column in
+// next[], where check[] says which row they belong to, and the columns it
+// has no entry for take the row's default. The default is the row's most
+// common rule, so as with yacc's default reductions a bad token may be
+// caught when it comes to be matched rather than here; it is never
+// consumed.
+// ---------------------------------------------------------------------------
+struct ParseTable
+{
+	int start;							// the start symbol
+	int firstNonTerminal;
+	int rows;
+	int columns;
+	int tokens;							// entries in translate
+	const unsigned short *translate;
+	const unsigned short *dense;		// nullptr if compressed
+	const int *base;
+	const unsigned short *next;
+	const unsigned short *check;
+	const unsigned short *defaults;
+
+	// the rule to predict for symbol given token, 0 if there is none
+	int predict(int symbol, int token) const
+	{
+		unsigned row = (unsigned)(symbol - firstNonTerminal);
+		if (row >= (unsigned)rows || (unsigned)token >= (unsigned)tokens)
+			return 0;
+
+		unsigned column = translate[token];
+		if (column >= (unsigned)columns)
+			return 0;
+
+		if (dense)
+			return dense[row * columns + column];
+
+		int index = base[row] + column;
+		return check[index] == row ? next[index] : defaults[row];
+	}
+};
+
+// ---------------------------------------------------------------------------
+// TableParser — base class of a generated LL(1) parser.
+//
+// The generator writes each grammar's yyparse() itself, around the table,
+// the rules' symbols and a table of its actions, see OutputTable() in
+// bnfparser.cpp, and it reads its tokens from a TokenSource with the
+// grammar's own YYSTYPE. Its yypush(token, value) takes them one at a
+// time instead, returning YYPUSH_MORE until the parse is over; the
+// stacks stay here in between. The symbol stack is one block, grown by
+// doubling, and a rule's symbols go onto it in one copy.
+// ---------------------------------------------------------------------------
 class TableParser
 {
 protected:
 	using Symbols = int;
 	using Rule = int;
-	using LexicalAnalyzer = int(*)();
-
-	LexicalAnalyzer yylex;
 
 	// parsing table
-	std::map< Symbols, std::map<Symbols, Rule> > table;
-	
-	std::map<Symbols, Rule> actions;
+	const ParseTable *parseTable;
 
-	// symbol stack
-	std::stack<Symbols> ss;
+	// symbol stack, ss[0, depth) is in use
+	std::vector<Symbols> ss;
+	size_t depth = 0;
 
 	bool yydebug = false;
 
+	void push(Symbols symbol)
+	{
+		if (depth == ss.size())
+			grow(1);
+		ss[depth++] = symbol;
+	}
+
+	void push(const Symbols *symbols, size_t count)
+	{
+		if (depth + count > ss.size())
+			grow(count);
+		memcpy(&ss[depth], symbols, count * sizeof(Symbols));
+		depth += count;
+	}
+
+	void grow(size_t count);
+	void unexpectedToken(int token);
+
 public:
-	TableParser(LexicalAnalyzer lexer) { yylex = lexer; };
-	~TableParser() = default;
+	TableParser(const ParseTable *pTable) : ss(YYSTACKSIZE) { parseTable = pTable; };
+	virtual ~TableParser() = default;
+
+	// drop a parse that was being pushed, see yypush()
+	void yyreset() { depth = 0; }
 
 	void setDebug(bool onoff) {
 		yydebug = onoff;
 	}
 
-	virtual int yyparse();
+	virtual int yyparse() = 0;
 	
 	virtual void yyerror(const std::string &str);
 	virtual void yywarning(const std::string &str);
 	virtual void yylog(const char *fmt, ...);
+};
+
+// ---------------------------------------------------------------------------
+// LRTable — the LALR(1) tables a generated shift-reduce parser is built
+// with, see bnf -l.
+//
+// ACTION is indexed by state and token column: an entry > 0 shifts to
+// that state, < 0 reduces by rule -entry, and 0 is an error. GOTO gives
+// the state to go to after reducing to a non-terminal. Both are comb
+// compressed as in ParseTable, ACTION's rows being states and GOTO's
+// non-terminals. A state's default is its most common reduction, so a
+// bad token may cause some reductions before it is found to be an error
+// but it is never shifted; states where %nonassoc makes a token an error
+// have none.
+// ---------------------------------------------------------------------------
+struct LRTable
+{
+	int states;
+	int columns;
+	int tokens;							// entries in translate
+	int accept;							// the rule that ends the parse
+	const unsigned short *translate;
+
+	const short *actionDefaults;
+	const int *actionBase;
+	const short *actionNext;
+	const unsigned short *actionCheck;
+
+	const unsigned short *gotoDefaults;
+	const int *gotoBase;
+	const unsigned short *gotoNext;
+	const unsigned short *gotoCheck;
+
+	// each rule's length and non-terminal
+	const unsigned short *ruleLength;
+	const unsigned short *ruleLhs;
+
+	int action(int state, int token) const
+	{
+		unsigned column = (unsigned)token < (unsigned)tokens ? translate[token] : columns;
+		if (column >= (unsigned)columns)
+			return 0;
+
+		int index = actionBase[state] + column;
+		return actionCheck[index] == state ? actionNext[index] : actionDefaults[state];
+	}
+
+	int go(int state, int nonTerminal) const
+	{
+		int index = gotoBase[nonTerminal] + state;
+		return gotoCheck[index] == nonTerminal ? gotoNext[index] : gotoDefaults[nonTerminal];
+	}
+};
+
+// ---------------------------------------------------------------------------
+// LRParser — shift-reduce parser over an LRTable.
+//
+// Generated subclasses override yyreduce() with the grammar's actions.
+// States and values are kept in two stacks side by side, each one block
+// with YYSTACKSIZE entries reserved, and a reduction pops its values in
+// one go. yyparse() reads the tokens from its TokenSource; yypush() is
+// given them one at a time instead, by a caller that has them when it
+// has them, and the parser needs no source.
+// ---------------------------------------------------------------------------
+template<typename ValueType>
+class LRParser
+{
+protected:
+	TokenSource<ValueType> *m_pSource;
+	ValueType       m_yylval;      // the lookahead's value
+	const LRTable  *m_table;
+	bool            m_debug = false;
+
+	std::vector<int>       m_states;
+	std::vector<ValueType> m_values;
+
+	// run rule's action; yyvsp[0] is $1, and yyval, $$, starts out as $1
+	virtual void yyreduce(int rule, ValueType *yyvsp, ValueType &yyval) = 0;
+
+public:
+	LRParser(TokenSource<ValueType> *pSource, const LRTable *pTable)
+		: m_pSource(pSource), m_yylval(), m_table(pTable)
+	{
+		m_states.reserve(YYSTACKSIZE);
+		m_values.reserve(YYSTACKSIZE);
+	}
+
+	virtual ~LRParser() = default;
+
+	void setDebug(bool onoff) { m_debug = onoff; }
+
+	virtual void yyerror(const std::string& msg)
+	{
+		yyreport("error", msg);
+	}
+
+	// Parse what has been pushed so far and token, with its value. The
+	// stacks stay in the parser between calls, and a new parse starts
+	// after one is accepted, fails or is reset.
+	int yypush(int token, const ValueType &value)
+	{
+		m_yylval = value;
+		return yystep(token);
+	}
+
+	void yyreset()
+	{
+		m_states.clear();
+		m_values.clear();
+	}
+
+	virtual int yyparse()
+	{
+		yyreset();
+
+		int status;
+		do
+			status = yystep(m_pSource->yylex(m_yylval));
+		while (status == YYPUSH_MORE);
+
+		return status;
+	}
 
-	virtual void initTable() = 0;
-	virtual int yyrule(int rule) = 0;
-	virtual int yyaction(int action) = 0;
+protected:
+	// shift token, m_yylval's, after the reductions it calls for
+	int yystep(int token)
+	{
+		if (m_states.empty())
+		{
+			m_states.push_back(0);
+			m_values.push_back(ValueType());
+		}
+
+		for (;;)
+		{
+			int action = m_table->action(m_states.back(), token);
 
-	virtual void tokenMatch(int token) = 0;
+			if (action > 0)
+			{
+				m_states.push_back(action);
+				m_values.push_back(m_yylval);
+				return YYPUSH_MORE;
+			}
+			else if (action < 0)
+			{
+				int rule = -action;
+				if (rule == m_table->accept)
+				{
+					yyreset();
+					return YYPUSH_ACCEPT;
+				}
+
+				size_t base = m_values.size() - m_table->ruleLength[rule];
+				ValueType yyval = base < m_values.size() ? m_values[base] : ValueType();
+				yyreduce(rule, m_values.data() + base, yyval);
+
+				m_states.resize(base);
+				m_values.erase(m_values.begin() + base, m_values.end());
+
+				m_states.push_back(m_table->go(m_states.back(), m_table->ruleLhs[rule]));
+				m_values.push_back(yyval);
+			}
+			else
+			{
+				char msg[64];
+				snprintf(msg, sizeof(msg), "unexpected token %d", token);
+				yyerror(msg);
+				yyreset();
+				return YYPUSH_ERROR;
+			}
+		}
+	}
+};
+
+// ---------------------------------------------------------------------------
+// PrattTable — binding powers by token, written out by the generator as
+// constant arrays from the %left/%right/%nonassoc declarations.
+//
+//   Left-assoc  %left  op at level L:  infixLeft L, infixRight L
+//   Right-assoc %right op at level L:  infixLeft L, infixRight L - 1
+//
+// A prefix operator's operand takes the operators that bind tighter than
+// its prefix entry, and a postfix operator applies to what has been
+// parsed while its entry is above the binding power in force. A token
+// with a 0 entry isn't that kind of operator.
+// ---------------------------------------------------------------------------
+struct PrattTable
+{
+	int tokens;							// entries in each array
+	const unsigned char *infixLeft;
+	const unsigned char *infixRight;
+	const unsigned char *prefix;
+	const unsigned char *postfix;
+
+	int lbp(int token) const		{ return (unsigned)token < (unsigned)tokens ? infixLeft[token] : 0; }
+	int rbp(int token) const		{ return (unsigned)token < (unsigned)tokens ? infixRight[token] : 0; }
+	int prefixBP(int token) const	{ return (unsigned)token < (unsigned)tokens ? prefix[token] : 0; }
+	int postfixBP(int token) const	{ return (unsigned)token < (unsigned)tokens ? postfix[token] : 0; }
 };
 
 // ---------------------------------------------------------------------------
 // PrattParser — Top-Down Operator Precedence (Pratt) parser base class.
 //
 // Generated subclasses override:
-//   initPrattTable() — populate m_infixBP from %left/%right/%nonassoc decls
-//   nud(token, val)  — null denotation: handle prefix/atom expressions
-//   led(op,l,r)      — left denotation: handle infix binary expressions
+//   nud(token, val)            — null denotation: atoms and bracketed forms
+//   led(op, l, r)              — left denotation: infix binary expressions
+//   prefix(op, val, operand)   — prefix operators, if the grammar has any
+//   postfix(op, operand, val)  — postfix operators, likewise
 //
-// Binding powers (stored in m_infixBP):
-//   Left-assoc  %left  op at level L:  {lbp=L, rbp=L}
-//   Right-assoc %right op at level L:  {lbp=L, rbp=L-1}
+// parseExpr() is the textbook recursive form; parseExprIterative() keeps
+// the operators waiting for their right operand on an explicit stack, so
+// a long chain of operators takes no recursion. Generated parsers use
+// the latter.
 // ---------------------------------------------------------------------------
 template<typename ValueType>
 class PrattParser
 {
 protected:
-	using LexicalAnalyzer = int(*)();
-
-	LexicalAnalyzer m_yylex;
-	ValueType*      m_yylval;      // pointer to user's global yylval
+	TokenSource<ValueType> *m_pSource;
+	ValueType       m_yylval;      // the lookahead's value
+	const PrattTable *m_table;
 	int             m_lookahead = 0;
 	bool            m_debug = false;
+	unsigned        m_errors = 0;  // since yyparse() started
 
-	struct BP { int lbp; int rbp; };
-	std::map<int, BP> m_infixBP;   // token → binding powers
+	// an operator waiting for its right operand, see parseExprIterative()
+	struct Pending
+	{
+		int op;
+		int bp;					// what its operand binds
+		bool prefix;
+		ValueType value;		// the left operand, or a prefix operator's own value
+	};
+	std::vector<Pending> m_pending;
 
 	void advance()
 	{
-		m_lookahead = m_yylex();
+		m_lookahead = m_pSource->yylex(m_yylval);
+	}
+
+	// an error that fails the parse, whatever yyerror() makes of it
+	void syntaxError(const std::string& msg)
+	{
+		m_errors++;
+		yyerror(msg);
 	}
 
 	void matchToken(int expected)
@@ -87,41 +565,111 @@ protected:
 			char msg[64];
 			snprintf(msg, sizeof(msg), "expected token '%c' (%d), got '%c' (%d)",
 			         expected, expected, m_lookahead, m_lookahead);
-			yyerror(msg);
+			syntaxError(msg);
 		}
 		advance();
 	}
 
+	// YYPUSH_ACCEPT if the parse had no errors and took all of the input
+	int parseStatus()
+	{
+		if (!m_errors && m_lookahead != 0)
+			syntaxError("expected the end of the input");
+
+		return m_errors ? YYPUSH_ERROR : YYPUSH_ACCEPT;
+	}
+
 	// Core Pratt expression parser.
 	// Parses and returns the value of the tightest sub-expression whose
 	// infix operators all have lbp > minBP.
 	ValueType parseExpr(int minBP = 0)
 	{
-		ValueType lval = *m_yylval;
+		ValueType lval = m_yylval;
 		int t = m_lookahead;
 		advance();
-		ValueType left = nud(t, lval);
+
+		int bp = m_table->prefixBP(t);
+		ValueType left = bp ? prefix(t, lval, parseExpr(bp)) : nud(t, lval);
 
 		while (true)
 		{
-			auto it = m_infixBP.find(m_lookahead);
-			if (it == m_infixBP.end() || it->second.lbp <= minBP)
-				break;
 			int op = m_lookahead;
+			if (m_table->postfixBP(op) > minBP)
+			{
+				ValueType opval = m_yylval;
+				advance();
+				left = postfix(op, left, opval);
+				continue;
+			}
+
+			if (m_table->lbp(op) <= minBP)
+				break;
 			advance();
-			ValueType right = parseExpr(m_infixBP[op].rbp);
+			ValueType right = parseExpr(m_table->rbp(op));
 			left = led(op, left, right);
 		}
 		return left;
 	}
 
-	virtual void initPrattTable() = 0;
+	// The same parse without recursion, but for what nud() does. Prefix
+	// operators, and infix operators with their left operand, wait on
+	// m_pending until what follows them binds no tighter than they do.
+	ValueType parseExprIterative(int minBP = 0)
+	{
+		size_t base = m_pending.size();
+
+		for (;;)
+		{
+			// an operand: any prefix operators, then an atom
+			while (m_table->prefixBP(m_lookahead))
+			{
+				m_pending.push_back(Pending{ m_lookahead, m_table->prefixBP(m_lookahead), true, m_yylval });
+				advance();
+			}
+
+			ValueType lval = m_yylval;
+			int t = m_lookahead;
+			advance();
+			ValueType left = nud(t, lval);
+
+			// then operators, until one starts a new operand
+			for (;;)
+			{
+				int op = m_lookahead;
+				int bp = m_pending.size() > base ? m_pending.back().bp : minBP;
+
+				if (m_table->postfixBP(op) > bp)
+				{
+					ValueType opval = m_yylval;
+					advance();
+					left = postfix(op, left, opval);
+				}
+				else if (m_table->lbp(op) > bp)
+				{
+					m_pending.push_back(Pending{ op, m_table->rbp(op), false, left });
+					advance();
+					break;
+				}
+				else if (m_pending.size() > base)
+				{
+					Pending pending = m_pending.back();
+					m_pending.pop_back();
+					left = pending.prefix ? prefix(pending.op, pending.value, left) : led(pending.op, pending.value, left);
+				}
+				else
+					return left;
+			}
+		}
+	}
+
 	virtual ValueType nud(int token, ValueType val) = 0;
 	virtual ValueType led(int op, ValueType left, ValueType right) = 0;
+	virtual ValueType prefix(int /*op*/, ValueType /*val*/, ValueType operand)		{ return operand; }
+	virtual ValueType postfix(int /*op*/, ValueType operand, ValueType /*val*/)	{ return operand; }
 
 public:
-	PrattParser(LexicalAnalyzer lex, ValueType* yylval)
-		: m_yylex(lex), m_yylval(yylval) {}
+	PrattParser(TokenSource<ValueType> *pSource, const PrattTable *pTable)
+		: m_pSource(pSource), m_yylval(), m_table(pTable) {}
 
 	virtual ~PrattParser() = default;
 
@@ -129,14 +677,15 @@ public:
 
 	virtual void yyerror(const std::string& msg)
 	{
-		fprintf(stderr, "error: %s\n", msg.c_str());
+		yyreport("error", msg);
 	}
 
 	virtual int yyparse()
 	{
-		initPrattTable();
+		m_pending.clear();
+		m_errors = 0;
 		advance();
-		parseExpr(0);
-		return 0;
+		parseExprIterative(0);
+		return parseStatus();
 	}
 };
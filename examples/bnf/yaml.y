@@ -446,9 +446,14 @@ int main(int argc, char *argv[])
 
     bool verbose = (argc > 2 && strcmp(argv[2], "-v") == 0);
 
-    yamlparser parser(yylex);
+    GlobalTokenSource<YYSTYPE> source(yylex, &yylval);
+    yamlparser parser(&source);
     parser.setDebug(verbose);
-    parser.yyparse();
+    if (parser.yyparse() != YYPUSH_ACCEPT)
+    {
+        fclose(YYIN);
+        return 1;
+    }
 
     printf("\nParsed '%s' successfully.\n", argv[1]);
 
@@ -40,6 +40,8 @@ IniParser::IniParser() : BaseParser(std::make_unique<SymbolTable>())
 //
 void IniParser::DoPair()
 {
+	PARSE_RULE("IniParser::DoPair");
+
 	std::string key = yylval.sym->lexeme;
 	match(TV_ID);
 	match('=');
@@ -105,6 +107,8 @@ void IniParser::DoPair()
 //
 void IniParser::DoSection()
 {
+	PARSE_RULE("IniParser::DoSection");
+
 	match('[');
 
 	std::string name = yylval.sym->lexeme;
@@ -115,7 +119,7 @@ void IniParser::DoSection()
 
 	// give this section its own scope so its keys can't collide with keys
 	// of the same name declared in any other section
-	yylog("push() — new symbol table scope for section '%s'", name.c_str());
+	YYLOG("push() — new symbol table scope for section '%s'", name.c_str());
 	m_pSymbolTable->push();
 
 	while (lookahead == TV_ID)
@@ -123,7 +127,7 @@ void IniParser::DoSection()
 
 	// everything installed above disappears with the scope — a key is only
 	// resolvable via lookupSymbol() while its section's scope is on top
-	yylog("pop() — discarding symbol table scope for section '%s'", name.c_str());
+	YYLOG("pop() — discarding symbol table scope for section '%s'", name.c_str());
 	m_pSymbolTable->pop();
 }
 
@@ -8,19 +8,37 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <stdlib.h>
 #include "jsonparser.h"
+#include "batchparser.h"
+#include "pushparser.h"
 
 //
 // Command line switches
 //
 bool g_bDebug = false;
+bool g_bArena = false;
+int g_iThreads = -1;
+bool g_bProfile = false;
+const char *g_szTraceFile = nullptr;
+const char *g_szBinaryTrace = nullptr;
+int g_iChunkSize = 0;
+unsigned g_iMaxDepth = 0;
 
 //
 // show usage
 //
 void usage()
 {
-	printf("usage: json [options] filename\n");
+	printf("usage: json [options] filename...\n");
+	printf("  -v  dump the parsed document\n");
+	printf("  -a  parse into a single arena, freed in one go\n");
+	printf("  -jN parse all the files on N threads, 0 for one per core\n");
+	printf("  -p  print time spent per grammar rule (PARSERKIT_PROFILE builds)\n");
+	printf("  -tF write a Chrome trace of the rules to file F\n");
+	printf("  -bF record the -v log as a binary trace in file F, see tracedump\n");
+	printf("  -cN push the file to the parser N bytes at a time\n");
+	printf("  -dN give up on documents nested deeper than N\n");
 	exit(0);
 }
 
@@ -34,11 +52,58 @@ int getopt(int n, char *args[])
 	{
 		if (args[i][1] == 'v')
 			g_bDebug = true;
+		else if (args[i][1] == 'a')
+			g_bArena = true;
+		else if (args[i][1] == 'j')
+			g_iThreads = atoi(&args[i][2]);
+		else if (args[i][1] == 'p')
+			g_bProfile = true;
+		else if (args[i][1] == 't')
+			g_szTraceFile = &args[i][2];
+		else if (args[i][1] == 'b')
+			g_szBinaryTrace = &args[i][2];
+		else if (args[i][1] == 'c')
+			g_iChunkSize = atoi(&args[i][2]);
+		else if (args[i][1] == 'd')
+			g_iMaxDepth = (unsigned)atoi(&args[i][2]);
 	}
 
 	return i;
 }
 
+//
+// bounds from the command line
+//
+void setLimits(BaseParser &parser)
+{
+	ParseLimits limits;
+	limits.maxDepth = g_iMaxDepth;
+	parser.setLimits(limits);
+}
+
+//
+// read the file a piece at a time, as if it were arriving over a socket
+//
+void pushFile(JSONParser &parser, const char *filename)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		printf("Couldn't open file: %s\n", filename);
+		return;
+	}
+
+	PushParser push(parser, filename);
+
+	std::vector<char> buf(g_iChunkSize);
+	size_t n;
+	while ((n = fread(buf.data(), 1, buf.size(), fp)) > 0)
+		push.feed(buf.data(), n);
+
+	fclose(fp);
+	push.finish();
+}
+
 //
 //
 //
@@ -49,11 +114,69 @@ int main(int argc, char* argv[])
 
 	int iFirstArg = getopt(argc, argv);
 
-	JSONParser parser;
+	if (g_iThreads >= 0)
+	{
+		// one parser per worker, created on that worker's thread
+		BatchParser batch([]()
+		{
+			if (g_szBinaryTrace)
+				TraceBuffer::start();
+
+			std::unique_ptr<BaseParser> parser(new JSONParser());
+			parser->yydebug = g_bDebug;
+			setLimits(*parser);
+			return parser;
+		}, g_iThreads);
+
+		for (int i = iFirstArg; i < argc; i++)
+			batch.addFile(argv[i]);
+
+		unsigned errors = batch.run();
+		batch.dumpResults(stdout);
+
+		if (g_szBinaryTrace && !TraceBuffer::save(g_szBinaryTrace))
+			printf("couldn't write %s\n", g_szBinaryTrace);
+
+		return errors ? 1 : 0;
+	}
+
+	// must outlive the parser
+	MonotonicResource arena;
+
+	JSONParser parser(g_bArena ? &arena : nullptr);
 	
 	parser.yydebug = g_bDebug;
+	setLimits(parser);
+
+	ParseProfiler profiler;
+	if (g_bProfile || g_szTraceFile)
+	{
+		if (g_szTraceFile)
+			profiler.enableTrace();
+
+		parser.setProfiler(&profiler);
+	}
+
+	if (g_szBinaryTrace)
+		TraceBuffer::start();
+
+	if (g_iChunkSize > 0)
+		pushFile(parser, argv[iFirstArg]);
+	else
+		parser.parseFile(argv[iFirstArg]);
+
+	if (g_szBinaryTrace)
+	{
+		TraceBuffer::stop();
+		if (!TraceBuffer::save(g_szBinaryTrace))
+			printf("couldn't write %s\n", g_szBinaryTrace);
+	}
+
+	if (g_bProfile)
+		profiler.dumpSummary(stdout);
 
-	parser.parseFile(argv[iFirstArg]);
+	if (g_szTraceFile && !profiler.writeTrace(g_szTraceFile))
+		printf("couldn't write %s\n", g_szTraceFile);
 
 	return 0;
 }
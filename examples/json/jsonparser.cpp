@@ -26,9 +26,13 @@ TokenTable _tokenTable[] =
 //
 //
 //
-JSONParser::JSONParser() : BaseParser(std::make_unique<SymbolTable>())
+JSONParser::JSONParser(MemoryResource *pResource) : BaseParser(std::make_unique<SymbolTable>(pResource), pResource)
 {
 	m_lexer = std::make_unique<LexicalAnalyzer>(_tokenTable, this, &yylval);
+
+	// JSON strings are data, not identifiers, so keep them out of the symbol
+	// table. Interning shares the text of keys that repeat across objects.
+	setLiteralPool(std::make_unique<LiteralPool>(LiteralPool::Policy::Intern, DEFAULT_LITERAL_BLOCK, getResource()));
 }
 
 //
@@ -37,16 +41,18 @@ JSONParser::JSONParser() : BaseParser(std::make_unique<SymbolTable>())
 //
 void JSONParser::DoObject(JSONValue &node)
 {
-	yylog("Found new object");
+	PARSE_RULE("JSONParser::DoObject");
+
+	YYLOG("Found new object");
 
 	match('{');
 	
 	// match key-value pairs
 	while (lookahead == TV_STRING) 
 	{
-		yylog("Found new key: %s", yylval.sym->lexeme.c_str());
+		YYLOG("Found new key: %.*s", yylval.lit.length, yylval.lit.text);
 
-		auto result = node.o->key_values.insert( std::pair<std::string, std::unique_ptr<JSONValue>>(yylval.sym->lexeme, std::make_unique<JSONValue>()) );
+		auto result = node.o->key_values.emplace( JSONString(yylval.lit.text, yylval.lit.length, getResource()), makeResource<JSONValue>(getResource()) );
 
 		match(TV_STRING);
 		match(':');
@@ -65,7 +71,9 @@ void JSONParser::DoObject(JSONValue &node)
 //
 void JSONParser::DoArray(JSONValue &node)
 {
-	yylog("Found new array");
+	PARSE_RULE("JSONParser::DoArray");
+
+	YYLOG("Found new array");
 
 	match('[');
 	
@@ -73,7 +81,7 @@ void JSONParser::DoArray(JSONValue &node)
 	// match key-value pairs
 	while (lookahead != ']')
 	{
-		std::unique_ptr<JSONValue> val = std::make_unique<JSONValue>();
+		ResourcePtr<JSONValue> val = makeResource<JSONValue>(getResource());
 
 		DoValue(*val);
 
@@ -94,13 +102,16 @@ void JSONParser::DoArray(JSONValue &node)
 //
 void JSONParser::DoValue(JSONValue &node)
 {
+	PARSE_RULE("JSONParser::DoValue");
+	NestingScope nesting(this);
+
 	switch (lookahead)
 	{
 	case TV_STRING:
 		node.value_type = JSONValue::ValueType::String;
-		node.s = yylval.sym->lexeme;
+		new (&node.s) JSONString(yylval.lit.text, yylval.lit.length, getResource());
 
-		yylog("'%s'", yylval.sym->lexeme.c_str());
+		YYLOG("'%.*s'", yylval.lit.length, yylval.lit.text);
 		match(lookahead);
 		break;
 	
@@ -108,7 +119,7 @@ void JSONParser::DoValue(JSONValue &node)
 		node.value_type = JSONValue::ValueType::Number;
 		node.n = (float)yylval.ival;
 
-		yylog("%d", yylval.ival);
+		YYLOG("%d", yylval.ival);
 
 		match(lookahead);
 		break;
@@ -117,7 +128,7 @@ void JSONParser::DoValue(JSONValue &node)
 		node.value_type = JSONValue::ValueType::Number;
 		node.n = yylval.fval;
 
-		yylog("%f", yylval.fval);
+		YYLOG("%f", yylval.fval);
 
 		match(lookahead);
 		break;
@@ -125,7 +136,7 @@ void JSONParser::DoValue(JSONValue &node)
 	case TV_NULL:
 		node.value_type = JSONValue::ValueType::Null;
 
-		yylog(m_lexer->getLexemeFromToken(lookahead));
+		YYLOG("%s", m_lexer->getLexemeFromToken(lookahead));
 		match(lookahead);
 		break;
 
@@ -134,20 +145,20 @@ void JSONParser::DoValue(JSONValue &node)
 		node.value_type = JSONValue::ValueType::Boolean;
 		node.b = lookahead == TV_TRUE ? true : false;
 
-		yylog(m_lexer->getLexemeFromToken(lookahead));
+		YYLOG("%s", m_lexer->getLexemeFromToken(lookahead));
 		match(lookahead);
 		break;
 
 	case '{':
 		node.value_type = JSONValue::ValueType::Object;
-		node.o = std::make_unique<JSONObject>();
+		new (&node.o) ResourcePtr<JSONObject>(makeResource<JSONObject>(getResource(), getResource()));
 
 		DoObject(node);
 		break;
 
 	case '[':
 		node.value_type = JSONValue::ValueType::Array;
-		node.a = std::make_unique<JSONArray>();
+		new (&node.a) ResourcePtr<JSONArray>(makeResource<JSONArray>(getResource(), getResource()));
 
 		DoArray(node);
 		break;
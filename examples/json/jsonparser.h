@@ -8,7 +8,7 @@ class JSONParser : public BaseParser
 protected:
 
 public:
-	JSONParser();
+	explicit JSONParser(MemoryResource *pResource = nullptr);
 	virtual ~JSONParser() = default;
 	
 	int yyparse() override;
@@ -7,10 +7,14 @@
 #include <string>
 #include <memory>
 #include <cstring>
+#include "../../memoryresource.h"
 
 struct JSONArray;
 struct JSONObject;
 
+// everything in a document allocates from the parser's MemoryResource
+using JSONString = std::basic_string<char, std::char_traits<char>, ResourceAllocator<char>>;
+
 struct JSONValue
 {
 	enum class ValueType { None, Null, String, Boolean, Number, Object, Array };
@@ -18,25 +22,25 @@ struct JSONValue
 
 	union
 	{
-		std::string s;
+		JSONString s;
 		bool b;
 		float n;
-		std::unique_ptr<JSONArray> a;
-		std::unique_ptr<JSONObject> o;
+		ResourcePtr<JSONArray> a;
+		ResourcePtr<JSONObject> o;
 	};
 
 	JSONValue() : value_type(ValueType::None) {
 		// Zero-initialize union storage.
-		// A zero-bit std::string is a valid empty SSO string in libc++.
-		// A zero-bit unique_ptr is a valid null unique_ptr.
+		// The members are constructed in place once the type is known,
+		// so the zero bits are never used as a live string or pointer.
 		std::memset((void*)&s, 0, sizeof(s));
 	}
 
 	virtual ~JSONValue() {
 		switch (value_type) {
-			case ValueType::String:  s.~basic_string<char>(); break;
-			case ValueType::Object:  o.~unique_ptr<JSONObject>(); break;
-			case ValueType::Array:   a.~unique_ptr<JSONArray>(); break;
+			case ValueType::String:  s.~JSONString(); break;
+			case ValueType::Object:  o.~ResourcePtr<JSONObject>(); break;
+			case ValueType::Array:   a.~ResourcePtr<JSONArray>(); break;
 			default: break;
 		}
 	}
@@ -49,16 +53,16 @@ struct JSONValue
 	JSONValue(JSONValue&& other) noexcept : value_type(other.value_type) {
 		switch (value_type) {
 			case ValueType::String:
-				new (&s) std::string(std::move(other.s));
-				other.s.~basic_string<char>();
+				new (&s) JSONString(std::move(other.s));
+				other.s.~JSONString();
 				break;
 			case ValueType::Object:
-				new (&o) std::unique_ptr<JSONObject>(std::move(other.o));
-				other.o.~unique_ptr<JSONObject>();
+				new (&o) ResourcePtr<JSONObject>(std::move(other.o));
+				other.o.~ResourcePtr<JSONObject>();
 				break;
 			case ValueType::Array:
-				new (&a) std::unique_ptr<JSONArray>(std::move(other.a));
-				other.a.~unique_ptr<JSONArray>();
+				new (&a) ResourcePtr<JSONArray>(std::move(other.a));
+				other.a.~ResourcePtr<JSONArray>();
 				break;
 			case ValueType::Boolean: b = other.b; break;
 			case ValueType::Number:  n = other.n; break;
@@ -83,9 +87,9 @@ struct JSONValue
 
 struct JSONArray
 {
-	std::vector<std::unique_ptr<JSONValue>> elements;
+	std::vector<ResourcePtr<JSONValue>, ResourceAllocator<ResourcePtr<JSONValue>>> elements;
 
-	JSONArray() = default;
+	explicit JSONArray(MemoryResource *pResource = nullptr) : elements(ResourceAllocator<ResourcePtr<JSONValue>>(pResource)) {}
 	virtual ~JSONArray() = default;
 
 	// not copyable
@@ -101,9 +105,10 @@ struct JSONArray
 
 struct JSONObject
 {
-	std::map<std::string, std::unique_ptr<JSONValue>> key_values;
+	using KeyValue = std::pair<const JSONString, ResourcePtr<JSONValue>>;
+	std::map<JSONString, ResourcePtr<JSONValue>, std::less<JSONString>, ResourceAllocator<KeyValue>> key_values;
 	
-	JSONObject() = default;
+	explicit JSONObject(MemoryResource *pResource = nullptr) : key_values(ResourceAllocator<KeyValue>(pResource)) {}
 	virtual ~JSONObject() = default;
 
 	// not copyable
@@ -98,6 +98,9 @@ void ScriptParser::yyerror(const char *fmt, ...)
 //
 double ScriptParser::DoFactor()
 {
+	PARSE_RULE("ScriptParser::DoFactor");
+	NestingScope nesting(this);
+
 	double val = 0.0;
 
 	switch (lookahead)
@@ -160,6 +163,8 @@ double ScriptParser::DoFactor()
 //
 double ScriptParser::DoTerm()
 {
+	PARSE_RULE("ScriptParser::DoTerm");
+
 	double left = DoFactor();
 
 	while (lookahead == '*' || lookahead == '/')
@@ -184,6 +189,8 @@ double ScriptParser::DoTerm()
 //
 double ScriptParser::DoExpr()
 {
+	PARSE_RULE("ScriptParser::DoExpr");
+
 	double left = DoTerm();
 
 	while (lookahead == '+' || lookahead == '-')
@@ -204,6 +211,8 @@ double ScriptParser::DoExpr()
 //
 void ScriptParser::DoStmt()
 {
+	PARSE_RULE("ScriptParser::DoStmt");
+
 	unsigned errsBefore = m_errorCount;
 
 	switch (lookahead)
@@ -0,0 +1,29 @@
+// tracedump.cpp — renders a binary trace written by TraceBuffer::save()
+//
+// Usage:
+//   tracedump <file>     One line per event, all threads in time order
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include "tracebuffer.h"
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		printf("usage: tracedump filename\n");
+		return 1;
+	}
+
+	TraceDecoder decoder;
+	if (!decoder.load(argv[1]))
+	{
+		printf("couldn't read trace %s\n", argv[1]);
+		return 1;
+	}
+
+	decoder.render(stdout);
+
+	return 0;
+}
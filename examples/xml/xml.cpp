@@ -13,6 +13,8 @@
 // Command line switches
 //
 bool g_bDebug = false;
+bool g_bDumpTree = false;
+bool g_bWriteBack = false;
 
 //
 // show usage
@@ -20,6 +22,9 @@ bool g_bDebug = false;
 void usage()
 {
 	printf("usage: xml [options] filename\n");
+	printf("  -v  debug output\n");
+	printf("  -t  print the syntax tree\n");
+	printf("  -w  write the input back out from the syntax tree\n");
 	exit(0);
 }
 
@@ -33,6 +38,10 @@ int getopt(int n, char *args[])
 	{
 		if (args[i][1] == 'v')
 			g_bDebug = true;
+		else if (args[i][1] == 't')
+			g_bDumpTree = true;
+		else if (args[i][1] == 'w')
+			g_bWriteBack = true;
 	}
 
 	return i;
@@ -54,5 +63,11 @@ int main(int argc, char* argv[])
 
 	parser.parseFile(argv[iFirstArg]);
 
+	if (g_bDumpTree)
+		parser.getTree().dump(stdout, &XMLParser::getNodeName);
+
+	if (g_bWriteBack)
+		parser.getTree().write(stdout);
+
 	return 0;
 }
\ No newline at end of file
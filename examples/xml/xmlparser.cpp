@@ -26,9 +26,19 @@ TokenTable _tokenTable[] =
 //
 //
 //
-XMLParser::XMLParser() : BaseParser(std::make_unique<SymbolTable>())
+XMLParser::XMLParser() : BaseParser(std::make_unique<SymbolTable>()), m_tree(getResource())
 {
 	m_lexer = std::make_unique<LexicalAnalyzer>(_tokenTable, this, &yylval);
+	setSyntaxTree(&m_tree);
+}
+
+//
+//
+//
+const char *XMLParser::getNodeName(int kind)
+{
+	static const char *names[] = { "document", "element", "start-tag", "end-tag", "attribute", "text" };
+	return kind >= 0 && kind < (int)(sizeof(names) / sizeof(names[0])) ? names[kind] : nullptr;
 }
 
 //
@@ -36,27 +46,26 @@ XMLParser::XMLParser() : BaseParser(std::make_unique<SymbolTable>())
 //
 void XMLParser::DoMarkup()
 {
+	PARSE_RULE("XMLParser::DoMarkup");
+
 	while (lookahead != TV_DONE)
 	{
 		// look for text
-		if (lookahead == TV_ID)
+		if (lookahead != '<')
 		{
-			match(TV_ID);
+			openNode(XN_TEXT);
+			while (lookahead != '<' && lookahead != TV_DONE)
+				match(lookahead);
+			closeNode();
 		}
-		else if (lookahead == '<')
+		else
 		{
-			match('<');
-
-			// if this is an end-tag we are done
-			if (lookahead == '/')
-			{
-				match('/');
+			// if this is an end-tag we are done, it's the caller's
+			if (speculate([this]() { match('<'); match('/'); }))
 				return;
-			}
 
 			DoEntity();
 		}
-
 	}
 }
 
@@ -65,18 +74,28 @@ void XMLParser::DoMarkup()
 //
 void XMLParser::DoEntity()
 {
+	PARSE_RULE("XMLParser::DoEntity");
+
 	std::string entityName;
 
-	entityName = yylval.sym->lexeme;
+	openNode(XN_ELEMENT);
+	openNode(XN_START_TAG);
+
+	match('<');
+
+	if (lookahead == TV_ID)
+		entityName = yylval.sym->lexeme;
 
 	match(TV_ID);
 
 	// match zero or more attributes
 	while (lookahead == TV_ID) 
 	{
+		openNode(XN_ATTRIBUTE);
 		match(TV_ID);
 		match('=');
 		match(TV_STRING);
+		closeNode();
 	}
 
 	// see if this is a self-closed tag
@@ -84,18 +103,28 @@ void XMLParser::DoEntity()
 	{
 		match(lookahead);
 		match('>');
+		closeNode();
+		closeNode();
 		return;
 	}
 
 	match('>');
+	closeNode();
 
 	DoMarkup();
 
-	if (entityName != yylval.sym->lexeme)
+	openNode(XN_END_TAG);
+	match('<');
+	match('/');
+
+	if (lookahead != TV_ID || entityName != yylval.sym->lexeme)
 		yyerror("incorrect or missing end tag: %s", entityName.c_str());
 
 	match(TV_ID);
 	match('>');
+	closeNode();
+
+	closeNode();
 }
 
 //
@@ -105,10 +134,12 @@ int XMLParser::yyparse()
 {
 	BaseParser::yyparse();
 
-	// match first start tag
-	match('<');
+	openNode(XN_DOCUMENT);
 
+	// the root element
 	DoEntity();
 
+	closeNode();
+
 	return 0;
 }
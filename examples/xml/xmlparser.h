@@ -2,9 +2,21 @@
 
 #include "../../baseparser.h"
 
+// the kinds of node in the syntax tree, tokens are their own
+enum
+{
+	XN_DOCUMENT,
+	XN_ELEMENT,
+	XN_START_TAG,
+	XN_END_TAG,
+	XN_ATTRIBUTE,
+	XN_TEXT,
+};
+
 class XMLParser : public BaseParser
 {
 protected:
+	SyntaxTree m_tree;
 
 public:
 	XMLParser();
@@ -14,4 +26,8 @@ public:
 
 	void DoEntity();
 	void DoMarkup();
-};
\ No newline at end of file
+
+	const SyntaxTree &getTree() const	{ return m_tree; }
+
+	static const char *getNodeName(int kind);
+};
@@ -16,6 +16,49 @@ YAMLLexer::YAMLLexer(TokenTable *tt, BaseParser *p, YYSTYPE *v)
     m_indentStack.push_back(0);
 }
 
+// -------------------------------------------------------------------------
+// Checkpoints
+// -------------------------------------------------------------------------
+std::unique_ptr<LexicalAnalyzer::Checkpoint> YAMLLexer::checkpoint()
+{
+    std::unique_ptr<YAMLCheckpoint> cp(new YAMLCheckpoint());
+    saveState(*cp);
+
+    cp->indentStack = m_indentStack;
+    cp->pending     = m_pending;
+    cp->flowDepth   = m_flowDepth;
+    cp->atBOL       = m_atBOL;
+
+    return cp;
+}
+
+bool YAMLLexer::restore(const Checkpoint &cp)
+{
+    const YAMLCheckpoint *pYaml = dynamic_cast<const YAMLCheckpoint*>(&cp);
+    if (!pYaml || !restoreState(cp))
+        return false;
+
+    m_indentStack = pYaml->indentStack;
+    m_pending     = pYaml->pending;
+    m_flowDepth   = pYaml->flowDepth;
+    m_atBOL       = pYaml->atBOL;
+
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Back to the start of a document
+// -------------------------------------------------------------------------
+void YAMLLexer::reset()
+{
+    LexicalAnalyzer::reset();
+
+    m_indentStack.assign(1, 0);
+    m_pending   = std::queue<int>();
+    m_flowDepth = 0;
+    m_atBOL     = true;
+}
+
 // -------------------------------------------------------------------------
 // Skip to end of line (leaves '\n' in the stream to be consumed later)
 // -------------------------------------------------------------------------
@@ -115,8 +158,13 @@ int YAMLLexer::readString()
         }
         s += (char)c;
     }
-    // Install the string in the symbol table so m_yylval->sym is set
-    m_yylval->sym = m_pParser->installSymbol(const_cast<char*>(s.c_str()), stStringLiteral);
+    // Route the string to the parser's literal pool if it has one, otherwise
+    // install it in the symbol table so m_yylval->sym is set
+    LiteralPool *pPool = m_pParser->getLiteralPool();
+    if (pPool)
+        m_yylval->lit = pPool->add(s.data(), s.size());
+    else
+        m_yylval->sym = m_pParser->installSymbol(const_cast<char*>(s.c_str()), stStringLiteral);
     return TV_STRING;
 }
 
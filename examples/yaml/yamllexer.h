@@ -42,6 +42,15 @@ class YAMLLexer : public LexicalAnalyzer
     int              m_flowDepth;    // nesting of { } and [ ]
     bool             m_atBOL;        // true when positioned at beginning of line
 
+    // checkpoints carry the indentation state along with the position
+    struct YAMLCheckpoint : Checkpoint
+    {
+        std::vector<int> indentStack;
+        std::queue<int>  pending;
+        int              flowDepth;
+        bool             atBOL;
+    };
+
     // Process beginning-of-line: count spaces, queue INDENT/DEDENT tokens.
     void processBOL();
 
@@ -57,4 +66,8 @@ public:
     YAMLLexer(TokenTable *tt, BaseParser *p, YYSTYPE *v);
 
     int yylex() override;
+    void reset() override;
+
+    std::unique_ptr<Checkpoint> checkpoint() override;
+    bool restore(const Checkpoint &cp) override;
 };
@@ -15,9 +15,12 @@ static TokenTable _tokenTable[] =
 // -------------------------------------------------------------------------
 // Constructor
 // -------------------------------------------------------------------------
-YAMLParser::YAMLParser() : BaseParser(std::make_unique<SymbolTable>())
+YAMLParser::YAMLParser(MemoryResource *pResource) : BaseParser(std::make_unique<SymbolTable>(pResource), pResource)
 {
     m_lexer = std::make_unique<YAMLLexer>(_tokenTable, this, &yylval);
+
+    // quoted strings are data, keep them out of the symbol table
+    setLiteralPool(std::make_unique<LiteralPool>(LiteralPool::Policy::Intern, DEFAULT_LITERAL_BLOCK, getResource()));
 }
 
 // -------------------------------------------------------------------------
@@ -27,7 +30,7 @@ int YAMLParser::yyparse()
 {
     BaseParser::yyparse(); // primes lookahead
 
-    YAMLValue root;
+    YAMLValue root(getResource());
     DoDocument(root);
 
     if (yydebug)
@@ -45,7 +48,9 @@ int YAMLParser::yyparse()
 // -------------------------------------------------------------------------
 void YAMLParser::DoDocument(YAMLValue &node)
 {
-    yylog("DoDocument");
+    PARSE_RULE("YAMLParser::DoDocument");
+
+    YYLOG("DoDocument");
 
     if (lookahead == TV_KEY)
     {
@@ -73,17 +78,19 @@ void YAMLParser::DoDocument(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoBlockMapping(YAMLValue &node)
 {
-    yylog("DoBlockMapping");
+    PARSE_RULE("YAMLParser::DoBlockMapping");
+
+    YYLOG("DoBlockMapping");
 
     while (lookahead == TV_KEY)
     {
-        std::string key = yylval.sym->lexeme; // save before match advances lookahead
-        yylog("  key: %s", key.c_str());
+        YAMLString key(yylval.sym->lexeme.data(), yylval.sym->lexeme.size(), getResource()); // save before match advances lookahead
+        YYLOG("  key: %s", key.c_str());
         match(TV_KEY);
 
-        auto val = std::make_unique<YAMLValue>();
+        auto val = makeResource<YAMLValue>(getResource(), getResource());
         DoBlockValue(*val);
-        node.mapping.emplace_back(key, std::move(val));
+        node.mapping.emplace_back(std::move(key), std::move(val));
     }
 }
 
@@ -94,13 +101,15 @@ void YAMLParser::DoBlockMapping(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoBlockSequence(YAMLValue &node)
 {
-    yylog("DoBlockSequence");
+    PARSE_RULE("YAMLParser::DoBlockSequence");
+
+    YYLOG("DoBlockSequence");
 
     while (lookahead == TV_DASH)
     {
         match(TV_DASH);
 
-        auto val = std::make_unique<YAMLValue>();
+        auto val = makeResource<YAMLValue>(getResource(), getResource());
         DoBlockValue(*val);
         node.sequence.push_back(std::move(val));
     }
@@ -116,7 +125,10 @@ void YAMLParser::DoBlockSequence(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoBlockValue(YAMLValue &node)
 {
-    yylog("DoBlockValue");
+    PARSE_RULE("YAMLParser::DoBlockValue");
+    NestingScope nesting(this);
+
+    YYLOG("DoBlockValue");
 
     if (lookahead == TV_NEWLINE)
     {
@@ -154,7 +166,9 @@ void YAMLParser::DoBlockValue(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoFlowMapping(YAMLValue &node)
 {
-    yylog("DoFlowMapping");
+    PARSE_RULE("YAMLParser::DoFlowMapping");
+
+    YYLOG("DoFlowMapping");
 
     match('{');
 
@@ -162,10 +176,15 @@ void YAMLParser::DoFlowMapping(YAMLValue &node)
     {
         // Flow mapping keys are SCALAR or STRING (the lexer does not emit
         // KEY inside flow context)
-        std::string key;
-        if (lookahead == TV_SCALAR || lookahead == TV_STRING)
+        YAMLString key(getResource());
+        if (lookahead == TV_SCALAR)
+        {
+            key.assign(yylval.sym->lexeme.data(), yylval.sym->lexeme.size());
+            match(lookahead);
+        }
+        else if (lookahead == TV_STRING)
         {
-            key = yylval.sym->lexeme;
+            key.assign(yylval.lit.text, yylval.lit.length);
             match(lookahead);
         }
         else
@@ -176,9 +195,9 @@ void YAMLParser::DoFlowMapping(YAMLValue &node)
 
         match(':');
 
-        auto val = std::make_unique<YAMLValue>();
+        auto val = makeResource<YAMLValue>(getResource(), getResource());
         DoFlowValue(*val);
-        node.mapping.emplace_back(key, std::move(val));
+        node.mapping.emplace_back(std::move(key), std::move(val));
 
         if (lookahead == ',')
             match(',');
@@ -192,13 +211,15 @@ void YAMLParser::DoFlowMapping(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoFlowSequence(YAMLValue &node)
 {
-    yylog("DoFlowSequence");
+    PARSE_RULE("YAMLParser::DoFlowSequence");
+
+    YYLOG("DoFlowSequence");
 
     match('[');
 
     while (lookahead != ']' && lookahead != TV_DONE)
     {
-        auto val = std::make_unique<YAMLValue>();
+        auto val = makeResource<YAMLValue>(getResource(), getResource());
         DoFlowValue(*val);
         node.sequence.push_back(std::move(val));
 
@@ -214,14 +235,21 @@ void YAMLParser::DoFlowSequence(YAMLValue &node)
 // -------------------------------------------------------------------------
 void YAMLParser::DoFlowValue(YAMLValue &node)
 {
-    yylog("DoFlowValue (lookahead=%d)", lookahead);
+    PARSE_RULE("YAMLParser::DoFlowValue");
+    NestingScope nesting(this);
+
+    YYLOG("DoFlowValue (lookahead=%d)", lookahead);
 
     switch (lookahead)
     {
     case TV_STRING:
+        node = YAMLValue::makeString(yylval.lit.text, yylval.lit.length, getResource());
+        match(TV_STRING);
+        break;
+
     case TV_SCALAR:
-        node = YAMLValue::makeString(yylval.sym->lexeme);
-        match(lookahead);
+        node = YAMLValue::makeString(yylval.sym->lexeme, getResource());
+        match(TV_SCALAR);
         break;
 
     case TV_YAML_INT:
@@ -18,7 +18,7 @@
 class YAMLParser : public BaseParser
 {
 public:
-    YAMLParser();
+    explicit YAMLParser(MemoryResource *pResource = nullptr);
     virtual ~YAMLParser() = default;
 
     int yyparse() override;
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "../../memoryresource.h"
 
 // -------------------------------------------------------------------------
 // YAMLType — discriminator for the value variant
@@ -18,12 +19,21 @@ enum class YAMLType
     Mapping
 };
 
+struct YAMLValue;
+
+using YAMLString = std::basic_string<char, std::char_traits<char>, ResourceAllocator<char>>;
+using YAMLPtr    = ResourcePtr<YAMLValue>;
+using YAMLPair   = std::pair<YAMLString, YAMLPtr>;
+
 // -------------------------------------------------------------------------
 // YAMLValue — a single YAML node
 //
 // Use the factory helpers or set 'type' and the matching field directly.
-// Sequence and Mapping store their children as owned unique_ptr<YAMLValue>.
-// Mapping preserves insertion order (std::vector of pairs).
+// Sequence and Mapping store their children as owned YAMLPtr, created with
+// makeResource<YAMLValue>(). Mapping preserves insertion order (std::vector
+// of pairs). Strings, containers and children all come from the node's
+// MemoryResource, so under a monotonic arena a whole tree is dropped
+// without visiting it.
 // -------------------------------------------------------------------------
 struct YAMLValue
 {
@@ -33,14 +43,15 @@ struct YAMLValue
     bool        b = false;
     int         i = 0;
     float       f = 0.0f;
-    std::string s;
+    YAMLString  s;
 
     // Collection payloads
-    std::vector<std::unique_ptr<YAMLValue>>                          sequence;
-    std::vector<std::pair<std::string, std::unique_ptr<YAMLValue>>>  mapping;
+    std::vector<YAMLPtr, ResourceAllocator<YAMLPtr>>    sequence;
+    std::vector<YAMLPair, ResourceAllocator<YAMLPair>>  mapping;
 
     // Non-copyable (owns children)
     YAMLValue() = default;
+    explicit YAMLValue(MemoryResource *pResource) : s(pResource), sequence(pResource), mapping(pResource) {}
     YAMLValue(YAMLValue &&) = default;
     YAMLValue &operator=(YAMLValue &&) = default;
     YAMLValue(const YAMLValue &) = delete;
@@ -51,7 +62,10 @@ struct YAMLValue
     static YAMLValue makeBool(bool b)         { YAMLValue v; v.type = YAMLType::Bool;     v.b = b; return v; }
     static YAMLValue makeInt(int i)           { YAMLValue v; v.type = YAMLType::Int;      v.i = i; return v; }
     static YAMLValue makeFloat(float f)       { YAMLValue v; v.type = YAMLType::Float;    v.f = f; return v; }
-    static YAMLValue makeString(std::string s){ YAMLValue v; v.type = YAMLType::String;   v.s = std::move(s); return v; }
+    static YAMLValue makeString(const char *text, size_t length, MemoryResource *pResource = nullptr)
+                                              { YAMLValue v(pResource); v.type = YAMLType::String; v.s.assign(text, length); return v; }
+    static YAMLValue makeString(const std::string &s, MemoryResource *pResource = nullptr)
+                                              { return makeString(s.data(), s.size(), pResource); }
 
     // Debug output
     void dump(int indent = 0) const;
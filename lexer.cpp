@@ -2,6 +2,14 @@
 
 #include "baseparser.h"
 
+#ifdef _WIN32
+#	include <stdlib.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
 //
 static const char *_internalTokenLexemes[] = 
 {
@@ -20,6 +28,8 @@ static_assert(ARRAY_SIZE(_internalTokenLexemes) == (TV_USER - TV_ERROR), "lexeme
 //
 //======================================================================
 LexicalAnalyzer::LexicalAnalyzer(TokenTable *aTokenTable, BaseParser *pParser, YYSTYPE *pyylval)
+	: m_fdStack(pParser->getResource())
+	, m_tokenTable(ltstr(), pParser->getResource())
 {
 	assert(aTokenTable);
 	assert(pParser);
@@ -29,6 +39,11 @@ LexicalAnalyzer::LexicalAnalyzer(TokenTable *aTokenTable, BaseParser *pParser, Y
 	m_yylval = pyylval;
 
 	m_iTotalLinesParsed = 0;
+	m_bytesRead = 0;
+	m_bytesClosed = 0;
+
+	m_pCapture = nullptr;
+	m_tokenStart = 0;
 
 	// add tokens to table
 	for (; aTokenTable->lexeme; aTokenTable++)
@@ -63,12 +78,37 @@ int LexicalAnalyzer::getChar()
 	// if parsing files get next file char
 	if (m_fdStack.back().fdDocument)
 	{
-		return fgetc(m_fdStack.back().fdDocument);
+		int c = fgetc(m_fdStack.back().fdDocument);
+		PARSE_PROFILE(if (c != EOF) m_bytesRead++);
+		if (m_pCapture && c != EOF)
+			m_pCapture->push_back((char)c);
+		return c;
 	}
 
 	// otherwise return data from memory ptr
-	int c = *m_fdStack.back().pTextData;
-	m_fdStack.back().pTextData++;
+	FDNode &node = m_fdStack.back();
+	int c = *node.pTextData;
+
+	// the end of a chunk, a source that runs dry is the end of the input
+	while (!c && node.pSource)
+	{
+		char *pNext = node.pSource->refill();
+		if (!pNext)
+		{
+			node.pSource = nullptr;
+			break;
+		}
+
+		node.chunkOffset += node.pTextData - node.pChunk;
+		node.pChunk = pNext;
+		node.pTextData = pNext;
+		c = *node.pTextData;
+	}
+
+	node.pTextData++;
+	PARSE_PROFILE(if (c) m_bytesRead++);
+	if (m_pCapture && c)
+		m_pCapture->push_back((char)c);
 	
 	return c;
 }
@@ -82,10 +122,18 @@ int LexicalAnalyzer::ungetChar(int c)
 
 	// if parsing files put back file char
 	if (m_fdStack.back().fdDocument)
+	{
+		PARSE_PROFILE(if (c != EOF) m_bytesRead--);
+		if (m_pCapture && c != EOF && !m_pCapture->empty())
+			m_pCapture->pop_back();
 		return ungetc(c, m_fdStack.back().fdDocument);
+	}
 
 	// otherwise put back data to memory ptr
 	m_fdStack.back().pTextData--;
+	PARSE_PROFILE(if (*m_fdStack.back().pTextData) m_bytesRead--);
+	if (m_pCapture && *m_fdStack.back().pTextData && !m_pCapture->empty())
+		m_pCapture->pop_back();
 	return 0;
 }
 
@@ -94,6 +142,14 @@ int LexicalAnalyzer::ungetChar(int c)
 //
 void LexicalAnalyzer::yyerror(const char *s)
 {
+	// our own errors (e.g. a missing quote) go to the parser's sink too;
+	// messages from the parser only come here when it has none
+	if (m_pParser->getDiagnosticSink())
+	{
+		m_pParser->report(Severity::Error, 0, "%s", s);
+		return;
+	}
+
 	puts(s);
 	fflush(stdout);
 	exit(-1);
@@ -104,6 +160,12 @@ void LexicalAnalyzer::yyerror(const char *s)
 //
 void LexicalAnalyzer::yywarning(const char *s)
 {
+	if (m_pParser->getDiagnosticSink())
+	{
+		m_pParser->report(Severity::Warning, 0, "%s", s);
+		return;
+	}
+
 	puts(s);
 	fflush(stdout);
 }
@@ -146,11 +208,246 @@ const char *LexicalAnalyzer::getLexemeFromToken(int token)
 	return "(unknown token)";
 }
 
+//======================================================================
+//
+//======================================================================
+LexicalAnalyzer::~LexicalAnalyzer()
+{
+#ifndef _WIN32
+	for (auto iter = m_includePaths.begin(); iter != m_includePaths.end(); iter++)
+		close(*iter);
+#endif
+}
+
+//======================================================================
+//
+//======================================================================
+LexicalAnalyzer::FDNode::~FDNode()
+{
+	if (fdDocument)
+		fclose(fdDocument);
+
+#ifndef _WIN32
+	if (dirFd >= 0)
+		close(dirFd);
+#endif
+}
+
+//======================================================================
+// Add a directory to search for files that aren't found relative to the
+// file including them. Searched in the order added.
+//======================================================================
+int LexicalAnalyzer::addIncludePath(const char *path)
+{
+	assert(path);
+
+#ifdef _WIN32
+	char szFullPath[_MAX_PATH];
+	if (!_fullpath(szFullPath, path, sizeof(szFullPath)))
+		return -1;
+
+	std::string dir = szFullPath;
+	if (!dir.empty() && dir.back() != '\\' && dir.back() != '/')
+		dir += '\\';
+
+	m_includePaths.push_back(dir);
+#else
+	int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	m_includePaths.push_back(fd);
+#endif
+
+	return 0;
+}
+
+#ifndef _WIN32
+//======================================================================
+// Open path relative to the directory handle dirFd, also returning a
+// handle on the directory the file lives in
+//======================================================================
+static FILE *openAt(int dirFd, const char *path, int &fileDirFd)
+{
+	int fd = openat(dirFd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode))
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	FILE *pFile = fdopen(fd, "r");
+	if (!pFile)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	const char *slash = strrchr(path, '/');
+	std::string dir = slash ? std::string(path, slash == path ? 1 : slash - path) : std::string(".");
+	fileDirFd = openat(dirFd, dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	return pFile;
+}
+#endif
+
+//======================================================================
+// Open theFile into node. Relative names are tried next to the file
+// doing the including (or the current directory for the first file),
+// then in each include path. Directories are held as handles, or as
+// absolute paths on Windows, and the process working directory is never
+// changed, so parsers on different threads can't disturb each other.
+//======================================================================
+int LexicalAnalyzer::openFile(const char *theFile, FDNode &node)
+{
+#ifdef _WIN32
+	bool absolute = theFile[0] == '/' || theFile[0] == '\\' || (theFile[0] && theFile[1] == ':');
+
+	std::vector<std::string> dirs;
+	dirs.push_back((absolute || m_fdStack.empty()) ? std::string() : m_fdStack.back().directory);
+	if (!absolute)
+		dirs.insert(dirs.end(), m_includePaths.begin(), m_includePaths.end());
+
+	for (auto iter = dirs.begin(); iter != dirs.end(); iter++)
+	{
+		std::string path = *iter + theFile;
+
+		FILE *pFile = fopen(path.c_str(), "rt");
+		if (!pFile)
+			continue;
+
+		char szFullPath[_MAX_PATH], drive[_MAX_DRIVE], dir[_MAX_DIR];
+		_fullpath(szFullPath, path.c_str(), sizeof(szFullPath));
+		_splitpath_s(szFullPath, drive, sizeof(drive), dir, sizeof(dir), nullptr, 0, nullptr, 0);
+
+		node.fdDocument = pFile;
+		node.directory = std::string(drive) + dir;
+		return 0;
+	}
+#else
+	if (theFile[0] == '/')
+	{
+		node.fdDocument = openAt(AT_FDCWD, theFile, node.dirFd);
+		return node.fdDocument ? 0 : -1;
+	}
+
+	int dirFd = (m_fdStack.empty() || m_fdStack.back().dirFd < 0) ? AT_FDCWD : m_fdStack.back().dirFd;
+	node.fdDocument = openAt(dirFd, theFile, node.dirFd);
+
+	for (auto iter = m_includePaths.begin(); !node.fdDocument && iter != m_includePaths.end(); iter++)
+		node.fdDocument = openAt(*iter, theFile, node.dirFd);
+
+	if (node.fdDocument)
+		return 0;
+#endif
+
+	return -1;
+}
+
+//======================================================================
+//
+//======================================================================
+void LexicalAnalyzer::saveState(Checkpoint &cp)
+{
+	cp.depth		= m_fdStack.size();
+	cp.fdDocument	= nullptr;
+	cp.pTextData	= nullptr;
+	cp.pSource		= nullptr;
+	cp.filePos		= -1;
+	cp.column		= getColumn();
+	cp.yylineno		= getLineNumber();
+	cp.totalLines	= m_iTotalLinesParsed;
+	cp.bytesRead	= m_bytesRead;
+	cp.captured		= getCaptured();
+
+	if (m_fdStack.empty())
+		return;
+
+	cp.fdDocument = m_fdStack.back().fdDocument;
+	if (cp.fdDocument)
+		cp.filePos = ftell(cp.fdDocument);
+	else
+	{
+		cp.pTextData	= m_fdStack.back().pTextData;
+		cp.pSource		= m_fdStack.back().pSource;
+	}
+}
+
+//======================================================================
+// Only into the file that was on top when the checkpoint was taken; a
+// different file at the same depth means it was popped and replaced
+//======================================================================
+bool LexicalAnalyzer::restoreState(const Checkpoint &cp)
+{
+	if (cp.depth != m_fdStack.size())
+		return false;
+
+	if (!m_fdStack.empty())
+	{
+		FDNode &node = m_fdStack.back();
+		if (node.fdDocument != cp.fdDocument)
+			return false;
+
+		// an earlier chunk may be gone
+		if (cp.pSource)
+			return false;
+
+		if (node.fdDocument)
+		{
+			if (cp.filePos < 0 || fseek(node.fdDocument, cp.filePos, SEEK_SET) != 0)
+				return false;
+		}
+		else
+		{
+			node.pTextData = cp.pTextData;
+		}
+
+		node.column		= cp.column;
+		node.yylineno	= cp.yylineno;
+	}
+
+	m_iTotalLinesParsed	= cp.totalLines;
+	m_bytesRead			= cp.bytesRead;
+
+	if (m_pCapture && cp.captured < m_pCapture->size())
+		m_pCapture->resize(cp.captured);
+
+	return true;
+}
+
+//======================================================================
+//
+//======================================================================
+std::unique_ptr<LexicalAnalyzer::Checkpoint> LexicalAnalyzer::checkpoint()
+{
+	std::unique_ptr<Checkpoint> cp(new Checkpoint());
+	saveState(*cp);
+
+	return cp;
+}
+
+//======================================================================
+//
+//======================================================================
+bool LexicalAnalyzer::restore(const Checkpoint &cp)
+{
+	return restoreState(cp);
+}
+
 //======================================================================
 //
 //======================================================================
 int LexicalAnalyzer::popFile()
 {
+	if (m_fdStack.empty())
+		return EOF;
+
+	m_bytesClosed += getOffset(m_fdStack.back());
+
 	// if we were processing a file, close it
 	if (m_fdStack.back().fdDocument)
 	{
@@ -179,6 +476,58 @@ int LexicalAnalyzer::popFile()
 	return 0;
 }
 
+//======================================================================
+// Drop every open file and buffer, e.g. after a parse was abandoned
+// part way through an include
+//======================================================================
+void LexicalAnalyzer::closeAll()
+{
+	while (!m_fdStack.empty())
+		popFile();
+}
+
+//
+void LexicalAnalyzer::reset()
+{
+	closeAll();
+
+	m_iTotalLinesParsed	= 0;
+	m_bytesRead			= 0;
+	m_bytesClosed		= 0;
+}
+
+//
+// how far into one input the lexer is
+//
+uint64_t LexicalAnalyzer::getOffset(const FDNode &node) const
+{
+	if (node.fdDocument)
+	{
+		long pos = ftell(node.fdDocument);
+		return pos > 0 ? (uint64_t)pos : 0;
+	}
+
+	if (!node.pTextData || !node.pChunk)
+		return node.chunkOffset;
+
+	// the terminating NUL has been read once the end is reached
+	uint64_t used = node.pTextData - node.pChunk;
+	if (used && !node.pTextData[-1])
+		used--;
+
+	return node.chunkOffset + used;
+}
+
+//
+uint64_t LexicalAnalyzer::getBytesConsumed() const
+{
+	uint64_t total = m_bytesClosed;
+	for (auto iter = m_fdStack.begin(); iter != m_fdStack.end(); iter++)
+		total += getOffset(*iter);
+
+	return total;
+}
+
 // this is a no-op  meant to be overridden in derived classes
 void LexicalAnalyzer::freeData(void *pUserData)
 {
@@ -194,21 +543,16 @@ int LexicalAnalyzer::pushFile(const char *theFile)
 {
 	assert(theFile);
 
-	m_fdStack.push_back(FDNode());
-
-	assert(m_fdStack.back().fdDocument == nullptr);
-
-	FILE *pFile = fopen(theFile, "rt");
-	if (nullptr == pFile)
+	// only push once the file is open, so a failed include leaves the
+	// current file in place
+	FDNode node;
+	if (openFile(theFile, node) != 0)
 		return -1;
 
-	m_fdStack.back().fdDocument = pFile;
+	node.filename = theFile;
+	node.yylineno = 1;
 
-	if (!m_fdStack.back().fdDocument)
-		return -1;
-
-	m_fdStack.back().filename = theFile;
-	m_fdStack.back().yylineno = 1;
+	m_fdStack.push_back(std::move(node));
 
 	return 0;
 }
@@ -216,7 +560,7 @@ int LexicalAnalyzer::pushFile(const char *theFile)
 //======================================================================
 //
 //======================================================================
-int LexicalAnalyzer::setData(char *theData, const char *fileName, void *pUserData)
+int LexicalAnalyzer::setData(char *theData, const char *fileName, void *pUserData, InputSource *pSource)
 {
 	assert(theData);
 
@@ -230,6 +574,8 @@ int LexicalAnalyzer::setData(char *theData, const char *fileName, void *pUserDat
 
 	// hold onto this for later
 	m_fdStack.back().pUserData	= pUserData;
+	m_fdStack.back().pSource	= pSource;
+	m_fdStack.back().pChunk		= theData;
 	m_fdStack.back().filename	= fileName;
 	m_fdStack.back().yylineno	= 1;
 
@@ -485,13 +831,27 @@ int LexicalAnalyzer::getStringLiteral()
 	int c;
 	char buf[DEFAULT_TEXT_BUF];
 	char *cptr = buf;
+	LiteralPool *pPool = m_pParser->getLiteralPool();
+
+	// in-memory input can be viewed in place if nothing needs translating,
+	// unless it comes in chunks that won't stay around
+	const FDNode &node = m_fdStack.back();
+	const char *pStart = node.fdDocument || node.pSource ? nullptr : node.pTextData;
+	bool escaped = false;
 
 	c = getChar();
 
 	while (c != '"' && cptr < &buf[sizeof(buf)])
 	{
+		// a non-exiting yyerror() returns here, take what we have
 		if (c == '\n' || c == EOF)
+		{
 			yyerror("missing quote");
+			break;
+		}
+
+		if (c == '\\')
+			escaped = true;
 
 		// build up our string, translating escape chars
 		*cptr++ = backslash(c);
@@ -501,6 +861,22 @@ int LexicalAnalyzer::getStringLiteral()
 	// make sure its asciiz
 	*cptr = '\0';
 
+	// literals go to the pool, if there is one, rather than the symbol table
+	if (pPool)
+	{
+		if (pPool->getPolicy() == LiteralPool::Policy::View && pStart && !escaped)
+		{
+			m_yylval->lit.text = pStart;
+			m_yylval->lit.length = (unsigned)(cptr - buf);
+		}
+		else
+		{
+			m_yylval->lit = pPool->add(buf, cptr - buf);
+		}
+
+		return TV_STRING;
+	}
+
 	sym = m_pParser->lookupSymbol(buf);
 	if (!sym)
 	{
@@ -595,6 +971,8 @@ yylex01:
 		goto yylex01;
 	}
 
+	markToken(chr);
+
 	// look for a number value
 	if (isdigit(chr) || chr == '-' || chr == '+')
 	{
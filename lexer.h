@@ -12,10 +12,28 @@
 #ifndef _WIN32
 #  include <strings.h>   // strcasecmp on Linux/macOS
 #endif
+#include "literalpool.h"
+#include "memoryresource.h"
+#include "profiler.h"
 
 struct SymbolEntry;
 class BaseParser;
 
+//======================================================================
+// Supplies in-memory input a piece at a time, see setData(). refill()
+// returns the next NUL terminated chunk once the lexer has read up to
+// the end of the last one, or nullptr at the end of the input. The
+// character before the chunk must be readable and hold the previous
+// chunk's last one, so that it can be put back. A chunk stays valid
+// until the next call, the last one until the input is closed.
+//======================================================================
+class InputSource
+{
+public:
+	virtual ~InputSource() = default;
+	virtual char *refill() = 0;
+};
+
 //======================================================================
 //
 //======================================================================
@@ -58,29 +76,63 @@ union YYSTYPE
 
 	SymbolEntry *sym;	// ID value
 	TokenTable *ptt;	// keyword
+
+	LiteralString lit;	// string literal, when the parser has a LiteralPool
 };
 
 //
 class LexicalAnalyzer
 {
+public:
+	// Where the lexer is in its input, see checkpoint(). A lexer with state
+	// of its own derives from this and overrides checkpoint()/restore().
+	struct Checkpoint
+	{
+		size_t depth;			// files open, the top one is the one read
+		FILE *fdDocument;
+		char *pTextData;
+		InputSource *pSource;
+		long filePos;
+		int column;
+		int yylineno;
+		int totalLines;
+		uint64_t bytesRead;
+		size_t captured;
+
+		virtual ~Checkpoint() = default;
+	};
+
 protected:
 	// File descriptor node
 	struct FDNode
 	{
 		FILE *fdDocument;
 		char *pTextData;
+		InputSource *pSource;		// more of pTextData to come
+		char *pChunk;				// where pTextData's chunk starts
+		uint64_t chunkOffset;		// bytes in the chunks before it
 		std::string filename;
 		int column;
 		int yylineno;
 		void *pUserData;
 
-		FDNode() : fdDocument(nullptr), pTextData(nullptr), filename(""), column(0), yylineno(1), pUserData(nullptr) {}
+		// where this file's own includes are resolved from
+#ifdef _WIN32
+		std::string directory;
+#else
+		int dirFd = -1;
+#endif
+
+		FDNode() : fdDocument(nullptr), pTextData(nullptr), pSource(nullptr), pChunk(nullptr), chunkOffset(0), filename(""), column(0), yylineno(1), pUserData(nullptr) {}
 
 		// move ctor
 		FDNode(FDNode &&rhs)
 		{
 			fdDocument = rhs.fdDocument;
 			pTextData = rhs.pTextData;
+			pSource = rhs.pSource;
+			pChunk = rhs.pChunk;
+			chunkOffset = rhs.chunkOffset;
 			filename = rhs.filename;
 			column = rhs.column;
 			yylineno = rhs.yylineno;
@@ -88,21 +140,34 @@ protected:
 			
 			// take ownership of the file ptr
 			rhs.fdDocument = nullptr;
-		}
 
-		virtual ~FDNode() 
-		{
-			if (fdDocument)
-				fclose(fdDocument);
+#ifdef _WIN32
+			directory = std::move(rhs.directory);
+#else
+			dirFd = rhs.dirFd;
+			rhs.dirFd = -1;
+#endif
 		}
+
+		virtual ~FDNode();
 	};
 
 	int m_iTotalLinesParsed;
+
+	// characters read, only counted when built with PARSERKIT_PROFILE
+	uint64_t m_bytesRead;
+
+	// consumed from inputs already closed, see getBytesConsumed()
+	uint64_t m_bytesClosed;
+
+	// every character read goes here too, see setCapture()
+	std::string *m_pCapture;
+	size_t m_tokenStart;
 	
 	//char m_szCurrentSourceLineText[256];
 	//int m_iCurrentSourceLineIndex;
 
-	using FDStack = std::vector<FDNode>;
+	using FDStack = std::vector<FDNode, ResourceAllocator<FDNode>>;
 	FDStack m_fdStack;
 
 	BaseParser *m_pParser;
@@ -129,9 +194,19 @@ protected:
 		}
 	};
 
-	using TokenTableMap = std::map<std::string, int, ltstr>;
+	using TokenTableMap = std::map<std::string, int, ltstr, ResourceAllocator<std::pair<const std::string, int>>>;
 	TokenTableMap m_tokenTable;
 
+	// directories searched for files not found next to the includer
+#ifdef _WIN32
+	std::vector<std::string> m_includePaths;
+#else
+	std::vector<int> m_includePaths;
+#endif
+
+	int openFile(const char *theFile, FDNode &node);
+	uint64_t getOffset(const FDNode &node) const;
+
 	// methods to help with lexical processing
 	// yylex() will use these to find tokens
 	int skipLeadingWhiteSpace();
@@ -150,27 +225,68 @@ protected:
 	int getChar();
 	int ungetChar(int c);
 
+	// the character just read starts the token, for a lexer's own yylex()
+	void markToken(int c)
+	{
+		if (m_pCapture)
+			m_tokenStart = m_pCapture->size() - (c == EOF || !c ? 0 : 1);
+	}
+
+	// fill in / rewind the base lexer's part of a checkpoint
+	void saveState(Checkpoint &cp);
+	bool restoreState(const Checkpoint &cp);
+
 public:
 	LexicalAnalyzer(TokenTable *atokenTable, BaseParser *pParser, YYSTYPE *pyylval);
-	virtual ~LexicalAnalyzer() = default;
+	virtual ~LexicalAnalyzer();
 
 	//const char *GetCurrentSourceText() { return m_szCurrentSourceLineText; }
 	//void ClearCurrentSourceText()		{ m_szCurrentSourceLineText[0] = 0; }
 
 	int pushFile(const char *theFile);
 	int popFile();
-	std::string getFile() const { return m_fdStack.back().filename; }
+	void closeAll();
+
+	// close everything and clear the counts for a new input, keeping the
+	// keyword table and options; lexers with state of their own extend it
+	virtual void reset();
 
-	int setData(char *theData, const char *fileName, void* pUserData);
+	int addIncludePath(const char *path);
+	std::string getFile() const { return m_fdStack.empty() ? std::string() : m_fdStack.back().filename; }
+	const char *getFileName() const	{ return m_fdStack.empty() ? "" : m_fdStack.back().filename.c_str(); }
+
+	// with a source, theData is only the first chunk of the input
+	int setData(char *theData, const char *fileName, void* pUserData, InputSource *pSource = nullptr);
 	virtual void freeData(void* pUserData);
 
 	const char *getLexemeFromToken(int token);
 
+	// Rewind to an earlier point in the current file or buffer. restore()
+	// fails if that file has been closed since or the stream can't seek,
+	// e.g. a pipe, or the buffer came from an InputSource. Symbols installed in between are not taken back.
+	virtual std::unique_ptr<Checkpoint> checkpoint();
+	virtual bool restore(const Checkpoint &cp);
+
 	void caseSensitive(bool onoff = true);
 
-	int getColumn()					{ return m_fdStack.back().column; }
-	int getLineNumber()				{ return m_fdStack.back().yylineno; }
+	// with nothing open these report the defaults of a fresh file
+	int getColumn()					{ return m_fdStack.empty() ? 0 : m_fdStack.back().column; }
+	int getLineNumber()				{ return m_fdStack.empty() ? 1 : m_fdStack.back().yylineno; }
 	int getTotalLinesParsed()		{ return m_iTotalLinesParsed; }
+	uint64_t getBytesRead() const	{ return m_bytesRead; }
+
+	// bytes consumed over every input so far, in any build; asks the
+	// stream for its position, so not for every character
+	uint64_t getBytesConsumed() const;
+
+	// Append the text read to pText, which must outlive the capture, and
+	// give the last token's place in it. Characters put back are taken
+	// off again, so it always ends with the last token; a token starts at
+	// its markToken(), or right after the one before for lexers without.
+	void setCapture(std::string *pText)		{ m_pCapture = pText; m_tokenStart = pText ? pText->size() : 0; }
+	std::string *getCapture() const			{ return m_pCapture; }
+	size_t getTokenStart() const			{ return m_tokenStart; }
+	size_t getCaptured() const				{ return m_pCapture ? m_pCapture->size() : 0; }
 
 	void setUnixComments(bool onoff)	{ m_bUnixComments = onoff; }
 	void setCPPComments(bool onoff)		{ m_bCPPComments = onoff; }
@@ -0,0 +1,191 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "literalpool.h"
+
+//======================================================================
+//
+//======================================================================
+LiteralPool::LiteralPool(Policy policy, size_t blockSize, MemoryResource *pResource)
+	: m_pResource(pResource ? pResource : getDefaultResource())
+	, m_blocks(m_pResource)
+	, m_table(m_pResource)
+	, m_scratch(m_pResource)
+{
+	assert(blockSize > 0);
+
+	m_policy	= policy;
+	m_blockSize	= blockSize;
+	m_pNext		= nullptr;
+	m_remaining	= 0;
+	m_count		= 0;
+	m_bytesUsed	= 0;
+}
+
+//======================================================================
+//
+//======================================================================
+LiteralPool::~LiteralPool()
+{
+	freeBlocks(0);
+}
+
+//======================================================================
+// Give all but the first keep blocks back to the resource
+//======================================================================
+void LiteralPool::freeBlocks(size_t keep)
+{
+	while (m_blocks.size() > keep)
+	{
+		m_pResource->deallocate(m_blocks.back().pData, m_blocks.back().size, 1);
+		m_blocks.pop_back();
+	}
+}
+
+//======================================================================
+// Carve bytes out of the current block, starting a new one if needed.
+// Oversized requests get a block of their own.
+//======================================================================
+char *LiteralPool::allocate(size_t bytes)
+{
+	if (bytes > m_remaining)
+	{
+		size_t size = (bytes > m_blockSize) ? bytes : m_blockSize;
+
+		Block block;
+		block.pData	= (char*)m_pResource->allocate(size, 1);
+		block.size	= size;
+		m_blocks.push_back(block);
+
+		m_pNext		= block.pData;
+		m_remaining	= size;
+	}
+
+	char *p = m_pNext;
+	m_pNext		+= bytes;
+	m_remaining	-= bytes;
+
+	return p;
+}
+
+//======================================================================
+//
+//======================================================================
+LiteralString LiteralPool::store(const char *text, size_t length)
+{
+	char *p = allocate(length + 1);
+
+	memcpy(p, text, length);
+	p[length] = 0;
+
+	m_bytesUsed += length + 1;
+
+	LiteralString lit;
+	lit.text	= p;
+	lit.length	= (unsigned)length;
+
+	return lit;
+}
+
+//======================================================================
+// FNV-1a
+//======================================================================
+size_t LiteralPool::hash(const char *text, size_t length)
+{
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		h ^= (unsigned char)text[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+//======================================================================
+// Double the intern table and rehash everything in it
+//======================================================================
+void LiteralPool::grow()
+{
+	std::vector<LiteralString, ResourceAllocator<LiteralString>> old(m_pResource);
+	old.swap(m_table);
+
+	LiteralString empty = { nullptr, 0 };
+	m_table.assign(old.empty() ? 64 : old.size() * 2, empty);
+
+	size_t mask = m_table.size() - 1;
+	for (auto iter = old.begin(); iter != old.end(); iter++)
+	{
+		if (!iter->text)
+			continue;
+
+		size_t slot = hash(iter->text, iter->length) & mask;
+		while (m_table[slot].text)
+			slot = (slot + 1) & mask;
+
+		m_table[slot] = *iter;
+	}
+}
+
+//======================================================================
+// Add a literal according to our policy
+//======================================================================
+LiteralString LiteralPool::add(const char *text, size_t length)
+{
+	assert(text);
+
+	if (m_policy == Policy::View)
+	{
+		m_scratch.assign(text, text + length);
+		m_scratch.push_back(0);
+
+		LiteralString lit;
+		lit.text	= m_scratch.data();
+		lit.length	= (unsigned)length;
+		return lit;
+	}
+
+	if (m_policy == Policy::Append)
+	{
+		m_count++;
+		return store(text, length);
+	}
+
+	// keep the intern table at most half full
+	if ((m_count + 1) * 2 > m_table.size())
+		grow();
+
+	size_t mask = m_table.size() - 1;
+	size_t slot = hash(text, length) & mask;
+
+	for (; m_table[slot].text; slot = (slot + 1) & mask)
+	{
+		if (m_table[slot].length == length && !memcmp(m_table[slot].text, text, length))
+			return m_table[slot];
+	}
+
+	m_table[slot] = store(text, length);
+	m_count++;
+
+	return m_table[slot];
+}
+
+//======================================================================
+// Forget every literal, keeping the first block and the intern table's
+// capacity for reuse
+//======================================================================
+void LiteralPool::clear()
+{
+	freeBlocks(1);
+
+	m_pNext		= m_blocks.empty() ? nullptr : m_blocks.front().pData;
+	m_remaining	= m_blocks.empty() ? 0 : m_blocks.front().size;
+	m_count		= 0;
+	m_bytesUsed	= 0;
+
+	LiteralString empty = { nullptr, 0 };
+	m_table.assign(m_table.size(), empty);
+}
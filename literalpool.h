@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef __LITERALPOOL_H
+#define __LITERALPOOL_H
+
+#include <stddef.h>
+#include <vector>
+#include <memory>
+#include "memoryresource.h"
+
+#define DEFAULT_LITERAL_BLOCK	4096
+
+//======================================================================
+// A string literal handed back by the lexer. The text is NUL terminated
+// unless it is a view straight into the input, so always use length.
+//======================================================================
+struct LiteralString
+{
+	const char	*text;
+	unsigned	length;
+};
+
+//======================================================================
+// Storage for string literals, kept apart from the identifier symbol
+// table so that data-heavy inputs don't bloat it or slow its lookups.
+//
+//	Intern	- store each distinct literal once, equal literals share text
+//	Append	- copy every literal into the arena, no dedupe
+//	View	- store nothing, literals are only valid until the next one
+//			  (the lexer points straight into in-memory input when it can)
+//======================================================================
+class LiteralPool
+{
+public:
+	enum class Policy
+	{
+		Intern,
+		Append,
+		View
+	};
+
+protected:
+	Policy m_policy;
+	MemoryResource *m_pResource;
+
+	struct Block
+	{
+		char *pData;
+		size_t size;
+	};
+
+	// arena of fixed size blocks, literals never move once stored
+	std::vector<Block, ResourceAllocator<Block>> m_blocks;
+	size_t m_blockSize;
+	char *m_pNext;
+	size_t m_remaining;
+
+	// open addressed intern table, capacity is always a power of two
+	std::vector<LiteralString, ResourceAllocator<LiteralString>> m_table;
+	size_t m_count;
+	size_t m_bytesUsed;
+
+	// reusable buffer for the View policy
+	std::vector<char, ResourceAllocator<char>> m_scratch;
+
+	char *allocate(size_t bytes);
+	LiteralString store(const char *text, size_t length);
+	void grow();
+	void freeBlocks(size_t keep);
+
+	static size_t hash(const char *text, size_t length);
+
+public:
+	explicit LiteralPool(Policy policy = Policy::Intern, size_t blockSize = DEFAULT_LITERAL_BLOCK, MemoryResource *pResource = nullptr);
+	virtual ~LiteralPool();
+
+	// not copyable, handed out literals point into our blocks
+	LiteralPool(const LiteralPool&) = delete;
+	LiteralPool &operator=(const LiteralPool&) = delete;
+
+	Policy getPolicy() const			{ return m_policy; }
+	size_t getCount() const				{ return m_count; }
+	size_t getBytesUsed() const			{ return m_bytesUsed; }
+
+	LiteralString add(const char *text, size_t length);
+
+	void clear();
+};
+
+#endif	// __LITERALPOOL_H
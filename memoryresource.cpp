@@ -0,0 +1,238 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <stdint.h>
+#include "memoryresource.h"
+
+//======================================================================
+// Global new/delete. Plain operator new only guarantees max_align_t
+// alignment, which is all ParserKit ever asks for.
+//======================================================================
+class NewDeleteResource : public MemoryResource
+{
+protected:
+	void *doAllocate(size_t bytes, size_t alignment) override
+	{
+		assert(alignment <= alignof(std::max_align_t));
+		(void)alignment;
+
+		return ::operator new(bytes);
+	}
+
+	void doDeallocate(void *p, size_t, size_t) override
+	{
+		::operator delete(p);
+	}
+};
+
+MemoryResource *getDefaultResource()
+{
+	static NewDeleteResource resource;
+	return &resource;
+}
+
+//======================================================================
+//
+//======================================================================
+MonotonicResource::MonotonicResource(size_t initialSize, MemoryResource *pUpstream)
+{
+	m_pUpstream			= pUpstream ? pUpstream : getDefaultResource();
+	m_pBlocks			= nullptr;
+	m_pBuffer			= nullptr;
+	m_bufferSize		= 0;
+	m_pNext				= nullptr;
+	m_remaining			= 0;
+	m_initialBlockSize	= initialSize ? initialSize : DEFAULT_ARENA_BLOCK;
+	m_nextBlockSize		= m_initialBlockSize;
+	m_bytesAllocated	= 0;
+}
+
+//======================================================================
+// Start out in a caller supplied buffer, e.g. one on the stack
+//======================================================================
+MonotonicResource::MonotonicResource(void *buffer, size_t size, MemoryResource *pUpstream)
+{
+	m_pUpstream			= pUpstream ? pUpstream : getDefaultResource();
+	m_pBlocks			= nullptr;
+	m_pBuffer			= buffer;
+	m_bufferSize		= size;
+	m_pNext				= (char*)buffer;
+	m_remaining			= size;
+	m_initialBlockSize	= size ? size : DEFAULT_ARENA_BLOCK;
+	m_nextBlockSize		= m_initialBlockSize;
+	m_bytesAllocated	= 0;
+}
+
+//======================================================================
+//
+//======================================================================
+MonotonicResource::~MonotonicResource()
+{
+	release();
+}
+
+//======================================================================
+//
+//======================================================================
+void *MonotonicResource::doAllocate(size_t bytes, size_t alignment)
+{
+	assert(alignment && (alignment & (alignment - 1)) == 0);
+
+	size_t pad = (alignment - ((uintptr_t)m_pNext & (alignment - 1))) & (alignment - 1);
+
+	if (!m_pNext || pad + bytes > m_remaining)
+	{
+		// grow geometrically, but always fit the request
+		size_t size = m_nextBlockSize;
+		while (size < bytes + alignment)
+			size *= 2;
+
+		size_t header = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+		Block *pBlock = (Block*)m_pUpstream->allocate(header + size);
+		pBlock->pNext = m_pBlocks;
+		pBlock->size = header + size;
+		m_pBlocks = pBlock;
+
+		m_pNext = (char*)pBlock + header;
+		m_remaining = size;
+		m_nextBlockSize = size * 2;
+
+		pad = (alignment - ((uintptr_t)m_pNext & (alignment - 1))) & (alignment - 1);
+	}
+
+	char *p = m_pNext + pad;
+	m_pNext += pad + bytes;
+	m_remaining -= pad + bytes;
+	m_bytesAllocated += bytes;
+
+	return p;
+}
+
+//======================================================================
+// Hand every block back upstream. Anything allocated from us is gone.
+//======================================================================
+void MonotonicResource::release()
+{
+	while (m_pBlocks)
+	{
+		Block *pNext = m_pBlocks->pNext;
+		m_pUpstream->deallocate(m_pBlocks, m_pBlocks->size);
+		m_pBlocks = pNext;
+	}
+
+	m_pNext				= (char*)m_pBuffer;
+	m_remaining			= m_bufferSize;
+	m_nextBlockSize		= m_initialBlockSize;
+	m_bytesAllocated	= 0;
+}
+
+//======================================================================
+//
+//======================================================================
+PoolResource::PoolResource(size_t chunkSize, MemoryResource *pUpstream)
+{
+	m_pUpstream	= pUpstream ? pUpstream : getDefaultResource();
+	m_pChunks	= nullptr;
+	m_chunkSize	= chunkSize < 2 * MAX_POOLED_SIZE ? 2 * MAX_POOLED_SIZE : chunkSize;
+
+	for (int i = 0; i < NUM_CLASSES; i++)
+		m_freeLists[i] = nullptr;
+}
+
+//======================================================================
+//
+//======================================================================
+PoolResource::~PoolResource()
+{
+	release();
+}
+
+//======================================================================
+// Index of the smallest power of two class that holds bytes, or -1 if
+// it is too big to pool
+//======================================================================
+int PoolResource::sizeClass(size_t bytes)
+{
+	if (bytes > MAX_POOLED_SIZE)
+		return -1;
+
+	int index = 0;
+	while (((size_t)1 << (index + MIN_SHIFT)) < bytes)
+		index++;
+
+	return index;
+}
+
+//======================================================================
+// Carve a fresh chunk into free nodes of one size class
+//======================================================================
+void PoolResource::refill(int index)
+{
+	size_t header = (sizeof(Chunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+	size_t nodeSize = (size_t)1 << (index + MIN_SHIFT);
+
+	Chunk *pChunk = (Chunk*)m_pUpstream->allocate(header + m_chunkSize);
+	pChunk->pNext = m_pChunks;
+	pChunk->size = header + m_chunkSize;
+	m_pChunks = pChunk;
+
+	char *p = (char*)pChunk + header;
+	for (size_t offset = 0; offset + nodeSize <= m_chunkSize; offset += nodeSize)
+	{
+		FreeNode *pNode = (FreeNode*)(p + offset);
+		pNode->pNext = m_freeLists[index];
+		m_freeLists[index] = pNode;
+	}
+}
+
+//======================================================================
+//
+//======================================================================
+void *PoolResource::doAllocate(size_t bytes, size_t alignment)
+{
+	int index = sizeClass(bytes);
+	if (index < 0)
+		return m_pUpstream->allocate(bytes, alignment);
+
+	if (!m_freeLists[index])
+		refill(index);
+
+	FreeNode *pNode = m_freeLists[index];
+	m_freeLists[index] = pNode->pNext;
+
+	return pNode;
+}
+
+//======================================================================
+//
+//======================================================================
+void PoolResource::doDeallocate(void *p, size_t bytes, size_t alignment)
+{
+	int index = sizeClass(bytes);
+	if (index < 0)
+	{
+		m_pUpstream->deallocate(p, bytes, alignment);
+		return;
+	}
+
+	FreeNode *pNode = (FreeNode*)p;
+	pNode->pNext = m_freeLists[index];
+	m_freeLists[index] = pNode;
+}
+
+//======================================================================
+// Return all chunks upstream. Oversized allocations are the caller's to
+// free, as they never passed through a chunk.
+//======================================================================
+void PoolResource::release()
+{
+	while (m_pChunks)
+	{
+		Chunk *pNext = m_pChunks->pNext;
+		m_pUpstream->deallocate(m_pChunks, m_pChunks->size);
+		m_pChunks = pNext;
+	}
+
+	for (int i = 0; i < NUM_CLASSES; i++)
+		m_freeLists[i] = nullptr;
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#ifndef __MEMORYRESOURCE_H
+#define __MEMORYRESOURCE_H
+
+#include <stddef.h>
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+
+#define DEFAULT_ARENA_BLOCK		4096
+#define MAX_POOLED_SIZE			512
+
+//======================================================================
+// Where ParserKit gets its memory from. Modelled on C++17's
+// std::pmr::memory_resource so it can be swapped for one later, but
+// usable from C++11.
+//
+// Everything that takes a MemoryResource * treats nullptr as "use
+// getDefaultResource()", which is plain global new/delete. The resource
+// must outlive everything that allocated from it.
+//======================================================================
+class MemoryResource
+{
+public:
+	virtual ~MemoryResource() = default;
+
+	void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+	{
+		return doAllocate(bytes, alignment);
+	}
+
+	void deallocate(void *p, size_t bytes, size_t alignment = alignof(std::max_align_t))
+	{
+		doDeallocate(p, bytes, alignment);
+	}
+
+	bool isEqual(const MemoryResource &other) const
+	{
+		return this == &other || doIsEqual(other);
+	}
+
+	// false for arenas that free everything at once; owners may then skip
+	// destructors and deallocation entirely, making teardown O(1)
+	virtual bool needsDeallocate() const	{ return true; }
+
+protected:
+	virtual void *doAllocate(size_t bytes, size_t alignment) = 0;
+	virtual void doDeallocate(void *p, size_t bytes, size_t alignment) = 0;
+	virtual bool doIsEqual(const MemoryResource &other) const { return this == &other; }
+};
+
+// global new/delete
+MemoryResource *getDefaultResource();
+
+//======================================================================
+// Bump allocator. deallocate() is a no-op, everything is returned in one
+// go by release() or the destructor. Blocks come from the upstream
+// resource and double in size as the arena grows; an optional caller
+// buffer is used first.
+//======================================================================
+class MonotonicResource : public MemoryResource
+{
+protected:
+	struct Block
+	{
+		Block *pNext;
+		size_t size;
+	};
+
+	MemoryResource *m_pUpstream;
+	Block *m_pBlocks;
+
+	void *m_pBuffer;
+	size_t m_bufferSize;
+
+	char *m_pNext;
+	size_t m_remaining;
+	size_t m_nextBlockSize;
+	size_t m_initialBlockSize;
+	size_t m_bytesAllocated;
+
+	void *doAllocate(size_t bytes, size_t alignment) override;
+	void doDeallocate(void *, size_t, size_t) override {}
+
+public:
+	explicit MonotonicResource(size_t initialSize = DEFAULT_ARENA_BLOCK, MemoryResource *pUpstream = nullptr);
+	MonotonicResource(void *buffer, size_t size, MemoryResource *pUpstream = nullptr);
+	virtual ~MonotonicResource();
+
+	MonotonicResource(const MonotonicResource&) = delete;
+	MonotonicResource &operator=(const MonotonicResource&) = delete;
+
+	bool needsDeallocate() const override	{ return false; }
+
+	// bytes handed out since construction or the last release()
+	size_t getBytesAllocated() const		{ return m_bytesAllocated; }
+
+	void release();
+};
+
+//======================================================================
+// Size-class pool. Requests up to MAX_POOLED_SIZE are rounded up to a
+// power of two and served from per-class free lists carved out of
+// upstream chunks; larger requests go straight upstream. Freed memory is
+// reused, but only returned upstream by release() or the destructor.
+//======================================================================
+class PoolResource : public MemoryResource
+{
+protected:
+	enum { MIN_SHIFT = 3, NUM_CLASSES = 7 };	// 8 .. 512 bytes
+
+	struct FreeNode
+	{
+		FreeNode *pNext;
+	};
+
+	struct Chunk
+	{
+		Chunk *pNext;
+		size_t size;
+	};
+
+	MemoryResource *m_pUpstream;
+	FreeNode *m_freeLists[NUM_CLASSES];
+	Chunk *m_pChunks;
+	size_t m_chunkSize;
+
+	static int sizeClass(size_t bytes);
+	void refill(int index);
+
+	void *doAllocate(size_t bytes, size_t alignment) override;
+	void doDeallocate(void *p, size_t bytes, size_t alignment) override;
+
+public:
+	explicit PoolResource(size_t chunkSize = DEFAULT_ARENA_BLOCK, MemoryResource *pUpstream = nullptr);
+	virtual ~PoolResource();
+
+	PoolResource(const PoolResource&) = delete;
+	PoolResource &operator=(const PoolResource&) = delete;
+
+	void release();
+};
+
+//======================================================================
+// Standard allocator that draws from a MemoryResource, for use with the
+// std containers. Copies (and rebinds) share the same resource.
+//======================================================================
+template <class T>
+class ResourceAllocator
+{
+	MemoryResource *m_pResource;
+
+public:
+	using value_type = T;
+
+	ResourceAllocator() : m_pResource(getDefaultResource()) {}
+	ResourceAllocator(MemoryResource *pResource) : m_pResource(pResource ? pResource : getDefaultResource()) {}
+
+	template <class U>
+	ResourceAllocator(const ResourceAllocator<U> &rhs) : m_pResource(rhs.getResource()) {}
+
+	T *allocate(size_t n)
+	{
+		return static_cast<T*>(m_pResource->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *p, size_t n)
+	{
+		m_pResource->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	MemoryResource *getResource() const	{ return m_pResource; }
+};
+
+template <class T, class U>
+bool operator==(const ResourceAllocator<T> &lhs, const ResourceAllocator<U> &rhs)
+{
+	return lhs.getResource()->isEqual(*rhs.getResource());
+}
+
+template <class T, class U>
+bool operator!=(const ResourceAllocator<T> &lhs, const ResourceAllocator<U> &rhs)
+{
+	return !(lhs == rhs);
+}
+
+//======================================================================
+// unique_ptr deleter for objects created with makeResource(). Under a
+// resource that doesn't need deallocation the object is simply dropped,
+// its destructor never runs, so anything it owns must live in the same
+// resource.
+//======================================================================
+template <class T>
+struct ResourceDelete
+{
+	MemoryResource *m_pResource;
+
+	ResourceDelete() : m_pResource(getDefaultResource()) {}
+	ResourceDelete(MemoryResource *pResource) : m_pResource(pResource ? pResource : getDefaultResource()) {}
+
+	void operator()(T *p) const
+	{
+		if (!m_pResource->needsDeallocate())
+			return;
+
+		p->~T();
+		m_pResource->deallocate(p, sizeof(T), alignof(T));
+	}
+};
+
+template <class T>
+using ResourcePtr = std::unique_ptr<T, ResourceDelete<T>>;
+
+template <class T, class... Args>
+ResourcePtr<T> makeResource(MemoryResource *pResource, Args&&... args)
+{
+	if (!pResource)
+		pResource = getDefaultResource();
+
+	void *p = pResource->allocate(sizeof(T), alignof(T));
+
+	try
+	{
+		return ResourcePtr<T>(new (p) T(std::forward<Args>(args)...), ResourceDelete<T>(pResource));
+	}
+	catch (...)
+	{
+		pResource->deallocate(p, sizeof(T), alignof(T));
+		throw;
+	}
+}
+
+#endif	// __MEMORYRESOURCE_H
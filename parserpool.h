@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef __PARSERPOOL_H
+#define __PARSERPOOL_H
+
+#include <stddef.h>
+#include <vector>
+#include <memory>
+#include <utility>
+#include "baseparser.h"
+
+#define DEFAULT_PARSER_POOL	8
+
+//======================================================================
+// Keeps finished parsers on each thread for the next input, e.g.
+//
+//	ParserPool<JSONParser>::Handle parser = ParserPool<JSONParser>::acquire();
+//	parser->parseData(text, "request", nullptr);
+//
+// A parser is only built when the calling thread has none idle. It is
+// reset() as the handle lets go of it, so take results out first, and
+// then kept for the thread's next acquire(); past MaxIdle it is deleted
+// instead. Idle parsers go when their thread exits. A handle dropped on
+// another thread leaves its parser in that thread's pool.
+//======================================================================
+template <class Parser, size_t MaxIdle = DEFAULT_PARSER_POOL>
+class ParserPool
+{
+public:
+	struct Release
+	{
+		void operator()(Parser *pParser) const	{ ParserPool::release(pParser); }
+	};
+
+	using Handle = std::unique_ptr<Parser, Release>;
+
+protected:
+	static std::vector<std::unique_ptr<Parser>> &idle()
+	{
+		static thread_local std::vector<std::unique_ptr<Parser>> s_idle;
+		return s_idle;
+	}
+
+	static void release(Parser *pParser)
+	{
+		std::unique_ptr<Parser> parser(pParser);
+		parser->reset();
+
+		std::vector<std::unique_ptr<Parser>> &pool = idle();
+		if (pool.size() < MaxIdle)
+			pool.push_back(std::move(parser));
+	}
+
+public:
+	// args are only used if a parser has to be built
+	template <class... Args>
+	static Handle acquire(Args&&... args)
+	{
+		std::vector<std::unique_ptr<Parser>> &pool = idle();
+		if (pool.empty())
+			return Handle(new Parser(std::forward<Args>(args)...));
+
+		Handle parser(pool.back().release());
+		pool.pop_back();
+		return parser;
+	}
+
+	// this thread's idle parsers
+	static size_t getIdleCount()	{ return idle().size(); }
+	static void clear()				{ idle().clear(); }
+};
+
+#endif	// __PARSERPOOL_H
@@ -0,0 +1,324 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include "profiler.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#	include <intrin.h>
+#	define PROFILER_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	include <x86intrin.h>
+#	define PROFILER_RDTSC
+#endif
+
+// how long to watch the cycle counter against the clock to rate it
+#define CALIBRATION_MS	10
+
+//======================================================================
+// Process wide rule names. A deque so the strings never move.
+//======================================================================
+static std::mutex &ruleLock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::deque<std::string> &ruleNames()
+{
+	static std::deque<std::string> names;
+	return names;
+}
+
+//======================================================================
+//
+//======================================================================
+unsigned ParseProfiler::ruleId(const char *name)
+{
+	assert(name);
+
+	std::lock_guard<std::mutex> guard(ruleLock());
+	std::deque<std::string> &names = ruleNames();
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (names[i] == name)
+			return (unsigned)i;
+	}
+
+	names.push_back(name);
+	return (unsigned)names.size() - 1;
+}
+
+//======================================================================
+//
+//======================================================================
+const char *ParseProfiler::ruleName(unsigned id)
+{
+	std::lock_guard<std::mutex> guard(ruleLock());
+	std::deque<std::string> &names = ruleNames();
+
+	return id < names.size() ? names[id].c_str() : "?";
+}
+
+//======================================================================
+//
+//======================================================================
+uint64_t ParseProfiler::now()
+{
+#ifdef PROFILER_RDTSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//======================================================================
+// The cycle counter is rated against the steady clock the first time
+// anyone asks; without one, ticks are nanoseconds
+//======================================================================
+double ParseProfiler::ticksPerSecond()
+{
+#ifdef PROFILER_RDTSC
+	static const double rate = []()
+	{
+		auto start = std::chrono::steady_clock::now();
+		uint64_t ticks = now();
+
+		std::chrono::duration<double> elapsed;
+		do
+		{
+			elapsed = std::chrono::steady_clock::now() - start;
+		} while (elapsed.count() * 1000 < CALIBRATION_MS);
+
+		return (now() - ticks) / elapsed.count();
+	}();
+
+	return rate;
+#else
+	return 1e9;
+#endif
+}
+
+//======================================================================
+//
+//======================================================================
+ParseProfiler::ParseProfiler()
+{
+	m_maxEvents = 0;
+	reset();
+}
+
+//======================================================================
+// Forget everything measured so far; tracing stays as it was
+//======================================================================
+void ParseProfiler::reset()
+{
+	m_rules.clear();
+	m_active.clear();
+	m_stack.clear();
+	m_events.clear();
+
+	m_droppedEvents	= 0;
+	m_tokens		= 0;
+	m_bytes			= 0;
+	m_symbols		= 0;
+	m_start			= now();
+}
+
+//======================================================================
+//
+//======================================================================
+void ParseProfiler::enableTrace(size_t maxEvents)
+{
+	m_maxEvents = maxEvents;
+
+	if (maxEvents)
+		m_events.reserve(std::min(maxEvents, (size_t)4096));
+}
+
+//======================================================================
+// The clock is read last, so the bookkeeping isn't charged to the rule
+//======================================================================
+void ParseProfiler::enter(unsigned rule)
+{
+	if (rule >= m_rules.size())
+	{
+		Rule empty = {};
+		m_rules.resize(rule + 1, empty);
+		m_active.resize(rule + 1, 0);
+	}
+
+	m_active[rule]++;
+
+	Frame frame;
+	frame.rule			= rule;
+	frame.childTicks	= 0;
+	frame.startTokens	= m_tokens;
+	frame.childTokens	= 0;
+	frame.start			= now();
+
+	m_stack.push_back(frame);
+}
+
+//======================================================================
+// And read first here, for the same reason
+//======================================================================
+void ParseProfiler::leave()
+{
+	uint64_t end = now();
+
+	assert(!m_stack.empty());
+	Frame frame = m_stack.back();
+	m_stack.pop_back();
+
+	uint64_t elapsed = end > frame.start ? end - frame.start : 0;
+	uint64_t tokens = m_tokens - frame.startTokens;
+
+	Rule &rule = m_rules[frame.rule];
+	rule.calls++;
+	rule.exclusive += elapsed > frame.childTicks ? elapsed - frame.childTicks : 0;
+	rule.selfTokens += tokens - frame.childTokens;
+
+	// a recursive rule's inner calls are already inside its outer one
+	if (--m_active[frame.rule] == 0)
+	{
+		rule.inclusive += elapsed;
+		rule.tokens += tokens;
+	}
+
+	if (!m_stack.empty())
+	{
+		m_stack.back().childTicks += elapsed;
+		m_stack.back().childTokens += tokens;
+	}
+
+	if (m_maxEvents)
+	{
+		if (m_events.size() < m_maxEvents)
+		{
+			Event event;
+			event.rule	= frame.rule;
+			event.depth	= (unsigned)m_stack.size();
+			event.begin	= frame.start;
+			event.end	= end;
+
+			m_events.push_back(event);
+		}
+		else
+		{
+			m_droppedEvents++;
+		}
+	}
+}
+
+//======================================================================
+//
+//======================================================================
+std::vector<ParseProfiler::Rule> ParseProfiler::getRules() const
+{
+	std::vector<Rule> rules;
+
+	for (size_t i = 0; i < m_rules.size(); i++)
+	{
+		if (!m_rules[i].calls)
+			continue;
+
+		rules.push_back(m_rules[i]);
+		rules.back().name = ruleName((unsigned)i);
+	}
+
+	return rules;
+}
+
+//======================================================================
+//
+//======================================================================
+void ParseProfiler::dumpSummary(FILE *fout) const
+{
+	std::vector<Rule> rules = getRules();
+
+	std::sort(rules.begin(), rules.end(), [](const Rule &a, const Rule &b)
+	{
+		return a.exclusive > b.exclusive;
+	});
+
+	// every tick is in exactly one rule's exclusive time
+	uint64_t total = 0;
+	for (auto iter = rules.begin(); iter != rules.end(); iter++)
+		total += iter->exclusive;
+
+	double msPerTick = 1000.0 / ticksPerSecond();
+
+	fprintf(fout, "%-28s %10s %11s %11s %7s %10s %10s\n", "rule", "calls", "incl ms", "excl ms", "excl %", "tokens", "self tok");
+
+	for (auto iter = rules.begin(); iter != rules.end(); iter++)
+	{
+		fprintf(fout, "%-28s %10llu %11.3f %11.3f %6.1f%% %10llu %10llu\n",
+			iter->name, (unsigned long long)iter->calls,
+			iter->inclusive * msPerTick, iter->exclusive * msPerTick,
+			total ? 100.0 * iter->exclusive / total : 0.0,
+			(unsigned long long)iter->tokens, (unsigned long long)iter->selfTokens);
+	}
+
+	fprintf(fout, "%.3f ms in marked rules, %llu tokens, %llu bytes, %llu symbols installed\n",
+		total * msPerTick, (unsigned long long)m_tokens, (unsigned long long)m_bytes, (unsigned long long)m_symbols);
+
+	if (m_droppedEvents)
+		fprintf(fout, "%llu trace events dropped\n", (unsigned long long)m_droppedEvents);
+}
+
+//======================================================================
+// Complete ("X") events, one per rule call, on a single thread. Times
+// are microseconds from when the profiler was started.
+//======================================================================
+bool ParseProfiler::writeTrace(FILE *fout) const
+{
+	double usPerTick = 1e6 / ticksPerSecond();
+
+	fputs("{\"traceEvents\":[\n", fout);
+
+	for (size_t i = 0; i < m_events.size(); i++)
+	{
+		const Event &event = m_events[i];
+
+		// rule names are identifiers, but keep the JSON valid regardless
+		std::string name;
+		for (const char *p = ruleName(event.rule); *p; p++)
+		{
+			if (*p == '"' || *p == '\\')
+				name += '\\';
+			if ((unsigned char)*p >= ' ')
+				name += *p;
+		}
+
+		fprintf(fout, "{\"name\":\"%s\",\"cat\":\"rule\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}%s\n",
+			name.c_str(),
+			(event.begin > m_start ? event.begin - m_start : 0) * usPerTick,
+			(event.end - event.begin) * usPerTick,
+			event.depth,
+			i + 1 < m_events.size() ? "," : "");
+	}
+
+	fprintf(fout, "],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"tokens\":%llu,\"bytes\":%llu,\"symbols\":%llu,\"dropped\":%llu}}\n",
+		(unsigned long long)m_tokens, (unsigned long long)m_bytes, (unsigned long long)m_symbols, (unsigned long long)m_droppedEvents);
+
+	return !ferror(fout);
+}
+
+//======================================================================
+//
+//======================================================================
+bool ParseProfiler::writeTrace(const char *filename) const
+{
+	FILE *fout = fopen(filename, "w");
+	if (!fout)
+		return false;
+
+	bool ok = writeTrace(fout);
+	return fclose(fout) == 0 && ok;
+}
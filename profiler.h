@@ -0,0 +1,148 @@
+#pragma once
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// rule scopes and token/byte counters cost a clock read or an increment
+// each, so they are opt in
+#ifdef PARSERKIT_PROFILE
+#  define PARSE_PROFILE(x)	x
+#  define PARSE_RULE(name) \
+	static const unsigned _parseRuleId = ParseProfiler::ruleId(name); \
+	RuleScope _parseRuleScope(getProfiler(), _parseRuleId)
+#else
+#  define PARSE_PROFILE(x)
+#  define PARSE_RULE(name)
+#endif
+
+//======================================================================
+// Where the time goes in a hand-written recursive descent parser.
+//
+// Rules are marked with PARSE_RULE("DoObject") at the top of the method
+// that parses them. Each call is timed on entry and exit with the CPU's
+// cycle counter where there is one (a steady clock elsewhere), and the
+// profiler keeps per rule call counts, inclusive and exclusive time and
+// the tokens consumed. Inclusive time for recursive rules is only
+// counted at the outermost call, so it never exceeds the parse.
+//
+// The parser feeds it tokens, bytes and symbol installs; with tracing
+// on, every rule call is also kept as an event for a Chrome trace.
+// Built without PARSERKIT_PROFILE the markers compile to nothing, and
+// attaching a profiler just leaves it empty.
+//======================================================================
+class ParseProfiler
+{
+public:
+	struct Rule
+	{
+		const char *name;
+		uint64_t calls;
+		uint64_t inclusive;		// ticks, outermost calls only
+		uint64_t exclusive;		// ticks, less time in other marked rules
+		uint64_t tokens;		// consumed in the rule and the rules it called
+		uint64_t selfTokens;	// consumed in the rule itself
+	};
+
+	struct Event
+	{
+		unsigned rule;
+		unsigned depth;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+protected:
+	struct Frame
+	{
+		unsigned rule;
+		uint64_t start;
+		uint64_t childTicks;
+		uint64_t startTokens;
+		uint64_t childTokens;
+	};
+
+	std::vector<Rule> m_rules;
+	std::vector<unsigned> m_active;		// live calls per rule, for recursion
+	std::vector<Frame> m_stack;
+
+	std::vector<Event> m_events;
+	size_t m_maxEvents;
+	uint64_t m_droppedEvents;
+
+	uint64_t m_tokens;
+	uint64_t m_bytes;
+	uint64_t m_symbols;
+
+	uint64_t m_start;
+
+public:
+	ParseProfiler();
+
+	// rules are numbered once per process, by name
+	static unsigned ruleId(const char *name);
+	static const char *ruleName(unsigned id);
+
+	// the cycle counter, and how fast it runs (measured once)
+	static uint64_t now();
+	static double ticksPerSecond();
+
+	void enter(unsigned rule);
+	void leave();
+
+	void countToken()				{ m_tokens++; }
+	void countBytes(uint64_t bytes)	{ m_bytes += bytes; }
+	void countSymbol()				{ m_symbols++; }
+
+	// keep up to maxEvents rule calls for writeTrace(), 0 turns it off
+	void enableTrace(size_t maxEvents = 1 << 20);
+
+	void reset();
+
+	// rules that were entered at least once
+	std::vector<Rule> getRules() const;
+	const std::vector<Event> &getEvents() const	{ return m_events; }
+	uint64_t getDroppedEvents() const			{ return m_droppedEvents; }
+
+	uint64_t getTokens() const		{ return m_tokens; }
+	uint64_t getBytes() const		{ return m_bytes; }
+	uint64_t getSymbols() const		{ return m_symbols; }
+	unsigned getDepth() const		{ return (unsigned)m_stack.size(); }
+
+	// table of rules, most exclusive time first, and the totals
+	void dumpSummary(FILE *fout = stdout) const;
+
+	// Chrome trace event JSON, for chrome://tracing or Perfetto
+	bool writeTrace(FILE *fout) const;
+	bool writeTrace(const char *filename) const;
+};
+
+//======================================================================
+// Times one call of a rule; a null profiler makes it a no-op
+//======================================================================
+class RuleScope
+{
+	ParseProfiler *m_pProfiler;
+
+public:
+	RuleScope(ParseProfiler *pProfiler, unsigned rule) : m_pProfiler(pProfiler)
+	{
+		if (m_pProfiler)
+			m_pProfiler->enter(rule);
+	}
+
+	~RuleScope()
+	{
+		if (m_pProfiler)
+			m_pProfiler->leave();
+	}
+
+	RuleScope(const RuleScope&) = delete;
+	RuleScope &operator=(const RuleScope&) = delete;
+};
+
+#endif	// __PROFILER_H
@@ -0,0 +1,343 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#  define _XOPEN_SOURCE 600		// for ucontext
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "pushparser.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <ucontext.h>
+#endif
+
+// sanitizers have to be told when the stack changes under them
+#if defined(__SANITIZE_ADDRESS__)
+#  define PUSH_ASAN 1
+#elif defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#    define PUSH_ASAN 1
+#  endif
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#  define PUSH_TSAN 1
+#elif defined(__has_feature)
+#  if __has_feature(thread_sanitizer)
+#    define PUSH_TSAN 1
+#  endif
+#endif
+
+#ifdef PUSH_ASAN
+#  include <sanitizer/common_interface_defs.h>
+#endif
+#ifdef PUSH_TSAN
+#  include <sanitizer/tsan_interface.h>
+#endif
+
+//======================================================================
+// The stack the parse runs on. resume() switches to it from whichever
+// thread calls, and returns when the parse yields or ends; yield() is
+// only called on it.
+//======================================================================
+struct PushParser::Fiber
+{
+	PushParser *pOwner;
+	bool returned;
+
+#ifdef _WIN32
+	LPVOID fiber;
+	LPVOID caller;
+
+	static VOID CALLBACK start(LPVOID pParam);
+#else
+	ucontext_t context;
+	ucontext_t caller;
+	std::unique_ptr<char[]> stack;
+	size_t stackSize;
+
+	static void start(unsigned hi, unsigned lo);
+#endif
+
+#ifdef PUSH_ASAN
+	void *pCallerFake;
+	void *pFiberFake;
+	const void *pCallerBottom;
+	size_t callerSize;
+#endif
+#ifdef PUSH_TSAN
+	void *pTsanFiber;
+	void *pTsanCaller;
+#endif
+
+	Fiber(PushParser *pParser, size_t size);
+	~Fiber();
+
+	void resume();
+	void yield();
+	void entry();
+};
+
+//
+PushParser::Fiber::Fiber(PushParser *pParser, size_t size)
+{
+	pOwner		= pParser;
+	returned	= false;
+
+#ifdef PUSH_ASAN
+	pCallerFake		= nullptr;
+	pFiberFake		= nullptr;
+	pCallerBottom	= nullptr;
+	callerSize		= 0;
+#endif
+#ifdef PUSH_TSAN
+	pTsanFiber	= __tsan_create_fiber(0);
+	pTsanCaller	= nullptr;
+#endif
+
+#ifdef _WIN32
+	caller	= nullptr;
+	fiber	= CreateFiber(size, &Fiber::start, this);
+#else
+	stackSize = size;
+	stack.reset(new char[stackSize]);
+
+	getcontext(&context);
+	context.uc_stack.ss_sp		= stack.get();
+	context.uc_stack.ss_size	= stackSize;
+	context.uc_link				= nullptr;
+
+	// makecontext() only passes ints
+	uint64_t p = (uint64_t)(uintptr_t)this;
+	makecontext(&context, (void (*)())&Fiber::start, 2, (unsigned)(p >> 32), (unsigned)p);
+#endif
+}
+
+//
+PushParser::Fiber::~Fiber()
+{
+#ifdef _WIN32
+	if (fiber)
+		DeleteFiber(fiber);
+#endif
+#ifdef PUSH_TSAN
+	__tsan_destroy_fiber(pTsanFiber);
+#endif
+}
+
+//
+void PushParser::Fiber::resume()
+{
+	assert(!returned);
+
+#ifdef PUSH_TSAN
+	pTsanCaller = __tsan_get_current_fiber();
+	__tsan_switch_to_fiber(pTsanFiber, 0);
+#endif
+
+#ifdef _WIN32
+	if (!IsThreadAFiber())
+		ConvertThreadToFiber(nullptr);
+	caller = GetCurrentFiber();
+	SwitchToFiber(fiber);
+#else
+#  ifdef PUSH_ASAN
+	__sanitizer_start_switch_fiber(&pCallerFake, stack.get(), stackSize);
+#  endif
+	swapcontext(&caller, &context);
+#  ifdef PUSH_ASAN
+	__sanitizer_finish_switch_fiber(pCallerFake, nullptr, nullptr);
+#  endif
+#endif
+}
+
+//
+void PushParser::Fiber::yield()
+{
+#ifdef PUSH_TSAN
+	__tsan_switch_to_fiber(pTsanCaller, 0);
+#endif
+
+#ifdef _WIN32
+	SwitchToFiber(caller);
+#else
+#  ifdef PUSH_ASAN
+	__sanitizer_start_switch_fiber(&pFiberFake, pCallerBottom, callerSize);
+#  endif
+	swapcontext(&context, &caller);
+#  ifdef PUSH_ASAN
+	__sanitizer_finish_switch_fiber(pFiberFake, &pCallerBottom, &callerSize);
+#  endif
+#endif
+}
+
+//
+// first time on the new stack; it must never return from here
+//
+void PushParser::Fiber::entry()
+{
+#ifdef PUSH_ASAN
+	__sanitizer_finish_switch_fiber(nullptr, &pCallerBottom, &callerSize);
+#endif
+
+	pOwner->run();
+	returned = true;
+
+#ifdef PUSH_TSAN
+	__tsan_switch_to_fiber(pTsanCaller, 0);
+#endif
+
+#ifdef _WIN32
+	for (;;)
+		SwitchToFiber(caller);
+#else
+#  ifdef PUSH_ASAN
+	// this stack is done with
+	__sanitizer_start_switch_fiber(nullptr, pCallerBottom, callerSize);
+#  endif
+	setcontext(&caller);
+#endif
+}
+
+#ifdef _WIN32
+VOID CALLBACK PushParser::Fiber::start(LPVOID pParam)
+{
+	((Fiber*)pParam)->entry();
+}
+#else
+void PushParser::Fiber::start(unsigned hi, unsigned lo)
+{
+	((Fiber*)(uintptr_t)(((uint64_t)hi << 32) | lo))->entry();
+}
+#endif
+
+//======================================================================
+//
+//======================================================================
+PushParser::PushParser(BaseParser &parser, const char *name, size_t stackSize) :
+	m_parser(parser),
+	m_name(name ? name : "input"),
+	m_stackSize(stackSize),
+	m_buffer(2, 0)
+{
+	m_pending	= false;
+	m_finished	= false;
+	m_cancelled	= false;
+	m_done		= false;
+	m_result	= 0;
+	m_bytesFed	= 0;
+}
+
+//
+// a parse still suspended is unwound, so that its destructors run
+//
+PushParser::~PushParser()
+{
+	if (m_pFiber && !m_done)
+	{
+		m_cancelled	= true;
+		m_finished	= true;
+		m_pFiber->resume();
+	}
+}
+
+//
+PushParser::Status PushParser::feed(const char *data, size_t length)
+{
+	if (m_done || m_finished)
+		return m_done ? Status::Done : Status::NeedInput;
+
+	if (!length)
+		return Status::NeedInput;
+
+	// the lexer may put back the last character of the chunk before
+	char prev = m_buffer[m_buffer.size() - 2];
+
+	m_buffer.resize(length + 2);
+	m_buffer[0] = prev;
+	memcpy(&m_buffer[1], data, length);
+	m_buffer[length + 1] = 0;
+
+	m_pending = true;
+	m_bytesFed += length;
+
+	return resume();
+}
+
+//
+int PushParser::finish()
+{
+	if (!m_done)
+	{
+		m_finished = true;
+		resume();
+	}
+
+	assert(m_done);
+	return m_result;
+}
+
+//
+PushParser::Status PushParser::resume()
+{
+	if (!m_pFiber)
+		m_pFiber.reset(new Fiber(this, m_stackSize));
+
+	m_pFiber->resume();
+
+	if (m_exception)
+	{
+		std::exception_ptr exception = m_exception;
+		m_exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+
+	return m_done ? Status::Done : Status::NeedInput;
+}
+
+//
+// on the fiber
+//
+void PushParser::run()
+{
+	try
+	{
+		m_result = m_parser.parseSource(this, m_name.c_str());
+	}
+	catch (...)
+	{
+		m_result = -1;
+		m_exception = std::current_exception();
+	}
+
+	m_done = true;
+}
+
+//
+// called by the lexer on the fiber when it has read everything fed so
+// far; suspends the parse until there is more
+//
+char *PushParser::refill()
+{
+	while (!m_pending && !m_finished)
+	{
+		m_pFiber->yield();
+
+		// once only, after that the input just ends
+		if (m_cancelled)
+		{
+			m_cancelled = false;
+			throw ParseAbort();
+		}
+	}
+
+	if (!m_pending)
+		return nullptr;
+
+	m_pending = false;
+	return &m_buffer[1];
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef __PUSHPARSER_H
+#define __PUSHPARSER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+#include "baseparser.h"
+
+#define DEFAULT_PUSH_STACK	(256 * 1024)
+
+//======================================================================
+// Drives a parser with input as it arrives, e.g. from a socket:
+//
+//	PushParser push(parser, "socket");
+//	while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+//		push.feed(buf, n);
+//	int rv = push.finish();
+//
+// The parse runs on a stack of its own. When the lexer reaches the end
+// of what has been fed so far the parse is suspended there, in whatever
+// rule it was in, and feed() returns; the next feed() picks it up again.
+// Nothing in the parser has to change, though a parser that prints
+// errors through the lexer's default yyerror() exits, so give it a
+// DiagnosticSink.
+//
+// feed() and finish() may be called from different threads, one at a
+// time. Destroying a PushParser before the parse is done unwinds it with
+// ParseAbort. stackSize must hold the parser's deepest recursion.
+//======================================================================
+class PushParser : protected InputSource
+{
+public:
+	enum class Status
+	{
+		NeedInput,		// suspended until the next feed() or finish()
+		Done			// the parse has returned, further input is ignored
+	};
+
+protected:
+	struct Fiber;
+
+	BaseParser &m_parser;
+	std::string m_name;
+	size_t m_stackSize;
+	std::unique_ptr<Fiber> m_pFiber;
+
+	// the chunk handed to the lexer: the last character fed, the new
+	// ones, then a NUL
+	std::vector<char> m_buffer;
+	bool m_pending;			// m_buffer holds a chunk the lexer hasn't had
+	bool m_finished;		// no more input
+	bool m_cancelled;
+	bool m_done;
+	int m_result;
+	size_t m_bytesFed;
+	std::exception_ptr m_exception;
+
+	char *refill() override;
+
+	void run();
+	Status resume();
+
+public:
+	explicit PushParser(BaseParser &parser, const char *name = "input", size_t stackSize = DEFAULT_PUSH_STACK);
+	virtual ~PushParser();
+
+	PushParser(const PushParser&) = delete;
+	PushParser &operator=(const PushParser&) = delete;
+
+	// hand over the next piece of input, which is copied and need not
+	// outlive the call; an exception thrown by the parse comes out here
+	Status feed(const char *data, size_t length);
+	Status feed(const std::string &text)	{ return feed(text.data(), text.size()); }
+
+	// the end of the input; runs the parse to completion and returns what
+	// parseData() would have
+	int finish();
+
+	bool isDone() const				{ return m_done; }
+	int getResult() const			{ return m_result; }
+	size_t getBytesFed() const		{ return m_bytesFed; }
+	BaseParser &getParser()			{ return m_parser; }
+};
+
+#endif	// __PUSHPARSER_H
@@ -1,11 +1,25 @@
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <algorithm>
 #include <assert.h>
 #include <list>
 #include <map>
 #include <string>
+#include <string.h>
+#include <stdio.h>
 #include "symboltable.h"
 
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
 //======================================================================
 //
 //======================================================================
@@ -28,9 +42,44 @@ static_assert(ARRAY_SIZE(_typeStrings) == stNumSymbolTypes, "array size mismatch
 //
 //======================================================================
 SymbolTable::SymbolTable()
+	: m_pResource(getDefaultResource())
+	, m_symbolTable(m_pResource)
+	, m_promoted(m_pResource)
+{
+	// add the first level to the table
+	m_symbolTable.push_back(SymbolMap(m_pResource));
+
+	resetStats();
+}
+
+//======================================================================
+// Allocate all scope levels from pResource, e.g. a per-request arena
+//======================================================================
+SymbolTable::SymbolTable(MemoryResource *pResource)
+	: m_pResource(pResource ? pResource : getDefaultResource())
+	, m_symbolTable(m_pResource)
+	, m_promoted(m_pResource)
+{
+	// add the first level to the table
+	m_symbolTable.push_back(SymbolMap(m_pResource));
+
+	resetStats();
+}
+
+//======================================================================
+// Create a private overlay on top of a shared, frozen base table
+//======================================================================
+SymbolTable::SymbolTable(std::shared_ptr<const FrozenSymbolTable> base, MemoryResource *pResource)
+	: m_pResource(pResource ? pResource : getDefaultResource())
+	, m_symbolTable(m_pResource)
+	, m_promoted(m_pResource)
 {
+	m_base = std::move(base);
+
 	// add the first level to the table
-	m_symbolTable.push_back(SymbolMap());
+	m_symbolTable.push_back(SymbolMap(m_pResource));
+
+	resetStats();
 }
 
 //======================================================================
@@ -38,7 +87,9 @@ SymbolTable::SymbolTable()
 //======================================================================
 void SymbolTable::push()
 {
-	m_symbolTable.push_back(SymbolMap());
+	m_symbolTable.push_back(SymbolMap(m_pResource));
+
+	SYMBOL_STAT(if (m_symbolTable.size() > m_stats.peakDepth) m_stats.peakDepth = (unsigned)m_symbolTable.size());
 }
 
 //======================================================================
@@ -52,14 +103,49 @@ void SymbolTable::pop()
 	assert(m_symbolTable.size() >= 0);
 }
 
+//======================================================================
+// Pop to the outermost scope and empty it, for the next input. A frozen
+// base stays as it was frozen; our copies of its entries go.
+//======================================================================
+void SymbolTable::reset()
+{
+	while (m_symbolTable.size() > 1)
+		m_symbolTable.pop_back();
+
+	if (m_symbolTable.empty())
+		m_symbolTable.push_back(SymbolMap(m_pResource));
+	else
+		m_symbolTable.front().clear();
+
+	m_promoted.clear();
+	m_globalIter = global_iterator();
+
+	resetStats();
+}
+
+//======================================================================
+// The global m_globalIter is on, as an entry callers can write to: our
+// own, or our promoted copy of a base one, never the iterator's copy
+//======================================================================
+SymbolEntry *SymbolTable::currentGlobal()
+{
+	if (m_globalIter == end_globals())
+		return nullptr;
+
+	SymbolMap &globals = m_symbolTable.front();
+	if (m_globalIter.m_mapIter != globals.end())
+		return &globals.find(m_globalIter.m_mapIter->first)->second;
+
+	return promote(m_globalIter.m_baseIndex);
+}
+
 //======================================================================
 //
 //======================================================================
 SymbolEntry *SymbolTable::getFirstGlobal()
 {
-	stack_iterator iter = m_symbolTable.begin();
-	m_globalIter = (*iter).begin();
-	return &m_globalIter->second;
+	m_globalIter = begin_globals();
+	return currentGlobal();
 }
 
 //======================================================================
@@ -67,13 +153,8 @@ SymbolEntry *SymbolTable::getFirstGlobal()
 //======================================================================
 SymbolEntry *SymbolTable::getNextGlobal()
 {
-	m_globalIter++;
-	stack_iterator iter = begin_stack();
-
-	if (m_globalIter == (*iter).end())
-		return nullptr;
-
-	return &m_globalIter->second;
+	++m_globalIter;
+	return currentGlobal();
 }
 
 //======================================================================
@@ -108,6 +189,26 @@ void SymbolTable::dumpContents()
 			puts(szText);
 		}
 	}
+
+	if (!m_base)
+		return;
+
+	// then the shared base, innermost level first
+	for (unsigned level = m_base->getLevelCount(); level-- > 0; )
+	{
+		for (unsigned index = m_base->levelBegin(level); index < m_base->levelEnd(level); index++)
+		{
+			SymbolEntry entry;
+			m_base->materialize(index, entry);
+
+			if (entry.type == stInteger)
+				snprintf(szText, sizeof(szText), "%s\t(%u, 0x%08X)\n", entry.lexeme.c_str(), entry.ival, entry.ival);
+			else
+				snprintf(szText, sizeof(szText), "%s\t%f\n", entry.lexeme.c_str(), entry.fval);
+
+			puts(szText);
+		}
+	}
 }
 
 //===============================================================
@@ -118,17 +219,41 @@ SymbolEntry *SymbolTable::lookup(const char *lexeme)
 	SymbolMap::iterator iter;
 	SymbolStack::reverse_iterator riter = m_symbolTable.rbegin();
 
+	SYMBOL_STAT(unsigned depth = (unsigned)m_symbolTable.size() - 1);
+	SYMBOL_STAT(m_stats.lookups++);
+	SYMBOL_STAT(m_stats.levels[depth < MAX_STATS_DEPTH ? depth : MAX_STATS_DEPTH - 1].lookups++);
+
 	for (; riter != m_symbolTable.rend(); riter++)
 	{
+		SYMBOL_STAT(m_stats.levelsWalked++);
+
 		// if we are done with this level, search next highest level
 		iter = (*riter).find(lexeme);
 		if (iter == (*riter).end())
+		{
+			SYMBOL_STAT(depth--);
 			continue;
+		}
 
+		SYMBOL_STAT(m_stats.levels[depth < MAX_STATS_DEPTH ? depth : MAX_STATS_DEPTH - 1].hits++);
 		return &(iter->second);
 	}
 
+	// then fall back to the shared base
+	if (m_base)
+	{
+		SYMBOL_STAT(m_stats.levelsWalked++);
+
+		unsigned index = m_base->find(lexeme);
+		if (index != FrozenSymbolTable::npos)
+		{
+			SYMBOL_STAT(m_stats.baseHits++);
+			return promote(index);
+		}
+	}
+
 	// symbol was not found anywhere in the table
+	SYMBOL_STAT(m_stats.misses++);
 	return nullptr;
 }
 
@@ -150,10 +275,31 @@ SymbolEntry *SymbolTable::reverse_lookup(int ival)
 		}
 	}
 
+	if (m_base)
+	{
+		unsigned index = m_base->reverse_lookup(ival);
+		if (index != FrozenSymbolTable::npos)
+			return promote(index);
+	}
+
 	// symbol was not found anywhere in the table
 	return nullptr;
 }
 
+//===============================================================
+// Return our private, writable copy of a base entry. Callers are free
+// to modify what lookup() returns, so base entries are copied on first
+// access rather than handed out directly.
+//===============================================================
+SymbolEntry *SymbolTable::promote(unsigned index)
+{
+	auto result = m_promoted.insert(std::make_pair(index, SymbolEntry()));
+	if (result.second)
+		m_base->materialize(index, result.first->second);
+
+	return &(result.first->second);
+}
+
 //======================================================================
 // Install given lexeme in the symbol table at the current level.
 // Duplicates are not allowed.
@@ -162,6 +308,23 @@ SymbolEntry *SymbolTable::install(const char *lexeme, SymbolType type)
 {
 	SymbolMap &currentMap = m_symbolTable.back();
 
+	SYMBOL_STAT(unsigned depth = (unsigned)m_symbolTable.size() - 1);
+	SYMBOL_STAT(m_stats.installs++);
+	SYMBOL_STAT(m_stats.levels[depth < MAX_STATS_DEPTH ? depth : MAX_STATS_DEPTH - 1].installs++);
+
+	// the base's globals are ours too, so one of them is promoted rather
+	// than hidden by a new entry
+	if (m_base && m_symbolTable.size() == 1 && m_base->getLevelCount() && currentMap.find(lexeme) == currentMap.end())
+	{
+		unsigned index = m_base->findAtLevel(0, lexeme);
+		if (index != FrozenSymbolTable::npos)
+		{
+			SymbolEntry *pEntry = promote(index);
+			assert(pEntry->type == type);
+			return pEntry;
+		}
+	}
+
 	// see if already in table
 	SymbolEntry se;
 	se.type = type;
@@ -175,6 +338,121 @@ SymbolEntry *SymbolTable::install(const char *lexeme, SymbolType type)
 	return &(result.first->second);
 }
 
+//======================================================================
+// Whether the probe counters were compiled in
+//======================================================================
+bool SymbolTable::statsEnabled()
+{
+#ifdef PARSERKIT_SYMBOL_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+//======================================================================
+// Heap bytes a string holds beyond its own footprint
+//======================================================================
+static size_t externalBytes(const std::string &s)
+{
+	static const size_t inlineCapacity = std::string().capacity();
+
+	return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+//======================================================================
+// Heap bytes one map node costs beyond its value, assuming a typical
+// red-black tree node header
+//======================================================================
+static size_t entryBytes(const SymbolEntry &entry)
+{
+	return 4 * sizeof(void*) + externalBytes(entry.lexeme) + externalBytes(entry.srcFile);
+}
+
+//======================================================================
+// Counters so far, plus a snapshot of the current levels
+//======================================================================
+SymbolTableStats SymbolTable::getStats() const
+{
+	SymbolTableStats stats = m_stats;
+
+	stats.depth		= (unsigned)m_symbolTable.size();
+	stats.entries	= 0;
+	stats.bytesUsed	= 0;
+
+	for (unsigned level = 0; level < MAX_STATS_DEPTH; level++)
+		stats.levels[level].entries = 0;
+
+	unsigned level = 0;
+	for (auto siter = m_symbolTable.begin(); siter != m_symbolTable.end(); siter++, level++)
+	{
+		stats.levels[level < MAX_STATS_DEPTH ? level : MAX_STATS_DEPTH - 1].entries += siter->size();
+		stats.entries += siter->size();
+
+		for (auto iter = siter->begin(); iter != siter->end(); iter++)
+			stats.bytesUsed += sizeof(*iter) + externalBytes(iter->first) + entryBytes(iter->second);
+	}
+
+	// promoted copies of base entries live with us too
+	for (auto iter = m_promoted.begin(); iter != m_promoted.end(); iter++)
+		stats.bytesUsed += sizeof(*iter) + entryBytes(iter->second);
+
+	return stats;
+}
+
+//======================================================================
+//
+//======================================================================
+void SymbolTable::resetStats()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.peakDepth = (unsigned)m_symbolTable.size();
+}
+
+//======================================================================
+// Fraction of the lookups issued at this depth that were found at it
+//======================================================================
+double SymbolTableStats::hitRate(unsigned level) const
+{
+	if (level >= MAX_STATS_DEPTH || !levels[level].lookups)
+		return 0.0;
+
+	return (double)levels[level].hits / levels[level].lookups;
+}
+
+//======================================================================
+//
+//======================================================================
+void SymbolTable::dumpStats() const
+{
+	SymbolTableStats stats = getStats();
+
+	printf("Symbol table: %u level(s), %u peak, %zu entries, ~%zu bytes\n", stats.depth, stats.peakDepth, stats.entries, stats.bytesUsed);
+
+	if (!statsEnabled())
+	{
+		puts("  (build with PARSERKIT_SYMBOL_STATS for probe counters)");
+		return;
+	}
+
+	printf("  lookups %llu, misses %llu, base hits %llu, %.2f levels walked per lookup\n",
+		(unsigned long long)stats.lookups, (unsigned long long)stats.misses,
+		(unsigned long long)stats.baseHits, stats.averageWalk());
+	printf("  installs %llu\n", (unsigned long long)stats.installs);
+
+	puts("  depth   entries   lookups      hits  hit rate  installs");
+	for (unsigned level = 0; level < MAX_STATS_DEPTH; level++)
+	{
+		const SymbolTableStats::Level &l = stats.levels[level];
+		if (!l.entries && !l.lookups && !l.hits && !l.installs)
+			continue;
+
+		printf("  %5u%s %9zu %9llu %9llu %8.1f%% %9llu\n", level, level == MAX_STATS_DEPTH - 1 ? "+" : " ",
+			l.entries, (unsigned long long)l.lookups, (unsigned long long)l.hits,
+			100.0 * stats.hitRate(level), (unsigned long long)l.installs);
+	}
+}
+
 //======================================================================
 //
 //======================================================================
@@ -216,3 +494,466 @@ int SymbolTable::dumpUnreferencedSymbolsAtCurrentLevel()
 
 	return count;
 }
+
+
+//======================================================================
+// Flatten every level of the table into an immutable image that any
+// number of parsers may share. An overlay's level n is merged with the
+// base's level n, so its globals stay globals; where both have a
+// lexeme, ours wins.
+//======================================================================
+std::shared_ptr<const FrozenSymbolTable> SymbolTable::freeze() const
+{
+	size_t baseLevels = m_base ? m_base->getLevelCount() : 0;
+	std::vector<std::vector<const SymbolEntry*>> levels(std::max(baseLevels, m_symbolTable.size()));
+	std::list<SymbolEntry> baseEntries;
+
+	// our own entries go first, as the image keeps a level's first entry
+	// for a lexeme
+	unsigned own = 0;
+	for (auto riter = m_symbolTable.begin(); riter != m_symbolTable.end(); riter++, own++)
+	{
+		for (auto iter = riter->begin(); iter != riter->end(); iter++)
+			levels[own].push_back(&iter->second);
+	}
+
+	if (m_base)
+	{
+		for (unsigned level = 0; level < baseLevels; level++)
+		{
+			for (unsigned index = m_base->levelBegin(level); index < m_base->levelEnd(level); index++)
+			{
+				// prefer our copy if this entry has been promoted
+				auto iter = m_promoted.find(index);
+				if (iter != m_promoted.end())
+				{
+					levels[level].push_back(&iter->second);
+					continue;
+				}
+
+				baseEntries.push_back(SymbolEntry());
+				m_base->materialize(index, baseEntries.back());
+				levels[level].push_back(&baseEntries.back());
+			}
+		}
+	}
+
+	return std::make_shared<const FrozenSymbolTable>(FrozenSymbolTable::buildImage(levels));
+}
+
+//======================================================================
+//
+//======================================================================
+SymbolTable::global_iterator::global_iterator(const SymbolTable *pTable, bool atEnd)
+{
+	m_pTable	= pTable;
+	m_mapIter	= pTable->m_symbolTable.front().end();
+	m_baseIndex	= FrozenSymbolTable::npos;
+
+	if (atEnd)
+		return;
+
+	m_mapIter = pTable->m_symbolTable.front().begin();
+	if (m_mapIter == pTable->m_symbolTable.front().end() && pTable->m_base && pTable->m_base->getLevelCount())
+	{
+		m_baseIndex = pTable->m_base->levelBegin(0);
+		settle();
+	}
+}
+
+//======================================================================
+// Skip base globals that are shadowed by our own globals, and load the
+// current one, if any, into our private copy.
+//======================================================================
+void SymbolTable::global_iterator::settle()
+{
+	const FrozenSymbolTable *pBase = m_pTable->m_base.get();
+	const SymbolMap &globals = m_pTable->m_symbolTable.front();
+
+	for (; m_baseIndex < pBase->levelEnd(0); m_baseIndex++)
+	{
+		if (globals.find(pBase->getLexeme(m_baseIndex)) != globals.end())
+			continue;
+
+		auto iter = m_pTable->m_promoted.find(m_baseIndex);
+		if (iter != m_pTable->m_promoted.end())
+			m_baseEntry = iter->second;
+		else
+			pBase->materialize(m_baseIndex, m_baseEntry);
+
+		return;
+	}
+
+	m_baseIndex = FrozenSymbolTable::npos;
+}
+
+//======================================================================
+//
+//======================================================================
+const SymbolEntry &SymbolTable::global_iterator::operator*() const
+{
+	if (m_mapIter != m_pTable->m_symbolTable.front().end())
+		return m_mapIter->second;
+
+	return m_baseEntry;
+}
+
+//======================================================================
+//
+//======================================================================
+SymbolTable::global_iterator &SymbolTable::global_iterator::operator++()
+{
+	const SymbolMap &globals = m_pTable->m_symbolTable.front();
+
+	if (m_mapIter != globals.end())
+	{
+		++m_mapIter;
+		if (m_mapIter != globals.end() || !m_pTable->m_base || !m_pTable->m_base->getLevelCount())
+			return *this;
+
+		m_baseIndex = m_pTable->m_base->levelBegin(0);
+	}
+	else
+	{
+		m_baseIndex++;
+	}
+
+	settle();
+	return *this;
+}
+
+//======================================================================
+//
+//======================================================================
+FrozenSymbolTable::FrozenSymbolTable(std::vector<char> image)
+{
+	m_storage = std::move(image);
+
+	assert(validateImage(m_storage.data(), m_storage.size()));
+	attach(m_storage.data());
+}
+
+//======================================================================
+// Use an image in place, without copying it. The owner, if any, is held
+// for as long as this table lives.
+//======================================================================
+FrozenSymbolTable::FrozenSymbolTable(const void *image, std::shared_ptr<const void> owner)
+{
+	m_pOwner = std::move(owner);
+	attach((const char*)image);
+}
+
+//======================================================================
+//
+//======================================================================
+void FrozenSymbolTable::attach(const char *image)
+{
+	m_pHeader	= (const ImageHeader*)image;
+	m_pLevels	= (const ImageLevel*)(m_pHeader + 1);
+	m_pEntries	= (const ImageEntry*)(m_pLevels + m_pHeader->levelCount);
+	m_pStrings	= (const char*)(m_pEntries + m_pHeader->entryCount);
+}
+
+//======================================================================
+// Binary search one level, entries are sorted by lexeme
+//======================================================================
+unsigned FrozenSymbolTable::findInLevel(const ImageLevel &level, const char *lexeme) const
+{
+	unsigned lo = level.firstEntry, hi = level.firstEntry + level.entryCount;
+
+	while (lo < hi)
+	{
+		unsigned mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(m_pStrings + m_pEntries[mid].lexeme, lexeme);
+
+		if (cmp == 0)
+			return mid;
+
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return npos;
+}
+
+//======================================================================
+// Look for a symbol, searching from the innermost level outward
+//======================================================================
+unsigned FrozenSymbolTable::find(const char *lexeme) const
+{
+	for (unsigned level = m_pHeader->levelCount; level-- > 0; )
+	{
+		unsigned index = findInLevel(m_pLevels[level], lexeme);
+		if (index != npos)
+			return index;
+	}
+
+	return npos;
+}
+
+//======================================================================
+//
+//======================================================================
+unsigned FrozenSymbolTable::findAtLevel(unsigned level, const char *lexeme) const
+{
+	assert(level < m_pHeader->levelCount);
+	return findInLevel(m_pLevels[level], lexeme);
+}
+
+//======================================================================
+//
+//======================================================================
+unsigned FrozenSymbolTable::reverse_lookup(int ival) const
+{
+	for (unsigned level = m_pHeader->levelCount; level-- > 0; )
+	{
+		for (unsigned index = levelBegin(level); index < levelEnd(level); index++)
+		{
+			int value;
+			memcpy(&value, &m_pEntries[index].value, sizeof(value));
+
+			if (value == ival)
+				return index;
+		}
+	}
+
+	return npos;
+}
+
+//======================================================================
+// Copy an entry out of the image into a regular SymbolEntry
+//======================================================================
+void FrozenSymbolTable::materialize(unsigned index, SymbolEntry &entry) const
+{
+	const ImageEntry &image = m_pEntries[index];
+
+	entry.lexeme		= m_pStrings + image.lexeme;
+	entry.type			= image.type;
+	entry.srcLine		= image.srcLine;
+	entry.srcFile		= m_pStrings + image.srcFile;
+	entry.global		= (image.flags & imageGlobal) != 0;
+	entry.isReferenced	= (image.flags & imageReferenced) ? 1 : 0;
+
+	memcpy(&entry.ival, &image.value, sizeof(image.value));
+}
+
+//======================================================================
+// Lay the given levels out as a single relocatable image. Strings are
+// pooled and referred to by offset so the image contains no pointers.
+//======================================================================
+std::vector<char> FrozenSymbolTable::buildImage(const std::vector<std::vector<const SymbolEntry*>> &levels)
+{
+	static_assert(sizeof(SymbolEntry::ival) == sizeof(uint32_t), "value union must fit the image entry");
+
+	std::map<std::string, uint32_t> stringOffsets;
+	std::string strings;
+
+	auto addString = [&](const std::string &str) -> uint32_t
+	{
+		auto result = stringOffsets.insert(std::make_pair(str, (uint32_t)strings.size()));
+		if (result.second)
+			strings.append(str.c_str(), str.size() + 1);
+
+		return result.first->second;
+	};
+
+	std::vector<ImageLevel> imageLevels;
+	std::vector<ImageEntry> imageEntries;
+
+	for (auto level = levels.begin(); level != levels.end(); level++)
+	{
+		// sort by lexeme so each level can be binary searched
+		std::map<std::string, const SymbolEntry*> sorted;
+		for (auto iter = level->begin(); iter != level->end(); iter++)
+			sorted.insert(std::make_pair((*iter)->lexeme, *iter));
+
+		ImageLevel imageLevel;
+		imageLevel.firstEntry = (uint32_t)imageEntries.size();
+		imageLevel.entryCount = (uint32_t)sorted.size();
+		imageLevels.push_back(imageLevel);
+
+		for (auto iter = sorted.begin(); iter != sorted.end(); iter++)
+		{
+			const SymbolEntry *pEntry = iter->second;
+			ImageEntry entry;
+
+			entry.lexeme	= addString(pEntry->lexeme);
+			entry.srcFile	= addString(pEntry->srcFile);
+			entry.type		= pEntry->type;
+			entry.srcLine	= pEntry->srcLine;
+			entry.flags		= (pEntry->global ? imageGlobal : 0) | (pEntry->isReferenced ? imageReferenced : 0);
+			memcpy(&entry.value, &pEntry->ival, sizeof(entry.value));
+
+			imageEntries.push_back(entry);
+		}
+	}
+
+	ImageHeader header;
+	header.magic		= imageMagic;
+	header.version		= imageVersion;
+	header.levelCount	= (uint32_t)imageLevels.size();
+	header.entryCount	= (uint32_t)imageEntries.size();
+	header.stringBytes	= (uint32_t)strings.size();
+	header.imageBytes	= (uint32_t)(sizeof(header) + imageLevels.size() * sizeof(ImageLevel) + imageEntries.size() * sizeof(ImageEntry) + strings.size());
+
+	std::vector<char> image;
+	image.reserve(header.imageBytes);
+
+	image.insert(image.end(), (const char*)&header, (const char*)(&header + 1));
+	image.insert(image.end(), (const char*)imageLevels.data(), (const char*)(imageLevels.data() + imageLevels.size()));
+	image.insert(image.end(), (const char*)imageEntries.data(), (const char*)(imageEntries.data() + imageEntries.size()));
+	image.insert(image.end(), strings.begin(), strings.end());
+
+	return image;
+}
+
+//======================================================================
+// Write the image as-is. It is relocatable, so it can be loaded back
+// at any address with load() or fromImage().
+//======================================================================
+int FrozenSymbolTable::save(const char *filename) const
+{
+	assert(filename);
+
+	FILE *fout = fopen(filename, "wb");
+	if (!fout)
+		return -1;
+
+	size_t written = fwrite(getImage(), 1, getImageSize(), fout);
+
+	if (fclose(fout) != 0 || written != getImageSize())
+		return -1;
+
+	return 0;
+}
+
+//======================================================================
+// Check that an untrusted image is well formed before we use it. Every
+// offset is bounds checked so that lookups can never read outside it.
+//======================================================================
+bool FrozenSymbolTable::validateImage(const void *image, size_t size)
+{
+	if (!image || ((uintptr_t)image % alignof(ImageEntry)) != 0 || size < sizeof(ImageHeader))
+		return false;
+
+	const ImageHeader *pHeader = (const ImageHeader*)image;
+
+	// a byte-swapped magic means the image came from a machine of the other endianness
+	if (pHeader->magic != imageMagic || pHeader->version != imageVersion || pHeader->imageBytes != size)
+		return false;
+
+	uint64_t expected = sizeof(ImageHeader) + (uint64_t)pHeader->levelCount * sizeof(ImageLevel)
+		+ (uint64_t)pHeader->entryCount * sizeof(ImageEntry) + pHeader->stringBytes;
+
+	if (expected != size)
+		return false;
+
+	const ImageLevel *pLevels = (const ImageLevel*)(pHeader + 1);
+	const ImageEntry *pEntries = (const ImageEntry*)(pLevels + pHeader->levelCount);
+	const char *pStrings = (const char*)(pEntries + pHeader->entryCount);
+
+	// the string pool must end with a terminator so no string can run off the end
+	if (pHeader->stringBytes == 0 ? pHeader->entryCount != 0 : pStrings[pHeader->stringBytes - 1] != 0)
+		return false;
+
+	// levels must tile the entry array in order
+	uint32_t next = 0;
+	for (uint32_t level = 0; level < pHeader->levelCount; level++)
+	{
+		if (pLevels[level].firstEntry != next || pLevels[level].entryCount > pHeader->entryCount - next)
+			return false;
+
+		next += pLevels[level].entryCount;
+	}
+
+	if (next != pHeader->entryCount)
+		return false;
+
+	for (uint32_t index = 0; index < pHeader->entryCount; index++)
+	{
+		if (pEntries[index].lexeme >= pHeader->stringBytes || pEntries[index].srcFile >= pHeader->stringBytes)
+			return false;
+	}
+
+	return true;
+}
+
+//======================================================================
+// Use a caller-owned image, e.g. one compiled into the executable, in
+// place. The image must outlive every table built on it.
+//======================================================================
+std::shared_ptr<const FrozenSymbolTable> FrozenSymbolTable::fromImage(const void *image, size_t size)
+{
+	if (!validateImage(image, size))
+		return nullptr;
+
+	return std::make_shared<const FrozenSymbolTable>(image, nullptr);
+}
+
+//======================================================================
+// Map a saved image into memory and use it directly as a frozen base,
+// with no per-entry work. Returns nullptr if the file can't be mapped
+// or is not a valid image.
+//======================================================================
+std::shared_ptr<const FrozenSymbolTable> FrozenSymbolTable::load(const char *filename)
+{
+	assert(filename);
+
+	std::shared_ptr<const void> mapping;
+	size_t size;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return nullptr;
+	}
+
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(hFile);
+
+	if (!hMapping)
+		return nullptr;
+
+	const void *pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+
+	if (!pView)
+		return nullptr;
+
+	size = (size_t)fileSize.QuadPart;
+	mapping = std::shared_ptr<const void>(pView, [](const void *p) { UnmapViewOfFile(p); });
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	size = (size_t)st.st_size;
+	void *pView = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (pView == MAP_FAILED)
+		return nullptr;
+
+	mapping = std::shared_ptr<const void>(pView, [size](const void *p) { munmap(const_cast<void*>(p), size); });
+#endif
+
+	if (!validateImage(mapping.get(), size))
+		return nullptr;
+
+	return std::make_shared<const FrozenSymbolTable>(mapping.get(), mapping);
+}
@@ -3,8 +3,26 @@
 #ifndef __SYMBOL_H
 #define __SYMBOL_H
 
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <list>
+#include <vector>
+#include <memory>
+#include "memoryresource.h"
+
 #define ARRAY_SIZE(p)	(size_t(sizeof(p) / sizeof(p[0])))
 
+// scopes nested deeper than this are counted in the last slot
+#define MAX_STATS_DEPTH	16
+
+// probe counters cost a few increments per lookup, so they are opt in
+#ifdef PARSERKIT_SYMBOL_STATS
+#  define SYMBOL_STAT(x)	x
+#else
+#  define SYMBOL_STAT(x)
+#endif
+
 // Define symbol types
 enum
 {
@@ -79,36 +97,224 @@ struct Position
 	}
 };
 
+class SymbolTable;
+
+//======================================================================
+// An immutable, flattened snapshot of a SymbolTable, produced by
+// SymbolTable::freeze(). All scope levels, entries and strings live in a
+// single contiguous, offset-based image, so a frozen table is never
+// written to after construction and may be read from any number of
+// threads without locking. Share one between parsers by handing the same
+// std::shared_ptr to each SymbolTable(base) overlay.
+//======================================================================
+class FrozenSymbolTable
+{
+public:
+	static const unsigned npos = ~0u;
+
+	// image layout: ImageHeader | ImageLevel[levels] | ImageEntry[entries] | strings
+	struct ImageHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	levelCount;
+		uint32_t	entryCount;
+		uint32_t	stringBytes;
+		uint32_t	imageBytes;
+	};
+
+	struct ImageLevel
+	{
+		uint32_t	firstEntry;		// index of the first entry in this level
+		uint32_t	entryCount;		// entries are sorted by lexeme within a level
+	};
+
+	struct ImageEntry
+	{
+		uint32_t	lexeme;			// offset of the lexeme in the string pool
+		uint32_t	srcFile;		// offset of the source file name in the string pool
+		int32_t		type;
+		int32_t		srcLine;
+		uint32_t	flags;			// imageGlobal | imageReferenced
+		uint32_t	value;			// raw bits of the SymbolEntry value union
+	};
+
+	enum
+	{
+		imageMagic		= 0x54534B50,	// 'PKST'
+		imageVersion	= 1,
+
+		imageGlobal		= 1,
+		imageReferenced	= 2
+	};
+
+protected:
+	std::vector<char> m_storage;
+
+	// keeps a mapped or caller-supplied image alive, if we don't own a copy
+	std::shared_ptr<const void> m_pOwner;
+
+	const ImageHeader	*m_pHeader;
+	const ImageLevel	*m_pLevels;
+	const ImageEntry	*m_pEntries;
+	const char			*m_pStrings;
+
+	unsigned findInLevel(const ImageLevel &level, const char *lexeme) const;
+	void attach(const char *image);
+
+public:
+	explicit FrozenSymbolTable(std::vector<char> image);
+	FrozenSymbolTable(const void *image, std::shared_ptr<const void> owner);
+	virtual ~FrozenSymbolTable() = default;
+
+	// not copyable, entries are referred to by index into the image
+	FrozenSymbolTable(const FrozenSymbolTable&) = delete;
+	FrozenSymbolTable &operator=(const FrozenSymbolTable&) = delete;
+
+	unsigned getLevelCount() const		{ return m_pHeader->levelCount; }
+	unsigned getEntryCount() const		{ return m_pHeader->entryCount; }
+	unsigned levelBegin(unsigned level) const	{ return m_pLevels[level].firstEntry; }
+	unsigned levelEnd(unsigned level) const		{ return m_pLevels[level].firstEntry + m_pLevels[level].entryCount; }
+
+	const char *getImage() const		{ return (const char*)m_pHeader; }
+	size_t getImageSize() const			{ return m_pHeader->imageBytes; }
+
+	unsigned find(const char *lexeme) const;
+	unsigned findAtLevel(unsigned level, const char *lexeme) const;
+	unsigned reverse_lookup(int ival) const;
+
+	const char *getLexeme(unsigned index) const		{ return m_pStrings + m_pEntries[index].lexeme; }
+	const char *getSrcFile(unsigned index) const	{ return m_pStrings + m_pEntries[index].srcFile; }
+	SymbolType getType(unsigned index) const		{ return m_pEntries[index].type; }
+
+	void materialize(unsigned index, SymbolEntry &entry) const;
+
+	static std::vector<char> buildImage(const std::vector<std::vector<const SymbolEntry*>> &levels);
+
+	// serialization, images are native-endian and contain no pointers
+	int save(const char *filename) const;
+
+	static bool validateImage(const void *image, size_t size);
+	static std::shared_ptr<const FrozenSymbolTable> fromImage(const void *image, size_t size);
+	static std::shared_ptr<const FrozenSymbolTable> load(const char *filename);
+};
+
+//======================================================================
+// What a SymbolTable has been doing. Depth 0 is the global scope.
+//
+// The probe counters (lookups, hits, installs, levels walked, peak depth)
+// are only gathered when built with PARSERKIT_SYMBOL_STATS; entries and
+// bytes are a snapshot taken by getStats() and are always available.
+//======================================================================
+struct SymbolTableStats
+{
+	struct Level
+	{
+		uint64_t lookups;		// lookups issued while this was the innermost depth
+		uint64_t hits;			// lookups satisfied at this depth
+		uint64_t installs;		// installs while this was the innermost depth
+		size_t entries;			// entries currently at this depth
+	};
+
+	Level levels[MAX_STATS_DEPTH];
+
+	uint64_t lookups;			// total lookup() calls
+	uint64_t misses;			// lookups not found anywhere
+	uint64_t baseHits;			// lookups satisfied by the frozen base
+	uint64_t levelsWalked;		// scope levels probed over all lookups
+	uint64_t installs;			// total install() calls
+	unsigned peakDepth;			// most scope levels seen at once
+
+	unsigned depth;				// scope levels right now
+	size_t entries;				// entries over all levels, excluding the base
+	size_t bytesUsed;			// estimated heap bytes held by those entries
+
+	double averageWalk() const	{ return lookups ? (double)levelsWalked / lookups : 0.0; }
+	double hitRate(unsigned level) const;
+};
+
 // Define symbol table class
 class SymbolTable
 {
 protected:
-	using SymbolMap = std::map<std::string, SymbolEntry>;
-	using SymbolStack = std::list<SymbolMap>;
+	using SymbolMap = std::map<std::string, SymbolEntry, std::less<std::string>, ResourceAllocator<std::pair<const std::string, SymbolEntry>>>;
+	using SymbolStack = std::list<SymbolMap, ResourceAllocator<SymbolMap>>;
+	using PromotedMap = std::map<unsigned, SymbolEntry, std::less<unsigned>, ResourceAllocator<std::pair<const unsigned, SymbolEntry>>>;
+
+	// where our scope levels get their nodes from, lexemes still use the global heap
+	MemoryResource *m_pResource;
 
 	SymbolStack m_symbolTable;
 	SymbolEntry *m_pCurrentSymbol;
 
+	// shared, read-only base layer beneath our own scope levels
+	std::shared_ptr<const FrozenSymbolTable> m_base;
+
+	// private copy-on-write copies of base entries, keyed by base index
+	PromotedMap m_promoted;
+
+	SymbolEntry *promote(unsigned index);
+	SymbolEntry *currentGlobal();
+
+	// counters, only written to when PARSERKIT_SYMBOL_STATS is defined
+	SymbolTableStats m_stats;
+
 public:
 	using stack_iterator = SymbolStack::iterator;
 	using map_iterator = SymbolMap::iterator;
 
+	//
+	// Stateless iterator over the global (outermost) scope: our own global
+	// entries followed by any base globals they do not shadow. Base
+	// entries are presented as copies, the shared image is never written.
+	//
+	class global_iterator
+	{
+		const SymbolTable *m_pTable;
+		SymbolMap::const_iterator m_mapIter;
+		unsigned m_baseIndex;
+		SymbolEntry m_baseEntry;
+
+		void settle();
+
+		// getFirstGlobal()/getNextGlobal() hand out the entry itself
+		friend class SymbolTable;
+
+	public:
+		global_iterator() : m_pTable(nullptr), m_baseIndex(FrozenSymbolTable::npos) {}
+		global_iterator(const SymbolTable *pTable, bool atEnd);
+
+		const SymbolEntry &operator*() const;
+		const SymbolEntry *operator->() const	{ return &**this; }
+
+		global_iterator &operator++();
+
+		bool operator==(const global_iterator &rhs) const { return m_mapIter == rhs.m_mapIter && m_baseIndex == rhs.m_baseIndex; }
+		bool operator!=(const global_iterator &rhs) const { return !(*this == rhs); }
+	};
+
 protected:
-	map_iterator m_globalIter;
+	global_iterator m_globalIter;
 
 	const char *getTypeString(int type);
 
 public:
 	SymbolTable();
+	explicit SymbolTable(MemoryResource *pResource);
+	explicit SymbolTable(std::shared_ptr<const FrozenSymbolTable> base, MemoryResource *pResource = nullptr);
 	virtual ~SymbolTable() = default;
 
 	SymbolEntry *lookup(const char *lexeme);
 	SymbolEntry *reverse_lookup(int ival);
 	SymbolEntry *install(const char *lexeme, SymbolType type);
 	
+	// deprecated, prefer the stateless begin_globals()/end_globals()
 	SymbolEntry *getFirstGlobal();
 	SymbolEntry *getNextGlobal();
 
+	global_iterator begin_globals() const	{ return global_iterator(this, false); }
+	global_iterator end_globals() const		{ return global_iterator(this, true); }
+
 	// iterators for accessing the symbol table stack
 	stack_iterator begin_stack()	{ return m_symbolTable.begin(); }
 	stack_iterator end_stack()		{ return m_symbolTable.end(); }
@@ -118,8 +324,26 @@ public:
 	void push();
 	void pop();
 
+	// empty again, down to one global scope over the same base; freed
+	// nodes go back to the resource, where a PoolResource keeps them
+	void reset();
+
+	// snapshot every level, including any base, into a shareable image
+	std::shared_ptr<const FrozenSymbolTable> freeze() const;
+	const std::shared_ptr<const FrozenSymbolTable> &getBase() const { return m_base; }
+
+	MemoryResource *getResource() const { return m_pResource; }
+
+	// write freeze() to disk, reload with FrozenSymbolTable::load()
+	int saveImage(const char *filename) const { return freeze()->save(filename); }
+
 	void dumpContents();
 	int dumpUnreferencedSymbolsAtCurrentLevel();
+
+	static bool statsEnabled();
+	SymbolTableStats getStats() const;
+	void resetStats();
+	void dumpStats() const;
 };
 
 #endif	// __SYMBOL_H
@@ -0,0 +1,226 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <string.h>
+#include "syntaxtree.h"
+
+//======================================================================
+//
+//======================================================================
+SyntaxTree::SyntaxTree(MemoryResource *pResource)
+	: m_nodes(pResource)
+	, m_open(pResource)
+{
+	m_textEnd = 0;
+}
+
+//
+void SyntaxTree::append(int kind, unsigned offset, unsigned trivia, unsigned length, bool token)
+{
+	Node node;
+	node.kind	= kind;
+	node.end	= (unsigned)m_nodes.size() + 1;
+	node.parent	= m_open.empty() ? NO_NODE : m_open.back();
+	node.offset	= offset;
+	node.trivia	= trivia;
+	node.length	= length;
+	node.token	= token;
+
+	m_nodes.push_back(node);
+}
+
+//
+unsigned SyntaxTree::openNode(int kind)
+{
+	unsigned index = (unsigned)m_nodes.size();
+	append(kind, m_textEnd, 0, 0, false);
+	m_open.push_back(index);
+
+	return index;
+}
+
+//======================================================================
+// The node now spans its children, and its text runs from its first
+// token to the last one read
+//======================================================================
+void SyntaxTree::closeNode()
+{
+	assert(!m_open.empty());
+	if (m_open.empty())
+		return;
+
+	unsigned index = m_open.back();
+	m_open.pop_back();
+
+	Node &node = m_nodes[index];
+	node.end = (unsigned)m_nodes.size();
+
+	for (unsigned i = index + 1; i < node.end; i++)
+	{
+		if (m_nodes[i].token)
+		{
+			node.offset = m_nodes[i].offset + m_nodes[i].trivia;
+			break;
+		}
+	}
+
+	node.length = m_textEnd - node.offset;
+}
+
+//======================================================================
+// [start, end) is where the lexer found the token in the text. Whatever
+// lies between the last token and this one is its trivia.
+//======================================================================
+unsigned SyntaxTree::addToken(int kind, size_t start, size_t end)
+{
+	if (end < m_textEnd)
+		end = m_textEnd;
+	if (start < m_textEnd)
+		start = m_textEnd;
+	if (start > end)
+		start = end;
+
+	unsigned index = (unsigned)m_nodes.size();
+	append(kind, m_textEnd, (unsigned)(start - m_textEnd), (unsigned)(end - start), true);
+	m_textEnd = (unsigned)end;
+
+	return index;
+}
+
+//
+void SyntaxTree::closeAll()
+{
+	while (!m_open.empty())
+		closeNode();
+}
+
+//
+SyntaxTree::Mark SyntaxTree::getMark() const
+{
+	Mark mark;
+	mark.nodes		= m_nodes.size();
+	mark.open		= m_open.size();
+	mark.textEnd	= m_textEnd;
+
+	return mark;
+}
+
+//======================================================================
+// Drop what was added since the mark; the text stays, it is still the
+// input
+//======================================================================
+void SyntaxTree::rewind(const Mark &mark)
+{
+	if (mark.nodes < m_nodes.size())
+		m_nodes.resize(mark.nodes);
+	if (mark.open < m_open.size())
+		m_open.resize(mark.open);
+
+	m_textEnd = mark.textEnd;
+}
+
+//
+void SyntaxTree::clear()
+{
+	m_nodes.clear();
+	m_open.clear();
+	m_text.clear();
+	m_textEnd = 0;
+}
+
+//
+LiteralString SyntaxTree::getText(unsigned index) const
+{
+	const Node &node = m_nodes[index];
+
+	LiteralString text;
+	text.text	= m_text.data() + node.offset + node.trivia;
+	text.length	= node.length;
+
+	return text;
+}
+
+//
+LiteralString SyntaxTree::getTrivia(unsigned index) const
+{
+	const Node &node = m_nodes[index];
+
+	LiteralString text;
+	text.text	= m_text.data() + node.offset;
+	text.length	= node.trivia;
+
+	return text;
+}
+
+//======================================================================
+//
+//======================================================================
+void SyntaxTree::write(FILE *fp) const
+{
+	for (auto iter = m_nodes.begin(); iter != m_nodes.end(); iter++)
+	{
+		if (iter->token)
+			fwrite(m_text.data() + iter->offset, 1, iter->trivia + iter->length, fp);
+	}
+
+	fwrite(m_text.data() + m_textEnd, 1, m_text.size() - m_textEnd, fp);
+}
+
+//
+std::string SyntaxTree::toString() const
+{
+	std::string text;
+	text.reserve(m_text.size());
+
+	for (auto iter = m_nodes.begin(); iter != m_nodes.end(); iter++)
+	{
+		if (iter->token)
+			text.append(m_text.data() + iter->offset, iter->trivia + iter->length);
+	}
+
+	text.append(m_text.data() + m_textEnd, m_text.size() - m_textEnd);
+	return text;
+}
+
+//======================================================================
+//
+//======================================================================
+void SyntaxTree::dump(FILE *fp, const char *(*name)(int kind)) const
+{
+	std::vector<unsigned> depth(m_nodes.size(), 0);
+
+	for (unsigned i = 0; i < m_nodes.size(); i++)
+	{
+		const Node &node = m_nodes[i];
+		if (node.parent != NO_NODE)
+			depth[i] = depth[node.parent] + 1;
+
+		fprintf(fp, "%*s", depth[i] * 2, "");
+
+		if (node.token)
+		{
+			fputc('\'', fp);
+			LiteralString text = getText(i);
+			for (unsigned c = 0; c < text.length; c++)
+			{
+				if (text.text[c] == '\n')
+					fputs("\\n", fp);
+				else if (text.text[c] == '\t')
+					fputs("\\t", fp);
+				else
+					fputc(text.text[c], fp);
+			}
+			fputc('\'', fp);
+		}
+		else
+		{
+			const char *kindName = name ? name(node.kind) : nullptr;
+			if (kindName)
+				fputs(kindName, fp);
+			else
+				fprintf(fp, "%d", node.kind);
+		}
+
+		fputc('\n', fp);
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef __SYNTAXTREE_H
+#define __SYNTAXTREE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "literalpool.h"
+#include "memoryresource.h"
+
+#define NO_NODE		((unsigned)-1)
+
+//======================================================================
+// A concrete syntax tree, built by a parser as it goes, see
+// BaseParser::setSyntaxTree(). Nodes sit in one array in preorder: a
+// node's children follow it, up to its end, so a subtree is a span of
+// the array and a walk is a loop over it,
+//
+//	for (unsigned child = tree.firstChild(node); child != NO_NODE; child = tree.nextSibling(child))
+//
+// The tree keeps the text the lexer read. Each token has its own text
+// and the whitespace, comments and anything skipped in front of it, so
+// writing the tokens out in order gives back the input. Dropping the
+// tree frees two blocks, the nodes, which come from pResource, and the
+// text.
+//======================================================================
+class SyntaxTree
+{
+public:
+	struct Node
+	{
+		int kind;				// the token, or what openNode() was given
+		unsigned end;			// one past the last node under this one
+		unsigned parent;		// NO_NODE at the top
+		unsigned offset;		// into the text, where the trivia starts
+		unsigned trivia;		// bytes of it, only tokens have any
+		unsigned length;		// then the token's own text, or the node's first token to its last
+		bool token;
+	};
+
+	// where the tree was, see rewind()
+	struct Mark
+	{
+		size_t nodes;
+		size_t open;
+		unsigned textEnd;
+	};
+
+protected:
+	std::vector<Node, ResourceAllocator<Node>> m_nodes;
+	std::vector<unsigned, ResourceAllocator<unsigned>> m_open;		// nodes not yet closed
+	std::string m_text;
+	unsigned m_textEnd;			// the end of the last token
+
+	void append(int kind, unsigned offset, unsigned trivia, unsigned length, bool token);
+
+public:
+	explicit SyntaxTree(MemoryResource *pResource = nullptr);
+	virtual ~SyntaxTree() = default;
+
+	// building, normally through BaseParser
+	unsigned openNode(int kind);
+	void closeNode();
+	unsigned addToken(int kind, size_t start, size_t end);
+	void closeAll();
+
+	Mark getMark() const;
+	void rewind(const Mark &mark);
+
+	void clear();
+
+	// the lexer appends what it reads here while the tree is built
+	std::string *getCaptureBuffer()			{ return &m_text; }
+
+	size_t size() const						{ return m_nodes.size(); }
+	bool empty() const						{ return m_nodes.empty(); }
+	const Node &operator[](unsigned index) const	{ return m_nodes[index]; }
+	const std::string &getSource() const	{ return m_text; }
+	unsigned getOpenDepth() const			{ return (unsigned)m_open.size(); }
+
+	unsigned firstChild(unsigned index) const
+	{
+		return index + 1 < m_nodes[index].end ? index + 1 : NO_NODE;
+	}
+
+	unsigned nextSibling(unsigned index) const
+	{
+		unsigned parent = m_nodes[index].parent;
+		unsigned next = m_nodes[index].end;
+		unsigned limit = parent == NO_NODE ? (unsigned)m_nodes.size() : m_nodes[parent].end;
+		return next < limit ? next : NO_NODE;
+	}
+
+	// the token's text or the node's, and what came before a token
+	LiteralString getText(unsigned index) const;
+	LiteralString getTrivia(unsigned index) const;
+
+	// the input again, from the tokens; what follows the last one is
+	// written too
+	void write(FILE *fp) const;
+	std::string toString() const;
+
+	// one line per node, indented; tokens show their text and nodes their
+	// kind, named by name() if given
+	void dump(FILE *fp, const char *(*name)(int kind) = nullptr) const;
+};
+
+#endif	// __SYNTAXTREE_H
@@ -0,0 +1,218 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../batchparser.h"
+#include "testy/test.h"
+
+namespace {
+
+enum { TV_TRUE = TV_USER, TV_FALSE };
+
+TokenTable g_tokenTable[] = {
+    { "true",  TV_TRUE  },
+    { "false", TV_FALSE },
+    { nullptr, TV_DONE  }
+};
+
+// Counts "true" tokens up to EOF, reports an error for each "false" and
+// a warning for anything else. Errors go through the batch's message
+// handler, so the default exiting yyerror() is never reached.
+class CountingParser : public BaseParser
+{
+public:
+    unsigned m_count = 0;
+
+    CountingParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        m_count = 0;
+
+        while (lookahead != TV_DONE)
+        {
+            if (lookahead == TV_TRUE)
+                m_count++;
+            else if (lookahead == TV_FALSE)
+                yyerror("unexpected false");
+            else
+                yywarning("ignoring token");
+
+            lookahead = m_lexer->yylex();
+        }
+
+        return 0;
+    }
+};
+
+std::unique_ptr<BaseParser> makeCounter()
+{
+    return std::unique_ptr<BaseParser>(new CountingParser());
+}
+
+std::string repeat(const char *word, int count)
+{
+    std::string text;
+    for (int i = 0; i < count; i++)
+        (text += word) += " ";
+    return text;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_batchparser()
+{
+    MODULE("BatchParser");
+
+    SUITE("results in input order");
+    {
+        BatchParser batch(makeCounter, 4);
+
+        const int inputs = 40;
+        std::vector<unsigned> counts(inputs, ~0u);
+
+        for (int i = 0; i < inputs; i++)
+        {
+            // vary sizes so the largest-first deal reorders them
+            std::string text = repeat("true", (i * 7) % 23 + 1);
+            batch.addData(("input" + std::to_string(i)).c_str(), text.c_str(), text.size());
+        }
+
+        batch.setCompletion([&counts](BaseParser &parser, size_t index, BatchResult &)
+        {
+            counts[index] = static_cast<CountingParser&>(parser).m_count;
+        });
+
+        TEST(batch.run() == 0);
+
+        const std::vector<BatchResult> &results = batch.getResults();
+        TEST(results.size() == (size_t)inputs);
+
+        bool ordered = true;
+        for (int i = 0; i < inputs; i++)
+        {
+            ordered = ordered && results[i].name == "input" + std::to_string(i);
+            ordered = ordered && results[i].status == BatchResult::Ok;
+            ordered = ordered && counts[i] == (unsigned)((i * 7) % 23 + 1);
+        }
+        TEST(ordered);
+    }
+
+    SUITE("diagnostics are captured per input");
+    {
+        BatchParser batch(makeCounter, 2);
+
+        std::string good = "true true";
+        std::string bad = "true false true false";
+        std::string noisy = "true 42 true";
+
+        batch.addData("good", good.c_str(), good.size());
+        batch.addData("bad", bad.c_str(), bad.size());
+        batch.addData("noisy", noisy.c_str(), noisy.size());
+
+        TEST(batch.run() == 1);
+
+        const std::vector<BatchResult> &results = batch.getResults();
+        TEST(results[0].status == BatchResult::Ok);
+        TEST(results[0].messages.empty());
+
+        // abandoned at the first error
+        TEST(results[1].status == BatchResult::Failed);
+        TEST(results[1].errors == 1);
+        TEST(results[1].messages.size() == 1);
+        TEST(results[1].messages[0].find("unexpected false") != std::string::npos);
+        TEST(results[1].messages[0].back() != '\n');
+
+        TEST(results[2].status == BatchResult::Ok);
+        TEST(results[2].warnings == 1);
+
+        TEST(batch.getStats().errors == 1);
+        TEST(batch.getStats().warnings == 1);
+    }
+
+    SUITE("recovery when not stopping on error");
+    {
+        BatchParser batch(makeCounter, 1);
+        batch.setStopOnError(false);
+
+        std::string bad = "true false true false";
+        batch.addData("bad", bad.c_str(), bad.size());
+
+        unsigned count = 0;
+        batch.setCompletion([&count](BaseParser &parser, size_t, BatchResult &)
+        {
+            count = static_cast<CountingParser&>(parser).m_count;
+        });
+
+        TEST(batch.run() == 2);
+        TEST(batch.getResults()[0].status == BatchResult::Failed);
+        TEST(batch.getResults()[0].messages.size() == 2);
+        TEST(count == 2);
+    }
+
+    SUITE("files");
+    {
+        const char *path = "batch_test_input.txt";
+        FILE *fp = fopen(path, "w");
+        TEST(fp != nullptr);
+        if (fp)
+        {
+            fputs("true true true", fp);
+            fclose(fp);
+        }
+
+        BatchParser batch(makeCounter, 2);
+        batch.addFile(path);
+        batch.addFile("no/such/batch_file.txt");
+
+        TEST(batch.run() == 1);
+
+        const std::vector<BatchResult> &results = batch.getResults();
+        TEST(results[0].status == BatchResult::Ok);
+        TEST(results[0].bytes == 14);
+        TEST(results[1].status == BatchResult::OpenFailed);
+        TEST(results[1].messages.size() == 1);
+
+        remove(path);
+    }
+
+    SUITE("statistics");
+    {
+        BatchParser batch(makeCounter, 3);
+
+        size_t bytes = 0;
+        for (int i = 0; i < 12; i++)
+        {
+            std::string text = repeat("true", 50 + i);
+            batch.addData("input", text.c_str(), text.size());
+            bytes += text.size();
+        }
+
+        batch.run();
+
+        const BatchStats &stats = batch.getStats();
+        TEST(stats.inputs == 12);
+        TEST(stats.bytes == bytes);
+        TEST(stats.workers == 3);
+        TEST(stats.parsed.size() == 3);
+        TEST(stats.parsed[0] + stats.parsed[1] + stats.parsed[2] == 12);
+        TEST(stats.wallSeconds > 0);
+        TEST(stats.utilization(0) >= 0 && stats.utilization(3) == 0);
+
+        // more workers than inputs are not started
+        BatchParser small(makeCounter, 8);
+        small.addData("one", "true", 4);
+        small.run();
+        TEST(small.getStats().workers == 1);
+
+        // run() again reparses from scratch
+        TEST(small.run() == 0);
+        TEST(small.getResults().size() == 1);
+        TEST(small.getStats().inputs == 1);
+    }
+}
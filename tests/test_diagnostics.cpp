@@ -0,0 +1,215 @@
+#include <cstring>
+#include <string>
+#include "../baseparser.h"
+#include "testy/test.h"
+
+namespace {
+
+enum { TV_TRUE = TV_USER, TV_FALSE, TV_MAYBE };
+
+TokenTable g_tokenTable[] = {
+    { "true",  TV_TRUE  },
+    { "false", TV_FALSE },
+    { "maybe", TV_MAYBE },
+    { nullptr, TV_DONE  }
+};
+
+// Keeps what the legacy path hands the lexer instead of exiting
+class CapturingLexer : public LexicalAnalyzer
+{
+public:
+    std::string m_last;
+
+    using LexicalAnalyzer::LexicalAnalyzer;
+    void yyerror(const char *s) override { m_last = s; }
+    void yywarning(const char *s) override { m_last = s; }
+};
+
+// Reads tokens to EOF: "false" is an error with code 7, "maybe" a warning
+// and a string literal is just skipped. Counts the tokens it got through.
+class DiagParser : public BaseParser
+{
+public:
+    unsigned m_tokens = 0;
+
+    DiagParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new CapturingLexer(g_tokenTable, this, &yylval));
+    }
+
+    CapturingLexer *lexer() { return static_cast<CapturingLexer *>(m_lexer.get()); }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        m_tokens = 0;
+
+        while (lookahead != TV_DONE)
+        {
+            if (lookahead == TV_FALSE)
+                report(Severity::Error, 7, "saw %s number %d", "false", (int)m_tokens);
+            else if (lookahead == TV_MAYBE)
+                yywarning("undecided");
+
+            m_tokens++;
+            lookahead = m_lexer->yylex();
+        }
+
+        return 0;
+    }
+};
+
+// Keeps the fully rendered text
+class RenderingSink : public DiagnosticSink
+{
+public:
+    std::string m_text;
+
+    void report(const Diagnostic &diag) override { m_text = diag.toString(); }
+};
+
+// Gives up on the first diagnostic
+class ImpatientSink : public DiagnosticSink
+{
+public:
+    void report(const Diagnostic &) override { throw ParseAbort(); }
+};
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_diagnostics()
+{
+    MODULE("Diagnostics");
+
+    SUITE("structured records");
+    {
+        DiagParser parser;
+        CollectingSink sink;
+        parser.setDiagnosticSink(&sink);
+
+        TEST(parser.parseData(dup("true maybe\ntrue false"), "input.txt", nullptr) == 0);
+        TEST(!parser.wasAborted());
+        TEST(parser.getErrorCount() == 1);
+        TEST(parser.getWarningCount() == 1);
+
+        const std::vector<CollectingSink::Record> &records = sink.getRecords();
+        TEST(records.size() == 2);
+        TEST(records[0].severity == Severity::Warning);
+        TEST(records[0].code == 0);
+        TEST(records[0].file == "input.txt");
+        TEST(records[0].line == 1);
+        TEST(records[0].message == "undecided");
+        TEST(records[1].severity == Severity::Error);
+        TEST(records[1].code == 7);
+        TEST(records[1].line == 2);
+        TEST(records[1].message == "saw false number 3");
+
+        // the console never saw a thing
+        TEST(parser.lexer()->m_last.empty());
+    }
+
+    SUITE("legacy default");
+    {
+        DiagParser parser;
+        parser.parseData(dup("false"), "old.txt", nullptr);
+
+        TEST(parser.getErrorCount() == 1);
+        TEST(parser.lexer()->m_last.find("old.txt(1) : error near column") == 0);
+        TEST(parser.lexer()->m_last.find(": saw false number 0\r\n") != std::string::npos);
+    }
+
+    SUITE("counting sink");
+    {
+        DiagParser parser;
+        CountingSink sink;
+        parser.setDiagnosticSink(&sink);
+
+        parser.parseData(dup("maybe maybe false maybe"), "test", nullptr);
+        TEST(sink.getCount(Severity::Warning) == 3);
+        TEST(sink.getCount(Severity::Error) == 1);
+        TEST(sink.getCount(Severity::Note) == 0);
+    }
+
+    SUITE("error limit");
+    {
+        DiagParser parser;
+        CountingSink sink;
+        parser.setDiagnosticSink(&sink);
+        parser.setErrorLimit(2);
+
+        TEST(parser.parseData(dup("false true false true false false"), "test", nullptr) == -1);
+        TEST(parser.wasAborted());
+        TEST(parser.getErrorCount() == 2);
+        TEST(parser.m_tokens == 2);
+
+        // the abandoned input was closed, the next parse starts clean
+        parser.setErrorLimit(0);
+        TEST(parser.parseData(dup("true true true"), "next", nullptr) == 0);
+        TEST(!parser.wasAborted());
+        TEST(parser.m_tokens == 3);
+    }
+
+    SUITE("fatal and sink aborts");
+    {
+        DiagParser parser;
+        CountingSink counter;
+        parser.setDiagnosticSink(&counter);
+
+        // reported outside a parse there is nothing to unwind
+        parser.report(Severity::Fatal, 1, "before parsing");
+        TEST(counter.getCount(Severity::Fatal) == 1);
+        TEST(parser.getErrorCount() == 1);
+
+        ImpatientSink impatient;
+        parser.setDiagnosticSink(&impatient);
+        TEST(parser.parseData(dup("true maybe true"), "test", nullptr) == -1);
+        TEST(parser.wasAborted());
+        TEST(parser.m_tokens == 1);
+    }
+
+    SUITE("lexer errors reach the sink");
+    {
+        CollectingSink sink;
+
+        // LexicalAnalyzer::yyerror() would exit here without a sink
+        class PlainParser : public DiagParser
+        {
+        public:
+            PlainParser() { m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval)); }
+        } plain;
+        plain.setDiagnosticSink(&sink);
+
+        TEST(plain.parseData(dup("true \"unterminated\ntrue"), "test", nullptr) == 0);
+        TEST(sink.getRecords().size() == 1);
+        TEST(sink.getRecords()[0].message == "missing quote");
+        TEST(plain.getErrorCount() == 1);
+    }
+
+    SUITE("rendering");
+    {
+        DiagParser parser;
+        RenderingSink sink;
+        parser.setDiagnosticSink(&sink);
+
+        // longer than any of the stack buffers
+        std::string longText(1000, 'x');
+        std::string file("far.txt");
+        Position pos(file, 12, 5);
+        parser.report(Severity::Note, 3, pos, "%s!", longText.c_str());
+
+        TEST(sink.m_text == "far.txt(12) : note near column 5: " + longText + "!");
+        TEST(parser.getErrorCount() == 0);
+        TEST(parser.getWarningCount() == 0);
+
+        TEST(strcmp(severityName(Severity::Fatal), "fatal error") == 0);
+    }
+}
@@ -1,7 +1,20 @@
 #include <cstring>
+#include <cstdio>
+#include <string>
 #include "../baseparser.h"
 #include "testy/test.h"
 
+#ifdef _WIN32
+#  include <direct.h>
+#  define makeDir(path) _mkdir(path)
+#  define removeDir(path) _rmdir(path)
+#else
+#  include <unistd.h>
+#  include <sys/stat.h>
+#  define makeDir(path) mkdir(path, 0755)
+#  define removeDir(path) rmdir(path)
+#endif
+
 namespace {
 
 enum { TV_TRUE = TV_USER, TV_FALSE };
@@ -38,6 +51,23 @@ char *dup(const char *text)
     return buf;
 }
 
+void writeFile(const char *path, const char *text)
+{
+    FILE *fp = fopen(path, "wt");
+    fputs(text, fp);
+    fclose(fp);
+}
+
+std::string currentDir()
+{
+    char buf[1024];
+#ifdef _WIN32
+    return _getcwd(buf, sizeof(buf)) ? buf : "";
+#else
+    return getcwd(buf, sizeof(buf)) ? buf : "";
+#endif
+}
+
 } // namespace
 
 //------------------------------------------------------
@@ -96,4 +126,131 @@ void test_lexer()
         TEST(fixture.lexer.yylex() == TV_INTVAL);
         TEST(fixture.yylval.ival == 42);
     }
+
+    SUITE("include resolution");
+    {
+        makeDir("test_inc");
+        makeDir("test_inc/sub");
+        makeDir("test_inc/lib");
+        writeFile("test_inc/main.txt", "1");
+        writeFile("test_inc/sub/inc.txt", "2");
+        writeFile("test_inc/lib/lib.txt", "3");
+
+        std::string cwd = currentDir();
+
+        LexerFixture fixture;
+        char name[] = "test_inc/main.txt";
+        TEST(fixture.lexer.pushFile(name) == 0);
+        TEST(strcmp(name, "test_inc/main.txt") == 0);
+
+        // relative to the including file, not the working directory
+        TEST(fixture.lexer.pushFile("sub/inc.txt") == 0);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 2);
+
+        // a failed include leaves the current file in place
+        TEST(fixture.lexer.pushFile("lib.txt") != 0);
+        TEST(fixture.lexer.getFile() == "sub/inc.txt");
+
+        TEST(fixture.lexer.addIncludePath("test_inc/lib") == 0);
+        TEST(fixture.lexer.addIncludePath("test_inc/missing") != 0);
+        TEST(fixture.lexer.pushFile("lib.txt") == 0);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 3);
+
+        // back out to main.txt once both includes are done
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 1);
+        TEST(fixture.lexer.yylex() == TV_DONE);
+
+        TEST(currentDir() == cwd);
+
+        remove("test_inc/lib/lib.txt");
+        remove("test_inc/sub/inc.txt");
+        remove("test_inc/main.txt");
+        removeDir("test_inc/lib");
+        removeDir("test_inc/sub");
+        removeDir("test_inc");
+    }
+
+    SUITE("checkpoints in memory");
+    {
+        LexerFixture fixture;
+        fixture.lexer.setData(dup("1 2\n3 4"), "test", nullptr);
+
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        std::unique_ptr<LexicalAnalyzer::Checkpoint> cp = fixture.lexer.checkpoint();
+
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 3);
+        TEST(fixture.lexer.getLineNumber() == 2);
+
+        TEST(fixture.lexer.restore(*cp));
+        TEST(fixture.lexer.getLineNumber() == 1);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 2);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 3);
+        TEST(fixture.lexer.getLineNumber() == 2);
+
+        // not once the buffer it was taken in has gone
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.yylex() == TV_DONE);
+        TEST(!fixture.lexer.restore(*cp));
+    }
+
+    SUITE("checkpoints in files");
+    {
+        writeFile("test_checkpoint.txt", "10 20\n30");
+
+        LexerFixture fixture;
+        TEST(fixture.lexer.pushFile("test_checkpoint.txt") == 0);
+
+        // the lexer has read one character past 10 and put it back
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        std::unique_ptr<LexicalAnalyzer::Checkpoint> cp = fixture.lexer.checkpoint();
+        int column = fixture.lexer.getColumn();
+
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 30);
+
+        TEST(fixture.lexer.restore(*cp));
+        TEST(fixture.lexer.getColumn() == column);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 20);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.yylval.ival == 30);
+        TEST(fixture.lexer.getLineNumber() == 2);
+        TEST(fixture.lexer.yylex() == TV_DONE);
+
+        remove("test_checkpoint.txt");
+    }
+
+    SUITE("bytes consumed");
+    {
+        LexerFixture fixture;
+        fixture.lexer.setData(dup("12 345"), "test", nullptr);
+        TEST(fixture.lexer.getBytesConsumed() == 0);
+
+        // the space after 12 was read and put back
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.getBytesConsumed() == 2);
+
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.yylex() == TV_DONE);
+        TEST(fixture.lexer.getBytesConsumed() == 6);
+
+        // and on through the next input
+        writeFile("test_consumed.txt", "10 20\n30");
+        TEST(fixture.lexer.pushFile("test_consumed.txt") == 0);
+        TEST(fixture.lexer.yylex() == TV_INTVAL);
+        TEST(fixture.lexer.getBytesConsumed() == 8);
+        while (fixture.lexer.yylex() != TV_DONE)
+            ;
+        TEST(fixture.lexer.getBytesConsumed() == 14);
+
+        remove("test_consumed.txt");
+    }
 }
@@ -0,0 +1,265 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <chrono>
+#include "../baseparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+// list: '(' { list | ID } ')'
+class ListParser : public BaseParser
+{
+public:
+    CollectingSink sink;
+    bool speculative;
+    bool slow;
+    unsigned atoms;
+
+    ListParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        setDiagnosticSink(&sink);
+        speculative = false;
+        slow = false;
+        atoms = 0;
+    }
+
+    void DoList()
+    {
+        NestingScope nesting(this);
+
+        match('(');
+        while (lookahead != ')' && lookahead != TV_DONE)
+        {
+            if (lookahead == '(')
+                DoList();
+            else
+                DoAtom();
+        }
+        match(')');
+    }
+
+    void DoAtom()
+    {
+        if (slow)
+        {
+            auto start = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(50))
+                ;
+        }
+
+        atoms++;
+        match(TV_ID);
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        if (speculative && speculate([this]() { DoList(); }))
+            DoList();
+        else if (!speculative)
+            DoList();
+        return 0;
+    }
+
+    bool fatal() const
+    {
+        return sink.getRecords().size() == 1 && sink.getRecords()[0].severity == Severity::Fatal;
+    }
+};
+
+std::string nested(int depth)
+{
+    return std::string(depth, '(') + "x" + std::string(depth, ')');
+}
+
+std::string flat(int count)
+{
+    std::string text = "(";
+    for (int i = 0; i < count; i++)
+        text += " a" + std::to_string(i);
+    return text + ")";
+}
+
+int parse(ListParser &parser, const std::string &text)
+{
+    std::vector<char> buf(text.begin(), text.end());
+    buf.push_back(0);
+    return parser.parseData(buf.data(), "test", nullptr);
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_limits()
+{
+    MODULE("Parse limits");
+
+    SUITE("none by default");
+    {
+        ListParser parser;
+        TEST(parse(parser, nested(200)) == 0);
+        TEST(parse(parser, flat(1000)) == 0);
+        TEST(parser.getLimitExceeded() == ParseLimits::None);
+        TEST(parser.getErrorCount() == 0);
+    }
+
+    SUITE("depth");
+    {
+        ListParser parser;
+        ParseLimits limits;
+        limits.maxDepth = 50;
+        parser.setLimits(limits);
+
+        TEST(parse(parser, nested(50)) == 0);
+        TEST(parser.getLimitExceeded() == ParseLimits::None);
+
+        TEST(parse(parser, nested(51)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Depth);
+        TEST(parser.wasAborted());
+        TEST(parser.fatal());
+
+        // the count unwinds with the parse
+        TEST(parse(parser, nested(50)) == 0);
+        TEST(parser.getLimitExceeded() == ParseLimits::None);
+    }
+
+    SUITE("depth while speculating");
+    {
+        ListParser parser;
+        parser.speculative = true;
+
+        ParseLimits limits;
+        limits.maxDepth = 10;
+        parser.setLimits(limits);
+
+        // ends the parse rather than failing the alternative
+        TEST(parse(parser, nested(20)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Depth);
+        TEST(parser.fatal());
+        TEST(!parser.isSpeculating());
+    }
+
+    SUITE("tokens");
+    {
+        ListParser parser;
+        ParseLimits limits;
+        limits.maxTokens = 10;
+        limits.checkInterval = 4;
+        parser.setLimits(limits);
+
+        TEST(parse(parser, flat(8)) == 0);
+
+        parser.atoms = 0;
+        TEST(parse(parser, flat(100)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Tokens);
+
+        // exact whatever the interval: '(' and ten atoms make eleven
+        TEST(parser.atoms == 10);
+    }
+
+    SUITE("bytes");
+    {
+        ListParser parser;
+        ParseLimits limits;
+        limits.maxBytes = 100;
+        limits.checkInterval = 1;
+        parser.setLimits(limits);
+
+        std::string small = flat(10);
+        TEST(small.size() < 100);
+        TEST(parse(parser, small) == 0);
+
+        TEST(parse(parser, flat(100)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Bytes);
+
+        // and from a file
+        const char *path = "limits_test.txt";
+        FILE *fp = fopen(path, "w");
+        if (fp)
+        {
+            fputs(flat(100).c_str(), fp);
+            fclose(fp);
+        }
+        TEST(parser.parseFile(path) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Bytes);
+
+        limits.maxBytes = 10000;
+        parser.setLimits(limits);
+        TEST(parser.parseFile(path) == 0);
+        remove(path);
+    }
+
+    SUITE("symbols");
+    {
+        ListParser parser;
+        ParseLimits limits;
+        limits.maxSymbols = 20;
+        parser.setLimits(limits);
+
+        TEST(parse(parser, flat(20)) == 0);
+
+        // counted per parse, not per table
+        TEST(parse(parser, flat(20)) == 0);
+        TEST(parse(parser, "(a b c a b c)") == 0);
+
+        ListParser fresh;
+        fresh.setLimits(limits);
+        TEST(parse(fresh, flat(21)) == -1);
+        TEST(fresh.getLimitExceeded() == ParseLimits::Symbols);
+    }
+
+    SUITE("deadline");
+    {
+        ListParser parser;
+        parser.slow = true;
+
+        ParseLimits limits;
+        limits.timeout = std::chrono::milliseconds(2);
+        limits.checkInterval = 8;
+        parser.setLimits(limits);
+
+        TEST(parse(parser, flat(2000)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Deadline);
+        TEST(parser.atoms < 2000);
+    }
+
+    SUITE("cancellation");
+    {
+        std::atomic<bool> cancel(true);
+
+        ListParser parser;
+        ParseLimits limits;
+        limits.pCancel = &cancel;
+        parser.setLimits(limits);
+
+        // looked at on the first token
+        TEST(parse(parser, flat(10)) == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Cancelled);
+        TEST(parser.atoms == 0);
+
+        cancel = false;
+        TEST(parse(parser, flat(10)) == 0);
+
+        // from another thread
+        parser.slow = true;
+        parser.atoms = 0;
+        std::thread canceller([&cancel]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            cancel = true;
+        });
+        int rv = parse(parser, flat(100000));
+        canceller.join();
+
+        TEST(rv == -1);
+        TEST(parser.getLimitExceeded() == ParseLimits::Cancelled);
+        TEST(parser.atoms < 100000);
+    }
+}
@@ -0,0 +1,157 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../baseparser.h"
+#include "../literalpool.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+struct PoolFixture
+{
+    BaseParser parser;
+    YYSTYPE yylval;
+    LexicalAnalyzer lexer;
+
+    explicit PoolFixture(LiteralPool::Policy policy)
+        : parser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+        , lexer(g_tokenTable, &parser, &yylval)
+    {
+        parser.setLiteralPool(std::unique_ptr<LiteralPool>(new LiteralPool(policy)));
+    }
+
+    std::string text() const
+    {
+        return std::string(yylval.lit.text, yylval.lit.length);
+    }
+};
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_literalpool()
+{
+    MODULE("LiteralPool");
+
+    SUITE("intern");
+    {
+        LiteralPool pool(LiteralPool::Policy::Intern);
+
+        LiteralString a = pool.add("hello", 5);
+        LiteralString b = pool.add("world", 5);
+        LiteralString c = pool.add("hello", 5);
+
+        TEST(a.text == c.text);
+        TEST(a.text != b.text);
+        TEST(a.length == 5);
+        TEST(strcmp(a.text, "hello") == 0);
+        TEST(pool.getCount() == 2);
+        TEST(pool.getBytesUsed() == 12);
+    }
+
+    SUITE("intern growth");
+    {
+        // small blocks force several arena blocks and table rehashes
+        LiteralPool pool(LiteralPool::Policy::Intern, 16);
+        std::vector<LiteralString> lits;
+        char buf[32];
+
+        for (int i = 0; i < 500; i++)
+        {
+            int len = snprintf(buf, sizeof(buf), "key%d", i);
+            lits.push_back(pool.add(buf, len));
+        }
+
+        TEST(pool.getCount() == 500);
+
+        bool same = true;
+        for (int i = 0; i < 500; i++)
+        {
+            int len = snprintf(buf, sizeof(buf), "key%d", i);
+            LiteralString lit = pool.add(buf, len);
+            same = same && lit.text == lits[i].text && strcmp(lit.text, buf) == 0;
+        }
+        TEST(same);
+        TEST(pool.getCount() == 500);
+    }
+
+    SUITE("append");
+    {
+        LiteralPool pool(LiteralPool::Policy::Append);
+
+        LiteralString a = pool.add("hello", 5);
+        LiteralString b = pool.add("hello", 5);
+
+        TEST(a.text != b.text);
+        TEST(strcmp(b.text, "hello") == 0);
+        TEST(pool.getCount() == 2);
+    }
+
+    SUITE("clear");
+    {
+        LiteralPool pool(LiteralPool::Policy::Intern);
+
+        pool.add("one", 3);
+        pool.add("two", 3);
+        pool.clear();
+
+        TEST(pool.getCount() == 0);
+        TEST(pool.getBytesUsed() == 0);
+
+        LiteralString lit = pool.add("three", 5);
+        TEST(strcmp(lit.text, "three") == 0);
+        TEST(pool.getCount() == 1);
+    }
+
+    SUITE("lexer routing");
+    {
+        PoolFixture fixture(LiteralPool::Policy::Intern);
+        fixture.lexer.setData(dup("\"key\" \"key\" \"a\\tb\" ident"), "test", nullptr);
+
+        TEST(fixture.lexer.yylex() == TV_STRING);
+        const char *first = fixture.yylval.lit.text;
+        TEST(fixture.text() == "key");
+
+        TEST(fixture.lexer.yylex() == TV_STRING);
+        TEST(fixture.yylval.lit.text == first);
+
+        TEST(fixture.lexer.yylex() == TV_STRING);
+        TEST(fixture.text() == "a\tb");
+
+        // identifiers still go to the symbol table, literals don't
+        TEST(fixture.lexer.yylex() == TV_ID);
+        TEST(fixture.yylval.sym->lexeme == "ident");
+        char key[] = "key";
+        TEST(fixture.parser.lookupSymbol(key) == nullptr);
+    }
+
+    SUITE("lexer view");
+    {
+        PoolFixture fixture(LiteralPool::Policy::View);
+        char *input = dup("\"plain\" \"esc\\n\"");
+        fixture.lexer.setData(input, "test", nullptr);
+
+        // unescaped literals point straight into the input
+        TEST(fixture.lexer.yylex() == TV_STRING);
+        TEST(fixture.text() == "plain");
+        TEST(fixture.yylval.lit.text == input + 1);
+
+        // escaped ones have to be translated into the scratch buffer
+        TEST(fixture.lexer.yylex() == TV_STRING);
+        TEST(fixture.text() == "esc\n");
+        TEST(fixture.parser.getLiteralPool()->getCount() == 0);
+    }
+}
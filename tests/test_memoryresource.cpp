@@ -0,0 +1,206 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include "../baseparser.h"
+#include "../memoryresource.h"
+#include "testy/test.h"
+
+namespace {
+
+// counts what passes through to the default resource
+class CountingResource : public MemoryResource
+{
+public:
+    size_t allocations = 0;
+    size_t live = 0;
+
+protected:
+    void *doAllocate(size_t bytes, size_t alignment) override
+    {
+        allocations++;
+        live++;
+        return getDefaultResource()->allocate(bytes, alignment);
+    }
+
+    void doDeallocate(void *p, size_t bytes, size_t alignment) override
+    {
+        live--;
+        getDefaultResource()->deallocate(p, bytes, alignment);
+    }
+};
+
+// tracks whether destructors ran
+struct Tracked
+{
+    static int destroyed;
+    int value;
+
+    explicit Tracked(int v) : value(v) {}
+    ~Tracked() { destroyed++; }
+};
+
+int Tracked::destroyed = 0;
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+} // namespace
+
+//------------------------------------------------------
+void test_memoryresource()
+{
+    MODULE("MemoryResource");
+
+    SUITE("monotonic");
+    {
+        CountingResource upstream;
+        {
+            MonotonicResource arena(64, &upstream);
+
+            bool aligned = true;
+            for (int i = 0; i < 100; i++)
+            {
+                void *p = arena.allocate(24, 8);
+                aligned = aligned && ((uintptr_t)p & 7) == 0;
+                memset(p, i, 24);
+            }
+            TEST(aligned);
+            TEST(arena.getBytesAllocated() == 2400);
+
+            // blocks grow geometrically, so only a handful are needed
+            TEST(upstream.allocations < 10);
+
+            arena.release();
+            TEST(upstream.live == 0);
+            TEST(arena.getBytesAllocated() == 0);
+
+            arena.allocate(16);
+        }
+        TEST(upstream.live == 0);
+    }
+
+    SUITE("monotonic buffer");
+    {
+        CountingResource upstream;
+        char buffer[256];
+        MonotonicResource arena(buffer, sizeof(buffer), &upstream);
+
+        char *p = (char*)arena.allocate(100, 1);
+        TEST(p >= buffer && p < buffer + sizeof(buffer));
+        TEST(upstream.allocations == 0);
+
+        arena.allocate(200, 1);
+        TEST(upstream.allocations == 1);
+    }
+
+    SUITE("pool");
+    {
+        CountingResource upstream;
+        {
+            PoolResource pool(4096, &upstream);
+
+            void *a = pool.allocate(20);
+            pool.deallocate(a, 20);
+
+            // same size class comes back off the free list
+            void *b = pool.allocate(30);
+            TEST(a == b);
+            TEST(upstream.allocations == 1);
+
+            // oversized requests go straight upstream
+            void *big = pool.allocate(MAX_POOLED_SIZE + 1);
+            TEST(upstream.allocations == 2);
+            pool.deallocate(big, MAX_POOLED_SIZE + 1);
+            TEST(upstream.live == 1);
+        }
+        TEST(upstream.live == 0);
+    }
+
+    SUITE("allocator");
+    {
+        CountingResource counting;
+
+        std::vector<int, ResourceAllocator<int>> v(&counting);
+        for (int i = 0; i < 100; i++)
+            v.push_back(i);
+        TEST(counting.allocations > 0);
+
+        using Map = std::map<int, int, std::less<int>, ResourceAllocator<std::pair<const int, int>>>;
+        Map m{ResourceAllocator<std::pair<const int, int>>(&counting)};
+        size_t before = counting.allocations;
+        m[1] = 2;
+        TEST(counting.allocations == before + 1);
+
+        ResourceAllocator<int> a(&counting), b(&counting), c;
+        TEST(a == b);
+        TEST(a != c);
+        TEST(c.getResource() == getDefaultResource());
+    }
+
+    SUITE("makeResource");
+    {
+        CountingResource counting;
+        Tracked::destroyed = 0;
+        {
+            ResourcePtr<Tracked> p = makeResource<Tracked>(&counting, 42);
+            TEST(p->value == 42);
+        }
+        TEST(Tracked::destroyed == 1);
+        TEST(counting.live == 0);
+
+        // an arena drops objects without running their destructors
+        MonotonicResource arena;
+        {
+            ResourcePtr<Tracked> p = makeResource<Tracked>(&arena, 7);
+        }
+        TEST(Tracked::destroyed == 1);
+    }
+
+    SUITE("symbol table");
+    {
+        CountingResource counting;
+        {
+            SymbolTable table(&counting);
+            TEST(table.getResource() == &counting);
+
+            table.install("alpha", stUndef);
+            table.push();
+            table.install("beta", stUndef);
+            TEST(table.lookup("alpha") != nullptr);
+            TEST(table.lookup("beta") != nullptr);
+            TEST(counting.live > 0);
+            table.pop();
+        }
+        TEST(counting.live == 0);
+    }
+
+    SUITE("parser");
+    {
+        CountingResource counting;
+        {
+            BaseParser parser(std::unique_ptr<SymbolTable>(new SymbolTable(&counting)), &counting);
+            TEST(parser.getResource() == &counting);
+
+            YYSTYPE yylval;
+            size_t before = counting.allocations;
+            LexicalAnalyzer lexer(g_tokenTable, &parser, &yylval);
+            char text[] = "ident 42";
+            lexer.setData(text, "test", nullptr);
+            TEST(counting.allocations > before);
+            TEST(lexer.yylex() == TV_ID);
+            TEST(lexer.yylex() == TV_INTVAL);
+
+            parser.setLiteralPool(std::unique_ptr<LiteralPool>(new LiteralPool(LiteralPool::Policy::Intern, 64, &counting)));
+            parser.getLiteralPool()->add("literal", 7);
+        }
+        TEST(counting.live == 0);
+    }
+
+    SUITE("default parser");
+    {
+        BaseParser parser(std::unique_ptr<SymbolTable>(new SymbolTable()));
+        TEST(parser.getResource() == getDefaultResource());
+    }
+}
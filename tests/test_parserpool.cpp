@@ -0,0 +1,205 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "../parserpool.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { "let", TV_USER },
+    { nullptr, TV_DONE }
+};
+
+// items: { 'let' ID | INTVAL | STRING }, warning on each 'let'
+class ItemParser : public BaseParser
+{
+public:
+    CollectingSink sink;
+    std::string items;
+
+    ItemParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        setDiagnosticSink(&sink);
+        setLiteralPool(std::unique_ptr<LiteralPool>(new LiteralPool()));
+    }
+
+    void reset() override
+    {
+        BaseParser::reset();
+        items.clear();
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        while (lookahead != TV_DONE)
+        {
+            if (lookahead == TV_USER)
+            {
+                yywarning("let");
+                match(TV_USER);
+                if (lookahead == TV_ID)
+                    items += yylval.sym->lexeme + " ";
+                match(TV_ID);
+            }
+            else if (lookahead == TV_INTVAL || lookahead == TV_STRING)
+            {
+                items += "# ";
+                match(lookahead);
+            }
+            else
+            {
+                yyerror("unexpected token");
+                match(lookahead);
+            }
+        }
+        return 0;
+    }
+
+    SymbolEntry *find(const char *name)
+    {
+        return lookupSymbol(const_cast<char*>(name));
+    }
+
+    LexicalAnalyzer &lexer()    { return *m_lexer; }
+};
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_parserpool()
+{
+    MODULE("Reset and ParserPool");
+
+    SUITE("symbol table reset");
+    {
+        SymbolTable base;
+        base.install("keyword", stDefine);
+
+        SymbolTable table(base.freeze());
+        table.install("a", stInteger);
+        table.push();
+        table.install("b", stInteger);
+        table.lookup("keyword")->ival = 7;
+
+        table.reset();
+        TEST(table.getStats().depth == 1);
+        TEST(table.getStats().entries == 0);
+        TEST(table.lookup("a") == nullptr);
+        TEST(table.lookup("b") == nullptr);
+
+        // the base stays, without the changes made over it
+        TEST(table.lookup("keyword") != nullptr);
+        TEST(table.lookup("keyword")->ival == 0);
+
+        TEST(table.install("a", stInteger) != nullptr);
+    }
+
+    SUITE("parser reset");
+    {
+        ItemParser parser;
+        parser.parseData(dup("let x 1\n\"s\" ; let y\n2"), "test", nullptr);
+        TEST(parser.items == "x # # y # ");
+        TEST(parser.getErrorCount() == 1);
+        TEST(parser.getWarningCount() == 2);
+        TEST(parser.find("x") != nullptr);
+        TEST(parser.getLiteralPool()->getCount() == 1);
+        TEST(parser.lexer().getTotalLinesParsed() > 0);
+
+        parser.reset();
+        TEST(parser.items.empty());
+        TEST(parser.getErrorCount() == 0);
+        TEST(parser.getWarningCount() == 0);
+        TEST(parser.find("x") == nullptr);
+        TEST(parser.getLiteralPool()->getCount() == 0);
+        TEST(parser.lexer().getTotalLinesParsed() == 0);
+        TEST(parser.lexer().getBytesConsumed() == 0);
+
+        // parses as a new one would
+        ItemParser fresh;
+        fresh.parseData(dup("let z 3"), "test", nullptr);
+        parser.parseData(dup("let z 3"), "test", nullptr);
+        TEST(parser.items == fresh.items);
+        TEST(parser.getWarningCount() == 1);
+        TEST(parser.lexer().getBytesConsumed() == fresh.lexer().getBytesConsumed());
+    }
+
+    SUITE("reset after an abort");
+    {
+        ItemParser parser;
+        parser.setErrorLimit(1);
+        parser.parseData(dup("let ; 1 2"), "test", nullptr);
+        TEST(parser.wasAborted());
+
+        parser.reset();
+        TEST(!parser.wasAborted());
+        parser.parseData(dup("let a 1 2"), "test", nullptr);
+        TEST(!parser.wasAborted());
+        TEST(parser.items == "a # # ");
+        TEST(parser.getErrorCount() == 0);
+        TEST(parser.getWarningCount() == 1);
+    }
+
+    SUITE("pool");
+    {
+        using Pool = ParserPool<ItemParser, 2>;
+        Pool::clear();
+
+        ItemParser *pFirst;
+        {
+            Pool::Handle parser = Pool::acquire();
+            pFirst = parser.get();
+            parser->parseData(dup("let a ;"), "test", nullptr);
+            TEST(parser->getErrorCount() == 1);
+            TEST(Pool::getIdleCount() == 0);
+        }
+        TEST(Pool::getIdleCount() == 1);
+
+        {
+            // the same one back, clean
+            Pool::Handle parser = Pool::acquire();
+            TEST(parser.get() == pFirst);
+            TEST(parser->getErrorCount() == 0);
+            TEST(parser->items.empty());
+            TEST(parser->find("a") == nullptr);
+        }
+
+        {
+            Pool::Handle a = Pool::acquire();
+            Pool::Handle b = Pool::acquire();
+            Pool::Handle c = Pool::acquire();
+            TEST(a.get() == pFirst);
+            TEST(Pool::getIdleCount() == 0);
+        }
+
+        // no more than MaxIdle kept
+        TEST(Pool::getIdleCount() == 2);
+
+        size_t otherIdle = 99;
+        std::thread other([&otherIdle]()
+        {
+            otherIdle = Pool::getIdleCount();
+            Pool::Handle parser = Pool::acquire();
+            parser->parseData(dup("let b"), "test", nullptr);
+        });
+        other.join();
+
+        // each thread has its own
+        TEST(otherIdle == 0);
+        TEST(Pool::getIdleCount() == 2);
+
+        Pool::clear();
+        TEST(Pool::getIdleCount() == 0);
+    }
+}
@@ -0,0 +1,223 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include "../baseparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+// list: '(' { list | ID } ')'
+class ListParser : public BaseParser
+{
+public:
+    ListParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+    }
+
+    void DoList()
+    {
+        PARSE_RULE("ListParser::DoList");
+
+        match('(');
+        while (lookahead != ')' && lookahead != TV_DONE)
+        {
+            if (lookahead == '(')
+                DoList();
+            else
+                DoAtom();
+        }
+        match(')');
+    }
+
+    void DoAtom()
+    {
+        PARSE_RULE("ListParser::DoAtom");
+
+        match(TV_ID);
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        DoList();
+        return 0;
+    }
+};
+
+const ParseProfiler::Rule *findRule(const std::vector<ParseProfiler::Rule> &rules, const char *name)
+{
+    for (auto iter = rules.begin(); iter != rules.end(); iter++)
+    {
+        if (strcmp(iter->name, name) == 0)
+            return &*iter;
+    }
+
+    return nullptr;
+}
+
+void spin()
+{
+    uint64_t start = ParseProfiler::now();
+    while (ParseProfiler::now() - start < 10000)
+        ;
+}
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_profiler()
+{
+    MODULE("ParseProfiler");
+
+    SUITE("rule ids");
+    {
+        unsigned a = ParseProfiler::ruleId("test::a");
+        unsigned b = ParseProfiler::ruleId("test::b");
+        TEST(a != b);
+        TEST(ParseProfiler::ruleId("test::a") == a);
+        TEST(strcmp(ParseProfiler::ruleName(b), "test::b") == 0);
+        TEST(ParseProfiler::ticksPerSecond() > 0);
+    }
+
+    SUITE("inclusive and exclusive time");
+    {
+        unsigned outer = ParseProfiler::ruleId("test::outer");
+        unsigned inner = ParseProfiler::ruleId("test::inner");
+
+        ParseProfiler profiler;
+        {
+            RuleScope a(&profiler, outer);
+            spin();
+            for (int i = 0; i < 3; i++)
+            {
+                RuleScope b(&profiler, inner);
+                profiler.countToken();
+                spin();
+            }
+        }
+        TEST(profiler.getDepth() == 0);
+
+        std::vector<ParseProfiler::Rule> rules = profiler.getRules();
+        TEST(rules.size() == 2);
+
+        const ParseProfiler::Rule *pOuter = findRule(rules, "test::outer");
+        const ParseProfiler::Rule *pInner = findRule(rules, "test::inner");
+        TEST(pOuter && pInner);
+        if (pOuter && pInner)
+        {
+            TEST(pOuter->calls == 1);
+            TEST(pInner->calls == 3);
+            TEST(pOuter->inclusive >= pOuter->exclusive + pInner->inclusive);
+            TEST(pOuter->exclusive > 0);
+            TEST(pOuter->tokens == 3);
+            TEST(pOuter->selfTokens == 0);
+            TEST(pInner->selfTokens == 3);
+        }
+    }
+
+    SUITE("recursion is not double counted");
+    {
+        unsigned rule = ParseProfiler::ruleId("test::recursive");
+
+        ParseProfiler profiler;
+        {
+            RuleScope a(&profiler, rule);
+            spin();
+            {
+                RuleScope b(&profiler, rule);
+                spin();
+            }
+        }
+
+        std::vector<ParseProfiler::Rule> rules = profiler.getRules();
+        TEST(rules.size() == 1);
+        TEST(rules[0].calls == 2);
+        TEST(rules[0].inclusive == rules[0].exclusive);
+    }
+
+    SUITE("trace");
+    {
+        unsigned rule = ParseProfiler::ruleId("test::traced");
+
+        ParseProfiler profiler;
+        profiler.enableTrace(2);
+        for (int i = 0; i < 3; i++)
+            RuleScope scope(&profiler, rule);
+
+        TEST(profiler.getEvents().size() == 2);
+        TEST(profiler.getDroppedEvents() == 1);
+
+        const char *path = "profiler_test_trace.json";
+        TEST(profiler.writeTrace(path));
+
+        FILE *fp = fopen(path, "r");
+        std::string text;
+        if (fp)
+        {
+            char buf[256];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+                text.append(buf, n);
+            fclose(fp);
+        }
+        remove(path);
+
+        TEST(text.find("\"traceEvents\"") != std::string::npos);
+        TEST(text.find("\"name\":\"test::traced\",\"cat\":\"rule\",\"ph\":\"X\"") != std::string::npos);
+
+        profiler.reset();
+        TEST(profiler.getEvents().empty());
+        TEST(profiler.getRules().empty());
+    }
+
+    SUITE("null profiler");
+    {
+        RuleScope scope(nullptr, 0);
+        ListParser parser;
+        TEST(parser.getProfiler() == nullptr);
+        parser.parseData(dup("(a (b c) d)"), "test", nullptr);
+        TEST(parser.getErrorCount() == 0);
+    }
+
+#ifdef PARSERKIT_PROFILE
+    SUITE("parser counters");
+    {
+        ListParser parser;
+        ParseProfiler profiler;
+        parser.setProfiler(&profiler);
+
+        const char *text = "(a (b c) (d (e)) f)";
+        parser.parseData(dup(text), "test", nullptr);
+        TEST(parser.getErrorCount() == 0);
+
+        std::vector<ParseProfiler::Rule> rules = profiler.getRules();
+        const ParseProfiler::Rule *pList = findRule(rules, "ListParser::DoList");
+        const ParseProfiler::Rule *pAtom = findRule(rules, "ListParser::DoAtom");
+        TEST(pList && pAtom);
+        if (pList && pAtom)
+        {
+            TEST(pList->calls == 4);
+            TEST(pAtom->calls == 6);
+            TEST(pAtom->selfTokens == 6);
+        }
+
+        // 14 tokens plus the end of input
+        TEST(profiler.getTokens() == 15);
+        TEST(profiler.getBytes() == strlen(text));
+        TEST(profiler.getSymbols() == 6);
+    }
+#endif
+}
@@ -0,0 +1,254 @@
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../pushparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+// list: '(' { list | ID | INTVAL | STRING } ')', recording the atoms
+class ListParser : public BaseParser
+{
+public:
+    std::string atoms;
+    CollectingSink sink;
+    unsigned lists;
+
+    ListParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        setDiagnosticSink(&sink);
+        lists = 0;
+    }
+
+    void note(const std::string &text)
+    {
+        atoms += atoms.empty() ? text : " " + text;
+    }
+
+    void DoList()
+    {
+        lists++;
+
+        match('(');
+        while (lookahead != ')' && lookahead != TV_DONE)
+        {
+            if (lookahead == '(')
+            {
+                DoList();
+                continue;
+            }
+
+            if (lookahead == TV_INTVAL)
+                note(std::to_string(yylval.ival));
+            else if (lookahead == TV_STRING && getLiteralPool())
+                note(std::string(yylval.lit.text, yylval.lit.length));
+            else if (lookahead == TV_ID || lookahead == TV_STRING)
+                note(yylval.sym->lexeme);
+
+            if (lookahead == TV_ID && yylval.sym->lexeme == "boom")
+                throw std::runtime_error("boom");
+
+            match(lookahead);
+        }
+        match(')');
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        DoList();
+        return 0;
+    }
+};
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+const char *g_text = "(alpha (beta 12 \"two words\")\n  (gamma (delta)) 0x1f \"x\" epsilon)";
+
+} // namespace
+
+//------------------------------------------------------
+void test_pushparser()
+{
+    MODULE("PushParser");
+
+    ListParser whole;
+    whole.parseData(dup(g_text), "test", nullptr);
+
+    SUITE("one byte at a time");
+    {
+        TEST(whole.getErrorCount() == 0);
+        TEST(whole.atoms == "alpha beta 12 two words gamma delta 31 x epsilon");
+
+        ListParser parser;
+        PushParser push(parser, "test");
+
+        bool waiting = true;
+        size_t length = strlen(g_text);
+        for (size_t i = 0; i < length - 1; i++)
+        {
+            if (push.feed(&g_text[i], 1) != PushParser::Status::NeedInput)
+                waiting = false;
+        }
+        TEST(waiting);
+        TEST(!push.isDone());
+
+        // the closing ')' ends the list, but the parse can't know that
+        TEST(push.feed(&g_text[length - 1], 1) == PushParser::Status::NeedInput);
+        TEST(push.finish() == 0);
+        TEST(push.isDone());
+        TEST(push.getBytesFed() == length);
+        TEST(parser.atoms == whole.atoms);
+        TEST(parser.getErrorCount() == 0);
+        TEST(parser.lists == 4);
+    }
+
+    SUITE("literal views across chunks");
+    {
+        ListParser parser;
+        parser.setLiteralPool(std::unique_ptr<LiteralPool>(new LiteralPool(LiteralPool::Policy::View)));
+
+        PushParser push(parser, "test");
+        std::string text = g_text;
+        for (size_t i = 0; i < text.size(); i += 3)
+            push.feed(text.substr(i, 3));
+        push.finish();
+
+        TEST(parser.atoms == whole.atoms);
+    }
+
+    SUITE("errors");
+    {
+        ListParser parser;
+        PushParser push(parser, "pushed");
+        push.feed("(a\n(b", 5);
+        push.feed("\n 7", 3);
+        TEST(parser.getErrorCount() == 0);
+
+        // the missing ')'s are only known at the end
+        TEST(push.finish() == 0);
+        TEST(parser.getErrorCount() == 2);
+
+        TEST(parser.atoms == "a b 7");
+
+        // reported where parsing it whole would have
+        ListParser reference;
+        reference.parseData(dup("(a\n(b\n 7"), "pushed", nullptr);
+
+        const std::vector<CollectingSink::Record> &records = parser.sink.getRecords();
+        const std::vector<CollectingSink::Record> &expected = reference.sink.getRecords();
+        TEST(records.size() == expected.size());
+        if (records.size() == expected.size())
+        {
+            bool same = true;
+            for (size_t i = 0; i < records.size(); i++)
+            {
+                if (records[i].file != expected[i].file || records[i].line != expected[i].line || records[i].column != expected[i].column)
+                    same = false;
+            }
+            TEST(same);
+        }
+
+        // done, the rest is ignored
+        TEST(push.feed(")", 1) == PushParser::Status::Done);
+        TEST(push.finish() == 0);
+    }
+
+    SUITE("many at once");
+    {
+        const int count = 20;
+        std::vector<std::unique_ptr<ListParser>> parsers;
+        std::vector<std::unique_ptr<PushParser>> pushes;
+        for (int i = 0; i < count; i++)
+        {
+            parsers.emplace_back(new ListParser());
+            pushes.emplace_back(new PushParser(*parsers.back(), "test", 64 * 1024));
+        }
+
+        // each one in differently sized pieces, taking turns
+        size_t length = strlen(g_text);
+        for (size_t offset = 0; offset < length; offset++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                size_t step = i + 1;
+                if (offset % step == 0)
+                    pushes[i]->feed(&g_text[offset], offset + step > length ? length - offset : step);
+            }
+        }
+
+        bool same = true;
+        for (int i = 0; i < count; i++)
+        {
+            pushes[i]->finish();
+            if (parsers[i]->atoms != whole.atoms || parsers[i]->getErrorCount())
+                same = false;
+        }
+        TEST(same);
+    }
+
+    SUITE("another thread");
+    {
+        ListParser parser;
+        PushParser push(parser, "test");
+
+        std::string text = g_text;
+        std::thread first([&]() { push.feed(text.substr(0, 20)); });
+        first.join();
+        push.feed(text.substr(20));
+        push.finish();
+
+        TEST(parser.atoms == whole.atoms);
+    }
+
+    SUITE("abandoned");
+    {
+        ListParser parser;
+        {
+            PushParser push(parser, "test");
+            push.feed("(a (b (c", 8);
+        }
+        TEST(parser.wasAborted());
+        TEST(parser.atoms == "a b");
+
+        // still usable
+        parser.atoms.clear();
+        parser.parseData(dup("(d)"), "test", nullptr);
+        TEST(!parser.wasAborted());
+        TEST(parser.atoms == "d");
+    }
+
+    SUITE("exceptions");
+    {
+        ListParser parser;
+        PushParser push(parser, "test");
+
+        bool thrown = false;
+        try
+        {
+            push.feed("(a bo", 5);
+            push.feed("om c)", 5);
+        }
+        catch (const std::runtime_error &)
+        {
+            thrown = true;
+        }
+        TEST(thrown);
+        TEST(push.isDone());
+        TEST(push.getResult() == -1);
+    }
+}
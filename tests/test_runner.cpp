@@ -3,6 +3,17 @@
 void test_symboltable();
 void test_lexer();
 void test_baseparser();
+void test_literalpool();
+void test_memoryresource();
+void test_batchparser();
+void test_diagnostics();
+void test_profiler();
+void test_tracebuffer();
+void test_speculation();
+void test_pushparser();
+void test_limits();
+void test_parserpool();
+void test_syntaxtree();
 
 void test_main(int argc, char *argv[])
 {
@@ -12,4 +23,15 @@ void test_main(int argc, char *argv[])
     test_symboltable();
     test_lexer();
     test_baseparser();
+    test_literalpool();
+    test_memoryresource();
+    test_batchparser();
+    test_diagnostics();
+    test_profiler();
+    test_tracebuffer();
+    test_speculation();
+    test_pushparser();
+    test_limits();
+    test_parserpool();
+    test_syntaxtree();
 }
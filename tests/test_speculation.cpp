@@ -0,0 +1,270 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include "../baseparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+enum { RULE_NESTED = 1 };
+
+// statements that need two tokens to tell apart:
+//   stmt: ID ID [ '=' INTVAL ] ';'     declaration
+//       | ID '=' INTVAL ';'            assignment
+//       | ID '(' ')' ';'               call
+class StatementParser : public BaseParser
+{
+public:
+    std::string kinds;
+    CollectingSink sink;
+
+    StatementParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        setDiagnosticSink(&sink);
+    }
+
+    void DoDeclaration()
+    {
+        match(TV_ID);
+        match(TV_ID);
+        if (lookahead == '=')
+        {
+            match('=');
+            match(TV_INTVAL);
+        }
+        match(';');
+    }
+
+    void DoAssignment()
+    {
+        match(TV_ID);
+        match('=');
+        match(TV_INTVAL);
+        match(';');
+    }
+
+    void DoCall()
+    {
+        match(TV_ID);
+        match('(');
+        match(')');
+        match(';');
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        while (lookahead != TV_DONE)
+        {
+            if (speculate([this]() { DoDeclaration(); }))
+            {
+                kinds += 'd';
+                DoDeclaration();
+            }
+            else if (attempt([this]() { DoAssignment(); }))
+            {
+                kinds += 'a';
+            }
+            else
+            {
+                kinds += 'c';
+                DoCall();
+            }
+        }
+        return 0;
+    }
+};
+
+// nested: '(' nested ')' ',' | '(' nested ')' ';' | ID
+//
+// Trying the first alternative before the second makes every level
+// parse the one inside it twice, exponential without memoization.
+class NestedParser : public BaseParser
+{
+public:
+    bool useMemo;
+    unsigned calls;
+
+    NestedParser(bool memo) : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        useMemo = memo;
+        calls = 0;
+    }
+
+    void DoAlternative(int op)
+    {
+        match('(');
+        DoNested();
+        match(')');
+        match(op);
+    }
+
+    void DoNestedRule()
+    {
+        calls++;
+
+        if (lookahead != '(')
+            match(TV_ID);
+        else if (speculate([this]() { DoAlternative(','); }))
+            DoAlternative(',');
+        else
+            DoAlternative(';');
+    }
+
+    void DoNested()
+    {
+        if (useMemo)
+            memoize(RULE_NESTED, [this]() { DoNestedRule(); });
+        else
+            DoNestedRule();
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        DoNested();
+        if (lookahead != TV_DONE)
+            yyerror("unexpected input");
+        return 0;
+    }
+};
+
+// records what mark()/rewind() do to the lookahead
+class MarkingParser : public BaseParser
+{
+public:
+    std::string trail;
+
+    MarkingParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+    }
+
+    void note(const std::string &text)
+    {
+        trail += trail.empty() ? text : " " + text;
+    }
+
+    void noteLexeme()
+    {
+        note(lookahead == TV_ID ? yylval.sym->lexeme : "?");
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        note(std::to_string(getTokenIndex()));
+
+        unsigned outer = mark();
+        match(TV_ID);
+        match(TV_ID);
+
+        unsigned inner = mark();
+        note(std::to_string(inner));
+        match(TV_ID);
+        noteLexeme();
+
+        rewind(outer);
+        note(std::to_string(getTokenIndex()));
+        noteLexeme();
+        match(TV_ID);
+        noteLexeme();
+
+        rewind(inner);
+        release(inner);
+        release(outer);
+        noteLexeme();
+
+        // replayed, then read on from the lexer
+        match(TV_ID);
+        match(TV_ID);
+        if (lookahead == TV_DONE)
+            note(std::to_string(getTokenIndex()));
+        return 0;
+    }
+};
+
+char *dup(const char *text)
+{
+    static char buf[1024];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+std::string nested(int depth)
+{
+    std::string text;
+    for (int i = 0; i < depth; i++)
+        text += '(';
+    text += 'x';
+    for (int i = 0; i < depth; i++)
+        text += i % 2 ? ");" : "),";
+    return text;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_speculation()
+{
+    MODULE("Speculative parsing");
+
+    SUITE("choosing alternatives");
+    {
+        StatementParser parser;
+        parser.parseData(dup("int x = 1; x = 2; f(); int y; g();"), "test", nullptr);
+        TEST(parser.kinds == "dacdc");
+        TEST(parser.getErrorCount() == 0);
+        TEST(parser.sink.getRecords().empty());
+        TEST(!parser.isSpeculating());
+    }
+
+    SUITE("errors after speculation");
+    {
+        StatementParser parser;
+        parser.parseData(dup("x = 1;\nint\ny\nz;"), "test", nullptr);
+
+        // only the real parse reports, and at the replayed token's line
+        // rather than the lexer's, which is a line further on
+        TEST(parser.kinds == "acd");
+        TEST(parser.getErrorCount() == 3);
+
+        const std::vector<CollectingSink::Record> &records = parser.sink.getRecords();
+        TEST(records.size() == 3);
+        if (!records.empty())
+            TEST(records[0].line == 3);
+    }
+
+    SUITE("mark and rewind");
+    {
+        MarkingParser parser;
+        parser.parseData(dup("a b c d"), "test", nullptr);
+        TEST(parser.trail == "0 2 d 0 a b c 4");
+        TEST(parser.getErrorCount() == 0);
+    }
+
+    SUITE("packrat memoization");
+    {
+        std::string text = nested(12);
+
+        NestedParser plain(false);
+        plain.parseData(dup(text.c_str()), "test", nullptr);
+        TEST(plain.getErrorCount() == 0);
+
+        NestedParser memo(true);
+        memo.parseData(dup(text.c_str()), "test", nullptr);
+        TEST(memo.getErrorCount() == 0);
+
+        // a few calls per level once each level's inner rule is found in
+        // the memo after its first try
+        TEST(plain.calls > 1000);
+        TEST(memo.calls < 4 * 13);
+    }
+}
@@ -1,6 +1,10 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdio>
 #include "../symboltable.h"
 #include "testy/test.h"
 
@@ -81,4 +85,192 @@ void test_symboltable()
         pInstalled->isReferenced = 1;
         TEST(table.dumpUnreferencedSymbolsAtCurrentLevel() == 0);
     }
+
+    SUITE("frozen base");
+    {
+        SymbolTable builder;
+
+        SymbolEntry *pEnum = builder.install("RED", stEnum);
+        pEnum->ival = 7;
+        pEnum->srcLine = 3;
+        pEnum->srcFile = "colors.h";
+        builder.install("GREEN", stEnum)->ival = 8;
+
+        std::shared_ptr<const FrozenSymbolTable> base = builder.freeze();
+        TEST(base->getLevelCount() == 1);
+        TEST(base->getEntryCount() == 2);
+
+        SymbolTable overlay1(base), overlay2(base);
+
+        SymbolEntry *pFound = overlay1.lookup("RED");
+        TEST(pFound != nullptr);
+        TEST(pFound->type == stEnum);
+        TEST(pFound->ival == 7);
+        TEST(pFound->srcLine == 3);
+        TEST(pFound->srcFile == "colors.h");
+
+        // writes go to the overlay's private copy, never to the base
+        TEST(overlay1.lookup("RED") == pFound);
+        pFound->isReferenced = 1;
+        TEST(overlay2.lookup("RED")->isReferenced == 0);
+
+        // overlays install and scope independently of each other
+        overlay1.install("local", stInteger);
+        TEST(overlay2.lookup("local") == nullptr);
+        TEST(overlay1.reverse_lookup(8) != nullptr);
+        TEST(overlay1.lookup("missing") == nullptr);
+
+        // installing a base global gets the base entry, as a plain table
+        // would, rather than hiding it
+        SymbolEntry *pGreen = overlay2.install("GREEN", stEnum);
+        TEST(pGreen->ival == 8);
+        TEST(overlay2.lookup("GREEN") == pGreen);
+        TEST(overlay2.install("GREEN", stEnum) == pGreen);
+
+        // but not from a nested scope, where it's a new local
+        overlay2.push();
+        TEST(overlay2.install("RED", stEnum)->ival == 0);
+        overlay2.pop();
+        TEST(overlay2.lookup("RED")->ival == 7);
+    }
+
+    SUITE("global iteration");
+    {
+        SymbolTable builder;
+        builder.install("a", stInteger);
+        builder.install("b", stInteger);
+
+        SymbolTable table(builder.freeze());
+        table.install("b", stInteger)->ival = 9;
+        table.install("c", stFloat);
+
+        int count = 0;
+        bool sawBaseA = false, sawOwnB = false;
+        for (auto iter = table.begin_globals(); iter != table.end_globals(); ++iter)
+        {
+            count++;
+            if (iter->lexeme == "a")
+                sawBaseA = true;
+            if (iter->lexeme == "b")
+                sawOwnB = (iter->ival == 9);
+        }
+
+        // installing "b" promoted the base one, so it's there once
+        TEST(count == 3);
+        TEST(sawBaseA);
+        TEST(sawOwnB);
+
+        // the deprecated walk hands out entries that can be written to,
+        // base ones included
+        for (SymbolEntry *pEntry = table.getFirstGlobal(); pEntry; pEntry = table.getNextGlobal())
+            pEntry->isReferenced = 1;
+        TEST(table.lookup("a")->isReferenced);
+        TEST(table.lookup("b")->isReferenced);
+        TEST(table.lookup("c")->isReferenced);
+
+        // re-frozen, an overlay's globals are merged into the base's
+        std::shared_ptr<const FrozenSymbolTable> refrozen = table.freeze();
+        TEST(refrozen->getLevelCount() == 1);
+        TEST(refrozen->getEntryCount() == 3);
+
+        SymbolTable reader(refrozen);
+        count = 0;
+        bool sawC = false, sawB9 = false;
+        for (auto iter = reader.begin_globals(); iter != reader.end_globals(); ++iter)
+        {
+            count++;
+            if (iter->lexeme == "c")
+                sawC = (iter->type == stFloat);
+            if (iter->lexeme == "b")
+                sawB9 = (iter->ival == 9);
+        }
+        TEST(count == 3);
+        TEST(sawC);
+        TEST(sawB9);
+
+        SymbolTable empty;
+        TEST(empty.begin_globals() == empty.end_globals());
+        TEST(empty.getFirstGlobal() == nullptr);
+    }
+
+    SUITE("image serialization");
+    {
+        SymbolTable builder;
+        SymbolEntry *pReg = builder.install("r0", stEnum);
+        pReg->ival = 0x10;
+        pReg->srcFile = "regs.inc";
+        pReg->srcLine = 12;
+
+        builder.push();
+        builder.install("pi", stFloat)->fval = 3.5f;
+
+        TEST(builder.saveImage("test_symbols.pkst") == 0);
+
+        std::shared_ptr<const FrozenSymbolTable> base = FrozenSymbolTable::load("test_symbols.pkst");
+        TEST(base != nullptr);
+        TEST(base->getLevelCount() == 2);
+
+        SymbolTable table(base);
+        SymbolEntry *pFound = table.lookup("r0");
+        TEST(pFound != nullptr);
+        TEST(pFound->type == stEnum);
+        TEST(pFound->ival == 0x10);
+        TEST(pFound->srcFile == "regs.inc");
+        TEST(pFound->srcLine == 12);
+        TEST(EQUAL_EPSILON(table.lookup("pi")->fval, 3.5f));
+
+        // images are relocatable, a copy at another address works too
+        std::vector<uint32_t> copy(base->getImageSize() / sizeof(uint32_t));
+        memcpy(copy.data(), base->getImage(), base->getImageSize());
+        TEST(FrozenSymbolTable::fromImage(copy.data(), base->getImageSize())->find("r0") != FrozenSymbolTable::npos);
+
+        // corrupt images are rejected rather than trusted
+        copy[0] = 0;
+        TEST(FrozenSymbolTable::fromImage(copy.data(), base->getImageSize()) == nullptr);
+        TEST(FrozenSymbolTable::load("does_not_exist.pkst") == nullptr);
+
+        remove("test_symbols.pkst");
+    }
+
+    SUITE("statistics");
+    {
+        SymbolTable table;
+        table.install("global", stUndef);
+        table.push();
+        table.install("local", stUndef);
+
+        TEST(table.lookup("local") != nullptr);
+        TEST(table.lookup("global") != nullptr);
+        TEST(table.lookup("nowhere") == nullptr);
+
+        // the snapshot half is always there
+        SymbolTableStats stats = table.getStats();
+        TEST(stats.depth == 2);
+        TEST(stats.entries == 2);
+        TEST(stats.levels[0].entries == 1);
+        TEST(stats.levels[1].entries == 1);
+        TEST(stats.bytesUsed > 0);
+
+        if (SymbolTable::statsEnabled())
+        {
+            TEST(stats.lookups == 3);
+            TEST(stats.misses == 1);
+            TEST(stats.installs == 2);
+            TEST(stats.peakDepth == 2);
+            TEST(stats.levels[1].lookups == 3);
+            TEST(stats.levels[1].hits == 1);
+            TEST(stats.levels[0].hits == 1);
+            TEST(stats.levelsWalked == 5);
+            TEST(EQUAL_EPSILON(stats.hitRate(1), 1.0 / 3.0));
+        }
+        else
+        {
+            TEST(stats.lookups == 0);
+            TEST(stats.installs == 0);
+        }
+
+        table.resetStats();
+        TEST(table.getStats().lookups == 0);
+        TEST(table.getStats().entries == 2);
+    }
 }
@@ -0,0 +1,278 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../pushparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+enum { LIST = 1, ATOM, TRIAL };
+
+// list: '(' { list | atom } ')'
+class ListParser : public BaseParser
+{
+public:
+    CollectingSink sink;
+    SyntaxTree tree;
+    bool speculative;
+    bool failedAttempt;
+
+    ListParser(MemoryResource *pResource = nullptr) : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()), pResource), tree(pResource)
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+        m_lexer->setCPPComments(true);
+        m_lexer->setCStyleComments(true);
+        setDiagnosticSink(&sink);
+        setSyntaxTree(&tree);
+        speculative = false;
+        failedAttempt = false;
+    }
+
+    void DoList()
+    {
+        openNode(LIST);
+        match('(');
+        while (lookahead != ')' && lookahead != TV_DONE)
+        {
+            if (lookahead == '(')
+                DoList();
+            else
+            {
+                openNode(ATOM);
+                match(lookahead);
+                closeNode();
+            }
+        }
+        match(')');
+        closeNode();
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+
+        if (failedAttempt)
+        {
+            bool parsed = attempt([this]()
+            {
+                openNode(TRIAL);
+                match('(');
+                match(TV_INTVAL);
+                closeNode();
+            });
+            (void)parsed;
+        }
+
+        if (!speculative || speculate([this]() { DoList(); }))
+            DoList();
+        return 0;
+    }
+
+    void usePlainLexer();
+};
+
+// single characters, skipping blanks itself, without marking tokens
+class PlainLexer : public LexicalAnalyzer
+{
+public:
+    PlainLexer(BaseParser *pParser, YYSTYPE *pyylval) : LexicalAnalyzer(g_tokenTable, pParser, pyylval) {}
+
+    int yylex() override
+    {
+        int c;
+        while ((c = getChar()) == ' ' || c == '\n')
+            ;
+
+        if (c == EOF || !c)
+            return TV_DONE;
+
+        return isalpha(c) ? TV_ID : c;
+    }
+};
+
+void ListParser::usePlainLexer()
+{
+    m_lexer.reset(new PlainLexer(this, &yylval));
+}
+
+int parse(ListParser &parser, const std::string &text)
+{
+    std::vector<char> buf(text.begin(), text.end());
+    buf.push_back(0);
+    return parser.parseData(buf.data(), "test", nullptr);
+}
+
+std::string str(const LiteralString &text)
+{
+    return std::string(text.text, text.length);
+}
+
+// kinds in preorder, tokens as their text
+std::string shape(const SyntaxTree &tree)
+{
+    std::string text;
+    for (unsigned i = 0; i < tree.size(); i++)
+    {
+        if (!text.empty())
+            text += " ";
+        if (tree[i].token)
+            text += str(tree.getText(i));
+        else
+            text += tree[i].kind == LIST ? "L" : tree[i].kind == ATOM ? "A" : "?";
+    }
+    return text;
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_syntaxtree()
+{
+    MODULE("SyntaxTree");
+
+    SUITE("preorder");
+    {
+        ListParser parser;
+        TEST(parse(parser, "(a (b c) d)") == 0);
+
+        const SyntaxTree &tree = parser.tree;
+        TEST(shape(tree) == "L ( A a L ( A b A c ) A d )");
+        TEST(tree.getOpenDepth() == 0);
+        TEST(tree[0].parent == NO_NODE);
+        TEST(tree[0].end == tree.size());
+        TEST(str(tree.getText(0)) == "(a (b c) d)");
+
+        // the root's children, skipping over the inner list
+        std::string children;
+        for (unsigned child = tree.firstChild(0); child != NO_NODE; child = tree.nextSibling(child))
+            children += tree[child].token ? "t" : tree[child].kind == LIST ? "L" : "A";
+        TEST(children == "tALAt");
+
+        unsigned inner = 4;
+        TEST(tree[inner].kind == LIST);
+        TEST(str(tree.getText(inner)) == "(b c)");
+        TEST(tree[inner].parent == 0);
+        TEST(tree[tree[inner].end].kind == ATOM);
+        TEST(tree.firstChild(tree.size() - 1) == NO_NODE);
+    }
+
+    SUITE("trivia");
+    {
+        std::string text = "  // first\n( a /* b */ b\n\t( ) )  \n";
+
+        ListParser parser;
+        TEST(parse(parser, text) == 0);
+
+        const SyntaxTree &tree = parser.tree;
+        TEST(tree.toString() == text);
+        TEST(tree.getSource() == text);
+        TEST(str(tree.getTrivia(1)) == "  // first\n");
+        TEST(str(tree.getText(1)) == "(");
+
+        // the node's text starts at its first token, after the trivia
+        TEST(str(tree.getText(0)) == "( a /* b */ b\n\t( ) )");
+        TEST(tree[0].trivia == 0);
+
+        unsigned b = 5;
+        TEST(str(tree.getText(b)) == "b");
+        TEST(str(tree.getTrivia(b)) == " /* b */ ");
+    }
+
+    SUITE("from a file");
+    {
+        std::string text = "(one\n  (two 2 \"three\")\n) // done\n";
+        const char *path = "syntaxtree_test.txt";
+        FILE *fp = fopen(path, "w");
+        if (fp)
+        {
+            fputs(text.c_str(), fp);
+            fclose(fp);
+        }
+
+        ListParser parser;
+        TEST(parser.parseFile(path) == 0);
+        TEST(parser.tree.toString() == text);
+        TEST(str(parser.tree.getText(0)) == "(one\n  (two 2 \"three\")\n)");
+        remove(path);
+
+        // each parse starts a new tree
+        TEST(parse(parser, "(x)") == 0);
+        TEST(shape(parser.tree) == "L ( A x )");
+    }
+
+    SUITE("speculation");
+    {
+        std::string text = "(a (b) c)";
+
+        ListParser plain;
+        parse(plain, text);
+
+        // nothing is added twice, or at all while trying
+        ListParser speculative;
+        speculative.speculative = true;
+        TEST(parse(speculative, text) == 0);
+        TEST(shape(speculative.tree) == shape(plain.tree));
+
+        // a failed attempt takes its nodes back
+        ListParser attempted;
+        attempted.failedAttempt = true;
+        TEST(parse(attempted, text) == 0);
+        TEST(shape(attempted.tree) == shape(plain.tree));
+        TEST(attempted.tree.toString() == text);
+    }
+
+    SUITE("errors");
+    {
+        std::string text = "(a (b c";
+
+        ListParser parser;
+        parse(parser, text);
+        TEST(parser.getErrorCount() == 2);
+
+        // open rules are closed where the parse ended
+        TEST(parser.tree.getOpenDepth() == 0);
+        TEST(parser.tree[0].end == parser.tree.size());
+        TEST(parser.tree.toString() == text);
+    }
+
+    SUITE("pushed");
+    {
+        std::string text = "(a /* x */ (bb cc)\n dd)\n";
+
+        ListParser parser;
+        PushParser push(parser, "test");
+        for (size_t i = 0; i < text.size(); i += 2)
+            push.feed(text.substr(i, 2));
+        TEST(push.finish() == 0);
+
+        TEST(parser.tree.toString() == text);
+        TEST(shape(parser.tree) == "L ( A a L ( A bb A cc ) A dd )");
+    }
+
+    SUITE("a lexer of its own");
+    {
+        std::string text = " ( a\n b ) ";
+
+        ListParser parser;
+        parser.usePlainLexer();
+        TEST(parse(parser, text) == 0);
+
+        // without markToken() the blanks go with the token after them
+        TEST(parser.tree.toString() == text);
+        TEST(str(parser.tree.getText(1)) == " (");
+        TEST(parser.tree[1].trivia == 0);
+    }
+
+    SUITE("from a resource");
+    {
+        MonotonicResource arena;
+        ListParser parser(&arena);
+        TEST(parse(parser, "(a (b (c (d))))") == 0);
+        TEST(shape(parser.tree) == "L ( A a L ( A b L ( A c L ( A d ) ) ) )");
+    }
+}
@@ -0,0 +1,241 @@
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "../baseparser.h"
+#include "testy/test.h"
+
+namespace {
+
+TokenTable g_tokenTable[] = {
+    { nullptr, TV_DONE }
+};
+
+// items: { ID | INTVAL }, logging each one
+class LoggingParser : public BaseParser
+{
+public:
+    std::string text;
+
+    LoggingParser() : BaseParser(std::unique_ptr<SymbolTable>(new SymbolTable()))
+    {
+        m_lexer.reset(new LexicalAnalyzer(g_tokenTable, this, &yylval));
+    }
+
+    void yylog(const char *fmt, ...) override
+    {
+        text += fmt;
+    }
+
+    int yyparse() override
+    {
+        BaseParser::yyparse();
+        while (lookahead != TV_DONE)
+        {
+            if (lookahead == TV_INTVAL)
+                YYLOG("int %d", yylval.ival);
+            else
+                YYLOG("id %s", yylval.sym->lexeme);
+            match(lookahead);
+        }
+        return 0;
+    }
+};
+
+char *dup(const char *text)
+{
+    static char buf[256];
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    return buf;
+}
+
+std::string last(const TraceDecoder &decoder)
+{
+    return decoder.getRecords().empty() ? "" : decoder.format(decoder.getRecords().back().event);
+}
+
+} // namespace
+
+//------------------------------------------------------
+void test_tracebuffer()
+{
+    MODULE("TraceBuffer");
+
+    TraceBuffer::clear();
+
+    SUITE("format ids");
+    {
+        // testy prints the expression as a format, so no '%' inside TEST()
+        const char *fmtInt = "test %d";
+        const char *fmtString = "test %s";
+
+        unsigned a = TraceBuffer::formatId(fmtInt);
+        unsigned b = TraceBuffer::formatId(fmtString, "x");
+        TEST(a != b);
+        TEST(TraceBuffer::formatId(fmtInt, 1) == a);
+        TEST(TraceBuffer::getFormats()[b] == fmtString);
+        TEST(sizeof(TraceBuffer::Event) == 64);
+    }
+
+    SUITE("not tracing");
+    {
+        TEST(TraceBuffer::current() == nullptr);
+
+        LoggingParser parser;
+        parser.parseData(dup("a 1"), "test", nullptr);
+        TEST(parser.text.empty());
+
+        parser.yydebug = true;
+        parser.parseData(dup("a 1"), "test", nullptr);
+        std::string formats = std::string("id %s") + "int %d";
+        TEST(parser.text == formats);
+    }
+
+    SUITE("arguments");
+    {
+        TraceBuffer *pTrace = TraceBuffer::start(16);
+        TEST(pTrace != nullptr);
+        TEST(TraceBuffer::current() == pTrace);
+        TEST(TraceBuffer::start() == pTrace);
+        TEST(pTrace->getCapacity() == 16);
+
+        TraceDecoder decoder;
+
+        YYTRACE("%d %u %x %c", -42, 7u, 255, 'q');
+        decoder.capture();
+        TEST(last(decoder) == "-42 7 ff q");
+
+        YYTRACE("%.2f %5.1f %g", 3.14159, 2.5f, 1e10);
+        decoder.capture();
+        TEST(last(decoder) == "3.14   2.5 1e+10");
+
+        std::string key = "name";
+        YYTRACE("key %s = %s, %zu%%", key, "value", (size_t)12);
+        decoder.capture();
+        std::string percent = "key name = value, 12%";
+        TEST(last(decoder) == percent);
+
+        const char *slice = "abcdef";
+        YYTRACE("'%.*s' %*d|", 3, slice, 4, 9);
+        decoder.capture();
+        TEST(last(decoder) == "'abc'    9|");
+
+        // one string takes the rest of the event, and is cut to fit
+        std::string longText(100, 'x');
+        YYTRACE("%d %s", 1, longText.c_str());
+        decoder.capture();
+        TEST(last(decoder) == "1 " + std::string(39, 'x'));
+
+        // no room left, the second string is lost but the event isn't
+        YYTRACE("%s %s", longText.c_str(), "more");
+        decoder.capture();
+        TEST(last(decoder) == std::string(47, 'x') + " (?)");
+
+        TEST(pTrace->getRecorded() == 6);
+        TEST(pTrace->getLost() == 0);
+    }
+
+    SUITE("parser log");
+    {
+        LoggingParser parser;
+        parser.parseData(dup("alpha 12 beta"), "test", nullptr);
+        TEST(parser.text.empty());
+
+        TraceDecoder decoder;
+        decoder.capture();
+
+        const std::vector<TraceDecoder::Record> &records = decoder.getRecords();
+        TEST(records.size() == 9);
+        if (records.size() == 9)
+        {
+            TEST(decoder.format(records[6].event) == "id alpha");
+            TEST(decoder.format(records[7].event) == "int 12");
+            TEST(decoder.format(records[8].event) == "id beta");
+            TEST(records[6].event.timestamp <= records[8].event.timestamp);
+        }
+    }
+
+    SUITE("wrap around");
+    {
+        TraceBuffer *pTrace = TraceBuffer::current();
+        for (int i = 0; i < 40; i++)
+            YYTRACE("event %d", i);
+
+        TEST(pTrace->getLost() == pTrace->getRecorded() - 16);
+
+        std::vector<TraceBuffer::Event> events = pTrace->snapshot();
+        TEST(events.size() == 16);
+
+        TraceDecoder decoder;
+        decoder.capture();
+        TEST(decoder.getRecords().size() == 16);
+        TEST(decoder.format(decoder.getRecords().front().event) == "event 24");
+        TEST(last(decoder) == "event 39");
+        TEST(decoder.getLost() == pTrace->getRecorded() - 16);
+
+        TraceBuffer::stop();
+        TEST(TraceBuffer::current() == nullptr);
+        YYTRACE("not recorded %d", 1);
+        TEST(pTrace->getRecorded() == 49);
+    }
+
+    SUITE("threads and files");
+    {
+        TraceBuffer::clear();
+
+        std::thread threads[3];
+        for (int t = 0; t < 3; t++)
+        {
+            threads[t] = std::thread([t]()
+            {
+                TraceBuffer::start(64);
+                for (int i = 0; i < 10; i++)
+                    YYTRACE("thread %d step %d", t, i);
+                TraceBuffer::stop();
+            });
+        }
+        for (int t = 0; t < 3; t++)
+            threads[t].join();
+
+        TEST(TraceBuffer::getBuffers().size() == 3);
+
+        const char *path = "tracebuffer_test.trace";
+        TEST(TraceBuffer::save(path));
+
+        TraceDecoder decoder;
+        TEST(decoder.load(path));
+        TEST(decoder.getRecords().size() == 30);
+        TEST(decoder.getLost() == 0);
+
+        bool ordered = true;
+        int steps[3] = {};
+        const std::vector<TraceDecoder::Record> &records = decoder.getRecords();
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            if (i && records[i].event.timestamp < records[i - 1].event.timestamp)
+                ordered = false;
+
+            // each thread's own events stay in order
+            int t = -1, step = -1;
+            sscanf(decoder.format(records[i].event).c_str(), "thread %d step %d", &t, &step);
+            if (t >= 0 && t < 3 && step == steps[t])
+                steps[t]++;
+        }
+        TEST(ordered);
+        TEST(steps[0] == 10 && steps[1] == 10 && steps[2] == 10);
+
+        FILE *fp = fopen(path, "wb");
+        if (fp)
+        {
+            fputs("not a trace", fp);
+            fclose(fp);
+        }
+        TEST(!decoder.load(path));
+        TEST(!decoder.load("no_such_file.trace"));
+        remove(path);
+
+        TraceBuffer::clear();
+        TEST(TraceBuffer::getBuffers().empty());
+    }
+}
@@ -0,0 +1,598 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include "tracebuffer.h"
+#include "profiler.h"
+
+#define TRACE_MAGIC		"PKTRACE1"
+
+thread_local TraceBuffer *TraceBuffer::s_pCurrent = nullptr;
+
+//======================================================================
+// Process wide format strings and buffers, only touched when a call
+// site first records, a thread starts or stops, and when saving
+//======================================================================
+static std::mutex &traceLock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::deque<std::string> &traceFormats()
+{
+	static std::deque<std::string> formats;
+	return formats;
+}
+
+static std::vector<std::shared_ptr<TraceBuffer>> &traceBuffers()
+{
+	static std::vector<std::shared_ptr<TraceBuffer>> buffers;
+	return buffers;
+}
+
+//======================================================================
+//
+//======================================================================
+unsigned TraceBuffer::registerFormat(const char *fmt)
+{
+	assert(fmt);
+
+	std::lock_guard<std::mutex> guard(traceLock());
+	std::deque<std::string> &formats = traceFormats();
+
+	for (size_t i = 0; i < formats.size(); i++)
+	{
+		if (formats[i] == fmt)
+			return (unsigned)i;
+	}
+
+	formats.push_back(fmt);
+	return (unsigned)formats.size() - 1;
+}
+
+//======================================================================
+//
+//======================================================================
+std::vector<std::string> TraceBuffer::getFormats()
+{
+	std::lock_guard<std::mutex> guard(traceLock());
+	return std::vector<std::string>(traceFormats().begin(), traceFormats().end());
+}
+
+//======================================================================
+//
+//======================================================================
+TraceBuffer::TraceBuffer(size_t events, unsigned thread)
+{
+	size_t capacity = 1;
+	while (capacity < events)
+		capacity *= 2;
+
+	m_events.reset(new Event[capacity]);
+	m_mask		= capacity - 1;
+	m_next		= 0;
+	m_recording	= false;
+	m_thread	= thread;
+}
+
+//======================================================================
+// Copy as much of the string as fits in the slots left, NUL terminated.
+// Only that much is scanned, so a slice of a larger buffer (for "%.*s")
+// costs no more than a short string.
+//======================================================================
+TraceBuffer::ArgType TraceBuffer::store(Event &event, unsigned &slot, const char *text)
+{
+	if (!text)
+		text = "(null)";
+
+	char *pDest = (char*)&event.args[slot];
+	size_t room = (6 - slot) * sizeof(uint64_t);
+
+	const char *pEnd = (const char*)memchr(text, 0, room - 1);
+	size_t length = pEnd ? pEnd - text : room - 1;
+
+	memcpy(pDest, text, length);
+	pDest[length] = 0;
+
+	slot += (unsigned)(length / sizeof(uint64_t)) + 1;
+	return TA_STRING;
+}
+
+//======================================================================
+//
+//======================================================================
+TraceBuffer *TraceBuffer::start(size_t events)
+{
+	if (s_pCurrent)
+		return s_pCurrent;
+
+	std::lock_guard<std::mutex> guard(traceLock());
+	std::vector<std::shared_ptr<TraceBuffer>> &buffers = traceBuffers();
+
+	buffers.push_back(std::make_shared<TraceBuffer>(events, (unsigned)buffers.size()));
+	s_pCurrent = buffers.back().get();
+	s_pCurrent->m_recording = true;
+
+	return s_pCurrent;
+}
+
+//======================================================================
+//
+//======================================================================
+void TraceBuffer::stop()
+{
+	if (s_pCurrent)
+		s_pCurrent->m_recording = false;
+
+	s_pCurrent = nullptr;
+}
+
+//======================================================================
+//
+//======================================================================
+std::vector<std::shared_ptr<TraceBuffer>> TraceBuffer::getBuffers()
+{
+	std::lock_guard<std::mutex> guard(traceLock());
+	return traceBuffers();
+}
+
+//======================================================================
+// Only the calling thread's buffer can be detached here, other threads
+// must have stopped
+//======================================================================
+void TraceBuffer::clear()
+{
+	stop();
+
+	std::lock_guard<std::mutex> guard(traceLock());
+	traceBuffers().clear();
+}
+
+//======================================================================
+//
+//======================================================================
+uint64_t TraceBuffer::now()
+{
+	return ParseProfiler::now();
+}
+
+//======================================================================
+//
+//======================================================================
+uint64_t TraceBuffer::getLost() const
+{
+	uint64_t recorded = getRecorded();
+	return recorded > m_mask + 1 ? recorded - (m_mask + 1) : 0;
+}
+
+//======================================================================
+// Events the owner overwrote while we were copying are dropped, and so
+// is the slot it may be writing now. Nothing is dropped when the caller
+// is the owner or the owner has stopped.
+//======================================================================
+std::vector<TraceBuffer::Event> TraceBuffer::snapshot() const
+{
+	// checked first: if it stops while we copy, it may have been writing
+	bool quiet = this == s_pCurrent || !m_recording.load(std::memory_order_acquire);
+
+	uint64_t capacity = m_mask + 1;
+	uint64_t end = m_next.load(std::memory_order_acquire);
+	uint64_t begin = end > capacity ? end - capacity : 0;
+
+	std::vector<Event> events;
+	events.reserve((size_t)(end - begin));
+
+	for (uint64_t i = begin; i < end; i++)
+		events.push_back(m_events[i & m_mask]);
+
+	uint64_t after = m_next.load(std::memory_order_acquire);
+	if (!quiet && after + 1 > begin + capacity)
+	{
+		uint64_t stale = std::min(after + 1 - capacity - begin, (uint64_t)events.size());
+		events.erase(events.begin(), events.begin() + (size_t)stale);
+	}
+
+	return events;
+}
+
+//======================================================================
+// Layout, native byte order:
+//	magic[8], double ticksPerSecond
+//	uint32 formats, then per format uint32 length and the text
+//	uint32 buffers, then per buffer uint32 thread, uint64 lost,
+//	uint32 events and the Event records
+//======================================================================
+bool TraceBuffer::save(FILE *fout)
+{
+	std::vector<std::string> formats = getFormats();
+	std::vector<std::shared_ptr<TraceBuffer>> buffers = getBuffers();
+
+	double rate = ParseProfiler::ticksPerSecond();
+
+	fwrite(TRACE_MAGIC, 1, 8, fout);
+	fwrite(&rate, sizeof(rate), 1, fout);
+
+	uint32_t count = (uint32_t)formats.size();
+	fwrite(&count, sizeof(count), 1, fout);
+
+	for (auto iter = formats.begin(); iter != formats.end(); iter++)
+	{
+		uint32_t length = (uint32_t)iter->size();
+		fwrite(&length, sizeof(length), 1, fout);
+		fwrite(iter->data(), 1, length, fout);
+	}
+
+	count = (uint32_t)buffers.size();
+	fwrite(&count, sizeof(count), 1, fout);
+
+	for (auto iter = buffers.begin(); iter != buffers.end(); iter++)
+	{
+		std::vector<Event> events = (*iter)->snapshot();
+
+		uint32_t thread = (*iter)->getThread();
+		uint64_t lost = (*iter)->getRecorded() - events.size();
+		uint32_t size = (uint32_t)events.size();
+
+		fwrite(&thread, sizeof(thread), 1, fout);
+		fwrite(&lost, sizeof(lost), 1, fout);
+		fwrite(&size, sizeof(size), 1, fout);
+		if (size)
+			fwrite(events.data(), sizeof(Event), size, fout);
+	}
+
+	return !ferror(fout);
+}
+
+//======================================================================
+//
+//======================================================================
+bool TraceBuffer::save(const char *filename)
+{
+	FILE *fout = fopen(filename, "wb");
+	if (!fout)
+		return false;
+
+	bool ok = save(fout);
+	return fclose(fout) == 0 && ok;
+}
+
+//======================================================================
+//
+//======================================================================
+TraceDecoder::TraceDecoder()
+{
+	m_ticksPerSecond	= 0;
+	m_lost				= 0;
+}
+
+//======================================================================
+//
+//======================================================================
+void TraceDecoder::sort()
+{
+	std::stable_sort(m_records.begin(), m_records.end(), [](const Record &a, const Record &b)
+	{
+		return a.event.timestamp < b.event.timestamp;
+	});
+}
+
+//======================================================================
+//
+//======================================================================
+void TraceDecoder::capture()
+{
+	m_formats = TraceBuffer::getFormats();
+	m_ticksPerSecond = ParseProfiler::ticksPerSecond();
+	m_records.clear();
+	m_lost = 0;
+
+	std::vector<std::shared_ptr<TraceBuffer>> buffers = TraceBuffer::getBuffers();
+	for (auto iter = buffers.begin(); iter != buffers.end(); iter++)
+	{
+		std::vector<TraceBuffer::Event> events = (*iter)->snapshot();
+		m_lost += (*iter)->getRecorded() - events.size();
+
+		for (auto event = events.begin(); event != events.end(); event++)
+		{
+			Record record;
+			record.thread = (*iter)->getThread();
+			record.event = *event;
+			m_records.push_back(record);
+		}
+	}
+
+	sort();
+}
+
+//======================================================================
+//
+//======================================================================
+bool TraceDecoder::load(FILE *fin)
+{
+	char magic[8];
+	if (fread(magic, 1, 8, fin) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0)
+		return false;
+
+	if (fread(&m_ticksPerSecond, sizeof(m_ticksPerSecond), 1, fin) != 1)
+		return false;
+
+	m_formats.clear();
+	m_records.clear();
+	m_lost = 0;
+
+	uint32_t count;
+	if (fread(&count, sizeof(count), 1, fin) != 1)
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t length;
+		if (fread(&length, sizeof(length), 1, fin) != 1)
+			return false;
+
+		std::string text(length, 0);
+		if (length && fread(&text[0], 1, length, fin) != length)
+			return false;
+
+		m_formats.push_back(text);
+	}
+
+	if (fread(&count, sizeof(count), 1, fin) != 1)
+		return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t thread, size;
+		uint64_t lost;
+
+		if (fread(&thread, sizeof(thread), 1, fin) != 1 || fread(&lost, sizeof(lost), 1, fin) != 1 || fread(&size, sizeof(size), 1, fin) != 1)
+			return false;
+
+		m_lost += lost;
+
+		for (uint32_t e = 0; e < size; e++)
+		{
+			Record record;
+			record.thread = thread;
+			if (fread(&record.event, sizeof(record.event), 1, fin) != 1)
+				return false;
+
+			m_records.push_back(record);
+		}
+	}
+
+	sort();
+	return true;
+}
+
+//======================================================================
+//
+//======================================================================
+bool TraceDecoder::load(const char *filename)
+{
+	FILE *fin = fopen(filename, "rb");
+	if (!fin)
+		return false;
+
+	bool ok = load(fin);
+	fclose(fin);
+
+	return ok;
+}
+
+//======================================================================
+// Walk the format one conversion at a time, handing each its argument
+// converted to what the conversion expects. Length modifiers in the
+// original are dropped, as every value was widened when recorded.
+//======================================================================
+std::string TraceDecoder::format(const TraceBuffer::Event &event) const
+{
+	if (event.format >= m_formats.size())
+		return "(unknown trace format)";
+
+	const char *p = m_formats[event.format].c_str();
+	std::string out;
+
+	unsigned arg = 0, slot = 0;
+
+	// next argument as an integer, or its text for %s
+	auto nextInt = [&](int64_t &value) -> bool
+	{
+		if (arg >= event.count)
+			return false;
+
+		uint8_t type = event.types[arg++];
+		if (type == TraceBuffer::TA_DOUBLE)
+		{
+			double d;
+			memcpy(&d, &event.args[slot++], sizeof(d));
+			value = (int64_t)d;
+		}
+		else if (type == TraceBuffer::TA_STRING)
+		{
+			slot += (unsigned)(strlen((const char*)&event.args[slot]) / sizeof(uint64_t)) + 1;
+			value = 0;
+		}
+		else if (type == TraceBuffer::TA_NONE)
+		{
+			value = 0;
+		}
+		else
+		{
+			value = (int64_t)event.args[slot++];
+		}
+
+		return true;
+	};
+
+	while (*p)
+	{
+		if (*p != '%')
+		{
+			out += *p++;
+			continue;
+		}
+
+		if (p[1] == '%')
+		{
+			out += '%';
+			p += 2;
+			continue;
+		}
+
+		// %[flags][width][.precision][length]conversion
+		std::string spec = "%";
+		p++;
+
+		while (*p && strchr("-+ #0", *p))
+			spec += *p++;
+
+		int64_t star;
+		if (*p == '*')
+		{
+			p++;
+			spec += std::to_string(nextInt(star) ? (long long)star : 0);
+		}
+
+		while (*p >= '0' && *p <= '9')
+			spec += *p++;
+
+		if (*p == '.')
+		{
+			spec += *p++;
+			if (*p == '*')
+			{
+				p++;
+				spec += std::to_string(nextInt(star) ? (long long)star : 0);
+			}
+
+			while (*p >= '0' && *p <= '9')
+				spec += *p++;
+		}
+
+		while (*p && strchr("hljztL", *p))
+			p++;
+
+		char conversion = *p;
+		if (!conversion)
+			break;
+		p++;
+
+		char buf[128];
+		buf[0] = 0;
+
+		if (arg >= event.count)
+		{
+			out += "(?)";
+			continue;
+		}
+
+		uint8_t type = event.types[arg];
+
+		switch (conversion)
+		{
+		case 'd': case 'i': case 'c':
+		case 'u': case 'o': case 'x': case 'X':
+			{
+				int64_t value;
+				nextInt(value);
+
+				if (conversion == 'c')
+					snprintf(buf, sizeof(buf), (spec + 'c').c_str(), (int)value);
+				else if (conversion == 'd' || conversion == 'i')
+					snprintf(buf, sizeof(buf), (spec + "ll" + conversion).c_str(), (long long)value);
+				else
+					snprintf(buf, sizeof(buf), (spec + "ll" + conversion).c_str(), (unsigned long long)value);
+			}
+			break;
+
+		case 'f': case 'F': case 'e': case 'E':
+		case 'g': case 'G': case 'a': case 'A':
+			{
+				double value = 0;
+				arg++;
+
+				if (type == TraceBuffer::TA_DOUBLE || type == TraceBuffer::TA_RAW)
+					memcpy(&value, &event.args[slot++], sizeof(value));
+				else if (type == TraceBuffer::TA_INT)
+					value = (double)(int64_t)event.args[slot++];
+				else if (type == TraceBuffer::TA_UINT || type == TraceBuffer::TA_POINTER)
+					value = (double)event.args[slot++];
+				else if (type == TraceBuffer::TA_STRING)
+					slot += (unsigned)(strlen((const char*)&event.args[slot]) / sizeof(uint64_t)) + 1;
+
+				snprintf(buf, sizeof(buf), (spec + conversion).c_str(), value);
+			}
+			break;
+
+		case 's':
+			arg++;
+			if (type == TraceBuffer::TA_STRING)
+			{
+				const char *text = (const char*)&event.args[slot];
+				slot += (unsigned)(strlen(text) / sizeof(uint64_t)) + 1;
+
+				// the text can be longer than the stack buffer
+				int length = snprintf(nullptr, 0, (spec + 's').c_str(), text);
+				if (length > 0)
+				{
+					std::string piece(length + 1, 0);
+					snprintf(&piece[0], piece.size(), (spec + 's').c_str(), text);
+					piece.resize(length);
+					out += piece;
+				}
+			}
+			else
+			{
+				if (type != TraceBuffer::TA_NONE)
+					slot++;
+				out += "(?)";
+			}
+			continue;
+
+		case 'p':
+			arg++;
+			snprintf(buf, sizeof(buf), "%p", (void*)(uintptr_t)(type == TraceBuffer::TA_NONE ? 0 : event.args[slot++]));
+			break;
+
+		default:
+			// something we don't understand, show it as it was
+			out += spec;
+			out += conversion;
+			continue;
+		}
+
+		out += buf;
+	}
+
+	return out;
+}
+
+//======================================================================
+//
+//======================================================================
+void TraceDecoder::render(FILE *fout) const
+{
+	if (m_records.empty())
+		return;
+
+	double usPerTick = m_ticksPerSecond > 0 ? 1e6 / m_ticksPerSecond : 0;
+	uint64_t first = m_records.front().event.timestamp;
+
+	for (auto iter = m_records.begin(); iter != m_records.end(); iter++)
+	{
+		std::string text = format(iter->event);
+
+		// yylog() callers often end with a newline, puts() adds one anyway
+		while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+			text.pop_back();
+
+		fprintf(fout, "%12.3f [%u] %s\n", (iter->event.timestamp - first) * usPerTick, iter->thread, text.c_str());
+	}
+
+	if (m_lost)
+		fprintf(fout, "%llu older event(s) were overwritten\n", (unsigned long long)m_lost);
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#ifndef __TRACEBUFFER_H
+#define __TRACEBUFFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#define DEFAULT_TRACE_EVENTS	65536
+#define MAX_TRACE_ARGS			5
+
+//======================================================================
+// Record a trace event if this thread is tracing, e.g.
+//
+//	YYTRACE("found key %s at depth %d", key.c_str(), depth);
+//
+// The format is registered once per call site and must be a literal;
+// the arguments are evaluated once more the first time through.
+//======================================================================
+#define YYTRACE(...) \
+	do \
+	{ \
+		if (TraceBuffer *_pTrace = TraceBuffer::current()) \
+		{ \
+			static const unsigned _traceFormat = TraceBuffer::formatId(__VA_ARGS__); \
+			_pTrace->record(_traceFormat, __VA_ARGS__); \
+		} \
+	} while (0)
+
+// drop-in for yylog(): binary when this thread is tracing, text with yydebug
+#define YYLOG(...) \
+	do \
+	{ \
+		if (TraceBuffer *_pTrace = TraceBuffer::current()) \
+		{ \
+			static const unsigned _traceFormat = TraceBuffer::formatId(__VA_ARGS__); \
+			_pTrace->record(_traceFormat, __VA_ARGS__); \
+		} \
+		else if (yydebug) \
+		{ \
+			yylog(__VA_ARGS__); \
+		} \
+	} while (0)
+
+//======================================================================
+// A per-thread ring of fixed size binary trace events.
+//
+// Recording stores the format's id, a timestamp and the raw argument
+// bits, nothing is formatted; TraceDecoder renders the text later, from
+// the live buffers or from a file written by save(). Strings are copied
+// into the event, truncated to the room left in it. When the ring is
+// full the oldest events are overwritten.
+//
+// Only the owning thread writes to a buffer, so recording takes no
+// locks. Buffers stay registered after stop() so they can be saved once
+// the threads are done; clear() drops them and must not race a thread
+// that is still recording.
+//======================================================================
+class TraceBuffer
+{
+public:
+	enum ArgType : uint8_t
+	{
+		TA_NONE,
+		TA_INT,			// sign extended
+		TA_UINT,
+		TA_DOUBLE,		// the double's bits
+		TA_STRING,		// NUL terminated text from this slot on
+		TA_POINTER,
+		TA_RAW			// bits of some other small value
+	};
+
+	// one cache line
+	struct Event
+	{
+		uint64_t timestamp;
+		uint16_t format;
+		uint8_t count;
+		uint8_t types[MAX_TRACE_ARGS];
+		uint64_t args[6];
+	};
+
+protected:
+	std::unique_ptr<Event[]> m_events;
+	uint64_t m_mask;
+	std::atomic<uint64_t> m_next;
+	std::atomic<bool> m_recording;		// some thread has it as current()
+	unsigned m_thread;
+
+	static thread_local TraceBuffer *s_pCurrent;
+
+	static unsigned registerFormat(const char *fmt);
+
+	// argument packing, one overload per kind of value
+	static void pack(Event &, unsigned &, unsigned &)
+	{
+	}
+
+	template <class T, class... Rest>
+	static void pack(Event &event, unsigned &slot, unsigned &count, const T &value, const Rest&... rest)
+	{
+		if (count < MAX_TRACE_ARGS && slot < 6)
+		{
+			event.types[count++] = store(event, slot, value);
+			pack(event, slot, count, rest...);
+		}
+	}
+
+	template <class T>
+	static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, ArgType>::type
+	store(Event &event, unsigned &slot, T value)
+	{
+		if (std::is_signed<T>::value || std::is_enum<T>::value)
+		{
+			event.args[slot++] = (uint64_t)(int64_t)value;
+			return TA_INT;
+		}
+
+		event.args[slot++] = (uint64_t)value;
+		return TA_UINT;
+	}
+
+	static ArgType store(Event &event, unsigned &slot, double value)
+	{
+		memcpy(&event.args[slot++], &value, sizeof(value));
+		return TA_DOUBLE;
+	}
+
+	static ArgType store(Event &event, unsigned &slot, float value)	{ return store(event, slot, (double)value); }
+	static ArgType store(Event &event, unsigned &slot, const char *text);
+	static ArgType store(Event &event, unsigned &slot, char *text)				{ return store(event, slot, (const char*)text); }
+	static ArgType store(Event &event, unsigned &slot, const std::string &text)	{ return store(event, slot, text.c_str()); }
+
+	template <class T>
+	static ArgType store(Event &event, unsigned &slot, const T *p)
+	{
+		event.args[slot++] = (uint64_t)(uintptr_t)p;
+		return TA_POINTER;
+	}
+
+	template <class T>
+	static typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value && !std::is_pointer<T>::value && !std::is_array<T>::value, ArgType>::type
+	store(Event &event, unsigned &slot, const T &value)
+	{
+		// e.g. a YYSTYPE union; keep the bits if they fit
+		if (sizeof(T) > sizeof(uint64_t) || !std::is_trivially_copyable<T>::value)
+			return TA_NONE;
+
+		event.args[slot] = 0;
+		memcpy(&event.args[slot++], &value, sizeof(T));
+		return TA_RAW;
+	}
+
+public:
+	TraceBuffer(size_t events, unsigned thread);
+
+	TraceBuffer(const TraceBuffer&) = delete;
+	TraceBuffer &operator=(const TraceBuffer&) = delete;
+
+	// this thread's buffer, nullptr when it isn't tracing
+	static TraceBuffer *current()	{ return s_pCurrent; }
+
+	// begin or end tracing on the calling thread; events is rounded up to
+	// a power of two
+	static TraceBuffer *start(size_t events = DEFAULT_TRACE_EVENTS);
+	static void stop();
+
+	// every buffer started so far
+	static std::vector<std::shared_ptr<TraceBuffer>> getBuffers();
+	static void clear();
+
+	// format strings are numbered once per process
+	template <class... Args>
+	static unsigned formatId(const char *fmt, const Args&...)	{ return registerFormat(fmt); }
+	static std::vector<std::string> getFormats();
+
+	template <class... Args>
+	void record(unsigned format, const char *, const Args&... args)
+	{
+		uint64_t index = m_next.load(std::memory_order_relaxed);
+		Event &event = m_events[index & m_mask];
+
+		event.timestamp	= now();
+		event.format	= (uint16_t)format;
+
+		unsigned slot = 0, count = 0;
+		pack(event, slot, count, args...);
+		event.count = (uint8_t)count;
+
+		m_next.store(index + 1, std::memory_order_release);
+	}
+
+	// the events still in the ring, oldest first; safe to call while the
+	// owner is recording, at the cost of the oldest one or two
+	std::vector<Event> snapshot() const;
+
+	uint64_t getRecorded() const	{ return m_next.load(std::memory_order_acquire); }
+	uint64_t getLost() const;
+	size_t getCapacity() const		{ return (size_t)m_mask + 1; }
+	unsigned getThread() const		{ return m_thread; }
+
+	static uint64_t now();
+
+	// write every buffer and the format table for TraceDecoder
+	static bool save(FILE *fout);
+	static bool save(const char *filename);
+};
+
+//======================================================================
+// Turns binary trace events back into text, merged across threads in
+// timestamp order
+//======================================================================
+class TraceDecoder
+{
+public:
+	struct Record
+	{
+		unsigned thread;
+		TraceBuffer::Event event;
+	};
+
+protected:
+	std::vector<std::string> m_formats;
+	std::vector<Record> m_records;
+	double m_ticksPerSecond;
+	uint64_t m_lost;
+
+	void sort();
+
+public:
+	TraceDecoder();
+
+	// from the live buffers of this process
+	void capture();
+
+	// from a file written by TraceBuffer::save()
+	bool load(FILE *fin);
+	bool load(const char *filename);
+
+	const std::vector<Record> &getRecords() const	{ return m_records; }
+	uint64_t getLost() const						{ return m_lost; }
+
+	// the message an event was recorded with
+	std::string format(const TraceBuffer::Event &event) const;
+
+	// one line per event: microseconds since the first, thread, message
+	void render(FILE *fout) const;
+};
+
+#endif	// __TRACEBUFFER_H